@@ -4,9 +4,11 @@
 // 
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <utility>
 #include <string>
+#include <unordered_map>
 
 #include "AppxPackaging.hpp"
 #include "ComHelper.hpp"
@@ -27,21 +29,34 @@ namespace MSIX {
     // For now, we only support Bcp47 tags that contains language, script and region,
     // which covers the basic Bcp47 language matching. We need a proper Bcp47
     // language matching API that handle all the special cases and the full Bcp47 format.
+    // The tag keeps the subtags as they were written for GetFullTag. Comparisons are case insensitive and use a
+    // lowercase form computed once, with the language and script packed in one number.
     class Bcp47Tag final
     {
     public:
         Bcp47Tag(const std::string& fullTag);
         Bcp47Tag(const std::string& language, const std::string& script, const std::string& region) : 
-            m_language(language), m_script(script), m_region(region) {} 
+            m_language(language), m_script(script), m_region(region) { Normalize(); }
 
-        Bcp47ClosenessMeasure Compare(const Bcp47Tag& otherTag);
-        Bcp47ClosenessMeasure CompareNeutral(const Bcp47Tag& otherTag);
+        Bcp47ClosenessMeasure Compare(const Bcp47Tag& otherTag) const;
+        Bcp47ClosenessMeasure CompareNeutral(const Bcp47Tag& otherTag) const;
         const std::string GetFullTag() const;
 
+        // Same for tags with the same language and script
+        std::uint64_t GetKey() const { return m_key; }
+        // und-*
+        bool IsAnyLanguage() const { return m_isAnyLanguage; }
+
     protected:
+        void Normalize();
+        Bcp47ClosenessMeasure Compare(const Bcp47Tag& otherTag, const std::string& region) const;
+
         std::string m_language;
         std::string m_script;
         std::string m_region;
+        std::uint64_t m_key = 0;
+        std::string m_normalizedRegion;
+        bool m_isAnyLanguage = false;
     };
 
     class Applicability
@@ -60,6 +75,8 @@ namespace MSIX {
     private:
         MSIX_PLATFORMS GetPlatform();
         std::vector<Bcp47Tag> GetLanguages();
+        void IndexLanguages();
+        std::size_t FindFirstMatchingLanguage(const Bcp47Tag& packageLanguage) const;
 
         bool m_hasExactLanguageMatch = false;
         bool m_matchApplicationPackage = false;
@@ -68,5 +85,9 @@ namespace MSIX {
         std::vector<std::pair<std::string, ComPtr<IAppxPackageReader>>> m_extraApplicationPackages;
         MSIX_APPLICABILITY_OPTIONS m_applicabilityFlags = MSIX_APPLICABILITY_OPTIONS::MSIX_APPLICABILITY_OPTION_FULL;
         std::vector<Bcp47Tag> m_languages;
+        // First user language for each language and script, and the first und-* one. A package language can only
+        // match user languages with the same language and script, or any of them if one of the two is und.
+        std::unordered_map<std::uint64_t, std::size_t> m_firstLanguageByKey;
+        std::size_t m_firstAnyLanguage = std::string::npos;
     };
 }
\ No newline at end of file
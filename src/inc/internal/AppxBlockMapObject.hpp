@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <string>
 #include <map>
+#include <memory>
 #include <vector>
 #include <iterator>
 
@@ -38,10 +39,21 @@ MSIX_INTERFACE(IAppxBlockMapInternal, 0x67fed21a,0x70ef,0x4175,0x8f,0x12,0x41,0x
 
 namespace MSIX {
 
+    struct BlockMapEntry
+    {
+        std::vector<Block> blocks;
+        std::uint32_t      localFileHeaderSize;
+        std::uint64_t      uncompressedSize;
+    };
+
+    // Files of AppxBlockMap.xml by name. Immutable once read, so the blockmap objects read from the same
+    // bytes share it through the factory's document cache.
+    typedef std::map<std::string, BlockMapEntry> BlockMapTable;
+
     class AppxBlockMapBlock final : public MSIX::ComClass<AppxBlockMapBlock, IAppxBlockMapBlock>
     {
     public:
-        AppxBlockMapBlock(IMsixFactory* factory, Block* block) :
+        AppxBlockMapBlock(IMsixFactory* factory, const Block* block) :
             m_factory(factory),
             m_block(block)
         {}
@@ -62,7 +74,7 @@ namespace MSIX {
 
     private:
         IMsixFactory* m_factory;
-        Block*        m_block;
+        const Block*  m_block;
     };
 
     class AppxBlockMapFile final : public MSIX::ComClass<AppxBlockMapFile, IAppxBlockMapFile, IAppxBlockMapFileUtf8 >
@@ -70,7 +82,7 @@ namespace MSIX {
     public:
         AppxBlockMapFile(
             IMsixFactory* factory,
-            std::vector<Block>* blocks,
+            const std::vector<Block>* blocks,
             std::uint32_t localFileHeaderSize,
             const std::string& name,
             std::uint64_t uncompressedSize
@@ -137,7 +149,7 @@ namespace MSIX {
 
     private:
         std::vector<ComPtr<IAppxBlockMapBlock>> m_blockMapBlocks;
-        std::vector<Block>* m_blocks;
+        const std::vector<Block>* m_blocks;
         IMsixFactory*       m_factory;
         std::uint32_t       m_localFileHeaderSize;
         std::string         m_name;
@@ -171,7 +183,7 @@ namespace MSIX {
         HRESULT STDMETHODCALLTYPE GetFile(LPCSTR filename, IAppxBlockMapFile **file) noexcept override;
 
     protected:
-        std::map<std::string, std::vector<Block>>        m_blockMap;
+        std::shared_ptr<const BlockMapTable>             m_blockMap;
         std::map<std::string, ComPtr<IAppxBlockMapFile>> m_blockMapFiles;
         IMsixFactory*   m_factory;
         ComPtr<IStream> m_stream;
@@ -20,8 +20,9 @@ namespace MSIX {
         BlockMapWriter();
 
         void AddFile(const std::string& name, std::uint64_t uncompressedSize, std::uint32_t lfh);
-        void AddBlock(const std::vector<std::uint8_t>& block, ULONG size, bool isCompressed);
-        void CloseFile();
+        // The hashes are computed by BlockPipeline while the file is written.
+        void AddBlockHash(const std::vector<std::uint8_t>& hash, ULONG size, bool isCompressed);
+        void CloseFile(const std::vector<std::uint8_t>& fileHash);
         void Close();
         ComPtr<IStream> GetStream() { return m_xmlWriter.GetStream(); }
 
@@ -29,7 +30,6 @@ namespace MSIX {
         XmlWriter m_xmlWriter;
 
     private:
-        MSIX::SHA256 m_fileHashEngine;
         bool m_addFileHash = false;
     };
 }
\ No newline at end of file
@@ -8,12 +8,18 @@
 #include "ComHelper.hpp"
 #include "DirectoryObject.hpp"
 #include "AppxBlockMapWriter.hpp"
+#include "BlockPipeline.hpp"
 #include "ContentTypeWriter.hpp"
 #include "ZipObjectWriter.hpp"
 #include "BundleWriterHelper.hpp"
 #include "BundleManifestWriter.hpp"
 #include "AppxPackageInfo.hpp"
 
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
 // internal interface
 // {ca90bcd9-78a2-4773-820c-0b687de49f99}
 #ifndef WIN32
@@ -69,6 +75,13 @@ namespace MSIX {
 
         void AddPackageReferenceInternal(std::string fileName, IStream* packageStream, bool isDefaultApplicablePackage);
 
+        ComPtr<IAppxManifestReader> ReadReferencedPackage(IStream* packageStream);
+
+        void AddPackageReferences(const std::vector<std::pair<std::string, std::string>>& packages,
+            const std::function<ComPtr<IStream>(const std::string&)>& open);
+
+        void AddPayloadPackageInternal(const std::string& fileName, IStream* packageStream, bool isDefaultApplicablePackage);
+
         void AddExternalPackageReferenceInternal(std::string fileName, IStream* packageStream, bool isDefaultApplicablePackage);
             
         void ValidateAndAddPayloadFile(const std::string& name, IStream* stream, APPX_COMPRESSION_OPTION compressionOpt, const char* contentType);
@@ -80,6 +93,7 @@ namespace MSIX {
         ComPtr<IZipWriter> m_zipWriter;
         BlockMapWriter m_blockMapWriter;
         ContentTypeWriter m_contentTypeWriter;
+        BlockPipelinePool m_pipelines;
         BundleWriterHelper m_bundleWriterHelper;
     };
 }
@@ -10,10 +10,13 @@
 #include "MSIXFactory.hpp"
 #include "IXml.hpp"
 #include "StorageObject.hpp"
+#include "DocumentCache.hpp"
 
 #include <string>
 #include <vector>
 #include <array>
+#include <map>
+#include <mutex>
 
 namespace MSIX {
 
@@ -39,7 +42,7 @@ namespace MSIX {
         APPXSIGNATURE_P7X,
     };
 
-    class AppxFactory final : public ComClass<AppxFactory, IMsixFactory, IAppxFactory, IXmlFactory, IAppxBundleFactory, IMsixFactoryOverrides, IAppxFactoryUtf8>
+    class AppxFactory final : public ComClass<AppxFactory, IMsixFactory, IAppxFactory, IXmlFactory, IAppxBundleFactory, IMsixFactoryOverrides, IAppxFactoryUtf8, IMsixDocumentCache>
     {
     public:
         AppxFactory(MSIX_VALIDATION_OPTION validationOptions, MSIX_APPLICABILITY_OPTIONS applicability, COTASKMEMALLOC* memalloc, COTASKMEMFREE* memfree ) : 
@@ -48,7 +51,14 @@ namespace MSIX {
             ThrowErrorIf(Error::InvalidParameter, (m_memalloc == nullptr || m_memfree == nullptr), "allocator/deallocator pair not specified.")
             ComPtr<IMsixFactory> self;
             ThrowHrIfFailed(QueryInterface(UuidOfImpl<IMsixFactory>::iid, reinterpret_cast<void**>(&self)));
-            m_xmlFactory = CreateXmlFactory(self.Get());
+            if (validationOptions & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION)
+            {
+                m_xmlFactory = CreateLiteXmlFactory(self.Get());
+            }
+            else
+            {
+                m_xmlFactory = CreateXmlFactory(self.Get());
+            }
         }
 
         ~AppxFactory() {}
@@ -69,9 +79,10 @@ namespace MSIX {
         HRESULT MarshalOutString(std::string& internal, LPWSTR *result) noexcept override;
         HRESULT MarshalOutWstring(std::wstring& internal, LPWSTR* result) noexcept override;
         HRESULT MarshalOutStringUtf8(std::string& internal, LPSTR* result) noexcept override;
-        HRESULT MarshalOutBytes(std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) noexcept override;
+        HRESULT MarshalOutBytes(const std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) noexcept override;
         MSIX_VALIDATION_OPTION GetValidationOptions() override { return m_validationOptions; }
         ComPtr<IStream> GetResource(const std::string& resource) override;
+        DocumentCache& GetDocumentCache() override { return m_documentCache; }
 
         // IXmlFactory
         MSIX::ComPtr<IXmlDom> CreateDomFromStream(XmlContentType footPrintType, const ComPtr<IStream>& stream) override
@@ -86,15 +97,25 @@ namespace MSIX {
         // IAppxFactoryUtf8
         HRESULT STDMETHODCALLTYPE CreateValidatedBlockMapReader(IStream* blockMapStream, LPCSTR signatureFileName, IAppxBlockMapReader** blockMapReader) noexcept override;
 
+        // IMsixDocumentCache
+        HRESULT STDMETHODCALLTYPE SetSizeLimit(UINT64 sizeLimit) noexcept override;
+        HRESULT STDMETHODCALLTYPE Prewarm(IStream* packageStream) noexcept override;
+        HRESULT STDMETHODCALLTYPE Clear() noexcept override;
+        HRESULT STDMETHODCALLTYPE GetStatistics(MSIX_DOCUMENT_CACHE_STATISTICS* statistics) noexcept override;
+
         ComPtr<IXmlFactory> m_xmlFactory;
         COTASKMEMALLOC* m_memalloc;
         COTASKMEMFREE*  m_memfree;
         MSIX_VALIDATION_OPTION m_validationOptions;
         ComPtr<IStorageObject> m_resourcezip;
         std::vector<std::uint8_t> m_resourcesVector;
+        // Resources are read while validating inner packages of a bundle on several threads.
+        std::mutex m_resourceLock;
+        std::map<std::string, std::vector<std::uint8_t>> m_resources;
         MSIX_APPLICABILITY_OPTIONS m_applicabilityFlags;
         ComPtr<IMsixStreamFactory> m_streamFactory;
         ComPtr<IMsixApplicabilityLanguagesEnumerator> m_applicabilityLanguagesEnumerator;
+        DocumentCache m_documentCache;
 
     private:
         template<typename T>
@@ -9,6 +9,7 @@
 #include <algorithm>
 #include <iostream>
 #include <limits>
+#include <functional>
 
 #include "MSIXWindows.hpp"
 #include "AppxPackaging.hpp"
@@ -91,4 +92,79 @@ namespace MSIX {
         IMsixFactory* m_factory;
         std::uint64_t m_size;
     };
+
+    // File whose stream is only opened when it is first requested. Used for payload packages of a bundle
+    // that were not validated when the bundle was opened; open validates the package. The size is known
+    // upfront, so it can be queried without opening the file. A failure to open is returned again by every
+    // later call.
+    class DeferredAppxFile final : public ComClass<DeferredAppxFile, IAppxFile, IAppxFileUtf8>
+    {
+    public:
+        DeferredAppxFile(IMsixFactory* factory, const std::string& name, std::uint64_t size, std::function<ComPtr<IStream>()> open) :
+            m_name(name), m_factory(factory), m_size(size), m_open(std::move(open))
+        {}
+
+        // IAppxFile methods
+        HRESULT STDMETHODCALLTYPE GetCompressionOption(APPX_COMPRESSION_OPTION* compressionOption) noexcept override
+        {   // Payload packages can't be compressed
+            if (compressionOption) { *compressionOption = APPX_COMPRESSION_OPTION_NONE; }
+            return static_cast<HRESULT>(Error::OK);
+        }
+
+        HRESULT STDMETHODCALLTYPE GetContentType(LPWSTR* contentType) noexcept override
+        {
+            return static_cast<HRESULT>(Error::NotImplemented);
+        }
+
+        HRESULT STDMETHODCALLTYPE GetName(LPWSTR* fileName) noexcept override try
+        {
+            return m_factory->MarshalOutString(m_name, fileName);
+        } CATCH_RETURN();
+
+        HRESULT STDMETHODCALLTYPE GetSize(UINT64* size) noexcept override try
+        {
+            if (size)
+            {
+                *size = m_size;
+            }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        HRESULT STDMETHODCALLTYPE GetStream(IStream** stream) noexcept override try
+        {
+            ThrowErrorIf(Error::InvalidParameter, (stream == nullptr || *stream != nullptr), "bad pointer");
+            if (!m_stream && SUCCEEDED(m_openResult))
+            {
+                m_openResult = Open();
+            }
+            ThrowHrIfFailed(m_openResult);
+            *stream = m_stream.As<IStream>().Detach();
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        // IAppxFileUtf8
+        HRESULT STDMETHODCALLTYPE GetContentType(LPSTR* contentType) noexcept override
+        {
+            return static_cast<HRESULT>(Error::NotImplemented);
+        }
+
+        HRESULT STDMETHODCALLTYPE GetName(LPSTR* fileName) noexcept override try
+        {
+            return m_factory->MarshalOutStringUtf8(m_name, fileName);
+        } CATCH_RETURN();
+
+    protected:
+        HRESULT Open() noexcept try
+        {
+            m_stream = m_open();
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        std::string m_name;
+        ComPtr<IStream> m_stream;
+        IMsixFactory* m_factory;
+        std::uint64_t m_size;
+        std::function<ComPtr<IStream>()> m_open;
+        HRESULT m_openResult = static_cast<HRESULT>(Error::OK);
+    };
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <vector>
 #include <memory>
 #include <map>
+#include <mutex>
 
 #include "AppxPackaging.hpp"
 #include "AppxPackageInfo.hpp"
@@ -410,7 +411,16 @@ namespace MSIX {
         DX_FEATURE_LEVEL m_DXFeatureLevel;
     };
 
-    // Object backed by AppxManifest.xml
+    // Parsed and validated AppxManifest.xml, shared through the factory's document cache by the manifest objects
+    // read from the same bytes. Reading a xerces DOM allocates from its document, so every read holds the lock.
+    struct ManifestDocument
+    {
+        ComPtr<IXmlDom> dom;
+        mutable std::mutex lock;
+    };
+
+    // Object backed by AppxManifest.xml. The identity is read and the whole manifest validated when the object is
+    // created; every other section is read the first time it is requested.
     class AppxManifestObject final : public ComClass<AppxManifestObject, ChainInterfaces<IAppxManifestReader4, IAppxManifestReader3, IAppxManifestReader2, IAppxManifestReader>,
                                                     IAppxManifestReader5, IVerifierObject, IAppxManifestObject, IMsixDocumentElement>
     {
@@ -456,13 +466,55 @@ namespace MSIX {
         HRESULT STDMETHODCALLTYPE GetDocumentElement(IMsixElement** documentElement) noexcept override;
 
     protected:
+        template<typename T>
+        struct Section
+        {
+            bool loaded = false;
+            T value;
+        };
+
+        // Returns the value of the section, reading it from the manifest on first use.
+        template<typename T>
+        const T& Load(Section<T>& section, T (AppxManifestObject::*read)())
+        {
+            std::lock_guard<std::mutex> lock(m_document->lock);
+            if (!section.loaded)
+            {
+                section.value = (this->*read)();
+                section.loaded = true;
+            }
+            return section.value;
+        }
+
+        // Validates the sections that are read on demand, so their errors are reported at open.
+        void Validate();
+
+        ComPtr<IAppxManifestProperties> ReadProperties();
+        std::vector<ComPtr<IAppxManifestPackageDependency>> ReadPackageDependencies();
+        std::vector<std::pair<std::string, APPX_CAPABILITY_CLASS_TYPE>> ReadCapabilities();
+        std::vector<ComPtr<IAppxManifestQualifiedResource>> ReadResources();
+        std::vector<ComPtr<IAppxManifestApplication>> ReadApplications();
+        std::vector<ComPtr<IAppxManifestTargetDeviceFamily>> ReadTargetDeviceFamilies();
+        std::vector<ComPtr<IAppxManifestMainPackageDependency>> ReadMainPackageDependencies();
+
         std::vector<std::string> GetCapabilities(APPX_CAPABILITY_CLASS_TYPE capabilityClass);
 
         ComPtr<IMsixFactory> m_factory;
         ComPtr<IStream> m_stream;
         ComPtr<IAppxManifestPackageId> m_packageId;
         MSIX_PLATFORMS m_platform = MSIX_PLATFORM_NONE;
-        std::vector<ComPtr<IAppxManifestTargetDeviceFamily>> m_tdf;
+        std::shared_ptr<const ManifestDocument> m_document;
         ComPtr<IXmlDom> m_dom;
+        bool m_documentShared = false; // came from the document cache, other objects may read it
+        std::mutex m_callerDomLock;
+        ComPtr<IXmlDom> m_callerDom; // only used by GetDocumentElement, when the document is shared
+
+        Section<ComPtr<IAppxManifestProperties>> m_properties;
+        Section<std::vector<ComPtr<IAppxManifestPackageDependency>>> m_packageDependencies;
+        Section<std::vector<std::pair<std::string, APPX_CAPABILITY_CLASS_TYPE>>> m_capabilities;
+        Section<std::vector<ComPtr<IAppxManifestQualifiedResource>>> m_resources;
+        Section<std::vector<ComPtr<IAppxManifestApplication>>> m_applications;
+        Section<std::vector<ComPtr<IAppxManifestTargetDeviceFamily>>> m_tdf;
+        Section<std::vector<ComPtr<IAppxManifestMainPackageDependency>>> m_mainPackageDependencies;
     };
 }
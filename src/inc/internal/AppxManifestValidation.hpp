@@ -14,6 +14,9 @@ namespace MSIX {
         // Returns true if the given identifier is valid.
         static bool IsIdentifierValid(const std::string& identifier);
 
+        // Returns true if the given FileName of a package in the bundle manifest is valid.
+        static bool IsPackageFileNameValid(const std::string& fileName);
+
         // Validates the entire manifest; after the manifest has been validated by schema.
         static void ValidateManifest(IXmlDom* manifest);
     };
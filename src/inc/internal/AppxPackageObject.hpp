@@ -42,6 +42,11 @@ public:
 MSIX_INTERFACE(IPackage, 0x51b2c456,0xaaa9,0x46d6,0x8e,0xc9,0x29,0x82,0x20,0x55,0x91,0x89);
 
 namespace MSIX {
+    // Reads the AppxManifest.xml of a package without creating a package reader. Only the blocks of the
+    // manifest are verified against the blockmap; the signature, content types and the rest of the payload
+    // are not looked at, so the package still has to be validated by other means.
+    ComPtr<IAppxManifestReader> ReadPackageManifest(IMsixFactory* factory, const ComPtr<IStorageObject>& container);
+
     // Storage object representing the entire AppxPackage
     // Note: This class has is own implmentation of QueryInterface, if a new interface is implemented
     // AppxPackageObject::QueryInterface must also be modified too.
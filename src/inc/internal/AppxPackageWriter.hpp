@@ -8,12 +8,15 @@
 #include "ComHelper.hpp"
 #include "DirectoryObject.hpp"
 #include "AppxBlockMapWriter.hpp"
+#include "BlockPipeline.hpp"
 #include "ContentTypeWriter.hpp"
 #include "ZipObjectWriter.hpp"
 
 #include <map>
 #include <memory>
 #include <future>
+#include <functional>
+#include <vector>
 
 // internal interface
 // {32e89da5-7cbb-4443-8cf0-b84eedb51d0a}
@@ -28,10 +31,22 @@ class IPackageWriter : public IUnknown
 public:
     // TODO: add options if needed
     virtual void PackPayloadFiles(const MSIX::ComPtr<IDirectoryObject>& from) = 0;
+    // Deflated blocks are reused from, and added to, cache. Must be called before any file is added.
+    virtual void SetBlockCache(const std::shared_ptr<MSIX::BlockCache>& cache) = 0;
+    // Adds the files of a tar stream, in the order they are in it. AppxManifest.xml is not added, it is returned
+    // in manifest to be passed to Close. Returns false if the stream doesn't have it.
+    virtual bool PackPayloadTar(const MSIX::ComPtr<IStream>& tar, std::vector<std::uint8_t>& manifest) = 0;
 };
 MSIX_INTERFACE(IPackageWriter, 0x32e89da5,0x7cbb,0x4443,0x8c,0xf0,0xb8,0x4e,0xed,0xb5,0x1d,0x0a);
 
 namespace MSIX {
+
+    // Memory used to buffer compressed payload files when packing a directory.
+    static const std::uint64_t DefaultPackMemoryLimit = 64 * 1024 * 1024;
+
+    // Files of a batch are open until the batch is compressed, this keeps them within the file descriptor limit.
+    static const std::size_t MaxPayloadFilesInBatch = 256;
+
     class AppxPackageWriter final : public ComClass<AppxPackageWriter, IPackageWriter, IAppxPackageWriter,
         IAppxPackageWriterUtf8, IAppxPackageWriter3, IAppxPackageWriter3Utf8>
     {
@@ -41,6 +56,8 @@ namespace MSIX {
 
         // IPackageWriter
         void PackPayloadFiles(const ComPtr<IDirectoryObject>& from) override;
+        void SetBlockCache(const std::shared_ptr<BlockCache>& cache) override;
+        bool PackPayloadTar(const ComPtr<IStream>& tar, std::vector<std::uint8_t>& manifest) override;
 
         // IAppxPackageWriter
         HRESULT STDMETHODCALLTYPE AddPayloadFile(LPCWSTR fileName, LPCWSTR contentType,
@@ -68,6 +85,36 @@ namespace MSIX {
         }
         WriterState;
 
+        // Payload file of a batch. The stream is only opened when the file is reached, so a
+        // directory is not opened all at once.
+        struct PayloadFile
+        {
+            std::string name;
+            std::string contentType;
+            APPX_COMPRESSION_OPTION compressionOpt;
+            std::function<ComPtr<IStream>()> open;
+        };
+
+        // Payload file compressed and hashed before it is written to the package.
+        struct PreparedPayloadFile
+        {
+            const PayloadFile* file;
+            ComPtr<IStream> stream;
+            std::uint64_t uncompressedSize;
+            std::uint32_t crc;
+            std::vector<std::uint8_t> data;
+            std::vector<std::pair<std::vector<std::uint8_t>, ULONG>> blocks;
+            std::vector<std::uint8_t> fileHash;
+        };
+
+        void AddPayloadFilesInternal(const std::vector<PayloadFile>& files, std::uint64_t memoryLimit);
+
+        void PreparePayloadFile(PreparedPayloadFile& prepared);
+
+        void AddPreparedFileToPackage(PreparedPayloadFile& prepared);
+
+        void ValidatePayloadFile(const std::string& name, APPX_COMPRESSION_OPTION compressionOpt);
+
         void ValidateAndAddPayloadFile(const std::string& name, IStream* stream,
             APPX_COMPRESSION_OPTION compressionOpt, const char* contentType);
 
@@ -81,6 +128,7 @@ namespace MSIX {
         ComPtr<IZipWriter> m_zipWriter;
         BlockMapWriter m_blockMapWriter;
         ContentTypeWriter m_contentTypeWriter;
+        BlockPipelinePool m_pipelines;
     };
 }
 
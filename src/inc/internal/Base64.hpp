@@ -0,0 +1,31 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace MSIX {
+
+    // Base64 with padding and without line breaks, as used by the hashes of the blockmap. Blocks of the input are
+    // processed with SSSE3 when the processor supports it, the rest with a table based implementation.
+    class Base64
+    {
+    public:
+        static std::size_t GetEncodedSize(std::size_t size) { return ((size + 2) / 3) * 4; }
+        static std::size_t GetMaxDecodedSize(std::size_t size) { return (size / 4) * 3; }
+
+        // Writes GetEncodedSize(size) characters to output.
+        static void Encode(const std::uint8_t* data, std::size_t size, char* output);
+
+        // Writes the decoded bytes to output, which must have room for GetMaxDecodedSize(size) bytes, and returns
+        // how many were written. Throws InvalidParameter if data is not a sequence of valid four character groups.
+        static std::size_t Decode(const char* data, std::size_t size, std::uint8_t* output);
+
+        static std::string ComputeBase64(const std::vector<std::uint8_t>& buffer);
+    };
+}
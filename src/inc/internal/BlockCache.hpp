@@ -0,0 +1,74 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include "AppxPackaging.hpp"
+#include "ComHelper.hpp"
+#include "DirectoryObject.hpp"
+#include "AppxFactory.hpp"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace MSIX {
+
+    // File written in the cache directory.
+    static const char* const BLOCK_CACHE_FILE = ".msixblockcache";
+    static const std::uint64_t DefaultBlockCacheSizeLimit = 256 * 1024 * 1024;
+
+    // Deflated blocks from previous packs, keyed by the SHA256 of the uncompressed block, the compression
+    // level and the flush mode. BlockPipeline writes a cached block instead of deflating it again. Deflate
+    // state is reset by the full flush at the end of each block, so a block deflates to the same bytes
+    // wherever it is in a file and a warm pack is byte-identical to a cold one.
+    // The least recently used blocks are evicted when the cache goes over its size limit. Safe to use
+    // from several threads.
+    class BlockCache final
+    {
+    public:
+        typedef std::shared_ptr<const std::vector<std::uint8_t>> Data;
+
+        BlockCache(std::uint64_t sizeLimit) : m_sizeLimit(sizeLimit) {}
+
+        static void MakeKey(std::string& key, const std::vector<std::uint8_t>& hash, int level, int flush);
+
+        Data Find(const std::string& key);
+        void Insert(const std::string& key, const std::uint8_t* data, std::size_t size);
+
+        // Takes the deflated blocks of a package. The package must have been deflated the same way this
+        // SDK does; that is checked by deflating one of its blocks again, if it doesn't match nothing is taken.
+        // Each block is inflated and checked against its blockmap hash, blocks that don't match are skipped.
+        void Seed(IMsixFactory* factory, const ComPtr<IStream>& package);
+
+        // A missing or corrupted cache file, or one written with another zlib version, results in an empty cache.
+        // Blocks that don't inflate to the hash they are keyed by are dropped.
+        void Load(const ComPtr<IDirectoryObject>& directory);
+        // Writes to a temporary file and renames it, so the previous cache is kept if writing fails.
+        void Save(const ComPtr<IDirectoryObject>& directory);
+
+        std::uint64_t GetHits() const { return m_hits; }
+        std::uint64_t GetMisses() const { return m_misses; }
+
+    protected:
+        struct Entry
+        {
+            Data data;
+            std::list<std::string>::iterator use;
+        };
+
+        void InsertLocked(const std::string& key, Data data);
+
+        std::mutex m_lock;
+        std::map<std::string, Entry> m_entries;
+        std::list<std::string> m_uses; // least recently used first
+        std::uint64_t m_size = 0;
+        std::uint64_t m_sizeLimit;
+        std::uint64_t m_hits = 0;
+        std::uint64_t m_misses = 0;
+    };
+}
@@ -41,7 +41,7 @@ namespace MSIX {
     class BlockMapStream final : public StreamBase
     {
     public:
-        BlockMapStream(IMsixFactory* factory, std::string decodedName, const ComPtr<IStream>& stream, std::vector<Block>& blocks)
+        BlockMapStream(IMsixFactory* factory, std::string decodedName, const ComPtr<IStream>& stream, const std::vector<Block>& blocks)
             : m_factory(factory), m_decodedName(decodedName), m_stream(stream)
         {
             // Determine overall stream size
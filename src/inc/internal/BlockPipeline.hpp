@@ -0,0 +1,82 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include "AppxPackaging.hpp"
+#include "ComHelper.hpp"
+#include "Crypto.hpp"
+#include "BlockCache.hpp"
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <zlib.h>
+
+namespace MSIX {
+
+    // Reads a file one block at a time and runs crc32, SHA256 and deflate over each block while it is still
+    // in cache. The output is written straight to the destination stream. The input and output buffers and
+    // the deflate state are allocated once and reused for every block of every file.
+    class BlockPipeline final
+    {
+    public:
+        static const int CompressionLevel = Z_BEST_COMPRESSION;
+        static const int FlushMode = Z_FULL_FLUSH;
+
+        // Called for each block with the hash of the uncompressed data and the size written for it.
+        typedef std::function<void(const std::vector<std::uint8_t>& hash, ULONG outputSize)> BlockCallback;
+
+        struct Result
+        {
+            std::uint32_t crc;
+            std::uint64_t outputSize;
+        };
+
+        BlockPipeline();
+        ~BlockPipeline();
+
+        // Deflated blocks are looked up in and added to cache. May be null.
+        void SetCache(const std::shared_ptr<BlockCache>& cache) { m_cache = cache; }
+
+        // Reads size bytes from input and writes them, deflated if compress is true, to output. fileHash
+        // receives the hash of the whole file, which the blockmap only needs when there is more than one block.
+        Result Process(IStream* input, std::uint64_t size, bool compress, IStream* output,
+            const BlockCallback& onBlock, std::vector<std::uint8_t>* fileHash);
+
+    protected:
+        ULONG Deflate(IStream* output, int flush);
+        ULONG DeflateBlock(IStream* output, std::uint32_t blockSize);
+
+        z_stream m_zstrm;
+        std::vector<std::uint8_t> m_input;
+        std::vector<std::uint8_t> m_output;
+        std::vector<std::uint8_t> m_hash;
+        SHA256 m_fileHashEngine;
+        bool m_used = false;
+        std::shared_ptr<BlockCache> m_cache;
+        std::string m_key;
+        std::vector<std::uint8_t>* m_captured = nullptr;
+        std::vector<std::uint8_t> m_capture;
+    };
+
+    // Pipelines are expensive to set up, deflate alone keeps hundreds of KB of state, so they are kept
+    // for the next file. Safe to use from several threads.
+    class BlockPipelinePool final
+    {
+    public:
+        typedef std::unique_ptr<BlockPipeline, std::function<void(BlockPipeline*)>> Lease;
+
+        Lease Acquire();
+
+        void SetCache(const std::shared_ptr<BlockCache>& cache);
+
+    protected:
+        std::mutex m_lock;
+        std::shared_ptr<BlockCache> m_cache;
+        std::vector<std::unique_ptr<BlockPipeline>> m_free;
+    };
+}
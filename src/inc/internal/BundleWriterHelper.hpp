@@ -22,12 +22,12 @@ namespace MSIX {
 
         std::uint64_t GetStreamSize(IStream* stream);
 
-        void AddPackage(std::string fileName, IAppxPackageReader* packageReader, std::uint64_t bundleOffset,
+        void AddPackage(std::string fileName, IAppxManifestReader* manifestReader, std::uint64_t bundleOffset,
             std::uint64_t packageSize, bool isDefaultApplicableResource);
 
         void GetValidatedPackageData(
             std::string fileName,
-            IAppxPackageReader* packageReader,
+            IAppxManifestReader* manifestReader,
             APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE* packageType,
             IAppxManifestPackageId** packageId,
             IAppxManifestQualifiedResourcesEnumerator** resources,
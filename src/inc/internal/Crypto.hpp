@@ -46,10 +46,4 @@ namespace MSIX {
     private:
         void* m_hashContext = nullptr;
     };
-
-    class Base64
-    {
-    public:
-        static std::string ComputeBase64(const std::vector<std::uint8_t>& buffer);
-    };
 }
\ No newline at end of file
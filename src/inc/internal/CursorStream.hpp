@@ -0,0 +1,81 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "ComHelper.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace MSIX {
+
+    // Read only view of a stream with its own position. Streams that share an underlying stream, like
+    // the files of a zip container, move the same seek pointer; giving each reader a cursor over them and
+    // the same lock lets them be read from different threads.
+    class CursorStream final : public StreamBase
+    {
+    public:
+        CursorStream(const ComPtr<IStream>& stream, const std::shared_ptr<std::mutex>& lock) : m_stream(stream), m_lock(lock)
+        {
+            ThrowErrorIfNot(Error::InvalidParameter, lock, "Invalid lock");
+            LARGE_INTEGER start = { 0 };
+            ULARGE_INTEGER end = { 0 };
+            std::lock_guard<std::mutex> guard(*m_lock);
+            ThrowHrIfFailed(m_stream->Seek(start, Reference::END, &end));
+            m_size = end.QuadPart;
+        }
+
+        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override try
+        {
+            LARGE_INTEGER offset = { 0 };
+            offset.QuadPart = m_position;
+            ULONG amountRead = 0;
+            {
+                std::lock_guard<std::mutex> guard(*m_lock);
+                ThrowHrIfFailed(m_stream->Seek(offset, Reference::START, nullptr));
+                ThrowHrIfFailed(m_stream->Read(buffer, countBytes, &amountRead));
+            }
+            m_position += amountRead;
+            if (bytesRead) { *bytesRead = amountRead; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER* newPosition) noexcept override try
+        {
+            std::int64_t newPos = 0;
+            switch (origin)
+            {
+            case Reference::CURRENT:
+                newPos = static_cast<std::int64_t>(m_position) + move.QuadPart;
+                break;
+            case Reference::START:
+                newPos = move.QuadPart;
+                break;
+            case Reference::END:
+                newPos = static_cast<std::int64_t>(m_size) + move.QuadPart;
+                break;
+            }
+            // Constrain to the stream like RangeStream does, readers of the zip rely on it.
+            newPos = std::max<std::int64_t>(newPos, 0);
+            m_position = std::min(static_cast<std::uint64_t>(newPos), m_size);
+            if (newPosition) { newPosition->QuadPart = m_position; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        // IStreamInternal
+        std::uint64_t GetSize() override { return m_size; }
+        bool IsCompressed() override { return m_stream.As<IStreamInternal>()->IsCompressed(); }
+        std::string GetName() override { return m_stream.As<IStreamInternal>()->GetName(); }
+
+    protected:
+        ComPtr<IStream> m_stream;
+        std::shared_ptr<std::mutex> m_lock;
+        std::uint64_t m_size = 0;
+        std::uint64_t m_position = 0;
+    };
+}
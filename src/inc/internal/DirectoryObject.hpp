@@ -34,6 +34,15 @@ public:
     // Returns a multipmap sorted by last modified time. Use multimap in the unlikely case there are two files
     // with the same last modified time.
     virtual std::multimap<std::uint64_t, std::string> GetFilesByLastModDate() = 0;
+
+    // Returns true if a regular file with this name exists in the directory.
+    virtual bool FileExists(const std::string& fileName) = 0;
+
+    // Deletes a file by name. Returns false if the file exists and could not be deleted.
+    virtual bool RemoveFile(const std::string& fileName) = 0;
+
+    // Replaces target with source in a single step. If target already exists it is overwritten.
+    virtual void RenameFile(const std::string& source, const std::string& target) = 0;
 };
 MSIX_INTERFACE(IDirectoryObject, 0x1675f000,0x9b74,0x49bb,0xba,0x31,0x94,0xed,0x7c,0x43,0x5c,0x28);
 
@@ -57,6 +66,9 @@ namespace MSIX {
         // IDirectoryObject
         ComPtr<IStream> OpenFile(const std::string& fileName, MSIX::FileStream::Mode mode) override;
         std::multimap<std::uint64_t, std::string> GetFilesByLastModDate() override;
+        bool FileExists(const std::string& fileName) override;
+        bool RemoveFile(const std::string& fileName) override;
+        void RenameFile(const std::string& source, const std::string& target) override;
 
         char GetPathSeparator() const;
 
@@ -0,0 +1,75 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include "AppxPackaging.hpp"
+#include "ComHelper.hpp"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace MSIX {
+
+    // Parsed footprint files of the packages opened by a factory, keyed by the kind of file and the SHA256
+    // of its bytes. Values are immutable and shared by every object read from the same bytes. The validation
+    // options of a factory don't change, so the same bytes always parse to the same value; failures aren't
+    // cached. Entries are charged the memory their value holds, as estimated by the parse function, and the least
+    // recently used are evicted when the cache goes over its size limit. Disabled while the size limit is 0. Safe
+    // to use from several threads.
+    class DocumentCache final
+    {
+    public:
+        enum class Document : std::uint8_t
+        {
+            ContentTypes,
+            BlockMap,
+            Manifest,
+        };
+
+        typedef std::shared_ptr<const void> Value;
+        // Sets size to the memory held by the value it returns.
+        typedef Value (*Parse)(void* context, const ComPtr<IStream>& stream, std::uint64_t& size);
+
+        // Returns the value for the contents of stream. On a miss parse gets a stream over a copy of the bytes,
+        // so the value doesn't keep the stream alive. When the cache is disabled parse gets stream itself, and
+        // shared, if given, is set to false: the value is private to the caller.
+        template<typename T>
+        std::shared_ptr<const T> Get(Document document, const ComPtr<IStream>& stream, void* context, Parse parse,
+            bool* shared = nullptr)
+        {
+            return std::static_pointer_cast<const T>(GetValue(document, stream, context, parse, shared));
+        }
+
+        bool IsEnabled();
+        // Evicts entries over the new limit. 0 disables the cache and drops its entries.
+        void SetSizeLimit(std::uint64_t sizeLimit);
+        void Clear();
+        MSIX_DOCUMENT_CACHE_STATISTICS GetStatistics();
+
+    protected:
+        struct Entry
+        {
+            Value value;
+            std::uint64_t size;
+            std::list<std::string>::iterator use;
+        };
+
+        Value GetValue(Document document, const ComPtr<IStream>& stream, void* context, Parse parse, bool* shared);
+        void EvictLocked();
+        void ClearLocked();
+
+        std::mutex m_lock;
+        std::map<std::string, Entry> m_entries;
+        std::list<std::string> m_uses; // least recently used first
+        std::uint64_t m_size = 0;
+        std::uint64_t m_sizeLimit = 0;
+        std::uint64_t m_hits = 0;
+        std::uint64_t m_misses = 0;
+        std::uint64_t m_evictions = 0;
+    };
+}
@@ -11,6 +11,10 @@ namespace MSIX { namespace Encoding {
     std::string DecodeFileName(const std::string& fileName);
     std::string EncodeFileName(const std::string& fileName);
 
+    // Return fileName itself when it doesn't change, which is nearly always, and otherwise the result written to buffer.
+    const std::string& DecodeFileName(const std::string& fileName, std::string& buffer);
+    const std::string& EncodeFileName(const std::string& fileName, std::string& buffer);
+
     std::string Base32Encoding(const std::vector<uint8_t>& bytes);
     std::vector<std::uint8_t> GetBase64DecodedValue(const std::string& value);
 
@@ -18,7 +18,7 @@ namespace MSIX {
     class EnumeratorCom final : public MSIX::ComClass<EnumeratorCom<EnumeratorInterface, ObjectType>, EnumeratorInterface>
     {
     public:
-        EnumeratorCom(std::vector<ComPtr<ObjectType>>& objects) :
+        EnumeratorCom(const std::vector<ComPtr<ObjectType>>& objects) :
             m_objects(objects)
         {}
 
@@ -56,7 +56,7 @@ namespace MSIX {
     class EnumeratorString final : public MSIX::ComClass<EnumeratorString<EnumeratorInterface, EnumeratorInterfaceUtf8>, EnumeratorInterface, EnumeratorInterfaceUtf8>
     {
     public:
-        EnumeratorString(IMsixFactory* factory, std::vector<std::string>& values) :
+        EnumeratorString(IMsixFactory* factory, const std::vector<std::string>& values) :
             m_factory(factory), m_values(values)
         {}
 
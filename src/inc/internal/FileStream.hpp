@@ -57,6 +57,13 @@ namespace MSIX {
             m_size = end.u.LowPart;
         }
 
+        // Wraps an already opened file, like stdin or stdout. Unless ownsFile is set, the file is not closed
+        // by this object. It might not be seekable.
+        FileStream(FILE* file, const std::string& name, bool ownsFile = false) : m_name(name), m_file(file), m_ownsFile(ownsFile)
+        {
+            ThrowErrorIfNot(Error::InvalidParameter, (m_file), "invalid file");
+        }
+
         virtual ~FileStream() override
         {
             Close();
@@ -66,7 +73,8 @@ namespace MSIX {
         {
             if (m_file)
             {   // the most we would ever do w.r.t. a failure from fclose is *maybe* log something...
-                std::fclose(m_file);
+                if (m_ownsFile) { std::fclose(m_file); }
+                else { std::fflush(m_file); }
                 m_file = nullptr;
             }
         }
@@ -127,5 +135,6 @@ namespace MSIX {
         std::uint64_t m_size = 0;
         std::string m_name;
         FILE* m_file;
+        bool m_ownsFile = true;
     };
 }
@@ -23,13 +23,13 @@ namespace MSIX {
     protected:
         bool m_validated;
         ComPtr<IStream> m_stream;
-        std::vector<std::uint8_t>& m_expectedHash;
+        const std::vector<std::uint8_t>& m_expectedHash;
         std::unique_ptr<std::vector<std::uint8_t>> m_cacheBuffer;
         std::uint64_t m_relativePosition;
         size_t m_streamSize;
 
     public:
-        HashStream(const ComPtr<IStream>& stream, std::vector<std::uint8_t>& expectedHash) :
+        HashStream(const ComPtr<IStream>& stream, const std::vector<std::uint8_t>& expectedHash) :
             m_validated(false),
             m_stream(stream),
             m_expectedHash(expectedHash),
@@ -3,6 +3,8 @@
 //  See LICENSE file in the project root for full license information.
 // 
 #pragma once
+#include <cstring>
+#include <forward_list>
 #include <memory>
 #include <string>
 #include <vector>
@@ -80,6 +82,49 @@ enum class XmlAttributeName : std::uint8_t
     DXFeatureLevel,
 };
 
+namespace MSIX {
+
+    // Read only view of UTF-8 characters owned by an XML element or its document, like C++17's string_view.
+    class XmlStringView
+    {
+    public:
+        XmlStringView() = default;
+        XmlStringView(const char* data, std::size_t size) : m_data(data), m_size(size) {}
+        XmlStringView(const std::string& value) : m_data(value.data()), m_size(value.size()) {}
+
+        const char* data() const { return m_data; }
+        std::size_t size() const { return m_size; }
+        bool empty() const { return m_size == 0; }
+        std::string str() const { return std::string(m_data, m_size); }
+
+        bool operator==(const XmlStringView& other) const
+        {
+            return (m_size == other.m_size) && (m_size == 0 || std::memcmp(m_data, other.m_data, m_size) == 0);
+        }
+        bool operator!=(const XmlStringView& other) const { return !(*this == other); }
+        bool operator==(const char* other) const { return *this == XmlStringView(other, std::strlen(other)); }
+        bool operator!=(const char* other) const { return !(*this == other); }
+
+    private:
+        const char* m_data = "";
+        std::size_t m_size = 0;
+    };
+
+    // Keeps the values returned by an element, for XML backends that can't return views of their own storage.
+    class XmlStringStore
+    {
+    public:
+        XmlStringView Keep(std::string&& value)
+        {
+            m_values.push_front(std::move(value));
+            return m_values.front();
+        }
+
+    private:
+        std::forward_list<std::string> m_values;
+    };
+}
+
 // {ac94449e-442d-4bed-8fca-83770c0f7ee9}
 #ifndef WIN32
 interface IXmlElement : public IUnknown
@@ -95,6 +140,12 @@ public:
     virtual std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) = 0;
     virtual std::string               GetText() = 0;
     virtual std::string               GetPrefix() = 0;
+
+    // Same as above without a copy. Views are valid for as long as the element. Backends that transcode keep the
+    // UTF-8 they produce, so reading a value doesn't allocate every time.
+    virtual MSIX::XmlStringView       GetAttributeValueView(XmlAttributeName attribute) = 0;
+    virtual MSIX::XmlStringView       GetTextView() = 0;
+    virtual MSIX::XmlStringView       GetPrefixView() = 0;
 };
 MSIX_INTERFACE(IXmlElement, 0xac94449e,0x442d,0x4bed,0x8f,0xca,0x83,0x77,0x0c,0x0f,0x7e,0xe9);
 
@@ -176,6 +227,9 @@ public:
     {
         return ForEachElementIn(GetDocument(), query, visitor);
     }
+
+    // Memory held by the parsed document, used to charge caches of parsed documents. 0 if the parser can't tell.
+    virtual std::uint64_t GetMemoryUsage() { return 0; }
 };
 MSIX_INTERFACE(IXmlDom, 0x0e7a446e,0xbaf7,0x44c1,0xb3,0x8a,0x21,0x6b,0xfa,0x18,0xa1,0xa8);
 
@@ -195,6 +249,9 @@ MSIX_INTERFACE(IXmlFactory, 0xf82a60ec,0xfbfc,0x4cb9,0xbc,0x04,0x1a,0x0f,0xe2,0x
 namespace MSIX {
     MSIX::ComPtr<IXmlFactory> CreateXmlFactory(IMsixFactory* factory);
 
+    // Non-validating parser used when MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION is set.
+    MSIX::ComPtr<IXmlFactory> CreateLiteXmlFactory(IMsixFactory* factory);
+
     template <typename T>
     struct StringToNumber
     {
@@ -225,14 +282,14 @@ namespace MSIX {
     template <class T>
     static T GetNumber(const ComPtr<IXmlElement>& element, XmlAttributeName attribute, T defaultValue)
     {
-        const auto& attributeValue = element->GetAttributeValue(attribute);
+        auto attributeValue = element->GetAttributeValueView(attribute);
         bool hasValue = !attributeValue.empty();
         T value = defaultValue;
         if (hasValue)
         {
             try
             {
-                value = StringToNumber<T>::Get(attributeValue);
+                value = StringToNumber<T>::Get(attributeValue.str());
             }
             catch (std::invalid_argument& ia)
             {
@@ -258,7 +315,20 @@ namespace MSIX {
 
     const XmlQueryNameCharType* GetQueryString(XmlQueryName query);
     std::string GetQueryStringUtf8(XmlQueryName query);
+    std::size_t GetQueryCount();
+
+    // Slash separated element names of a query. Paths that start with '/' are matched from the
+    // document element, the rest from the element passed to IXmlDom::ForEachElementIn.
+    struct XmlQueryPath
+    {
+        bool fromRoot = false;
+        std::vector<std::string> steps;
+    };
+
+    XmlQueryPath ParseQueryPath(const std::string& path);
+    const XmlQueryPath& GetQueryPath(XmlQueryName query);
 
     std::wstring GetAttributeNameString(XmlAttributeName attr);
     const char* GetAttributeNameStringUtf8(XmlAttributeName attr);
+    std::size_t GetAttributeNameCount();
 }
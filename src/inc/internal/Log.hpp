@@ -4,6 +4,7 @@
 // 
 #pragma once
 #include <string>
+#include <vector>
 
 namespace MSIX {
     namespace Global { 
@@ -11,6 +12,13 @@ namespace MSIX {
             void Append(const std::string& comment);
             std::string Text();
             void Clear();
+
+            // While a capture is active on the calling thread, comments appended from that thread go to
+            // the capture instead of the global log. Used by worker threads so their comments can be
+            // merged back in a deterministic order. Captures can be nested; Begin returns the capture that was
+            // active, which must be given back to End.
+            std::vector<std::string>* BeginThreadCapture(std::vector<std::string>* capture);
+            void EndThreadCapture(std::vector<std::string>* previous);
         }
     }
 }
\ No newline at end of file
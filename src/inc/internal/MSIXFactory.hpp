@@ -8,6 +8,8 @@
 
 #include <vector>
 
+namespace MSIX { class DocumentCache; }
+
 // internal interface
 // {1f850db4-32b8-4db6-8bf4-5a897eb611f1}
 #ifndef WIN32
@@ -20,10 +22,11 @@ class IMsixFactory : public IUnknown
 {
 public:
     virtual HRESULT MarshalOutString(std::string& internal, LPWSTR* result) = 0;
-    virtual HRESULT MarshalOutBytes(std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) = 0;
+    virtual HRESULT MarshalOutBytes(const std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) = 0;
     virtual MSIX_VALIDATION_OPTION GetValidationOptions() = 0;
     virtual MSIX::ComPtr<IStream> GetResource(const std::string& resource) = 0;
     virtual HRESULT MarshalOutWstring(std::wstring& internal, LPWSTR* result) = 0;
     virtual HRESULT MarshalOutStringUtf8(std::string& internal, LPSTR* result) = 0;
+    virtual MSIX::DocumentCache& GetDocumentCache() = 0;
 };
 MSIX_INTERFACE(IMsixFactory, 0x1f850db4,0x32b8,0x4db6,0x8b,0xf4,0x5a,0x89,0x7e,0xb6,0x11,0xf1);
@@ -211,13 +211,19 @@ public:
 
     std::vector<std::uint8_t> GetBytes()
     {
-        THROW_IF_PACK_NOT_ENABLED
         std::vector<std::uint8_t> bytes;
+        AppendBytes(bytes);
+        return bytes;
+    }
+
+    // Serializes the object at the end of bytes, so several objects can be written at once.
+    void AppendBytes(std::vector<std::uint8_t>& bytes)
+    {
+        THROW_IF_PACK_NOT_ENABLED
         this->for_each([](auto& field, std::size_t index, std::vector<std::uint8_t>& bytes)
         {
             field.GetBytes(bytes);
         }, bytes);
-        return bytes;
     }
 
     void WriteTo(const ComPtr<IStream>& stream)
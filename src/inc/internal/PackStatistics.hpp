@@ -0,0 +1,70 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace MSIX { namespace Global {
+
+    // Process wide counters of the pack pipeline, returned by MsixGetPackStatistics.
+    struct PackStatistics
+    {
+        std::atomic<std::uint64_t> blocks;
+        std::atomic<std::uint64_t> bufferAllocations;
+        std::atomic<std::uint64_t> bufferReuses;
+        std::atomic<std::uint64_t> zipRecordWrites;
+        std::atomic<std::uint64_t> zipRecordBytes;
+        std::atomic<std::uint64_t> cacheHits;
+        std::atomic<std::uint64_t> cacheMisses;
+        std::atomic<std::uint64_t> cacheEvictions;
+        std::atomic<std::uint64_t> scannedDirectories;
+        std::atomic<std::uint64_t> scannedFiles;
+        std::atomic<std::uint64_t> scanMicroseconds;
+        std::atomic<std::uint64_t> packMicroseconds;
+
+        static PackStatistics& Get()
+        {
+            static PackStatistics statistics;
+            return statistics;
+        }
+
+        void Reset()
+        {
+            blocks = 0;
+            bufferAllocations = 0;
+            bufferReuses = 0;
+            zipRecordWrites = 0;
+            zipRecordBytes = 0;
+            cacheHits = 0;
+            cacheMisses = 0;
+            cacheEvictions = 0;
+            scannedDirectories = 0;
+            scannedFiles = 0;
+            scanMicroseconds = 0;
+            packMicroseconds = 0;
+        }
+
+    private:
+        PackStatistics() { Reset(); }
+    };
+
+    // Adds the time from its creation to its destruction to a counter of PackStatistics.
+    class PackTimer
+    {
+    public:
+        PackTimer(std::atomic<std::uint64_t>& counter) : m_counter(counter), m_start(std::chrono::steady_clock::now()) {}
+        ~PackTimer()
+        {
+            m_counter += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - m_start).count());
+        }
+
+    private:
+        std::atomic<std::uint64_t>& m_counter;
+        std::chrono::steady_clock::time_point m_start;
+    };
+} /* Global */ } /* MSIX */
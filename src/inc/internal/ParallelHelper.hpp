@@ -0,0 +1,44 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace MSIX {
+
+    // Outcome of one task run by ParallelFor. Comments the task appended to the log are kept here
+    // instead of going to the global log, so the caller can merge them in task order.
+    struct ParallelTaskResult
+    {
+        std::exception_ptr error;
+        std::vector<std::string> log;
+    };
+
+    namespace Helper {
+
+        // Number of threads ParallelFor uses for the given number of tasks.
+        std::size_t GetWorkerCount(std::size_t tasks);
+
+        // Runs the task on the calling thread and returns its outcome the same way ParallelFor does.
+        ParallelTaskResult RunCaptured(const std::function<void()>& task);
+
+        // Runs task(0) ... task(count - 1) on a set of worker threads. Tasks must be independent of each
+        // other. Every task runs, even if others fail. Failures don't propagate; they are returned in the
+        // result of the task at the same index.
+        std::vector<ParallelTaskResult> ParallelFor(std::size_t count, const std::function<void(std::size_t)>& task);
+
+        // Appends the log of the results to the global log in task order and rethrows the error of the
+        // first task that failed. The log ends up as if the tasks had run one after the other on the
+        // calling thread and stopped at the first failure.
+        void MergeParallelResults(std::vector<ParallelTaskResult>& results);
+
+        // Same as MergeParallelResults for a single result. For callers that consume the results one by one.
+        void MergeParallelResult(ParallelTaskResult& result);
+    }
+}
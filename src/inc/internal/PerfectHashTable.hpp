@@ -0,0 +1,104 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace MSIX {
+
+    // Read only table of string keys. The seed of the hash is searched when the table is built so every key
+    // lands in its own slot, and a lookup is one hash plus at most one comparison. With ignoreCase, ASCII
+    // letters of the keys and the lookups are compared case insensitive. Keys must be unique.
+    template<typename T>
+    class PerfectHashTable
+    {
+    public:
+        struct Entry
+        {
+            const char* key;
+            T value;
+        };
+
+        template<std::size_t N>
+        PerfectHashTable(const Entry (&entries)[N], bool ignoreCase = false) :
+            m_entries(entries, entries + N), m_ignoreCase(ignoreCase)
+        {
+            static_assert(N < 0xFF, "The slots store the index of the entry in a byte");
+            std::size_t size = 4;
+            while (size < 2 * N) { size *= 2; }
+            for (;;)
+            {
+                for (m_seed = 1; m_seed <= 0x1000; m_seed++)
+                {
+                    if (TryBuild(size)) { return; }
+                }
+                size *= 2;
+            }
+        }
+
+        const T* Find(const char* key, std::size_t length) const
+        {
+            auto slot = m_slots[Hash(key, length, m_seed) & (m_slots.size() - 1)];
+            if (slot == Empty) { return nullptr; }
+            const auto& entry = m_entries[slot];
+            if (m_lengths[slot] != length || !Equals(entry.key, key, length)) { return nullptr; }
+            return &entry.value;
+        }
+
+        const T* Find(const std::string& key) const { return Find(key.data(), key.size()); }
+
+    private:
+        enum : std::uint8_t { Empty = 0xFF };
+
+        std::uint8_t Fold(char c) const
+        {
+            auto value = static_cast<std::uint8_t>(c);
+            return (m_ignoreCase && value >= 'A' && value <= 'Z') ? static_cast<std::uint8_t>(value + ('a' - 'A')) : value;
+        }
+
+        std::uint32_t Hash(const char* key, std::size_t length, std::uint32_t seed) const
+        {
+            std::uint32_t hash = 2166136261u ^ (seed * 0x9E3779B1u);
+            for (std::size_t i = 0; i < length; i++)
+            {
+                hash = (hash ^ Fold(key[i])) * 16777619u;
+            }
+            return hash ^ (hash >> 15);
+        }
+
+        bool Equals(const char* entryKey, const char* key, std::size_t length) const
+        {
+            for (std::size_t i = 0; i < length; i++)
+            {
+                if (Fold(entryKey[i]) != Fold(key[i])) { return false; }
+            }
+            return true;
+        }
+
+        bool TryBuild(std::size_t size)
+        {
+            m_slots.assign(size, Empty);
+            m_lengths.resize(m_entries.size());
+            for (std::size_t i = 0; i < m_entries.size(); i++)
+            {
+                m_lengths[i] = std::strlen(m_entries[i].key);
+                auto& slot = m_slots[Hash(m_entries[i].key, m_lengths[i], m_seed) & (size - 1)];
+                if (slot != Empty) { return false; }
+                slot = static_cast<std::uint8_t>(i);
+            }
+            return true;
+        }
+
+        std::vector<Entry> m_entries;
+        std::vector<std::size_t> m_lengths;
+        std::vector<std::uint8_t> m_slots;
+        std::uint32_t m_seed = 0;
+        bool m_ignoreCase;
+    };
+}
@@ -0,0 +1,99 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include "AppxPackaging.hpp"
+#include "Exceptions.hpp"
+#include "DirectoryObject.hpp"
+
+#include <string>
+#include <vector>
+
+namespace MSIX {
+    namespace Serialization {
+
+        // Helpers for the small binary files the SDK keeps between runs, like the unpack state and the
+        // block cache. Integers are little endian; byte strings are prefixed with their 32 bit length.
+
+        template <class T>
+        inline void WriteNumber(std::vector<std::uint8_t>& buffer, T value)
+        {
+            for (std::size_t i = 0; i < sizeof(T); i++)
+            {
+                buffer.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+            }
+        }
+
+        inline void WriteBytes(std::vector<std::uint8_t>& buffer, const std::uint8_t* bytes, std::size_t count)
+        {
+            WriteNumber<std::uint32_t>(buffer, static_cast<std::uint32_t>(count));
+            buffer.insert(buffer.end(), bytes, bytes + count);
+        }
+
+        inline void WriteBytes(std::vector<std::uint8_t>& buffer, const std::string& bytes)
+        {
+            WriteBytes(buffer, reinterpret_cast<const std::uint8_t*>(bytes.data()), bytes.size());
+        }
+
+        // Reads what the Write functions wrote. Every read returns false instead of going past the end of
+        // the buffer, so a truncated or corrupted file is detected by the caller.
+        class Reader
+        {
+        public:
+            Reader(const std::vector<std::uint8_t>& buffer) : m_buffer(buffer) {}
+
+            template <class T>
+            bool ReadNumber(T& value)
+            {
+                if (m_buffer.size() - m_position < sizeof(T)) { return false; }
+                value = 0;
+                for (std::size_t i = 0; i < sizeof(T); i++)
+                {
+                    value |= static_cast<T>(m_buffer[m_position++]) << (8 * i);
+                }
+                return true;
+            }
+
+            // The bytes point into the buffer and are valid as long as it is.
+            bool ReadBytes(const std::uint8_t*& bytes, std::uint32_t& count)
+            {
+                if (!ReadNumber(count) || (m_buffer.size() - m_position < count)) { return false; }
+                bytes = m_buffer.data() + m_position;
+                m_position += count;
+                return true;
+            }
+
+            template <class Container>
+            bool ReadBytes(Container& bytes)
+            {
+                const std::uint8_t* data = nullptr;
+                std::uint32_t count = 0;
+                if (!ReadBytes(data, count)) { return false; }
+                bytes.assign(data, data + count);
+                return true;
+            }
+
+            bool AtEnd() const { return m_position == m_buffer.size(); }
+
+        private:
+            const std::vector<std::uint8_t>& m_buffer;
+            std::size_t m_position = 0;
+        };
+
+        // Writes the buffer to a temporary file and renames it, so the previous file is kept if writing fails.
+        inline void ReplaceFile(const ComPtr<IDirectoryObject>& directory, const std::string& fileName,
+            const std::string& tempSuffix, const std::vector<std::uint8_t>& buffer)
+        {
+            std::string tempFile = fileName + tempSuffix;
+            {
+                auto stream = directory->OpenFile(tempFile, FileStream::Mode::WRITE);
+                ULONG written = 0;
+                ThrowHrIfFailed(stream->Write(buffer.data(), static_cast<ULONG>(buffer.size()), &written));
+                ThrowErrorIf(Error::FileWrite, (written != buffer.size()), "write failed");
+            }
+            directory->RenameFile(tempFile, fileName);
+        }
+    }
+}
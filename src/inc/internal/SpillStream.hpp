@@ -0,0 +1,81 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+// 
+#pragma once
+
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "ComHelper.hpp"
+#include "VectorStream.hpp"
+#include "FileStream.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace MSIX {
+
+    // Memory a SpillStream uses before moving its data to a temporary file.
+    static const std::size_t DefaultSpillMemoryLimit = 4 * 1024 * 1024;
+
+    // Stream for documents that grow with the size of the package, like the blockmap. The data is kept in
+    // memory until it grows past memoryLimit, then it is moved to an anonymous temporary file that goes
+    // away with the stream. If no temporary file can be created, the data stays in memory.
+    class SpillStream final : public StreamBase
+    {
+    public:
+        SpillStream(std::size_t memoryLimit = DefaultSpillMemoryLimit) : m_memoryLimit(memoryLimit)
+        {
+            m_stream = ComPtr<IStream>::Make<VectorStream>(&m_buffer);
+        }
+
+        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override
+        {
+            return m_stream->Read(buffer, countBytes, bytesRead);
+        }
+
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER *newPosition) noexcept override
+        {
+            return m_stream->Seek(move, origin, newPosition);
+        }
+
+        HRESULT STDMETHODCALLTYPE Write(const void *buffer, ULONG countBytes, ULONG *bytesWritten) noexcept override try
+        {
+            if (!m_spilled && (m_buffer.size() + countBytes > m_memoryLimit))
+            {
+                Spill();
+            }
+            return m_stream->Write(buffer, countBytes, bytesWritten);
+        } CATCH_RETURN();
+
+        bool IsSpilled() { return m_spilled && m_buffer.empty(); }
+
+    protected:
+        void Spill()
+        {
+            m_spilled = true;
+            FILE* file = std::tmpfile();
+            if (file == nullptr)
+            {
+                return;
+            }
+            auto fileStream = ComPtr<IStream>::Make<FileStream>(file, "temporary file", true);
+
+            ULARGE_INTEGER position = { 0 };
+            ThrowHrIfFailed(m_stream->Seek({ 0 }, StreamBase::Reference::CURRENT, &position));
+            ULONG written = 0;
+            ThrowHrIfFailed(fileStream->Write(m_buffer.data(), static_cast<ULONG>(m_buffer.size()), &written));
+            LARGE_INTEGER move = { 0 };
+            move.QuadPart = static_cast<LONGLONG>(position.QuadPart);
+            ThrowHrIfFailed(fileStream->Seek(move, StreamBase::Reference::START, nullptr));
+
+            m_stream = fileStream;
+            std::vector<std::uint8_t>().swap(m_buffer);
+        }
+
+        std::size_t m_memoryLimit;
+        bool m_spilled = false;
+        std::vector<std::uint8_t> m_buffer;
+        ComPtr<IStream> m_stream;
+    };
+}
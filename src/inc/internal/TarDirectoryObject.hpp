@@ -0,0 +1,76 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <map>
+
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "ComHelper.hpp"
+#include "DirectoryObject.hpp"
+
+// internal interface
+// {5d3b1f0e-8c2a-4f6b-9e47-0b6a1c2d3e4f}
+#ifndef WIN32
+interface ITarDirectoryObject : public IUnknown
+#else
+#include "Unknwn.h"
+#include "Objidl.h"
+class ITarDirectoryObject : public IUnknown
+#endif
+{
+public:
+    // Starts a new entry in the tar stream. Exactly size bytes must be written to the returned stream
+    // before the next entry is started. Data is written through to the underlying stream.
+    virtual MSIX::ComPtr<IStream> OpenFile(const std::string& fileName, std::uint64_t size) = 0;
+
+    // Finishes the current entry and writes the end of archive marker.
+    virtual void Close() = 0;
+
+    // Ends the stream with an error trailer instead of the end of archive marker. The entry that was
+    // being written is padded to its declared size, so the trailer can still be parsed, but its content
+    // is incomplete.
+    virtual void Abort(const std::string& reason) noexcept = 0;
+};
+MSIX_INTERFACE(ITarDirectoryObject, 0x5d3b1f0e,0x8c2a,0x4f6b,0x9e,0x47,0x0b,0x6a,0x1c,0x2d,0x3e,0x4f);
+
+namespace MSIX {
+
+    // Serializes files as a POSIX (pax) tar stream. Entries are written in the order they are opened
+    // and nothing is buffered besides the 512 bytes headers, so the output can be a pipe.
+    class TarDirectoryObject final : public ComClass<TarDirectoryObject, IDirectoryObject, ITarDirectoryObject>
+    {
+    public:
+        TarDirectoryObject(const ComPtr<IStream>& stream) : m_stream(stream) {}
+
+        // IDirectoryObject
+        ComPtr<IStream> OpenFile(const std::string& fileName, FileStream::Mode mode) override;
+        std::multimap<std::uint64_t, std::string> GetFilesByLastModDate() override { NOTSUPPORTED; }
+        bool FileExists(const std::string&) override { return false; }
+        bool RemoveFile(const std::string&) override { return true; }
+        void RenameFile(const std::string&, const std::string&) override { NOTSUPPORTED; }
+
+        // ITarDirectoryObject
+        ComPtr<IStream> OpenFile(const std::string& fileName, std::uint64_t size) override;
+        void Close() override;
+        void Abort(const std::string& reason) noexcept override;
+
+        // Called by the entry stream
+        void WriteEntryData(const void* buffer, ULONG countBytes);
+
+    protected:
+        void FinishEntry();
+        void WriteHeader(const std::string& name, std::uint64_t size, char type);
+        void WritePaxHeader(const std::string& name, const std::string& records, char type);
+        void WriteZeros(std::uint64_t count);
+
+        ComPtr<IStream> m_stream;
+        std::uint64_t m_entrySize = 0;
+        std::uint64_t m_entryRemaining = 0;
+        bool m_inEntry = false;
+        bool m_closed = false;
+    };
+}
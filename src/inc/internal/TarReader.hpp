@@ -0,0 +1,49 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "ComHelper.hpp"
+
+namespace MSIX {
+
+    // Reads the regular files of a ustar, pax or GNU tar stream in the order they are in the stream.
+    // The stream is only read forward, so it can be a pipe. Directories, links and other special
+    // entries are skipped.
+    class TarReader final
+    {
+    public:
+        TarReader(const ComPtr<IStream>& stream);
+
+        // Moves to the next regular file. Returns false at the end of the archive. The data of the
+        // previous file that wasn't read is skipped.
+        bool NextFile(std::string& name, std::uint64_t& size);
+
+        // Returns a stream over the data of the current file. It can be read only until NextFile is called.
+        ComPtr<IStream> GetFileStream();
+
+        // Called by the file stream
+        ULONG ReadFileData(std::uint64_t entry, void* buffer, ULONG countBytes);
+
+    protected:
+        void Read(void* buffer, std::size_t count);
+        bool ReadHeader(std::vector<std::uint8_t>& header);
+        void ReadEntryData(std::uint64_t size, std::string& data);
+        void Skip(std::uint64_t count);
+        void ParsePaxRecords(const std::string& records, std::string& path, std::string& size);
+
+        ComPtr<IStream> m_stream;
+        std::string m_name;
+        std::uint64_t m_entry = 0;
+        std::uint64_t m_size = 0;
+        std::uint64_t m_remaining = 0;
+        std::uint64_t m_padding = 0;
+        bool m_ended = false;
+    };
+}
@@ -5,33 +5,53 @@
 #pragma once
 
 #include <string>
-#include <locale>
-#include <codecvt>
-
-namespace MSIX {    
-    /*
-        from: https://social.msdn.microsoft.com/Forums/en-US/8f40dcd8-c67f-4eba-9134-a19b9178e481/vs-2015-rc-linker-stdcodecvt-error?forum=vcgeneral
-        Posted by Microsoft on 1/7/2016 at 8:12 PM
-        On Windows, using std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t> will produce:
-            error LNK2001: unresolved external symbol "__declspec(dllimport) public: static class std::locale::id std::codecvt
-            <char16_t,char,struct _Mbstatet>::id"(__imp_?id@?$codecvt@_SDU_Mbstatet@@@std@@2V0locale@2@A)
-        This is a known bug since VS2015 that hasn't being fixed and I don't think is ever going to as <codecvt> is deprecated in C++17
-        <snip>
-        A workaround is to replace 'char32_t' with 'unsigned int'. In VS2013, char32_t was a typedef of 'unsigned int'.
-        In VS2015, char32_t is a distinct type of it's own. Switching your use of 'char32_t' to 'unsigned int' will get
-        you the old behavior from earlier versions and won't trigger a missing export error.
-
-        There is also a similar error to this one with 'char16_t' that can be worked around using 'unsigned short'.
-        <snip>
-    */
+#include <cstddef>
+
+namespace MSIX {
+
+    // Validating UTF-8 <-> UTF-16/UTF-32 transcoder. The conversions write into a caller provided buffer that must
+    // hold at least GetMax*Size elements and return the number of elements written. Runs of ASCII are scanned
+    // and converted a vector at a time.
+    //
+    // Invalid input is never replaced; the conversion throws Error::Unexpected. Invalid input is:
+    //  - UTF-8: a byte that can't start a sequence (80-C1, F5-FF), a missing or unexpected continuation byte,
+    //    a truncated sequence, an overlong encoding, an encoded surrogate (D800-DFFF) or a value above 10FFFF.
+    //  - UTF-16: a high surrogate not followed by a low surrogate or a low surrogate not preceded by a high one.
+    //  - UTF-32: a surrogate or a value above 10FFFF.
+    // A byte order mark is converted like any other character. wchar_t is UTF-16 on Windows and UTF-32 elsewhere.
+    class Unicode
+    {
+    public:
+        static std::size_t GetMaxUtf16Size(std::size_t utf8Size) { return utf8Size; }
+        static std::size_t GetMaxUtf32Size(std::size_t utf8Size) { return utf8Size; }
+        static std::size_t GetMaxWideSize(std::size_t utf8Size) { return utf8Size; }
+        static std::size_t GetMaxUtf8SizeFromUtf16(std::size_t utf16Size) { return utf16Size * 3; }
+        static std::size_t GetMaxUtf8SizeFromUtf32(std::size_t utf32Size) { return utf32Size * 4; }
+        static std::size_t GetMaxUtf8SizeFromWide(std::size_t wideSize)
+        {
+            return (sizeof(wchar_t) == sizeof(char16_t)) ? GetMaxUtf8SizeFromUtf16(wideSize) : GetMaxUtf8SizeFromUtf32(wideSize);
+        }
+
+        static std::size_t Utf8ToUtf16(const char* data, std::size_t size, char16_t* output);
+        static std::size_t Utf8ToUtf32(const char* data, std::size_t size, char32_t* output);
+        static std::size_t Utf8ToWide(const char* data, std::size_t size, wchar_t* output);
+
+        static std::size_t Utf16ToUtf8(const char16_t* data, std::size_t size, char* output);
+        static std::size_t Utf32ToUtf8(const char32_t* data, std::size_t size, char* output);
+        static std::size_t WideToUtf8(const wchar_t* data, std::size_t size, char* output);
+
+        // Throws like the conversions if data isn't valid UTF-8
+        static void ValidateUtf8(const char* data, std::size_t size);
+    };
+
+    // UTF-16 string as handed to Win32 APIs
     #ifdef WIN32
     using StringType = std::basic_string<unsigned short>;
-    using StringConvert = std::wstring_convert<std::codecvt_utf8_utf16<unsigned short>, unsigned short>;
     #else
     using StringType = std::u16string;
-    using StringConvert = std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>;
     #endif
 
+    // The string helpers convert up to the first null character.
     StringType utf8_to_utf16(const std::string& utf8string);
 
     // converts an input utf8 formatted string into a utf16 formatted string
@@ -40,7 +60,7 @@ namespace MSIX {
 
     // converts an input utf16 formatted string into a utf8 formatted string
     std::string wstring_to_utf8(const std::wstring& utf16string);
+    std::string wstring_to_utf8(const wchar_t* utf16string);
     std::string u16string_to_utf8(const std::u16string& utf16string);
 
-
-} // namespace MSIX
\ No newline at end of file
+} // namespace MSIX
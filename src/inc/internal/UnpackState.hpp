@@ -0,0 +1,60 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "ComHelper.hpp"
+#include "BlockMapStream.hpp"
+#include "DirectoryObject.hpp"
+
+namespace MSIX {
+
+    // Sidecar file written at the root of an incremental unpack.
+    static const char* const UNPACK_STATE_FILE = ".msixunpackstate";
+    // Suffix of the temporary files written before being renamed to their final name.
+    static const char* const UNPACK_TEMP_SUFFIX = ".msixtmp";
+
+    // What the last incremental unpack extracted for a file. Files described by the blockmap
+    // are tracked by their uncompressed size and block hashes; footprint files that are not
+    // in the blockmap are always extracted again.
+    struct UnpackStateEntry
+    {
+        bool tracked = false;
+        std::uint64_t size = 0;
+        std::vector<std::uint8_t> hashes; // block hashes, concatenated
+
+        bool Matches(const UnpackStateEntry& other) const
+        {
+            return tracked && other.tracked && size == other.size && hashes == other.hashes;
+        }
+    };
+
+    class UnpackState final
+    {
+    public:
+        // A missing or corrupted state file results in an empty state, which means every file is extracted.
+        void Load(const ComPtr<IDirectoryObject>& directory, const std::string& stateFile);
+        // Writes to a temporary file and renames it, so the previous state is kept if writing fails.
+        void Save(const ComPtr<IDirectoryObject>& directory, const std::string& stateFile);
+        // Removes the state file. Called before the first file of the folder is changed, so an unpack that
+        // fails midway leaves no state and the next incremental unpack extracts everything again.
+        static void Invalidate(const ComPtr<IDirectoryObject>& directory, const std::string& stateFile);
+
+        const UnpackStateEntry* Find(const std::string& fileName) const;
+        void Set(const std::string& fileName, UnpackStateEntry&& entry) { m_entries[fileName] = std::move(entry); }
+        const std::map<std::string, UnpackStateEntry>& GetEntries() const { return m_entries; }
+
+        static UnpackStateEntry CreateEntry(std::uint64_t size, const std::vector<Block>& blocks);
+
+        // Reads the stream in blockmap sized blocks and compares each block against its hash.
+        static bool StreamMatchesBlocks(const ComPtr<IStream>& stream, std::uint64_t size, const std::vector<Block>& blocks);
+
+    private:
+        std::map<std::string, UnpackStateEntry> m_entries;
+    };
+}
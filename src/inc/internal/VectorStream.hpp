@@ -17,6 +17,8 @@ namespace MSIX {
     {
     public:
         VectorStream(std::vector<std::uint8_t>* data) : m_data(data) {}
+        // Stream that owns its data.
+        VectorStream(std::vector<std::uint8_t>&& data) : m_owned(std::move(data)), m_data(&m_owned) {}
 
         HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override try
         {
@@ -66,6 +68,7 @@ namespace MSIX {
         }
 
     protected:
+        std::vector<std::uint8_t> m_owned;
         ULONG m_offset = 0;
         std::vector<std::uint8_t>* m_data;
     };
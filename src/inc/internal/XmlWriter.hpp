@@ -7,8 +7,10 @@
 #include "ComHelper.hpp"
 #include "StringStream.hpp"
 
+#include <cstring>
 #include <stack>
 #include <string>
+#include <vector>
 
 namespace MSIX {
 
@@ -17,7 +19,8 @@ namespace MSIX {
     static const char* xmlNamespaceDelimiter = ":";
 
     // This is a super light xml writer that doesn't use any xml libraries and 
-    // just writes to a stream the basics of an xml file.
+    // just writes to a stream the basics of an xml file. Output is buffered and written to the stream in
+    // chunks of BufferSize; the stream is complete once the root element is closed.
     class XmlWriter final
     {
     public:
@@ -29,6 +32,8 @@ namespace MSIX {
         }
         State;
 
+        static const std::size_t BufferSize = 64 * 1024;
+
         XmlWriter() = delete; // A root must be given
 
         XmlWriter(const std::string& root, bool standalone = false) 
@@ -45,16 +50,23 @@ namespace MSIX {
         void StartElement(const std::string& name);
         void CloseElement();
         void AddAttribute(const std::string& name, const std::string& value);
+        void AddAttribute(const std::string& name, std::uint64_t value);
+        void AddBase64Attribute(const std::string& name, const std::vector<std::uint8_t>& value);
         State GetState() { return m_state; }
         ComPtr<IStream> GetStream();
 
     protected:
         void StartWrite(const std::string& root, bool standalone);
-        void Write(const std::string& toWrite);
-        void Write(const char toWrite);
+        void StartAttribute(const std::string& name);
+        void Write(const char* toWrite, std::size_t size);
+        void Write(const std::string& toWrite) { Write(toWrite.data(), toWrite.size()); }
+        void Write(const char* toWrite) { Write(toWrite, std::strlen(toWrite)); }
+        void Write(const char toWrite) { Write(&toWrite, 1); }
         void WriteTextValue(const std::string& value);
+        void Flush();
         State m_state;
         ComPtr<IStream> m_stream;
+        std::string m_buffer;
         std::stack<std::string> m_elements;
     };
 }
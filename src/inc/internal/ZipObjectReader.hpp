@@ -24,6 +24,9 @@ namespace MSIX {
         ComPtr<IStream> GetFile(const std::string& fileName) override;
         std::string GetFileName() override;
 
+        // Returns the file as stored in the package, without inflating it. Not cached.
+        ComPtr<IStream> GetRawFile(const std::string& fileName);
+
     protected:
         std::map<std::string, ComPtr<IStream>> m_streams;
     };
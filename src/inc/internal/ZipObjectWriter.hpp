@@ -12,6 +12,8 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <string>
+#include <unordered_set>
 #include <utility>
 
 #include <zlib.h>
@@ -29,10 +31,18 @@ public:
     // Writes the lfh header to the stream and return the size of the header
     virtual std::pair<std::uint32_t, MSIX::ComPtr<IStream>> PrepareToAddFile(const std::string& name, bool isCompressed) = 0;
 
+    // Same as PrepareToAddFile, but the data written to the returned stream is stored as is, even
+    // if isCompressed is true. Used when the data was already deflated by the caller.
+    virtual std::pair<std::uint32_t, MSIX::ComPtr<IStream>> PrepareToAddRawFile(const std::string& name, bool isCompressed) = 0;
+
     // Ends the file, rewrites the LFH or writes data descriptor and adds an entry
-    // to the central directories map
+    // to the central directories. compressedSize must be the size of the data written.
+    // The LFH is never rewritten if the output is not seekable.
     virtual void EndFile(std::uint32_t crc, std::uint64_t compressedSize, std::uint64_t uncompressedSize, bool forceDataDescriptor) = 0;
 
+    // Offset in the zip of the data of the file being added. Only valid between PrepareToAddFile and EndFile.
+    virtual std::uint64_t GetFileDataOffset() = 0;
+
     // Ends zip file by writing the central directory records, zip64 locator,
     // zip64 end of central directory and the end of central directories.
     virtual void Close() = 0;
@@ -55,7 +65,9 @@ namespace MSIX {
 
         // IZipWriter
         std::pair<std::uint32_t, ComPtr<IStream>> PrepareToAddFile(const std::string& name, bool isCompressed) override;
+        std::pair<std::uint32_t, ComPtr<IStream>> PrepareToAddRawFile(const std::string& name, bool isCompressed) override;
         void EndFile(std::uint32_t crc, std::uint64_t compressedSize, std::uint64_t uncompressedSize, bool forceDataDescriptor) override;
+        std::uint64_t GetFileDataOffset() override;
         void Close() override;
 
     protected:
@@ -66,7 +78,51 @@ namespace MSIX {
             Closed,
         };
 
+        // Central directory entry of a file added by this writer. The names of all the entries are kept
+        // one after the other in m_names. The central directory is only serialized when the zip is closed.
+        struct CentralDirectoryEntry
+        {
+            std::uint64_t compressedSize;
+            std::uint64_t uncompressedSize;
+            std::uint64_t lfhOffset;
+            std::size_t nameOffset;
+            std::uint32_t crc;
+            std::uint16_t nameSize;
+            std::uint16_t compressionMethod;
+            bool dataDescriptor;
+        };
+
+        // Hash and comparison of entries by their index in m_entries, so duplicated names can be found
+        // without another copy of the names.
+        struct EntryNameHash
+        {
+            const ZipObjectWriter* writer;
+            std::size_t operator()(std::size_t index) const;
+        };
+        struct EntryNameEqual
+        {
+            const ZipObjectWriter* writer;
+            bool operator()(std::size_t left, std::size_t right) const;
+        };
+
+        void AddEntry(const std::string& name);
+
+        // Records are serialized into m_records and written with one write when file data needs to
+        // follow them, or when the zip is closed. A data descriptor goes out with the next LFH and the
+        // central directory with the end records, in chunks of up to MaxQueuedRecordBytes.
+        static const std::size_t MaxQueuedRecordBytes = 1024 * 1024;
+        template <class T>
+        void QueueRecord(T& record) { record.AppendBytes(m_records); }
+        void FlushRecords();
+        std::uint64_t GetPosition();
+
         State m_state = State::ReadyForLfhOrClose;
+        bool m_seekable = true;
+        std::uint64_t m_position = 0;
         std::pair<std::uint64_t, LocalFileHeader> m_lastLFH;
+        std::vector<std::uint8_t> m_records;
+        std::vector<CentralDirectoryEntry> m_entries;
+        std::string m_names;
+        std::unordered_set<std::size_t, EntryNameHash, EntryNameEqual> m_entryNames;
     };
 }
\ No newline at end of file
@@ -1199,6 +1199,7 @@ interface IMsixElementEnumerator;
 interface IMsixFactoryOverrides;
 interface IMsixStreamFactory;
 interface IMsixApplicabilityLanguagesEnumerator;
+interface IMsixDocumentCache;
 
 #ifndef __IMsixDocumentElement_INTERFACE_DEFINED__
 #define __IMsixDocumentElement_INTERFACE_DEFINED__
@@ -1325,6 +1326,41 @@ interface IMsixApplicabilityLanguagesEnumerator;
     };
 #endif  /* __IMsixApplicabilityLanguagesEnumerator_INTERFACE_DEFINED__ */
 
+#ifndef __IMsixDocumentCache_INTERFACE_DEFINED__
+#define __IMsixDocumentCache_INTERFACE_DEFINED__
+
+    typedef struct MSIX_DOCUMENT_CACHE_STATISTICS
+    {
+        UINT64 hits;        // footprint files found in the cache instead of parsed
+        UINT64 misses;      // footprint files parsed because they weren't in the cache
+        UINT64 evictions;   // entries dropped to keep the cache under its size limit
+        UINT64 entries;     // entries in the cache
+        UINT64 size;        // estimated memory held by the entries in the cache
+    } MSIX_DOCUMENT_CACHE_STATISTICS;
+
+    // Implemented by the factory. Keeps the parsed AppxManifest.xml, AppxBlockMap.xml and [Content_Types].xml
+    // of the packages it opens, keyed by the SHA256 of their bytes, so opening the same package again doesn't
+    // parse and validate them again. The cache is disabled until a size limit is set.
+    // {8b7a2f4e-1c6d-4e59-a3b0-6f2d9c84e517}
+    MSIX_INTERFACE(IMsixDocumentCache,0x8b7a2f4e,0x1c6d,0x4e59,0xa3,0xb0,0x6f,0x2d,0x9c,0x84,0xe5,0x17);
+    interface IMsixDocumentCache : public IUnknown
+    {
+    public:
+        // 0 disables the cache and drops its entries.
+        virtual HRESULT STDMETHODCALLTYPE SetSizeLimit(
+            /* [in] */ UINT64 sizeLimit) noexcept = 0;
+
+        // Opens the package, or bundle, to fill the cache with its footprint files.
+        virtual HRESULT STDMETHODCALLTYPE Prewarm(
+            /* [in] */ IStream* packageStream) noexcept = 0;
+
+        virtual HRESULT STDMETHODCALLTYPE Clear() noexcept = 0;
+
+        virtual HRESULT STDMETHODCALLTYPE GetStatistics(
+            /* [out] */ MSIX_DOCUMENT_CACHE_STATISTICS* statistics) noexcept = 0;
+    };
+#endif  /* __IMsixDocumentCache_INTERFACE_DEFINED__ */
+
 // Specific to MSIX SDK. UTF8 variant of AppxPackaging interfaces
 interface IAppxBlockMapFileUtf8;
 interface IAppxBlockMapReaderUtf8;
@@ -1660,6 +1696,12 @@ enum MSIX_VALIDATION_OPTION
                                                                   // no schema validation is done, but it needs to be
                                                                   // valid xml.
         MSIX_VALIDATION_OPTION_SKIPPACKAGEVALIDATION       = 0x8,
+        MSIX_VALIDATION_OPTION_VALIDATEAPPLICABLEONLY      = 0x10, // When opening a bundle, only validate the packages that
+                                                                  // are applicable. Other packages are validated when their
+                                                                  // stream is first requested.
+        MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION     = 0x20, // Use the built-in non-validating XML parser. Documents
+                                                                  // must be well formed UTF-8 without DTDs, but are not
+                                                                  // validated against the schemas.
     }   MSIX_VALIDATION_OPTION;
 
 typedef /* [v1_enum] */
@@ -1667,7 +1709,13 @@ enum MSIX_PACKUNPACK_OPTION
     {
         MSIX_PACKUNPACK_OPTION_NONE                    = 0x0,
         MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER  = 0x1,
-        MSIX_PACKUNPACK_OPTION_UNPACKWITHFLATSTRUCTURE = 0x2
+        MSIX_PACKUNPACK_OPTION_UNPACKWITHFLATSTRUCTURE = 0x2,
+        MSIX_PACKUNPACK_OPTION_INCREMENTAL             = 0x4,  // Only extract files that changed since the last
+                                                               // incremental unpack to the same destination.
+        MSIX_PACKUNPACK_OPTION_DELETEREMOVEDFILES      = 0x8,  // Implies INCREMENTAL. Delete files extracted by the
+                                                               // previous unpack that are not in the package anymore.
+        MSIX_PACKUNPACK_OPTION_VERIFYEXISTINGFILES     = 0x10, // Implies INCREMENTAL. Rehash files on disk against the
+                                                               // blockmap instead of trusting the unpack state file.
     }   MSIX_PACKUNPACK_OPTION;
 
 typedef /* [v1_enum] */
@@ -1703,6 +1751,8 @@ enum MSIX_BUNDLE_OPTIONS
         MSIX_OPTION_VERSION = 0x8,
         MSIX_BUNDLE_OPTION_FLATBUNDLE = 0x10,
         MSIX_BUNDLE_OPTION_BUNDLEMANIFESTONLY = 0x20,
+        MSIX_BUNDLE_OPTION_SKIPPACKAGEVALIDATION = 0x40, // Only reads the manifest of the packages instead of
+                                                         // validating them.
     }   MSIX_BUNDLE_OPTIONS;
 
 #define MSIX_PLATFORM_ALL MSIX_PLATFORM_WINDOWS10      | \
@@ -1740,6 +1790,21 @@ MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackageFromStream(
     char* utf8Destination
 ) noexcept;
 
+// Unpacks the package as a tar stream instead of to a directory. Files are validated while they are written;
+// if validation fails the tar stream is terminated with an error trailer. utf8TarFile can be "-" for stdout.
+MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackageToTar(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    char* utf8TarFile
+) noexcept;
+
+MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackageFromPackageReaderToTarStream(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    IAppxPackageReader* packageReader,
+    IStream* tarStream
+) noexcept;
+
 MSIX_API HRESULT STDMETHODCALLTYPE UnpackBundle(
     MSIX_PACKUNPACK_OPTION packUnpackOptions,
     MSIX_VALIDATION_OPTION validationOption,
@@ -1764,6 +1829,8 @@ MSIX_API HRESULT STDMETHODCALLTYPE UnpackBundleFromStream(
 
 #ifdef MSIX_PACK
 
+// outputPackage can be "-" for stdout. Packages are written from start to end without seeking back, so stdout,
+// or the IStream given to CreatePackageWriter, doesn't need to be seekable.
 MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
     MSIX_PACKUNPACK_OPTION packUnpackOptions,
     MSIX_VALIDATION_OPTION validationOption,
@@ -1771,6 +1838,29 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
     char* outputPackage
 ) noexcept;
 
+// Same as PackPackage, reusing deflated blocks of previous packs. The output is the same as PackPackage.
+// utf8CacheDirectory: optional, directory where the blocks are kept between calls.
+// utf8SeedPackage: optional, package previously created with this SDK to take blocks from.
+// cacheSizeLimit: size limit of the blocks kept, 0 for the default of 256MB.
+MSIX_API HRESULT STDMETHODCALLTYPE PackPackageWithBlockCache(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* directoryPath,
+    char* outputPackage,
+    char* utf8CacheDirectory,
+    char* utf8SeedPackage,
+    UINT64 cacheSizeLimit
+) noexcept;
+
+// Same as PackPackage, with the files read from a tar stream instead of a directory. The files are added in the
+// order they are in the stream, which must have an AppxManifest.xml. utf8TarFile can be "-" for stdin.
+MSIX_API HRESULT STDMETHODCALLTYPE PackPackageFromTar(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8TarFile,
+    char* outputPackage
+) noexcept;
+
 MSIX_API HRESULT STDMETHODCALLTYPE PackBundle(
     MSIX_BUNDLE_OPTIONS bundleOptions,
     char* directoryPath,
@@ -1779,6 +1869,28 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackBundle(
     char* version
 ) noexcept;
 
+// Counters of the work done by the pack APIs in this process, for diagnostics.
+typedef struct MSIX_PACK_STATISTICS
+{
+    UINT64 blocks;              // 64KB blocks read from payload files
+    UINT64 bufferAllocations;   // block buffers allocated
+    UINT64 bufferReuses;        // files processed with block buffers that were already allocated
+    UINT64 zipRecordWrites;     // writes of zip headers and records issued to the output stream
+    UINT64 zipRecordBytes;      // bytes written by those writes
+    UINT64 cacheHits;           // blocks copied from the block cache instead of deflated
+    UINT64 cacheMisses;         // blocks deflated because they weren't in the block cache
+    UINT64 cacheEvictions;      // blocks dropped from the block cache to keep it under its size limit
+    UINT64 scannedDirectories;  // directories listed to find the files to pack
+    UINT64 scannedFiles;        // files found in those directories
+    UINT64 scanMicroseconds;    // time spent finding the files to pack
+    UINT64 packMicroseconds;    // time spent adding the files found to the package
+} MSIX_PACK_STATISTICS;
+
+MSIX_API HRESULT STDMETHODCALLTYPE MsixGetPackStatistics(
+    MSIX_PACK_STATISTICS* statistics,
+    bool reset
+) noexcept;
+
 #endif // MSIX_PACK
 
 // A call to called CoCreateAppxFactory is required before start using the factory on non-windows platforms specifying
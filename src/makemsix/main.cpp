@@ -191,8 +191,18 @@ struct Invocation
 
     const std::string& GetErrorText() const { return error; }
 
+    // For errors in the combination of options, reported after the command fails.
+    void SetErrorText(const std::string& text) const { error = text; }
+
     const Command* GetParsedCommand() const { return command; }
 
+    // Commands that write their output to stdout can't have anything else written there.
+    bool IsOutputToStdout() const
+    {
+        return (IsOptionPresent("-to-tar") && GetOptionValue("-to-tar") == "-") ||
+            (command != nullptr && *command == "pack" && IsOptionPresent("-p") && GetOptionValue("-p") == "-");
+    }
+
     bool IsOptionPresent(const std::string& name) const
     {
         return (GetInvokedOption(name) != nullptr);
@@ -351,6 +361,18 @@ MSIX_PACKUNPACK_OPTION GetPackUnpackOptionBase(const Invocation& invocation)
     {
         packUnpack |= MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER;
     }
+    if (invocation.IsOptionPresent("-incremental"))
+    {
+        packUnpack |= MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_INCREMENTAL;
+    }
+    if (invocation.IsOptionPresent("-delete-removed"))
+    {
+        packUnpack |= MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_DELETEREMOVEDFILES;
+    }
+    if (invocation.IsOptionPresent("-verify-existing"))
+    {
+        packUnpack |= MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_VERIFYEXISTINGFILES;
+    }
 
     return packUnpack;
 }
@@ -393,6 +415,11 @@ MSIX_VALIDATION_OPTION GetValidationOption(const Invocation& invocation)
         validation |= MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE;
     }
 
+    if (invocation.IsOptionPresent("-validate-applicable"))
+    {
+        validation |= MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_VALIDATEAPPLICABLEONLY;
+    }
+
     return validation;
 }
 
@@ -452,6 +479,11 @@ MSIX_BUNDLE_OPTIONS GetBundleOptions(const Invocation& invocation)
         bundleOptions |= MSIX_BUNDLE_OPTIONS::MSIX_BUNDLE_OPTION_BUNDLEMANIFESTONLY;
     }
 
+    if (invocation.IsOptionPresent("-skip-package-validation"))
+    {
+        bundleOptions |= MSIX_BUNDLE_OPTIONS::MSIX_BUNDLE_OPTION_SKIPPACKAGEVALIDATION;
+    }
+
     return bundleOptions;
 }
 
@@ -491,13 +523,17 @@ Command CreateUnpackCommand()
     Command result{ "unpack", "Unpack files from a package to disk",
         {
             Option{ "-p", "Input package file path.", true, 1, "package" },
-            Option{ "-d", "Output directory path.", true, 1, "directory" },
+            Option{ "-d", "Output directory path. Required unless -to-tar is specified.", false, 1, "directory" },
+            Option{ "-to-tar", "Writes the files as a tar stream to <tarFile> instead of to a directory. Use - for stdout.", false, 1, "tarFile" },
             Option{ "-pfn", "Unpacks all files to a subdirectory under the output path, named after the package full name." },
             Option{ "-ac", "Allows any certificate. By default the signature origin must be known." },
             Option{ "-ss", "Skips enforcement of signed packages. By default packages must be signed." },
             // Identical behavior as -pfn. This option was created to create parity with unbundle's -pfn-flat option so that IT pros
             // creating packages for app attach only need to be aware of a single option.
             Option{ "-pfn-flat", "Same behavior as -pfn for packages." },
+            Option{ "-incremental", "Only extracts files that changed since the last incremental unpack to the same output directory." },
+            Option{ "-delete-removed", "Incremental unpack that also deletes files that are no longer in the package." },
+            Option{ "-verify-existing", "Incremental unpack that rehashes files already on disk instead of trusting the saved unpack state." },
             Option{ TOOL_HELP_COMMAND_STRING, "Displays this help text." },
         }
     };
@@ -507,11 +543,25 @@ Command CreateUnpackCommand()
         "specified output <directory>. The output has the same directory structure ",
         "as the package. If <package> is a bundle, it extract its contests with full",
         "applicability validations and its packages will be unpacked in a directory ",
-        "named as the package full name.",
+        "named as the package full name. With -to-tar the files are written as a  ",
+        "tar stream instead; a file that fails validation ends the stream with an  ",
+        "error entry.",
         });
 
     result.SetInvocationFunc([](const Invocation& invocation)
         {
+            if (invocation.IsOptionPresent("-to-tar"))
+            {
+                return UnpackPackageToTar(
+                    GetPackUnpackOptionForPackage(invocation),
+                    GetValidationOption(invocation),
+                    const_cast<char*>(invocation.GetOptionValue("-p").c_str()),
+                    const_cast<char*>(invocation.GetOptionValue("-to-tar").c_str()));
+            }
+            if (!invocation.IsOptionPresent("-d"))
+            {
+                throw std::runtime_error("Required option missing: -d");
+            }
             return UnpackPackage(
                 GetPackUnpackOptionForPackage(invocation),
                 GetValidationOption(invocation),
@@ -534,7 +584,11 @@ Command CreateUnbundleCommand()
             Option{ "-sl", "Skips matching packages with the language of the system. By default unpacked resources packages will match the system languages." },
             Option{ "-sp", "Skips matching packages with of the same system. By default unpacked application packages will only match the platform." },
             Option{ "-extract-all", "Extracts all packages from the bundle." },
+            Option{ "-validate-applicable", "Only validates the packages that are applicable. By default all packages in the bundle are validated." },
             Option{ "-pfn-flat", "Unpacks bundle's files to a subdirectory under the specified output path, named after the package full name. Unpacks packages to subdirectories also under the specified output path, named after the package full name. By default unpacked packages will be nested inside the bundle folder." },
+            Option{ "-incremental", "Only extracts files that changed since the last incremental unpack to the same output directory." },
+            Option{ "-delete-removed", "Incremental unpack that also deletes files that are no longer in the bundle or its packages." },
+            Option{ "-verify-existing", "Incremental unpack that rehashes files already on disk instead of trusting the saved unpack state." },
             Option{ TOOL_HELP_COMMAND_STRING, "Displays this help text." },
         }
     };
@@ -565,8 +619,12 @@ Command CreatePackCommand()
 {
     Command result{ "pack", "Pack files from disk to a package",
         {
-            Option{ "-d", "Input directory path.", true, 1, "directory" },
-            Option{ "-p", "Output package file path.", true, 1, "package" },
+            Option{ "-d", "Input directory path.", false, 1, "directory" },
+            Option{ "-from-tar", "Reads the files from a tar stream at <tarFile> instead of a directory. Use - for stdin.", false, 1, "tarFile" },
+            Option{ "-p", "Output package file path. Use - for stdout.", true, 1, "package" },
+            Option{ "-cache", "Keeps the compressed blocks in <cacheDirectory> and reuses them on the next pack.", false, 1, "cacheDirectory" },
+            Option{ "-seed", "Reuses the compressed blocks of <seedPackage>, a previous version of the package.", false, 1, "seedPackage" },
+            Option{ "-timing", "Prints the time spent finding the files in <directory> and packing them." },
             Option{ TOOL_HELP_COMMAND_STRING, "Displays this help text." },
         }
     };
@@ -574,16 +632,83 @@ Command CreatePackCommand()
     result.SetDescription({
         "Creates an app package at <package> by adding all the files from the",
         "specified input <directory>. You must include a valid package manifest",
-        "file named AppxManifest.xml in the directory provided.",
+        "file named AppxManifest.xml in the directory provided. With -cache or",
+        "-seed files that didn't change since a previous pack aren't compressed",
+        "again. The package is the same as without them. With -from-tar the files",
+        "are read from a tar stream, in the order they are in it, instead of from",
+        "<directory>. The package can be written to stdout or a pipe, it is",
+        "written from start to end without seeking back.",
         });
 
     result.SetInvocationFunc([](const Invocation& invocation)
         {
-            return PackPackage(
-                MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
-                MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL,
-                const_cast<char*>(invocation.GetOptionValue("-d").c_str()),
-                const_cast<char*>(invocation.GetOptionValue("-p").c_str()));
+            bool useCache = invocation.IsOptionPresent("-cache");
+            bool useSeed = invocation.IsOptionPresent("-seed");
+            bool useTar = invocation.IsOptionPresent("-from-tar");
+            if (useTar == invocation.IsOptionPresent("-d"))
+            {
+                invocation.SetErrorText("You must specify either an input directory (-d) or a tar file (-from-tar).");
+                return static_cast<HRESULT>(-1);
+            }
+            if (useTar && (useCache || useSeed))
+            {
+                invocation.SetErrorText("-cache and -seed can't be used with -from-tar.");
+                return static_cast<HRESULT>(-1);
+            }
+
+            HRESULT hr;
+            if (useTar)
+            {
+                hr = PackPackageFromTar(
+                    MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                    MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL,
+                    const_cast<char*>(invocation.GetOptionValue("-from-tar").c_str()),
+                    const_cast<char*>(invocation.GetOptionValue("-p").c_str()));
+            }
+            else if (!useCache && !useSeed)
+            {
+                hr = PackPackage(
+                    MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                    MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL,
+                    const_cast<char*>(invocation.GetOptionValue("-d").c_str()),
+                    const_cast<char*>(invocation.GetOptionValue("-p").c_str()));
+            }
+            else
+            {
+                std::string cacheDirectory = useCache ? invocation.GetOptionValue("-cache") : std::string();
+                std::string seedPackage = useSeed ? invocation.GetOptionValue("-seed") : std::string();
+                hr = PackPackageWithBlockCache(
+                    MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                    MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL,
+                    const_cast<char*>(invocation.GetOptionValue("-d").c_str()),
+                    const_cast<char*>(invocation.GetOptionValue("-p").c_str()),
+                    useCache ? const_cast<char*>(cacheDirectory.c_str()) : nullptr,
+                    useSeed ? const_cast<char*>(seedPackage.c_str()) : nullptr,
+                    0);
+            }
+
+            MSIX_PACK_STATISTICS statistics = {};
+            if (SUCCEEDED(hr) && SUCCEEDED(MsixGetPackStatistics(&statistics, false)))
+            {
+                std::ostream& console = invocation.IsOutputToStdout() ? std::cerr : std::cout;
+                if (useCache || useSeed)
+                {
+                    auto lookups = statistics.cacheHits + statistics.cacheMisses;
+                    console << "Block cache: " << statistics.cacheHits << " of " << lookups << " compressed blocks reused";
+                    if (lookups > 0)
+                    {
+                        console << " (" << (statistics.cacheHits * 100 / lookups) << "%)";
+                    }
+                    console << std::endl;
+                }
+                if (invocation.IsOptionPresent("-timing"))
+                {
+                    console << "Found " << statistics.scannedFiles << " files in " << statistics.scannedDirectories
+                        << " directories in " << statistics.scanMicroseconds / 1000 << " ms" << std::endl;
+                    console << "Packed them in " << statistics.packMicroseconds / 1000 << " ms" << std::endl;
+                }
+            }
+            return hr;
         });
 
     return result;
@@ -606,6 +731,7 @@ Command CreateBundleCommand()
                             "be package manifests in XML format if this option is specified." },
             Option{ "-fb", "Generates a fully sparse bundle where all packages are references to"
                            "packages that exist outside of the bundle file." },
+            Option{ "-skip-package-validation", "Only reads the manifest of the packages of a flat bundle. By default the packages are fully validated." },
             Option{ "-o", "Forces the output to overwrite any existing files with the"
                            "same name.By default, the user is asked whether to overwrite existing"
                            "files with the same name.You can't use this option with /no." },
@@ -657,9 +783,6 @@ Command CreateBundleCommand()
 // Defines the grammar of commands and each command's associated options,
 int main(int argc, char* argv[])
 {
-    std::cout << "Microsoft (R) makemsix version " << SDK_VERSION << std::endl;
-    std::cout << "Copyright (C) 2017 Microsoft.  All rights reserved." << std::endl;
-
     std::vector<Command> commands = {
         CreateUnpackCommand(),
         CreateUnbundleCommand(),
@@ -674,8 +797,13 @@ int main(int argc, char* argv[])
     const Command& mainHelpCommand = commands.back();
 
     Invocation invocation;
+    bool parsed = invocation.Parse(commands, argc, argv);
+    std::ostream& console = (parsed && invocation.IsOutputToStdout()) ? std::cerr : std::cout;
+
+    console << "Microsoft (R) makemsix version " << SDK_VERSION << std::endl;
+    console << "Copyright (C) 2017 Microsoft.  All rights reserved." << std::endl;
 
-    if (!invocation.Parse(commands, argc, argv))
+    if (!parsed)
     {
         std::cout << std::endl;
         std::cout << "Error: " << invocation.GetErrorText() << std::endl;
@@ -696,21 +824,21 @@ int main(int argc, char* argv[])
 
     if (result != 0)
     {        
-        std::cout << "Error: 0x" << std::hex << result << std::endl;
+        console << "Error: 0x" << std::hex << result << std::endl;
         if (!invocation.GetErrorText().empty())
         {
-            std::cout << "Error: " << invocation.GetErrorText() << std::endl;
+            console << "Error: " << invocation.GetErrorText() << std::endl;
         }
 
         Text text;
         auto logResult = MsixGetLogTextUTF8(MyAllocate, &text);
         if (0 == logResult)
         {
-            std::cout << "LOG:" << std::endl << text.content << std::endl;
+            console << "LOG:" << std::endl << text.content << std::endl;
         }
         else 
         {
-            std::cout << "UNABLE TO GET LOG WITH HR=0x" << std::hex << logResult << std::endl;
+            console << "UNABLE TO GET LOG WITH HR=0x" << std::hex << logResult << std::endl;
         }
     }
     return result;
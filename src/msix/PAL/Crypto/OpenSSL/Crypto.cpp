@@ -6,7 +6,6 @@
 #include "Crypto.hpp"
 
 #include "openssl/sha.h"
-#include "openssl/evp.h"
 
 namespace MSIX {
     SHA256::SHA256()
@@ -46,13 +45,4 @@ namespace MSIX {
         ::SHA256(buffer, cbBuffer, hash.data());
         return true;
     }
-
-    std::string Base64::ComputeBase64(const std::vector<std::uint8_t>& buffer)
-    {
-        int expectedSize = ((buffer.size() +2)/3)*4; // +2 for a cheap round up if it needs padding
-        std::vector<std::uint8_t> result(expectedSize);
-        int encodeResult = EVP_EncodeBlock(static_cast<unsigned char*>(result.data()), const_cast<unsigned char*>(buffer.data()), buffer.size());
-        ThrowErrorIf(Error::Unexpected, expectedSize != encodeResult, "Error computing base64");
-        return std::string(result.begin(), result.end());
-    }
 }
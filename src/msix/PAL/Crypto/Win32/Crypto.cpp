@@ -10,7 +10,6 @@
 #include <winerror.h>
 #include "Exceptions.hpp"
 #include "Crypto.hpp"
-#include "UnicodeConversion.hpp"
 
 #include <memory>
 #include <vector>
@@ -131,17 +130,4 @@ namespace MSIX {
         hashEngine.FinalizeAndGetHashValue(hash);
         return true;
     }
-
-    std::string Base64::ComputeBase64(const std::vector<std::uint8_t>& buffer)
-    {
-        std::wstring result;
-        DWORD encodingFlags = CRYPT_STRING_BASE64 | CRYPT_STRING_NOCRLF;
-        DWORD encodedHashSize = 0;
-        ThrowHrIfFalse(CryptBinaryToStringW(buffer.data(), static_cast<DWORD>(buffer.size()), encodingFlags, nullptr, &encodedHashSize),
-            "CryptBinaryToStringW failed");
-        result.resize(encodedHashSize-1); // CryptBinaryToStringW returned size includes null termination
-        ThrowHrIfFalse(CryptBinaryToStringW(buffer.data(), static_cast<DWORD>(buffer.size()), encodingFlags, const_cast<wchar_t*>(result.data()), &encodedHashSize),
-            "CryptBinaryToStringW failed");
-        return wstring_to_utf8(result);
-    }
 }
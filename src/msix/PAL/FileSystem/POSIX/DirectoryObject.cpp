@@ -6,49 +6,127 @@
 #include "StreamBase.hpp"
 #include "DirectoryObject.hpp"
 #include "MsixFeatureSelector.hpp"
+#include "ParallelHelper.hpp"
+#include "PackStatistics.hpp"
+#include "ScopeExit.hpp"
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <fts.h>
 #include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <iterator>
 #include <map>
+#include <tuple>
 
 namespace MSIX
 {
     namespace
     {
-        template<class Lambda>
-        void WalkDirectory(const std::string& root, Lambda& visitor)
+        struct ScannedFile
         {
-            static std::string dot(".");
-            static std::string dotdot("..");
+            std::uint64_t lastModified;
+            std::string name;
+        };
 
-            std::unique_ptr<DIR, decltype(&closedir)> dir(opendir(root.c_str()), closedir);
-            ThrowErrorIf(Error::FileNotFound, dir.get() == nullptr, "Invalid directory");
+        // A directory to scan, relative to the root. ancestors has the device and inode of the directory
+        // and of every directory above it, a link to any of them is a loop.
+        struct ScanDirectory
+        {
+            std::string name;
+            std::vector<std::pair<dev_t, ino_t>> ancestors;
+        };
+
+        struct ScanResult
+        {
+            std::vector<ScannedFile> files;
+            std::vector<ScanDirectory> directories;
+        };
+
+        // Lists a directory relative to the root file descriptor and stats its entries relative to the
+        // directory's, so no full path is built or resolved for each entry.
+        void ScanOneDirectory(int rootFd, const ScanDirectory& directory, ScanResult& result)
+        {
+            int fd = openat(rootFd, directory.name.empty() ? "." : directory.name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            ThrowErrorIf(Error::FileNotFound, fd == -1, "Invalid directory");
+            std::unique_ptr<DIR, decltype(&closedir)> dir(fdopendir(fd), closedir);
+            if (dir.get() == nullptr)
+            {
+                close(fd);
+                ThrowErrorAndLog(Error::FileNotFound, "Invalid directory");
+            }
+
+            std::string prefix = directory.name.empty() ? directory.name : directory.name + "/";
             struct dirent* dp;
-            // TODO: handle junction loops
             while((dp = readdir(dir.get())) != nullptr)
             {
-                std::string fileName = std::string(dp->d_name);
-                std::string child = root + "/" + fileName;
-                if (dp->d_type == DT_DIR)
+                if ((strcmp(dp->d_name, ".") == 0) || (strcmp(dp->d_name, "..") == 0))
+                {
+                    continue;
+                }
+                // TODO: ignore .DS_STORE for mac?
+                // Directories are stat'ed too, links are followed and their device and inode are needed
+                // to detect loops.
+                struct stat sb;
+                ThrowErrorIf(Error::Unexpected, fstatat(fd, dp->d_name, &sb, 0) == -1, std::string("stat call failed" + std::to_string(errno)).c_str());
+                if (S_ISDIR(sb.st_mode))
                 {
-                    if ((fileName != dot) && (fileName != dotdot))
+                    auto id = std::make_pair(sb.st_dev, sb.st_ino);
+                    if (std::find(directory.ancestors.begin(), directory.ancestors.end(), id) == directory.ancestors.end())
                     {
-                        WalkDirectory(child, visitor);
+                        ScanDirectory child = { prefix + dp->d_name, directory.ancestors };
+                        child.ancestors.push_back(id);
+                        result.directories.push_back(std::move(child));
                     }
                 }
                 else
                 {
-                    // TODO: ignore .DS_STORE for mac?
-                    struct stat sb;
-                    ThrowErrorIf(Error::Unexpected, stat(child.c_str(), &sb) == -1, std::string("stat call failed" + std::to_string(errno)).c_str());
-                    if (!visitor(root, std::move(fileName), static_cast<std::uint64_t>(sb.st_mtime)))
-                    {
-                        break;
-                    }
+                    result.files.push_back({ static_cast<std::uint64_t>(sb.st_mtime), prefix + dp->d_name });
+                }
+            }
+        }
+
+        // Scans the tree one level at a time, the directories of each level in parallel. Files are
+        // sorted by last modified time and then by name, so the order doesn't depend on the order of
+        // the directory entries or on which thread got to them first.
+        std::vector<ScannedFile> ScanTree(const std::string& root)
+        {
+            int rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            ThrowErrorIf(Error::FileNotFound, rootFd == -1, "Invalid directory");
+            auto closeRoot = MSIX::scope_exit([rootFd] { close(rootFd); });
+
+            struct stat sb;
+            ThrowErrorIf(Error::Unexpected, fstat(rootFd, &sb) == -1, std::string("stat call failed" + std::to_string(errno)).c_str());
+            std::vector<ScanDirectory> level = { { std::string(), { std::make_pair(sb.st_dev, sb.st_ino) } } };
+
+            std::vector<ScannedFile> files;
+            while (!level.empty())
+            {
+                std::vector<ScanResult> results(level.size());
+                auto taskResults = Helper::ParallelFor(level.size(), [&](std::size_t index)
+                {
+                    ScanOneDirectory(rootFd, level[index], results[index]);
+                });
+                Helper::MergeParallelResults(taskResults);
+                Global::PackStatistics::Get().scannedDirectories += level.size();
+
+                std::vector<ScanDirectory> next;
+                for (auto& result : results)
+                {
+                    std::move(result.files.begin(), result.files.end(), std::back_inserter(files));
+                    std::move(result.directories.begin(), result.directories.end(), std::back_inserter(next));
                 }
+                level = std::move(next);
             }
+
+            std::sort(files.begin(), files.end(), [](const ScannedFile& left, const ScannedFile& right)
+            {
+                return std::tie(left.lastModified, left.name) < std::tie(right.lastModified, right.name);
+            });
+            return files;
         }
 
         #define DEFAULT_MODE S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH
@@ -104,19 +182,32 @@ namespace MSIX
     {
         THROW_IF_PACK_NOT_ENABLED
         std::multimap<std::uint64_t, std::string> files;
-        auto rootSize = m_root.size() + 1; // plus separator
-        auto lamdba = [&](
-                std::string root,
-                std::string&& name,
-                std::uint64_t size)
-           {
-                std::string fileName = root + GetPathSeparator() + name;
-                // root contains the top level directory, which we don't need
-                fileName = fileName.substr(rootSize);
-                files.insert(std::make_pair(size, std::move(fileName)));
-                return true;
-           };
-        WalkDirectory(m_root, lamdba);
+        for (auto& file : ScanTree(m_root))
+        {
+            // Files with the same time keep the order they're inserted in.
+            files.emplace_hint(files.end(), file.lastModified, std::move(file.name));
+        }
         return files;
     }
+
+    bool DirectoryObject::FileExists(const std::string& fileName)
+    {
+        std::string name = m_root + GetPathSeparator() + fileName;
+        struct stat sb;
+        return (stat(name.c_str(), &sb) == 0) && S_ISREG(sb.st_mode);
+    }
+
+    bool DirectoryObject::RemoveFile(const std::string& fileName)
+    {
+        std::string name = m_root + GetPathSeparator() + fileName;
+        return (remove(name.c_str()) == 0 || errno == ENOENT);
+    }
+
+    void DirectoryObject::RenameFile(const std::string& source, const std::string& target)
+    {
+        std::string from = m_root + GetPathSeparator() + source;
+        std::string to = m_root + GetPathSeparator() + target;
+        // rename replaces an existing target atomically
+        ThrowErrorIfNot(Error::FileWrite, (rename(from.c_str(), to.c_str()) == 0), std::string("rename failed: " + from).c_str());
+    }
 }
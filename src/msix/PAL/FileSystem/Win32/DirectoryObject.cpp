@@ -15,8 +15,6 @@
 #include <iostream>
 #include <string>
 #include <sstream>
-#include <locale>
-#include <codecvt>
 #include <queue>
 
 namespace MSIX
@@ -70,8 +68,7 @@ namespace MSIX
             // TODO: handle junction loops
             do
             {
-                utf16Name = std::wstring(findFileData.cFileName);
-                auto utf8Name = wstring_to_utf8(utf16Name);
+                auto utf8Name = wstring_to_utf8(findFileData.cFileName);
                 if (findFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
                 {
                     if (dot != utf8Name && dotdot != utf8Name)
@@ -335,6 +332,51 @@ namespace MSIX
             });
         return files;
     }
+
+    bool DirectoryObject::FileExists(const std::string& fileName)
+    {
+        std::queue<DirectoryInfo> directories;
+        SplitDirectories(fileName, directories, false);
+        std::string path;
+        EnsureDirectoryStructureExists(m_root, directories, true, GetPathSeparator(), &path);
+
+        DWORD attr = GetFileAttributesW(utf8_to_wstring(path).c_str());
+        return (attr != INVALID_FILE_ATTRIBUTES) && !(attr & FILE_ATTRIBUTE_DIRECTORY);
+    }
+
+    bool DirectoryObject::RemoveFile(const std::string& fileName)
+    {
+        std::queue<DirectoryInfo> directories;
+        SplitDirectories(fileName, directories, false);
+        std::string path;
+        EnsureDirectoryStructureExists(m_root, directories, true, GetPathSeparator(), &path);
+
+        if (!DeleteFileW(utf8_to_wstring(path).c_str()))
+        {
+            auto lastError = GetLastError();
+            return (lastError == ERROR_FILE_NOT_FOUND || lastError == ERROR_PATH_NOT_FOUND);
+        }
+        return true;
+    }
+
+    void DirectoryObject::RenameFile(const std::string& source, const std::string& target)
+    {
+        std::queue<DirectoryInfo> sourceDirectories;
+        SplitDirectories(source, sourceDirectories, false);
+        std::string sourcePath;
+        EnsureDirectoryStructureExists(m_root, sourceDirectories, true, GetPathSeparator(), &sourcePath);
+
+        std::queue<DirectoryInfo> targetDirectories;
+        SplitDirectories(target, targetDirectories, true);
+        std::string targetPath;
+        EnsureDirectoryStructureExists(m_root, targetDirectories, true, GetPathSeparator(), &targetPath);
+
+        if (!MoveFileExW(utf8_to_wstring(sourcePath).c_str(), utf8_to_wstring(targetPath).c_str(), MOVEFILE_REPLACE_EXISTING))
+        {
+            auto lastError = GetLastError();
+            ThrowWin32ErrorIfNot(lastError, false, std::string("Call to MoveFileEx failed for: " + sourcePath).c_str());
+        }
+    }
 }
 
 // Don't pollute other compilation units with any of our #defs...
@@ -12,6 +12,7 @@
 #include "AppxSignature.hpp"
 #include "FileStream.hpp"
 #include "SignatureValidator.hpp"
+#include "UnicodeConversion.hpp"
 
 namespace MSIX
 {
@@ -450,9 +451,7 @@ namespace MSIX
             publisherT.data(),
             requiredLength) > 0)
         {
-            auto converted = std::wstring_convert<std::codecvt_utf8<wchar_t>>{}.to_bytes(publisherT.data());
-            std::string result(converted.begin(), converted.end());
-            publisher = result;
+            publisher = wstring_to_utf8(publisherT.data());
             return true;
         }
         return false;
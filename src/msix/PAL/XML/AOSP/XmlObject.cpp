@@ -88,6 +88,22 @@ public:
         return {};
     }
 
+    // The values are copied from Java on every call, they are kept for as long as the element.
+    XmlStringView GetAttributeValueView(XmlAttributeName attribute) override
+    {
+        return m_strings.Keep(GetAttributeValue(attribute));
+    }
+
+    XmlStringView GetTextView() override
+    {
+        return m_strings.Keep(GetText());
+    }
+
+    XmlStringView GetPrefixView() override
+    {
+        return m_strings.Keep(GetPrefix());
+    }
+
     // IJavaXmlElement
     jobject GetJavaObject() override { return m_javaXmlElementObject.get(); }
 
@@ -152,6 +168,7 @@ private:
     jmethodID getElementsByTagNameFunc = nullptr;
     jmethodID getElementsFunc = nullptr;
     JNIEnv* m_env = nullptr;
+    XmlStringStore m_strings;
 
     std::string GetAttributeValue(std::string& attributeName)
     {
@@ -59,6 +59,22 @@ public:
         return m_xmlNode->Prefix;
     }
 
+    XmlStringView GetAttributeValueView(XmlAttributeName attribute) override
+    {
+        auto found = m_xmlNode->Attributes.find(GetAttributeNameStringUtf8(attribute));
+        return (found == m_xmlNode->Attributes.end()) ? XmlStringView() : XmlStringView(found->second);
+    }
+
+    XmlStringView GetTextView() override
+    {
+        return m_xmlNode->Text;
+    }
+
+    XmlStringView GetPrefixView() override
+    {
+        return m_xmlNode->Prefix;
+    }
+
     // IAppleXmlElement
     XmlNode* GetXmlNode() override { return m_xmlNode; }
 
@@ -0,0 +1,808 @@
+//
+//  Copyright (C) 2017 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+// 
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "IXml.hpp"
+#include "Base64.hpp"
+#include "StreamHelper.hpp"
+#include "UnicodeConversion.hpp"
+#include "Enumerators.hpp"
+
+// An internal interface for the elements of the non-validating XML parser
+// {5b1f3c9e-0a7d-4e52-9c61-2f8d4a7b9e03}
+#ifndef WIN32
+interface ILiteXmlElement : public IUnknown
+#else
+#include "Unknwn.h"
+#include "Objidl.h"
+class ILiteXmlElement : public IUnknown
+#endif
+{
+public:
+    virtual std::uint32_t GetNode() = 0;
+};
+MSIX_INTERFACE(ILiteXmlElement, 0x5b1f3c9e,0x0a7d,0x4e52,0x9c,0x61,0x2f,0x8d,0x4a,0x7b,0x9e,0x03);
+
+namespace MSIX {
+
+// Non-validating XML 1.0 parser for UTF-8 documents. DTDs are rejected. The document is parsed in one pass into a
+// flat table of elements that refer to the original buffer. Entity references and line endings are decoded in place,
+// which never makes a value longer than its source.
+class LiteXmlDocument final
+{
+public:
+    static const std::uint32_t None = std::numeric_limits<std::uint32_t>::max();
+
+    struct Span
+    {
+        std::uint32_t offset = 0;
+        std::uint32_t size = 0;
+    };
+
+    struct Attribute
+    {
+        Span name;
+        Span value;
+    };
+
+    struct Node
+    {
+        Span name;                      // qualified name
+        std::uint32_t prefixSize = 0;   // 0 if the name has no prefix
+        Span namespaceUri;
+        std::uint32_t parent = None;
+        std::uint32_t firstChild = None;
+        std::uint32_t lastChild = None;
+        std::uint32_t nextSibling = None;
+        std::uint32_t firstAttribute = 0;
+        std::uint32_t attributeCount = 0;
+        std::uint32_t firstText = 0;    // text of the element and its descendants is [firstText, endText) in m_texts
+        std::uint32_t endText = 0;
+    };
+
+    LiteXmlDocument(std::vector<std::uint8_t>&& buffer) : m_buffer(std::move(buffer))
+    {
+        ThrowErrorIf(Error::XmlFatal, m_buffer.size() >= None, "XML document is too big");
+        Parse();
+    }
+
+    const Node& GetNode(std::uint32_t index) const { return m_nodes[index]; }
+
+    std::uint64_t GetMemoryUsage() const
+    {
+        return sizeof(*this) + m_buffer.capacity() +
+            m_nodes.capacity() * sizeof(Node) +
+            m_attributes.capacity() * sizeof(Attribute) +
+            m_texts.capacity() * sizeof(Span) +
+            m_bindings.capacity() * sizeof(m_bindings[0]) +
+            m_scopes.capacity() * sizeof(std::size_t);
+    }
+
+    XmlStringView GetView(const Span& span) const { return XmlStringView(Data(span), span.size); }
+
+    XmlStringView GetPrefix(std::uint32_t index) const
+    {
+        const auto& node = m_nodes[index];
+        return XmlStringView(Data(node.name), node.prefixSize);
+    }
+
+    // The text is a view of the buffer when it is made of one piece. Returns false if it has to be concatenated.
+    bool GetTextView(std::uint32_t index, XmlStringView& text) const
+    {
+        const auto& node = m_nodes[index];
+        if (node.endText - node.firstText > 1)
+        {
+            return false;
+        }
+        text = (node.endText == node.firstText) ? XmlStringView() : GetView(m_texts[node.firstText]);
+        return true;
+    }
+
+    std::string GetText(std::uint32_t index) const
+    {
+        const auto& node = m_nodes[index];
+        std::size_t size = 0;
+        for (auto i = node.firstText; i < node.endText; i++) { size += m_texts[i].size; }
+        std::string result;
+        result.reserve(size);
+        for (auto i = node.firstText; i < node.endText; i++) { result.append(Data(m_texts[i]), m_texts[i].size); }
+        return result;
+    }
+
+    // Attributes are matched by their qualified name. Returns nullptr if the attribute is not present.
+    const Attribute* FindAttribute(std::uint32_t index, const char* name, std::size_t size) const
+    {
+        const auto& node = m_nodes[index];
+        for (auto i = node.firstAttribute; i < node.firstAttribute + node.attributeCount; i++)
+        {
+            if (Equals(m_attributes[i].name, name, size))
+            {
+                return &m_attributes[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Returns an empty string if the attribute is not present.
+    XmlStringView GetAttributeValue(std::uint32_t index, const char* name, std::size_t size) const
+    {
+        auto attribute = FindAttribute(index, name, size);
+        return (attribute == nullptr) ? XmlStringView() : GetView(attribute->value);
+    }
+
+    std::vector<std::uint8_t> GetBase64DecodedAttributeValue(std::uint32_t index, const char* name, std::size_t size) const
+    {
+        auto attribute = FindAttribute(index, name, size);
+        if (attribute == nullptr)
+        {
+            return {};
+        }
+        std::vector<std::uint8_t> result(Base64::GetMaxDecodedSize(attribute->value.size));
+        result.resize(Base64::Decode(Data(attribute->value), attribute->value.size, result.data()));
+        return result;
+    }
+
+    // Adds the elements selected by the path in document order. Steps are matched by local name, by qualified
+    // name if they have a prefix, '*' matches any element and '.' the current one. For paths from the root the
+    // first step is matched against the context element itself.
+    void Select(const XmlQueryPath& path, std::uint32_t context, std::vector<std::uint32_t>& result) const
+    {
+        if (path.fromRoot)
+        {
+            if (Matches(context, path.steps[0]))
+            {
+                SelectFrom(path, 1, context, result);
+            }
+        }
+        else
+        {
+            SelectFrom(path, 0, context, result);
+        }
+    }
+
+    bool LocalNameEquals(std::uint32_t index, const std::string& name) const
+    {
+        const auto& node = m_nodes[index];
+        auto skip = (node.prefixSize == 0) ? 0 : node.prefixSize + 1;
+        return (node.name.size - skip == name.size()) && (std::memcmp(Data(node.name) + skip, name.data(), name.size()) == 0);
+    }
+
+protected:
+    const char* Data(const Span& span) const { return reinterpret_cast<const char*>(m_buffer.data()) + span.offset; }
+
+    bool Equals(const Span& span, const char* value, std::size_t size) const
+    {
+        return (span.size == size) && (std::memcmp(Data(span), value, size) == 0);
+    }
+
+    bool Equals(const Span& left, const Span& right) const { return Equals(left, Data(right), right.size); }
+
+    bool Matches(std::uint32_t index, const std::string& step) const
+    {
+        if (step == "*") { return true; }
+        if (step.find(':') != std::string::npos) { return Equals(m_nodes[index].name, step.data(), step.size()); }
+        return LocalNameEquals(index, step);
+    }
+
+    void SelectFrom(const XmlQueryPath& path, std::size_t step, std::uint32_t index, std::vector<std::uint32_t>& result) const
+    {
+        if (step == path.steps.size())
+        {
+            result.push_back(index);
+            return;
+        }
+        if (path.steps[step] == ".")
+        {
+            SelectFrom(path, step + 1, index, result);
+            return;
+        }
+        for (auto child = m_nodes[index].firstChild; child != None; child = m_nodes[child].nextSibling)
+        {
+            if (Matches(child, path.steps[step]))
+            {
+                SelectFrom(path, step + 1, child, result);
+            }
+        }
+    }
+
+    enum class Content
+    {
+        Text,
+        CData,
+        AttributeValue,
+    };
+
+    static bool IsWhitespace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    static bool IsNameChar(char c)
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '_' || c == ':' || c == '-' || c == '.' || (static_cast<std::uint8_t>(c) >= 0x80);
+    }
+
+    std::uint32_t Offset(const char* position) const
+    {
+        return static_cast<std::uint32_t>(position - reinterpret_cast<const char*>(m_buffer.data()));
+    }
+
+    bool StartsWith(const char* literal) const
+    {
+        auto size = std::strlen(literal);
+        return (static_cast<std::size_t>(m_end - m_cursor) >= size) && (std::memcmp(m_cursor, literal, size) == 0);
+    }
+
+    bool SkipWhitespace()
+    {
+        auto start = m_cursor;
+        while (m_cursor < m_end && IsWhitespace(*m_cursor)) { m_cursor++; }
+        return m_cursor != start;
+    }
+
+    void Expect(char c)
+    {
+        ThrowErrorIf(Error::XmlFatal, (m_cursor == m_end || *m_cursor != c), "Malformed XML document");
+        m_cursor++;
+    }
+
+    // Returns the position of the literal from the cursor
+    char* Find(const char* literal) const
+    {
+        auto found = std::search(m_cursor, m_end, literal, literal + std::strlen(literal));
+        ThrowErrorIf(Error::XmlFatal, found == m_end, "Unexpected end of XML document");
+        return found;
+    }
+
+    Span ParseName()
+    {
+        auto start = m_cursor;
+        while (m_cursor < m_end && IsNameChar(*m_cursor)) { m_cursor++; }
+        ThrowErrorIf(Error::XmlFatal, (m_cursor == start) || (*start >= '0' && *start <= '9') || *start == '-' || *start == '.',
+            "Invalid XML name");
+        Span name;
+        name.offset = Offset(start);
+        name.size = static_cast<std::uint32_t>(m_cursor - start);
+        return name;
+    }
+
+    std::uint32_t GetPrefixSize(const Span& name) const
+    {
+        auto data = Data(name);
+        auto colon = static_cast<const char*>(std::memchr(data, ':', name.size));
+        if (colon == nullptr) { return 0; }
+        auto prefixSize = static_cast<std::uint32_t>(colon - data);
+        ThrowErrorIf(Error::XmlFatal, (prefixSize == 0) || (prefixSize + 1 == name.size) ||
+            (std::memchr(colon + 1, ':', name.size - prefixSize - 1) != nullptr), "Invalid qualified name");
+        return prefixSize;
+    }
+
+    // Decodes the character references and normalizes the line endings of [begin, end) in place.
+    Span Decode(char* begin, char* end, Content content)
+    {
+        Span span;
+        span.offset = Offset(begin);
+        char* read = begin;
+        if (content == Content::AttributeValue)
+        {
+            while (read < end && *read != '&' && *read != '<' && *read != '\r' && *read != '\n' && *read != '\t') { read++; }
+        }
+        else if (content == Content::Text)
+        {
+            while (read < end && *read != '&' && *read != '\r') { read++; }
+        }
+        else
+        {
+            while (read < end && *read != '\r') { read++; }
+        }
+        char* write = read;
+        while (read < end)
+        {
+            char c = *read++;
+            if (c == '&' && content != Content::CData)
+            {
+                read = DecodeReference(read, end, write);
+                continue;
+            }
+            ThrowErrorIf(Error::XmlFatal, (c == '<' && content == Content::AttributeValue), "'<' is not allowed in an attribute value");
+            if (c == '\r')
+            {
+                c = '\n';
+                if (read < end && *read == '\n') { read++; }
+            }
+            if (content == Content::AttributeValue && (c == '\n' || c == '\t'))
+            {
+                c = ' ';
+            }
+            *write++ = c;
+        }
+        span.size = static_cast<std::uint32_t>(write - begin);
+        return span;
+    }
+
+    // read is past the '&'. Writes the value of the reference and returns the position after the ';'
+    char* DecodeReference(char* read, char* end, char*& write)
+    {
+        auto semicolon = static_cast<char*>(std::memchr(read, ';', static_cast<std::size_t>(end - read)));
+        ThrowErrorIf(Error::XmlFatal, semicolon == nullptr, "Unterminated reference");
+        std::string name(read, semicolon);
+        if (name == "lt") { *write++ = '<'; }
+        else if (name == "gt") { *write++ = '>'; }
+        else if (name == "amp") { *write++ = '&'; }
+        else if (name == "apos") { *write++ = '\''; }
+        else if (name == "quot") { *write++ = '"'; }
+        else
+        {
+            ThrowErrorIf(Error::XmlFatal, (name.size() < 2 || name[0] != '#'), "Undefined entity");
+            bool hex = (name[1] == 'x');
+            std::size_t digits = hex ? 2 : 1;
+            ThrowErrorIf(Error::XmlFatal, (digits == name.size()) || (name.size() - digits > 8), "Invalid character reference");
+            std::uint32_t codepoint = 0;
+            for (auto i = digits; i < name.size(); i++)
+            {
+                char c = name[i];
+                std::uint32_t value = 0;
+                if (c >= '0' && c <= '9') { value = c - '0'; }
+                else if (hex && c >= 'a' && c <= 'f') { value = c - 'a' + 10; }
+                else if (hex && c >= 'A' && c <= 'F') { value = c - 'A' + 10; }
+                else { ThrowErrorAndLog(Error::XmlFatal, "Invalid character reference"); }
+                codepoint = codepoint * (hex ? 16 : 10) + value;
+            }
+            ThrowErrorIf(Error::XmlFatal, (codepoint == 0) || (codepoint > 0x10FFFF) || (codepoint >= 0xD800 && codepoint <= 0xDFFF),
+                "Invalid character reference");
+            if (codepoint < 0x80)
+            {
+                *write++ = static_cast<char>(codepoint);
+            }
+            else if (codepoint < 0x800)
+            {
+                *write++ = static_cast<char>(0xC0 | (codepoint >> 6));
+                *write++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+            else if (codepoint < 0x10000)
+            {
+                *write++ = static_cast<char>(0xE0 | (codepoint >> 12));
+                *write++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                *write++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+            else
+            {
+                *write++ = static_cast<char>(0xF0 | (codepoint >> 18));
+                *write++ = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+                *write++ = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+                *write++ = static_cast<char>(0x80 | (codepoint & 0x3F));
+            }
+        }
+        return semicolon + 1;
+    }
+
+    void AddText(char* begin, char* end, Content content)
+    {
+        auto text = Decode(begin, end, content);
+        if (text.size != 0)
+        {
+            m_texts.push_back(text);
+        }
+    }
+
+    // Returns the namespace bound to the prefix of a name in the current scope
+    Span LookupNamespace(const Span& name, std::uint32_t prefixSize) const
+    {
+        Span prefix;
+        prefix.offset = name.offset;
+        prefix.size = prefixSize;
+        for (auto binding = m_bindings.rbegin(); binding != m_bindings.rend(); binding++)
+        {
+            if (Equals(binding->first, prefix))
+            {
+                return binding->second;
+            }
+        }
+        ThrowErrorIf(Error::XmlFatal, (prefixSize != 0) && !Equals(prefix, "xml", 3), "Undeclared namespace prefix");
+        return {};
+    }
+
+    void ParseDeclaration()
+    {
+        auto close = Find("?>");
+        std::string declaration(m_cursor, close);
+        auto encoding = declaration.find("encoding");
+        if (encoding != std::string::npos)
+        {
+            auto quote = declaration.find_first_of("\"'", encoding);
+            ThrowErrorIf(Error::XmlFatal, quote == std::string::npos, "Malformed XML declaration");
+            auto endQuote = declaration.find(declaration[quote], quote + 1);
+            ThrowErrorIf(Error::XmlFatal, endQuote == std::string::npos, "Malformed XML declaration");
+            std::string value = declaration.substr(quote + 1, endQuote - quote - 1);
+            std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+            ThrowErrorIf(Error::XmlFatal, value != "utf-8" && value != "utf8", "Only UTF-8 XML documents are supported");
+        }
+        m_cursor = close + 2;
+    }
+
+    // Parses a start tag after the '<'. Returns the element that is open after it.
+    std::uint32_t StartElement(std::uint32_t parent)
+    {
+        auto index = static_cast<std::uint32_t>(m_nodes.size());
+        Node node;
+        node.name = ParseName();
+        node.parent = parent;
+        node.firstAttribute = static_cast<std::uint32_t>(m_attributes.size());
+        node.firstText = static_cast<std::uint32_t>(m_texts.size());
+        auto scope = m_bindings.size();
+
+        bool empty = false;
+        while (true)
+        {
+            bool whitespace = SkipWhitespace();
+            ThrowErrorIf(Error::XmlFatal, m_cursor == m_end, "Unexpected end of XML document");
+            if (*m_cursor == '/')
+            {
+                m_cursor++;
+                Expect('>');
+                empty = true;
+                break;
+            }
+            if (*m_cursor == '>')
+            {
+                m_cursor++;
+                break;
+            }
+            ThrowErrorIfNot(Error::XmlFatal, whitespace, "Attributes must be separated by whitespace");
+
+            Attribute attribute;
+            attribute.name = ParseName();
+            SkipWhitespace();
+            Expect('=');
+            SkipWhitespace();
+            ThrowErrorIf(Error::XmlFatal, (m_cursor == m_end) || (*m_cursor != '"' && *m_cursor != '\''), "Attribute value must be quoted");
+            char quote = *m_cursor++;
+            auto close = static_cast<char*>(std::memchr(m_cursor, quote, static_cast<std::size_t>(m_end - m_cursor)));
+            ThrowErrorIf(Error::XmlFatal, close == nullptr, "Unexpected end of XML document");
+            attribute.value = Decode(m_cursor, close, Content::AttributeValue);
+            m_cursor = close + 1;
+
+            for (auto i = node.firstAttribute; i < m_attributes.size(); i++)
+            {
+                ThrowErrorIf(Error::XmlFatal, Equals(m_attributes[i].name, attribute.name), "Duplicate attribute");
+            }
+            if (Equals(attribute.name, "xmlns", 5))
+            {
+                m_bindings.emplace_back(Span(), attribute.value);
+            }
+            else if (attribute.name.size > 6 && std::memcmp(Data(attribute.name), "xmlns:", 6) == 0)
+            {
+                ThrowErrorIf(Error::XmlFatal, attribute.value.size == 0, "Namespace prefix bound to an empty name");
+                Span prefix;
+                prefix.offset = attribute.name.offset + 6;
+                prefix.size = attribute.name.size - 6;
+                m_bindings.emplace_back(prefix, attribute.value);
+            }
+            m_attributes.push_back(attribute);
+        }
+        node.attributeCount = static_cast<std::uint32_t>(m_attributes.size()) - node.firstAttribute;
+
+        node.prefixSize = GetPrefixSize(node.name);
+        node.namespaceUri = LookupNamespace(node.name, node.prefixSize);
+        for (auto i = node.firstAttribute; i < m_attributes.size(); i++)
+        {
+            const auto& name = m_attributes[i].name;
+            auto prefixSize = GetPrefixSize(name);
+            if (prefixSize != 0 && !(prefixSize == 5 && std::memcmp(Data(name), "xmlns", 5) == 0))
+            {
+                LookupNamespace(name, prefixSize);
+            }
+        }
+
+        if (parent != None)
+        {
+            auto& parentNode = m_nodes[parent];
+            if (parentNode.lastChild == None) { parentNode.firstChild = index; }
+            else { m_nodes[parentNode.lastChild].nextSibling = index; }
+            parentNode.lastChild = index;
+        }
+        m_nodes.push_back(node);
+
+        if (empty)
+        {
+            m_nodes[index].endText = node.firstText;
+            m_bindings.resize(scope);
+            return parent;
+        }
+        m_scopes.push_back(scope);
+        return index;
+    }
+
+    // Parses an end tag after the '</'. Returns the parent of the element it closes.
+    std::uint32_t EndElement(std::uint32_t current)
+    {
+        ThrowErrorIf(Error::XmlFatal, current == None, "Unexpected end tag");
+        auto name = ParseName();
+        SkipWhitespace();
+        Expect('>');
+        auto& node = m_nodes[current];
+        ThrowErrorIfNot(Error::XmlFatal, Equals(node.name, name), "End tag does not match the start tag");
+        node.endText = static_cast<std::uint32_t>(m_texts.size());
+        m_bindings.resize(m_scopes.back());
+        m_scopes.pop_back();
+        return node.parent;
+    }
+
+    void Parse()
+    {
+        m_cursor = reinterpret_cast<char*>(m_buffer.data());
+        m_end = m_cursor + m_buffer.size();
+        ThrowErrorIf(Error::XmlFatal, StartsWith("\xFE\xFF") || StartsWith("\xFF\xFE"), "Only UTF-8 XML documents are supported");
+        if (StartsWith("\xEF\xBB\xBF"))
+        {
+            m_cursor += 3;
+        }
+        if (StartsWith("<?xml") && (m_end - m_cursor > 5) && IsWhitespace(m_cursor[5]))
+        {
+            ParseDeclaration();
+        }
+
+        std::uint32_t current = None;
+        while (m_cursor < m_end)
+        {
+            if (*m_cursor != '<')
+            {
+                auto start = m_cursor;
+                auto next = static_cast<char*>(std::memchr(m_cursor, '<', static_cast<std::size_t>(m_end - m_cursor)));
+                m_cursor = (next == nullptr) ? m_end : next;
+                if (current == None)
+                {
+                    ThrowErrorIfNot(Error::XmlFatal, std::all_of(start, m_cursor, IsWhitespace), "Text outside of the document element");
+                }
+                else
+                {
+                    AddText(start, m_cursor, Content::Text);
+                }
+            }
+            else if (StartsWith("<!--"))
+            {
+                m_cursor += 4;
+                m_cursor = Find("-->") + 3;
+            }
+            else if (StartsWith("<![CDATA["))
+            {
+                ThrowErrorIf(Error::XmlFatal, current == None, "CDATA outside of the document element");
+                m_cursor += 9;
+                auto close = Find("]]>");
+                AddText(m_cursor, close, Content::CData);
+                m_cursor = close + 3;
+            }
+            else if (StartsWith("<!"))
+            {
+                // Also prevents XXE attacks, there are no entities other than the predefined ones.
+                ThrowErrorAndLog(Error::XmlFatal, "DTDs are not supported");
+            }
+            else if (StartsWith("<?"))
+            {
+                ThrowErrorIf(Error::XmlFatal, StartsWith("<?xml") && (m_end - m_cursor > 5) && IsWhitespace(m_cursor[5]),
+                    "XML declaration must be at the start of the document");
+                m_cursor = Find("?>") + 2;
+            }
+            else if (StartsWith("</"))
+            {
+                m_cursor += 2;
+                current = EndElement(current);
+            }
+            else
+            {
+                ThrowErrorIf(Error::XmlFatal, (current == None) && !m_nodes.empty(), "Multiple document elements");
+                m_cursor++;
+                current = StartElement(current);
+            }
+        }
+        ThrowErrorIf(Error::XmlFatal, m_nodes.empty(), "No document element");
+        ThrowErrorIf(Error::XmlFatal, current != None, "Unexpected end of XML document");
+    }
+
+    std::vector<std::uint8_t> m_buffer;
+    std::vector<Node> m_nodes;
+    std::vector<Attribute> m_attributes;
+    std::vector<Span> m_texts;
+
+    // Parser state
+    char* m_cursor = nullptr;
+    char* m_end = nullptr;
+    std::vector<std::pair<Span, Span>> m_bindings; // prefix to namespace, innermost last
+    std::vector<std::size_t> m_scopes;             // size of m_bindings before each open element
+};
+
+class LiteXmlElement final : public ComClass<LiteXmlElement, IXmlElement, ILiteXmlElement, IMsixElement>
+{
+public:
+    LiteXmlElement(IMsixFactory* factory, const std::shared_ptr<LiteXmlDocument>& document, std::uint32_t node) :
+        m_factory(factory), m_document(document), m_node(node)
+    {
+    }
+
+    // IXmlElement
+    std::string GetAttributeValue(XmlAttributeName attribute) override
+    {
+        return GetAttributeValueView(attribute).str();
+    }
+
+    std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
+    {
+        const char* name = GetAttributeNameStringUtf8(attribute);
+        return m_document->GetBase64DecodedAttributeValue(m_node, name, std::strlen(name));
+    }
+
+    std::string GetText() override
+    {
+        return m_document->GetText(m_node);
+    }
+
+    std::string GetPrefix() override
+    {
+        return m_document->GetPrefix(m_node).str();
+    }
+
+    XmlStringView GetAttributeValueView(XmlAttributeName attribute) override
+    {
+        const char* name = GetAttributeNameStringUtf8(attribute);
+        return m_document->GetAttributeValue(m_node, name, std::strlen(name));
+    }
+
+    XmlStringView GetTextView() override
+    {
+        XmlStringView text;
+        if (m_document->GetTextView(m_node, text))
+        {
+            return text;
+        }
+        if (!m_hasText)
+        {
+            m_text = m_document->GetText(m_node);
+            m_hasText = true;
+        }
+        return m_text;
+    }
+
+    XmlStringView GetPrefixView() override
+    {
+        return m_document->GetPrefix(m_node);
+    }
+
+    // ILiteXmlElement
+    std::uint32_t GetNode() override { return m_node; }
+
+    // IMsixElement
+    HRESULT STDMETHODCALLTYPE GetAttributeValue(LPCWSTR name, LPWSTR* value) noexcept override try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (value == nullptr), "bad pointer.");
+        auto intermediate = wstring_to_utf8(name);
+        auto attributeValue = m_document->GetAttributeValue(m_node, intermediate.c_str(), intermediate.size()).str();
+        return m_factory->MarshalOutString(attributeValue, value);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE GetText(LPWSTR* value) noexcept override try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (value == nullptr), "bad pointer.");
+        auto text = GetText();
+        return m_factory->MarshalOutString(text, value);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE GetElements(LPCWSTR xpath, IMsixElementEnumerator** elements) noexcept override try
+    {
+        return GetElementsUtf8(wstring_to_utf8(xpath).c_str(), elements);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE GetAttributeValueUtf8(LPCSTR name, LPSTR* value) noexcept override try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (value == nullptr || name == nullptr), "bad pointer.");
+        auto attributeValue = m_document->GetAttributeValue(m_node, name, std::strlen(name)).str();
+        return m_factory->MarshalOutStringUtf8(attributeValue, value);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE GetTextUtf8(LPSTR* value) noexcept override try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (value == nullptr), "bad pointer.");
+        auto text = GetText();
+        return m_factory->MarshalOutStringUtf8(text, value);
+    } CATCH_RETURN();
+
+    // Only location paths made of child steps are supported, for example "/Package/Extensions/Extension" or "./*".
+    HRESULT STDMETHODCALLTYPE GetElementsUtf8(LPCSTR xpath, IMsixElementEnumerator** elements) noexcept override try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (xpath == nullptr || elements == nullptr || *elements != nullptr), "bad pointer.");
+        std::string path(xpath);
+        ThrowErrorIf(Error::InvalidParameter, path.find_first_of("[]@()|=' ") != std::string::npos, "Unsupported XPath expression");
+        auto query = ParseQueryPath(path);
+        std::vector<std::uint32_t> nodes;
+        m_document->Select(query, query.fromRoot ? 0 : m_node, nodes);
+
+        std::vector<ComPtr<IMsixElement>> elementsEnum;
+        for (auto node : nodes)
+        {
+            elementsEnum.push_back(ComPtr<IMsixElement>::Make<LiteXmlElement>(m_factory, m_document, node));
+        }
+        *elements = ComPtr<IMsixElementEnumerator>::
+            Make<EnumeratorCom<IMsixElementEnumerator,IMsixElement>>(elementsEnum).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+protected:
+    IMsixFactory* m_factory = nullptr;
+    std::shared_ptr<LiteXmlDocument> m_document;
+    std::uint32_t m_node = 0;
+    std::string m_text; // only used when the text has more than one piece
+    bool m_hasText = false;
+};
+
+class LiteXmlDom final : public ComClass<LiteXmlDom, IXmlDom>
+{
+public:
+    LiteXmlDom(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory)
+    {
+        m_document = std::make_shared<LiteXmlDocument>(Helper::CreateBufferFromStream(stream));
+    }
+
+    // IXmlDom
+    MSIX::ComPtr<IXmlElement> GetDocument() override
+    {
+        return ComPtr<IXmlElement>::Make<LiteXmlElement>(m_factory, m_document, 0);
+    }
+
+    std::uint64_t GetMemoryUsage() override
+    {
+        return m_document->GetMemoryUsage();
+    }
+
+    bool ForEachElementIn(const ComPtr<IXmlElement>& root, XmlQueryName query, XmlVisitor& visitor) override
+    {
+        auto node = root.As<ILiteXmlElement>()->GetNode();
+        const auto& path = GetQueryPath(query);
+        if (path.fromRoot)
+        {
+            ThrowErrorIfNot(Error::XmlFatal, m_document->LocalNameEquals(node, path.steps[0]), "Invalid root element");
+        }
+
+        std::vector<std::uint32_t> nodes;
+        m_document->Select(path, node, nodes);
+        for (auto element : nodes)
+        {
+            auto item = ComPtr<IXmlElement>::Make<LiteXmlElement>(m_factory, m_document, element);
+            if (!visitor(item))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+protected:
+    IMsixFactory* m_factory;
+    std::shared_ptr<LiteXmlDocument> m_document;
+};
+
+class LiteXmlFactory final : public ComClass<LiteXmlFactory, IXmlFactory>
+{
+public:
+    LiteXmlFactory(IMsixFactory* factory) : m_factory(factory)
+    {
+    }
+
+    ComPtr<IXmlDom> CreateDomFromStream(XmlContentType, const ComPtr<IStream>& stream) override
+    {
+        return ComPtr<IXmlDom>::Make<LiteXmlDom>(m_factory, stream);
+    }
+protected:
+    IMsixFactory* m_factory;
+};
+
+ComPtr<IXmlFactory> CreateLiteXmlFactory(IMsixFactory* factory) { return ComPtr<IXmlFactory>::Make<LiteXmlFactory>(factory); }
+
+} // namespace MSIX
@@ -176,6 +176,22 @@ public:
         return {};
     }
 
+    // The values are transcoded on every call, they are kept for as long as the element.
+    XmlStringView GetAttributeValueView(XmlAttributeName attribute) override
+    {
+        return m_strings.Keep(GetAttributeValue(attribute));
+    }
+
+    XmlStringView GetTextView() override
+    {
+        return m_strings.Keep(GetText());
+    }
+
+    XmlStringView GetPrefixView() override
+    {
+        return m_strings.Keep(GetPrefix());
+    }
+
     // IMSXMLElement
     ComPtr<IXMLDOMNodeList> SelectNodes(XmlQueryName query) override
     {
@@ -303,6 +319,7 @@ protected:
 
     IMsixFactory* m_factory;
     ComPtr<IXMLDOMElement> m_element;
+    XmlStringStore m_strings;
 };
 
 // Because MSXML6 uses IErrorInfo to provide additional details as to why a call could
@@ -2,12 +2,17 @@
 //  Copyright (C) 2017 Microsoft.  All rights reserved.
 //  See LICENSE file in the project root for full license information.
 // 
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <string>
 #include <vector>
 #include <map>
+#include <mutex>
 #include <queue>
-#include <list>
+#include <sstream>
+#include <unordered_map>
 
 #include "Exceptions.hpp"
 #include "StreamBase.hpp"
@@ -16,6 +21,7 @@
 #include "MSIXResource.hpp"
 #include "UnicodeConversion.hpp"
 #include "Enumerators.hpp"
+#include "Base64.hpp"
 
 // Mandatory for using any feature of Xerces.
 #include "xercesc/dom/DOM.hpp"
@@ -26,7 +32,6 @@
 #include "xercesc/sax/ErrorHandler.hpp"
 #include "xercesc/util/PlatformUtils.hpp"
 #include "xercesc/util/XMLString.hpp"
-#include "xercesc/util/Base64.hpp"
 #include "xercesc/sax/SAXParseException.hpp"
 #include "xercesc/util/XMLEntityResolver.hpp"
 #include "xercesc/util/XMLUni.hpp" // helpful XMLChr*
@@ -208,88 +213,271 @@ protected:
     XMLCh* m_ptr = nullptr;
 };
 
-class XercesXMLBytePtr
+using XercesString = std::basic_string<XMLCh>;
+
+// The names used in queries and attributes are ASCII, they don't need Xerces to be transcoded.
+static XercesString ToXercesString(const std::string& name)
+{
+    return XercesString(name.begin(), name.end());
+}
+
+// A XmlQueryName compiled into the local names of the elements of each step of its path. Each step only looks
+// at the element children of the elements matched by the previous one, in any namespace. For queries that
+// start with '/' the first step is the root element.
+struct XercesQuery
+{
+    bool fromRoot = false;
+    std::vector<XercesString> steps;
+};
+
+// Queries and attribute names are compiled once and shared by all the documents.
+class XercesNames
 {
 public:
-    XercesXMLBytePtr(XMLByte* c) : m_ptr(c) {}
-    ~XercesXMLBytePtr() { InternalRelease(); }
+    static const XercesQuery& GetQuery(XmlQueryName query)
+    {
+        return Get().m_queries[static_cast<std::size_t>(query)];
+    }
 
-    // move ctor
-    XercesXMLBytePtr(XercesXMLBytePtr &&right) : m_ptr(nullptr)
+    static const XMLCh* GetAttributeName(XmlAttributeName attribute)
     {
-        if (this != reinterpret_cast<XercesXMLBytePtr*>(&reinterpret_cast<std::int8_t&>(right)))
-        {   Swap(right);
+        return Get().m_attributes[static_cast<std::size_t>(attribute)].c_str();
+    }
+
+private:
+    XercesNames()
+    {
+        for (std::size_t i = 0; i < GetQueryCount(); i++)
+        {
+            const auto& path = GetQueryPath(static_cast<XmlQueryName>(i));
+            XercesQuery query;
+            query.fromRoot = path.fromRoot;
+            for (const auto& step : path.steps) { query.steps.push_back(ToXercesString(step)); }
+            m_queries.push_back(std::move(query));
         }
-    }  
+        for (std::size_t i = 0; i < GetAttributeNameCount(); i++)
+        {
+            m_attributes.push_back(ToXercesString(GetAttributeNameStringUtf8(static_cast<XmlAttributeName>(i))));
+        }
+    }
 
-    void InternalRelease()
-    {   delete(m_ptr);
-        m_ptr = nullptr;
+    static const XercesNames& Get()
+    {
+        static const XercesNames names;
+        return names;
     }
 
-    XercesXMLBytePtr& operator=(XercesXMLBytePtr&& right)
-    {   XercesXMLBytePtr(std::move(right)).Swap(*this);
-        return *this;
+    std::vector<XercesQuery> m_queries;
+    std::vector<XercesString> m_attributes;
+};
+
+// Xerces memory manager that keeps track of what a parser and its document hold, so the document can be charged
+// its size in the document cache.
+class CountingMemoryManager final : public XERCES_CPP_NAMESPACE::MemoryManager
+{
+public:
+    XERCES_CPP_NAMESPACE::MemoryManager* getExceptionMemoryManager() override
+    {
+        return XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager;
     }
 
-    XMLByte* operator->() const { return m_ptr; }
-    XMLByte* Get() const { return m_ptr; }
-protected:
-    inline void Swap(XercesXMLBytePtr& right ) { std::swap(m_ptr, right.m_ptr); }
-    XMLByte* m_ptr = nullptr;
+    void* allocate(XMLSize_t size) override
+    {
+        // The size is kept in front of the block for deallocate
+        auto block = static_cast<std::uint8_t*>(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager->allocate(size + HeaderSize));
+        *reinterpret_cast<XMLSize_t*>(block) = size;
+        m_size += size;
+        return block + HeaderSize;
+    }
+
+    void deallocate(void* p) override
+    {
+        if (p != nullptr)
+        {
+            auto block = static_cast<std::uint8_t*>(p) - HeaderSize;
+            m_size -= *reinterpret_cast<XMLSize_t*>(block);
+            XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager->deallocate(block);
+        }
+    }
+
+    std::uint64_t GetSize() const { return m_size; }
+
+private:
+    // Keeps the blocks aligned like the default memory manager does
+    static const std::size_t HeaderSize = alignof(std::max_align_t);
+
+    std::atomic<std::uint64_t> m_size{0};
+};
+
+// UTF-8 copies of the strings read from a document. Xerces strings are UTF-16 and don't move while the document
+// is alive, so each one is transcoded once into blocks owned by the document and later reads return views of it.
+// Elements of a cached document are read from several threads, so the store is guarded by its own lock. The blocks
+// never move, views handed out stay valid after the lock is released.
+class XercesStrings
+{
+public:
+    XmlStringView Get(const XMLCh* value)
+    {
+        if (value == nullptr || *value == chNull)
+        {
+            return {};
+        }
+        std::lock_guard<std::mutex> lock(m_lock);
+        return GetLocked(value);
+    }
+
+    // The text of an element is one text node most of the time. Otherwise, Xerces builds the concatenation in a new
+    // string on every call, so it is kept by element instead.
+    XmlStringView GetText(DOMElement* element)
+    {
+        DOMNode* child = element->getFirstChild();
+        if (child == nullptr)
+        {
+            return {};
+        }
+        if ((child->getNextSibling() == nullptr) && (child->getNodeType() == DOMNode::TEXT_NODE))
+        {
+            return Get(child->getNodeValue());
+        }
+        // getTextContent allocates from the document heap, which isn't thread safe either.
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto found = m_texts.find(element);
+        if (found != m_texts.end())
+        {
+            return found->second;
+        }
+        auto result = Store(element->getTextContent());
+        m_texts.emplace(element, result);
+        return result;
+    }
+
+    std::uint64_t GetSize()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_blocks.size() * BlockSize + m_largeSize;
+    }
+
+private:
+    static const std::size_t BlockSize = 4096;
+
+    XmlStringView GetLocked(const XMLCh* value)
+    {
+        auto found = m_values.find(value);
+        if (found != m_values.end())
+        {
+            return found->second;
+        }
+        auto result = Store(value);
+        m_values.emplace(value, result);
+        return result;
+    }
+
+    XmlStringView Store(const XMLCh* value)
+    {
+        if (value == nullptr)
+        {
+            return {};
+        }
+        std::size_t length = XMLString::stringLen(value);
+        char* out = Reserve(Unicode::GetMaxUtf8SizeFromUtf16(length));
+        std::size_t size = Unicode::Utf16ToUtf8(reinterpret_cast<const char16_t*>(value), length, out);
+        // Give back what the worst case didn't use.
+        if (!m_blocks.empty() && (out == m_blocks.back().get() + m_used))
+        {
+            m_used += size;
+        }
+        return XmlStringView(out, size);
+    }
+
+    // Returns space for size characters. Big strings get a block of their own.
+    char* Reserve(std::size_t size)
+    {
+        if (size > BlockSize / 4)
+        {
+            m_large.emplace_back(new char[size]);
+            m_largeSize += size;
+            return m_large.back().get();
+        }
+        if (m_blocks.empty() || (m_used + size > BlockSize))
+        {
+            m_blocks.emplace_back(new char[BlockSize]);
+            m_used = 0;
+        }
+        return m_blocks.back().get() + m_used;
+    }
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    std::vector<std::unique_ptr<char[]>> m_large;
+    std::size_t m_used = 0;
+    std::size_t m_largeSize = 0;
+    std::mutex m_lock;
+    std::unordered_map<const XMLCh*, XmlStringView> m_values;
+    std::unordered_map<const DOMElement*, XmlStringView> m_texts;
 };
 
 class XercesElement final : public ComClass<XercesElement, IXmlElement, IXercesElement, IMsixElement>
 {
 public:
 
-    XercesElement(IMsixFactory* factory, DOMElement* element, XERCES_CPP_NAMESPACE::XercesDOMParser* parser) :
-        m_factory(factory), m_element(element), m_parser(parser)
+    // The resolver and the strings belong to the document. The resolver is only used by GetElements.
+    XercesElement(IMsixFactory* factory, DOMElement* element, XERCES_CPP_NAMESPACE::XercesDOMParser* parser,
+        DOMXPathNSResolver* resolver, XercesStrings* strings) :
+        m_factory(factory), m_element(element), m_parser(parser), m_resolver(resolver), m_strings(strings)
     {
-        m_resolver = XercesPtr<DOMXPathNSResolver>(m_parser->getDocument()->createNSResolver(m_parser->getDocument()));
     }
     
     // IXmlElement
     std::string GetAttributeValue(XmlAttributeName attribute) override
     {
-        auto attributeName = GetAttributeNameStringUtf8(attribute);
-        return GetAttributeValue(attributeName);
+        return GetAttributeValueView(attribute).str();
     }
 
     std::vector<std::uint8_t> GetBase64DecodedAttributeValue(XmlAttributeName attribute) override
     {
-        XercesXMLChPtr nameAttr(XMLString::transcode(GetAttributeNameStringUtf8(attribute)));
-        XMLSize_t len = 0;
-        XercesXMLBytePtr decodedData(XERCES_CPP_NAMESPACE::Base64::decodeToXMLByte(
-            m_element->getAttribute(nameAttr.Get()),
-            &len));
-        std::vector<std::uint8_t> result(len);
-        for(XMLSize_t index=0; index < len; index++)
-        {   result[index] = static_cast<std::uint8_t>(decodedData.Get()[index]);
+        const XMLCh* value = m_element->getAttribute(XercesNames::GetAttributeName(attribute));
+        std::size_t size = XMLString::stringLen(value);
+        ThrowErrorIfNot(Error::InvalidParameter, (0 == (size % 4)), "invalid base64 encoding");
+        std::vector<std::uint8_t> result(MSIX::Base64::GetMaxDecodedSize(size));
+        std::size_t decoded = 0;
+        // Base64 is ASCII. The value is narrowed and decoded in chunks of whole four character groups.
+        char chunk[64];
+        for (std::size_t start = 0; start < size; start += sizeof(chunk))
+        {
+            std::size_t count = std::min(sizeof(chunk), size - start);
+            for (std::size_t i = 0; i < count; i++)
+            {
+                ThrowErrorIf(Error::InvalidParameter, (value[start + i] >= 128), "invalid base64 encoding");
+                chunk[i] = static_cast<char>(value[start + i]);
+            }
+            decoded += MSIX::Base64::Decode(chunk, count, result.data() + decoded);
         }
+        result.resize(decoded);
         return result;
     }
 
     std::string GetText() override
     {
-        DOMNode* node = dynamic_cast<DOMNode*>(m_element);
-        XercesCharPtr value(XMLString::transcode(node->getTextContent()));
-        if (value.Get() != nullptr)
-        {
-            return std::string(value.Get());
-        }
-        return {};
+        return GetTextView().str();
     }
 
     std::string GetPrefix() override
     {
-        DOMNode* node = dynamic_cast<DOMNode*>(m_element);
-        XercesCharPtr value(XMLString::transcode(node->getPrefix()));
-        if (value.Get() != nullptr)
-        {
-            return std::string(value.Get());
-        }
-        return {};
+        return GetPrefixView().str();
+    }
+
+    XmlStringView GetAttributeValueView(XmlAttributeName attribute) override
+    {
+        return m_strings->Get(m_element->getAttribute(XercesNames::GetAttributeName(attribute)));
+    }
+
+    XmlStringView GetTextView() override
+    {
+        return m_strings->GetText(m_element);
+    }
+
+    XmlStringView GetPrefixView() override
+    {
+        return m_strings->Get(m_element->getPrefix());
     }
 
     // IXercesElement
@@ -298,8 +486,7 @@ public:
     std::string GetAttributeValue(const std::string& attributeName) override
     {
         XercesXMLChPtr nameAttr(XMLString::transcode(attributeName.c_str()));
-        auto utf16string = std::u16string(const_cast<char16_t*>(reinterpret_cast<const char16_t*>(m_element->getAttribute(nameAttr.Get()))));
-        return u16string_to_utf8(utf16string);
+        return ToUtf8(m_element->getAttribute(nameAttr.Get()));
     }
 
      // IMsixElement
@@ -341,13 +528,14 @@ public:
     HRESULT STDMETHODCALLTYPE GetElementsUtf8(LPCSTR xpath, IMsixElementEnumerator** elements) noexcept override try
     {
         ThrowErrorIf(Error::InvalidParameter, (elements == nullptr || *elements != nullptr), "bad pointer.");
+        ThrowErrorIf(Error::InvalidState, (m_resolver == nullptr), "Element not in a document");
         // Note: getElementsByTagName only returns the childs of a DOMElement and doesn't 
         // support xPath. For this reason we need the XercesDomParser in this object.
         XercesXMLChPtr xPath(XMLString::transcode(xpath));
         XercesPtr<DOMXPathResult> result(m_parser->getDocument()->evaluate(
             xPath.Get(),
             m_element,
-            m_resolver.Get(),
+            m_resolver,
             DOMXPathResult::ORDERED_NODE_SNAPSHOT_TYPE,
             nullptr));
 
@@ -356,7 +544,7 @@ public:
         {
             result->snapshotItem(i);
             auto node = static_cast<DOMElement*>(result->getNodeValue());
-            auto item = ComPtr<IMsixElement>::Make<XercesElement>(m_factory, node, m_parser);
+            auto item = ComPtr<IMsixElement>::Make<XercesElement>(m_factory, node, m_parser, m_resolver, m_strings);
             elementsEnum.push_back(std::move(item));
         }
         *elements = ComPtr<IMsixElementEnumerator>::
@@ -365,10 +553,19 @@ public:
     } CATCH_RETURN();
 
 protected:
+    static std::string ToUtf8(const XMLCh* value)
+    {
+        std::size_t length = XMLString::stringLen(value);
+        std::string result(Unicode::GetMaxUtf8SizeFromUtf16(length), 0);
+        result.resize(Unicode::Utf16ToUtf8(reinterpret_cast<const char16_t*>(value), length, &result[0]));
+        return result;
+    }
+
     IMsixFactory* m_factory = nullptr;
     DOMElement* m_element = nullptr;
     XERCES_CPP_NAMESPACE::XercesDOMParser* m_parser;
-    XercesPtr<DOMXPathNSResolver> m_resolver;
+    DOMXPathNSResolver* m_resolver = nullptr;
+    XercesStrings* m_strings = nullptr;
 };
 
 class XercesDom final : public ComClass<XercesDom, IXmlDom>
@@ -382,8 +579,8 @@ public:
             reinterpret_cast<const XMLByte*>(&buffer[0]), buffer.size(), "XML File");
 
         // Create parser and grammar pool
-        auto grammarPool = std::make_unique<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>(XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager);
-        m_parser = std::make_unique<XERCES_CPP_NAMESPACE::XercesDOMParser>(nullptr, XERCES_CPP_NAMESPACE::XMLPlatformUtils::fgMemoryManager, grammarPool.get());
+        auto grammarPool = std::make_unique<XERCES_CPP_NAMESPACE::XMLGrammarPoolImpl>(&m_memory);
+        m_parser = std::make_unique<XERCES_CPP_NAMESPACE::XercesDOMParser>(nullptr, &m_memory, grammarPool.get());
         
         // For Non validation parser GetResources will return an empty vector for the ContentType, BlockMap and AppxBundleManifest.
         // XercesDom will only parse the schemas if the vector is not empty. If not, it will only see that it is valid xml.
@@ -442,6 +639,7 @@ public:
         }
 
         m_parser->parse(*source);
+        m_resolver = XercesPtr<DOMXPathNSResolver>(m_parser->getDocument()->createNSResolver(m_parser->getDocument()));
 
         // TODO: Do semantic check for all the elements we modified to maxOcurrs=unbounded and xs:patterns
     }
@@ -449,38 +647,33 @@ public:
     // IXmlDom
     MSIX::ComPtr<IXmlElement> GetDocument() override
     {
-        return ComPtr<IXmlElement>::Make<XercesElement>(m_factory, m_parser->getDocument()->getDocumentElement(), m_parser.get());
+        return ComPtr<IXmlElement>::Make<XercesElement>(m_factory, m_parser->getDocument()->getDocumentElement(),
+            m_parser.get(), m_resolver.Get(), &m_strings);
+    }
+
+    std::uint64_t GetMemoryUsage() override
+    {
+        return m_memory.GetSize() + m_strings.GetSize();
     }
 
     bool ForEachElementIn(const ComPtr<IXmlElement>& root, XmlQueryName query, XmlVisitor& visitor) override
     {
         DOMElement* element = root.As<IXercesElement>()->GetElement();
+        const auto& compiled = XercesNames::GetQuery(query);
 
-        std::list<DOMElement*> list;
-        std::string xpath(GetQueryString(query));
-
-        if (xpath.size() >= 2 && xpath[0] == '.' && xpath[1] == '/')
+        std::vector<DOMElement*> list;
+        std::size_t step = 0;
+        if (compiled.fromRoot)
         {
-            FindChildElements(xpath.substr(2), element, list);
-        }
-        else if (xpath.size() > 1 && xpath[0] == '/')
-        {
-            // Get name of root element
-            std::size_t secondSlash =  xpath.find_first_of('/', 1);
-            XercesXMLChPtr firstElement(XMLString::transcode(xpath.substr(1, secondSlash - 1).c_str()));
-            if (XMLString::compareString(firstElement.Get(), static_cast<DOMNode*>(element)->getLocalName()) == 0)
-            {
-                FindChildElements(xpath.substr(secondSlash + 1), element, list);
-            }
-            else
-            {
-                ThrowErrorAndLog(Error::XmlFatal, "Invalid root element");
-            }
+            ThrowErrorIfNot(Error::XmlFatal, XMLString::equals(compiled.steps[0].c_str(), element->getLocalName()),
+                "Invalid root element");
+            step = 1;
         }
+        FindChildElements(compiled, step, element, list);
 
         for(const auto& element : list)
         {
-            auto item = ComPtr<IXmlElement>::Make<XercesElement>(m_factory, element, m_parser.get());
+            auto item = ComPtr<IXmlElement>::Make<XercesElement>(m_factory, element, m_parser.get(), m_resolver.Get(), &m_strings);
             if (!visitor(item))
             {
                 return false;
@@ -496,7 +689,9 @@ protected:
         m_parser->setDoNamespaces(true);
         m_parser->parse(source);
         XERCES_CPP_NAMESPACE::DOMDocument* dom = m_parser->getDocument();
-        auto rootElement = ComPtr<IXercesElement>::Make<XercesElement>(m_factory, dom->getDocumentElement(), m_parser.get());
+        // This document is thrown away below, its strings too.
+        XercesStrings strings;
+        auto rootElement = ComPtr<IXercesElement>::Make<XercesElement>(m_factory, dom->getDocumentElement(), m_parser.get(), nullptr, &strings);
         std::string attr = "IgnorableNamespaces";
         std::string attrValue = rootElement->GetAttributeValue(attr);
         if (!attrValue.empty())
@@ -607,37 +802,33 @@ protected:
         }
     }
 
-    void FindChildElements(std::string xpath, DOMElement* root, std::list<DOMElement*>& list)
+    // Adds the children of root that match the step of the query, or their matches for the next steps, in
+    // document order.
+    void FindChildElements(const XercesQuery& query, std::size_t step, DOMElement* root, std::vector<DOMElement*>& list)
     {
-        // The special value "*" matches all namespaces
-        XercesXMLChPtr allNS(XMLString::transcode("*"));
-
-        // Find next element to search
-        std::size_t nextSeparator = xpath.find_first_of('/');
-        XercesXMLChPtr nextElement(XMLString::transcode(xpath.substr(0, nextSeparator).c_str()));
-
-        DOMNodeList* childs = root->getElementsByTagNameNS(allNS.Get(), nextElement.Get());
-        XMLSize_t childsSize = childs->getLength();
-        for(XMLSize_t i = 0; i < childsSize; i++)
+        const XMLCh* name = query.steps[step].c_str();
+        for (DOMElement* child = root->getFirstElementChild(); child != nullptr; child = child->getNextElementSibling())
         {
-            DOMNode* node = childs->item(i);
-            if (XMLString::compareString(nextElement.Get(), node->getLocalName()) == 0)
+            if (XMLString::equals(name, child->getLocalName()))
             {
-                if (nextSeparator == std::string::npos)
+                if (step + 1 == query.steps.size())
                 {
                     // This is the node we are looking for.
-                    list.emplace_back(static_cast<DOMElement*>(node));
+                    list.push_back(child);
                 }
                 else
                 {
-                    FindChildElements(xpath.substr(nextSeparator + 1), static_cast<DOMElement*>(node), list);
+                    FindChildElements(query, step + 1, child, list);
                 }
             }
         }
     }
 
     IMsixFactory* m_factory;
+    CountingMemoryManager m_memory; // must outlive the parser
     std::unique_ptr<XERCES_CPP_NAMESPACE::XercesDOMParser> m_parser;
+    XercesPtr<DOMXPathNSResolver> m_resolver;
+    XercesStrings m_strings;
     ComPtr<IStream> m_stream;
 };
 
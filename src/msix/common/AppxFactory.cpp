@@ -4,11 +4,13 @@
 // 
 #include "AppxFactory.hpp"
 #include "UnicodeConversion.hpp"
+#include "ScopeExit.hpp"
 #include "Exceptions.hpp"
 #include "ZipObjectReader.hpp"
 #include "AppxPackageObject.hpp"
 #include "MSIXResource.hpp"
 #include "VectorStream.hpp"
+#include "StreamHelper.hpp"
 #include "MsixFeatureSelector.hpp"
 #include "AppxPackageWriter.hpp"
 #include "AppxBundleWriter.hpp"
@@ -127,10 +129,16 @@ namespace MSIX {
     {
         ThrowErrorIf(Error::InvalidParameter, (result == nullptr || *result != nullptr), "bad pointer" );
         *result = nullptr;
-        if (!internal.empty())
+        // Transcode straight into the caller's buffer. Like utf8_to_wstring, stop at the first null character.
+        auto size = std::char_traits<char>::length(internal.c_str());
+        if (size != 0)
         {
-            auto intermediate = utf8_to_wstring(internal);
-            ThrowHrIfFailed(MarshalOutWstring(intermediate, result));
+            auto buffer = reinterpret_cast<wchar_t*>(m_memalloc(sizeof(wchar_t) * (Unicode::GetMaxWideSize(size) + 1)));
+            ThrowErrorIfNot(Error::OutOfMemory, buffer, "Allocation failed!");
+            auto freeBuffer = MSIX::scope_exit([&] { m_memfree(buffer); });
+            buffer[Unicode::Utf8ToWide(internal.c_str(), size, buffer)] = L'\0';
+            freeBuffer.release();
+            *result = buffer;
         }
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
@@ -159,14 +167,14 @@ namespace MSIX {
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
-    HRESULT AppxFactory::MarshalOutBytes(std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) noexcept try
+    HRESULT AppxFactory::MarshalOutBytes(const std::vector<std::uint8_t>& data, UINT32* size, BYTE** buffer) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (size==nullptr || buffer == nullptr || *buffer != nullptr), "Bad pointer");
         *size = static_cast<UINT32>(data.size());
         *buffer = reinterpret_cast<BYTE*>(m_memalloc(data.size()));
         ThrowErrorIfNot(Error::OutOfMemory, (*buffer), "Allocation failed");
         std::memcpy(reinterpret_cast<void*>(*buffer),
-                    reinterpret_cast<void*>(data.data()),
+                    reinterpret_cast<const void*>(data.data()),
                     data.size());
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
@@ -179,16 +187,23 @@ namespace MSIX {
             ThrowErrorAndLog(Error::FileNotFound, resource.c_str());
         }
 
-        if(!m_resourcezip) // Initialize it when first needed.
+        std::lock_guard<std::mutex> lock(m_resourceLock);
+        auto cached = m_resources.find(resource);
+        if (cached == m_resources.end())
         {
-            // Get stream of the resource zip file generated at CMake processing.
-            m_resourcesVector = std::vector<std::uint8_t>(Resource::resourceByte, Resource::resourceByte + Resource::resourceLength);
-            auto resourceStream = ComPtr<IStream>::Make<VectorStream>(&m_resourcesVector);
-            m_resourcezip = ComPtr<IStorageObject>::Make<ZipObjectReader>(resourceStream.Get());
+            if(!m_resourcezip) // Initialize it when first needed.
+            {
+                // Get stream of the resource zip file generated at CMake processing.
+                m_resourcesVector = std::vector<std::uint8_t>(Resource::resourceByte, Resource::resourceByte + Resource::resourceLength);
+                auto resourceStream = ComPtr<IStream>::Make<VectorStream>(&m_resourcesVector);
+                m_resourcezip = ComPtr<IStorageObject>::Make<ZipObjectReader>(resourceStream.Get());
+            }
+            auto file = m_resourcezip->GetFile(resource);
+            ThrowErrorIfNot(Error::FileNotFound, file, resource.c_str());
+            // Keep the inflated resource. Every caller gets its own stream over it, so they don't share a seek pointer.
+            cached = m_resources.emplace(resource, Helper::CreateBufferFromStream(file)).first;
         }
-        auto file = m_resourcezip->GetFile(resource);
-        ThrowErrorIfNot(Error::FileNotFound, file, resource.c_str());
-        return file;
+        return ComPtr<IStream>::Make<VectorStream>(&cached->second);
     }
 
     // IMsixFactoryOverrides
@@ -260,6 +275,35 @@ namespace MSIX {
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
+    // IMsixDocumentCache
+    HRESULT STDMETHODCALLTYPE AppxFactory::SetSizeLimit(UINT64 sizeLimit) noexcept try
+    {
+        m_documentCache.SetSizeLimit(sizeLimit);
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxFactory::Prewarm(IStream* packageStream) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (packageStream == nullptr), "Invalid parameter");
+        ThrowErrorIfNot(Error::InvalidState, m_documentCache.IsEnabled(), "The document cache is disabled");
+        ComPtr<IAppxPackageReader> reader;
+        ThrowHrIfFailed(CreatePackageReader(packageStream, &reader));
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxFactory::Clear() noexcept try
+    {
+        m_documentCache.Clear();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    HRESULT STDMETHODCALLTYPE AppxFactory::GetStatistics(MSIX_DOCUMENT_CACHE_STATISTICS* statistics) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (statistics == nullptr), "Invalid parameter");
+        *statistics = m_documentCache.GetStatistics();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
     // Helper to marshal out strings
     template<typename T>
     void AppxFactory::MarshalOutStringHelper(std::size_t size, T* from, T** to)
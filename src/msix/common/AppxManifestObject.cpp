@@ -9,82 +9,128 @@
 #include "Encoding.hpp"
 #include "Enumerators.hpp"
 #include "AppxPackageInfo.hpp"
-
-#include <array>
+#include "PerfectHashTable.hpp"
+#include "DocumentCache.hpp"
 
 namespace MSIX {
 
-    template<typename T>
-    struct Entry
-    {
-        const char* tdf;
-        const T value;
-
-        Entry(const char* t, const T p) : tdf(t), value(p) {}
-
-        inline bool operator==(const char* otherTdf) const {
-            return 0 == strcmp(tdf, otherTdf);
-        }
+    // TargetDeviceFamily names are compared case insensitive
+    static const PerfectHashTable<MSIX_PLATFORMS>::Entry targetDeviceFamilyList[] = {
+        { u8"windows.universal",      MSIX_PLATFORM_WINDOWS10 },
+        { u8"windows.mobile",         MSIX_PLATFORM_WINDOWS10 },
+        { u8"windows.desktop",        MSIX_PLATFORM_WINDOWS10 },
+        { u8"windows.xbox",           MSIX_PLATFORM_WINDOWS10 },
+        { u8"windows.team",           MSIX_PLATFORM_WINDOWS10 },
+        { u8"windows.holographic",    MSIX_PLATFORM_WINDOWS10 },
+        { u8"windows.iot",            MSIX_PLATFORM_WINDOWS10 },
+        { u8"windows.server",         MSIX_PLATFORM_WINDOWS10 },
+        { u8"apple.ios.all",          MSIX_PLATFORM_IOS },
+        { u8"apple.ios.phone",        MSIX_PLATFORM_IOS },
+        { u8"apple.ios.tablet",       MSIX_PLATFORM_IOS },
+        { u8"apple.ios.tv",           MSIX_PLATFORM_IOS },
+        { u8"apple.ios.watch",        MSIX_PLATFORM_IOS },
+        { u8"apple.macos.all",        MSIX_PLATFORM_MACOS },
+        { u8"google.android.all",     MSIX_PLATFORM_AOSP },
+        { u8"google.android.phone",   MSIX_PLATFORM_AOSP },
+        { u8"google.android.tablet",  MSIX_PLATFORM_AOSP },
+        { u8"google.android.desktop", MSIX_PLATFORM_AOSP },
+        { u8"google.android.tv",      MSIX_PLATFORM_AOSP },
+        { u8"google.android.watch",   MSIX_PLATFORM_AOSP },
+        { u8"msixcore.desktop",       MSIX_PLATFORM_CORE },
+        { u8"msixcore.server",        MSIX_PLATFORM_CORE },
+        { u8"linux.all",              MSIX_PLATFORM_LINUX },
+        { u8"web.edge.all",           MSIX_PLATFORM_WEB },
+        { u8"web.blink.all",          MSIX_PLATFORM_WEB },
+        { u8"web.chromium.all",       MSIX_PLATFORM_WEB },
+        { u8"web.webkit.all",         MSIX_PLATFORM_WEB },
+        { u8"web.safari.all",         MSIX_PLATFORM_WEB },
+        { u8"web.all",                MSIX_PLATFORM_WEB },
+        { u8"platform.all",           static_cast<MSIX_PLATFORMS>(MSIX_PLATFORM_ALL) },
     };
 
-    // ALL THE TargetDeviceFamily ENTRIES MUST BE LOWER-CASE
-    static const Entry<MSIX_PLATFORMS> targetDeviceFamilyList[] = {
-        Entry<MSIX_PLATFORMS>(u8"windows.universal",      MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"windows.mobile",         MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"windows.desktop",        MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"windows.xbox",           MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"windows.team",           MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"windows.holographic",    MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"windows.iot",            MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"windows.server",         MSIX_PLATFORM_WINDOWS10),
-        Entry<MSIX_PLATFORMS>(u8"apple.ios.all",          MSIX_PLATFORM_IOS),
-        Entry<MSIX_PLATFORMS>(u8"apple.ios.phone",        MSIX_PLATFORM_IOS),
-        Entry<MSIX_PLATFORMS>(u8"apple.ios.tablet",       MSIX_PLATFORM_IOS),
-        Entry<MSIX_PLATFORMS>(u8"apple.ios.tv",           MSIX_PLATFORM_IOS),
-        Entry<MSIX_PLATFORMS>(u8"apple.ios.watch",        MSIX_PLATFORM_IOS),
-        Entry<MSIX_PLATFORMS>(u8"apple.macos.all",        MSIX_PLATFORM_MACOS),
-        Entry<MSIX_PLATFORMS>(u8"google.android.all",     MSIX_PLATFORM_AOSP),
-        Entry<MSIX_PLATFORMS>(u8"google.android.phone",   MSIX_PLATFORM_AOSP),
-        Entry<MSIX_PLATFORMS>(u8"google.android.tablet",  MSIX_PLATFORM_AOSP),
-        Entry<MSIX_PLATFORMS>(u8"google.android.desktop", MSIX_PLATFORM_AOSP),
-        Entry<MSIX_PLATFORMS>(u8"google.android.tv",      MSIX_PLATFORM_AOSP),
-        Entry<MSIX_PLATFORMS>(u8"google.android.watch",   MSIX_PLATFORM_AOSP),
-        Entry<MSIX_PLATFORMS>(u8"msixcore.desktop",       MSIX_PLATFORM_CORE),
-        Entry<MSIX_PLATFORMS>(u8"msixcore.server",        MSIX_PLATFORM_CORE),
-        Entry<MSIX_PLATFORMS>(u8"linux.all",              MSIX_PLATFORM_LINUX),
-        Entry<MSIX_PLATFORMS>(u8"web.edge.all",           MSIX_PLATFORM_WEB),
-        Entry<MSIX_PLATFORMS>(u8"web.blink.all",          MSIX_PLATFORM_WEB),
-        Entry<MSIX_PLATFORMS>(u8"web.chromium.all",       MSIX_PLATFORM_WEB),
-        Entry<MSIX_PLATFORMS>(u8"web.webkit.all",         MSIX_PLATFORM_WEB),
-        Entry<MSIX_PLATFORMS>(u8"web.safari.all",         MSIX_PLATFORM_WEB),
-        Entry<MSIX_PLATFORMS>(u8"web.all",                MSIX_PLATFORM_WEB),
-        Entry<MSIX_PLATFORMS>(u8"platform.all",           static_cast<MSIX_PLATFORMS>(MSIX_PLATFORM_ALL)),
+    static const PerfectHashTable<APPX_CAPABILITIES>::Entry capabilitiesList[] = {
+        { u8"internetClient",             APPX_CAPABILITY_INTERNET_CLIENT },
+        { u8"internetClientServer",       APPX_CAPABILITY_INTERNET_CLIENT_SERVER },
+        { u8"privateNetworkClientServer", APPX_CAPABILITY_PRIVATE_NETWORK_CLIENT_SERVER },
+        { u8"documentsLibrary",           APPX_CAPABILITY_DOCUMENTS_LIBRARY },
+        { u8"picturesLibrary",            APPX_CAPABILITY_PICTURES_LIBRARY },
+        { u8"videosLibrary",              APPX_CAPABILITY_VIDEOS_LIBRARY },
+        { u8"musicLibrary",               APPX_CAPABILITY_MUSIC_LIBRARY },
+        { u8"enterpriseAuthentication",   APPX_CAPABILITY_ENTERPRISE_AUTHENTICATION },
+        { u8"sharedUserCertificates",     APPX_CAPABILITY_SHARED_USER_CERTIFICATES },
+        { u8"removableStorage",           APPX_CAPABILITY_REMOVABLE_STORAGE },
+        { u8"appointments",               APPX_CAPABILITY_APPOINTMENTS },
+        { u8"contacts",                   APPX_CAPABILITY_CONTACTS },
     };
 
-    static const Entry<APPX_CAPABILITIES> capabilitiesList[] = {
-        Entry<APPX_CAPABILITIES>(u8"internetClient",             APPX_CAPABILITY_INTERNET_CLIENT),
-        Entry<APPX_CAPABILITIES>(u8"internetClientServer",       APPX_CAPABILITY_INTERNET_CLIENT_SERVER),
-        Entry<APPX_CAPABILITIES>(u8"privateNetworkClientServer", APPX_CAPABILITY_PRIVATE_NETWORK_CLIENT_SERVER),
-        Entry<APPX_CAPABILITIES>(u8"documentsLibrary",           APPX_CAPABILITY_DOCUMENTS_LIBRARY),
-        Entry<APPX_CAPABILITIES>(u8"picturesLibrary",            APPX_CAPABILITY_PICTURES_LIBRARY),
-        Entry<APPX_CAPABILITIES>(u8"videosLibrary",              APPX_CAPABILITY_VIDEOS_LIBRARY),
-        Entry<APPX_CAPABILITIES>(u8"musicLibrary",               APPX_CAPABILITY_MUSIC_LIBRARY),
-        Entry<APPX_CAPABILITIES>(u8"enterpriseAuthentication",   APPX_CAPABILITY_ENTERPRISE_AUTHENTICATION),
-        Entry<APPX_CAPABILITIES>(u8"sharedUserCertificates",     APPX_CAPABILITY_SHARED_USER_CERTIFICATES),
-        Entry<APPX_CAPABILITIES>(u8"removableStorage",           APPX_CAPABILITY_REMOVABLE_STORAGE),
-        Entry<APPX_CAPABILITIES>(u8"appointments",               APPX_CAPABILITY_APPOINTMENTS),
-        Entry<APPX_CAPABILITIES>(u8"contacts",                   APPX_CAPABILITY_CONTACTS),
+    // Capability elements of these namespaces prefixes belong to the class. No prefix is the default namespace
+    // of AppxManifest, win10foundation.
+    static const PerfectHashTable<APPX_CAPABILITY_CLASS_TYPE>::Entry capabilityClassList[] = {
+        { u8"foundation",      APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"uap",             APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"win10foundation", APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"win10uap",        APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"uap2",            APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"uap3",            APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"uap4",            APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"uap6",            APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"uap7",            APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"win10mobile",     APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"",                APPX_CAPABILITY_CLASS_GENERAL },
+        { u8"rescap",          APPX_CAPABILITY_CLASS_RESTRICTED },
+        { u8"win10rescap",     APPX_CAPABILITY_CLASS_RESTRICTED },
+        { u8"wincap",          APPX_CAPABILITY_CLASS_WINDOWS },
+        { u8"win10wincap",     APPX_CAPABILITY_CLASS_WINDOWS },
     };
 
-    AppxManifestObject::AppxManifestObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
+    static const PerfectHashTable<MSIX_PLATFORMS>& GetTargetDeviceFamilyTable()
+    {
+        static const PerfectHashTable<MSIX_PLATFORMS> table(targetDeviceFamilyList, true);
+        return table;
+    }
+
+    static const PerfectHashTable<APPX_CAPABILITIES>& GetCapabilityTable()
+    {
+        static const PerfectHashTable<APPX_CAPABILITIES> table(capabilitiesList);
+        return table;
+    }
+
+    static const PerfectHashTable<APPX_CAPABILITY_CLASS_TYPE>& GetCapabilityClassTable()
+    {
+        static const PerfectHashTable<APPX_CAPABILITY_CLASS_TYPE> table(capabilityClassList);
+        return table;
+    }
+
+    // XML parsers that can't tell the memory held by their DOM are charged this many times the size of the XML.
+    static const std::uint64_t DomSizePerXmlByte = 16;
+
+    static DocumentCache::Value ReadManifest(void* factory, const ComPtr<IStream>& stream, std::uint64_t& size)
     {
         ComPtr<IXmlFactory> xmlFactory;
-        ThrowHrIfFailed(m_factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
-        m_dom = xmlFactory->CreateDomFromStream(XmlContentType::AppxManifestXml, stream);
+        ThrowHrIfFailed(reinterpret_cast<IMsixFactory*>(factory)->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
+        auto document = std::make_shared<ManifestDocument>();
+        document->dom = xmlFactory->CreateDomFromStream(XmlContentType::AppxManifestXml, stream);
 
 #if VALIDATING
-        AppxManifestValidation::ValidateManifest(m_dom.Get());
+        AppxManifestValidation::ValidateManifest(document->dom.Get());
 #endif
+        size = document->dom->GetMemoryUsage();
+        if (size == 0)
+        {
+            LARGE_INTEGER start = { 0 };
+            ULARGE_INTEGER end = { 0 };
+            ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::END, &end));
+            size = end.QuadPart * DomSizePerXmlByte;
+        }
+        return document;
+    }
+
+    AppxManifestObject::AppxManifestObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
+    {
+        m_document = factory->GetDocumentCache().Get<ManifestDocument>(DocumentCache::Document::Manifest, stream, factory, ReadManifest,
+            &m_documentShared);
+        m_dom = m_document->dom;
+        std::lock_guard<std::mutex> lock(m_document->lock);
 
         // Parse Identity element
         XmlVisitor visitor(static_cast<void*>(this), [](void* s, const ComPtr<IXmlElement>& identityNode)->bool
@@ -105,20 +151,25 @@ namespace MSIX {
         // Have to check for this semantically as not all validating parsers can validate this via schema
         ThrowErrorIfNot(Error::AppxManifestSemanticError, m_packageId, "No Identity element in AppxManifest.xml");
 
-        // Parse TargetDeviceFamily elements
+        // All validation options require a valid AppxManifest.xml
+        Validate();
+    }
+
+    void AppxManifestObject::Validate()
+    {
+        // TargetDeviceFamily elements must be known and have valid versions
         XmlVisitor visitorTDF(static_cast<void*>(this), [](void* s, const ComPtr<IXmlElement>& tdfNode)->bool
         {
             AppxManifestObject* self = reinterpret_cast<AppxManifestObject*>(s);
-            auto name = tdfNode->GetAttributeValue(XmlAttributeName::Name);
+            auto name = tdfNode->GetAttributeValueView(XmlAttributeName::Name);
             auto min = tdfNode->GetAttributeValue(XmlAttributeName::MinVersion);
             auto max = tdfNode->GetAttributeValue(XmlAttributeName::Dependencies_Tdf_MaxVersionTested);
-            auto tdf = ComPtr<IAppxManifestTargetDeviceFamily>::Make<AppxManifestTargetDeviceFamily>(self->m_factory.Get(), name, min, max);
-            self->m_tdf.push_back(std::move(tdf));
-            std::transform(name.begin(), name.end(), name.begin(), ::tolower);
-            const auto& tdfEntry = std::find(std::begin(targetDeviceFamilyList), std::end(targetDeviceFamilyList), name.c_str());
+            DecodeVersionNumber(min);
+            DecodeVersionNumber(max);
+            const auto tdfEntry = GetTargetDeviceFamilyTable().Find(name.data(), name.size());
             // TODO: Here and below; are unknown device families really an error?  I don't think so.
-            ThrowErrorIf(Error::AppxManifestSemanticError, (tdfEntry == std::end(targetDeviceFamilyList)), "Unrecognized TargetDeviceFamily");
-            self->m_platform = static_cast<MSIX_PLATFORMS>(self->m_platform | (*tdfEntry).value);
+            ThrowErrorIf(Error::AppxManifestSemanticError, (tdfEntry == nullptr), "Unrecognized TargetDeviceFamily");
+            self->m_platform = static_cast<MSIX_PLATFORMS>(self->m_platform | *tdfEntry);
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_TargetDeviceFamily, visitorTDF);
@@ -136,7 +187,13 @@ namespace MSIX {
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetProperties(IAppxManifestProperties **packageProperties) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (packageProperties == nullptr || *packageProperties != nullptr), "bad pointer");
+        auto properties = Load(m_properties, &AppxManifestObject::ReadProperties);
+        *packageProperties = properties.Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
 
+    ComPtr<IAppxManifestProperties> AppxManifestObject::ReadProperties()
+    {
         // Parse elements in Properties element
         std::map<std::string, std::string> stringValues;
         std::map<std::string, bool> boolValues;
@@ -205,9 +262,8 @@ namespace MSIX {
             XmlVisitor visitorBool(static_cast<void*>(&contextPropertiesBool), [](void* c, const ComPtr<IXmlElement>& node)->bool
             {
                 _contextPropertiesBool* contextProperties = reinterpret_cast<_contextPropertiesBool*>(c);
-                auto value = node->GetText();
                 // We expect the manifest to be correct
-                contextProperties->boolValues->insert(std::pair<std::string, bool>(contextProperties->value, value == "true"));
+                contextProperties->boolValues->insert(std::pair<std::string, bool>(contextProperties->value, node->GetTextView() == "true"));
                 contextProperties->wasFound = true;
                 return true;
             });
@@ -234,14 +290,20 @@ namespace MSIX {
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Properties, visitorProperties);
-        *packageProperties = ComPtr<IAppxManifestProperties>::Make<AppxManifestProperties>(
-            m_factory.Get(), std::move(stringValues), std::move(boolValues)).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+        return ComPtr<IAppxManifestProperties>::Make<AppxManifestProperties>(m_factory.Get(), std::move(stringValues), std::move(boolValues));
+    }
 
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetPackageDependencies(IAppxManifestPackageDependenciesEnumerator **dependencies) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (dependencies == nullptr || *dependencies != nullptr), "bad pointer");
+        *dependencies = ComPtr<IAppxManifestPackageDependenciesEnumerator>::
+            Make<EnumeratorCom<IAppxManifestPackageDependenciesEnumerator,IAppxManifestPackageDependency>>(
+                Load(m_packageDependencies, &AppxManifestObject::ReadPackageDependencies)).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    std::vector<ComPtr<IAppxManifestPackageDependency>> AppxManifestObject::ReadPackageDependencies()
+    {
         std::vector<ComPtr<IAppxManifestPackageDependency>> packageDependencies;
         struct _context
         {
@@ -263,10 +325,8 @@ namespace MSIX {
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_PackageDependency, visitorDependencies);
-        *dependencies = ComPtr<IAppxManifestPackageDependenciesEnumerator>::
-            Make<EnumeratorCom<IAppxManifestPackageDependenciesEnumerator,IAppxManifestPackageDependency>>(packageDependencies).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+        return packageDependencies;
+    }
 
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetCapabilities(APPX_CAPABILITIES *capabilities) noexcept try
     {
@@ -276,11 +336,11 @@ namespace MSIX {
         auto capabilitiesNames = GetCapabilities(APPX_CAPABILITY_CLASS_GENERAL);
         for (const auto& capability : capabilitiesNames)
         {
-            const auto& capabilityEntry = std::find(std::begin(capabilitiesList), std::end(capabilitiesList), capability.c_str());
+            const auto capabilityEntry = GetCapabilityTable().Find(capability);
             // Don't fail if not found as it can be custom capability or from a different namespace.
-            if (capabilityEntry != std::end(capabilitiesList))
+            if (capabilityEntry != nullptr)
             {
-                appxCapabilities = static_cast<APPX_CAPABILITIES>((appxCapabilities) | (*capabilityEntry).value);
+                appxCapabilities = static_cast<APPX_CAPABILITIES>((appxCapabilities) | *capabilityEntry);
             }
         }
         *capabilities = appxCapabilities;
@@ -290,16 +350,11 @@ namespace MSIX {
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetResources(IAppxManifestResourcesEnumerator **resources) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (resources == nullptr || *resources != nullptr), "bad pointer");
-        // Parse Resource elements.
         std::vector<std::string> appxResources;
-        XmlVisitor visitorResource(static_cast<void*>(&appxResources), [](void* r, const ComPtr<IXmlElement>& resourceNode)->bool
+        for (const auto& resource : Load(m_resources, &AppxManifestObject::ReadResources))
         {
-            std::vector<std::string>* resources = reinterpret_cast<std::vector<std::string>*>(r);
-            auto name = resourceNode->GetAttributeValue(XmlAttributeName::Language);
-            resources->push_back(std::move(name));
-            return true;
-        });
-        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Resources_Resource, visitorResource);
+            appxResources.push_back(resource.As<IAppxManifestQualifiedResourceInternal>()->GetLanguage());
+        }
         *resources = ComPtr<IAppxManifestResourcesEnumerator>::Make<EnumeratorString<IAppxManifestResourcesEnumerator, IAppxManifestResourcesEnumeratorUtf8>>(m_factory.Get(), appxResources).Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
@@ -318,7 +373,14 @@ namespace MSIX {
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetApplications(IAppxManifestApplicationsEnumerator **applications) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (applications == nullptr || *applications != nullptr), "bad pointer");
+        *applications = ComPtr<IAppxManifestApplicationsEnumerator>::
+            Make<EnumeratorCom<IAppxManifestApplicationsEnumerator,IAppxManifestApplication>>(
+                Load(m_applications, &AppxManifestObject::ReadApplications)).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
 
+    std::vector<ComPtr<IAppxManifestApplication>> AppxManifestObject::ReadApplications()
+    {
         std::vector<ComPtr<IAppxManifestApplication>> apps;
         struct _context
         {
@@ -341,10 +403,8 @@ namespace MSIX {
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Applications_Application, visitorApplication);
-        *applications = ComPtr<IAppxManifestApplicationsEnumerator>::
-            Make<EnumeratorCom<IAppxManifestApplicationsEnumerator,IAppxManifestApplication>>(apps).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+        return apps;
+    }
 
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetStream(IStream **manifestStream) noexcept try
     {
@@ -355,10 +415,17 @@ namespace MSIX {
     } CATCH_RETURN();
 
     // IAppxManifestReader2 
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetQualifiedResources(IAppxManifestQualifiedResourcesEnumerator **resources) noexcept
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetQualifiedResources(IAppxManifestQualifiedResourcesEnumerator **resources) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (resources == nullptr || *resources != nullptr), "bad pointer");
+        *resources = ComPtr<IAppxManifestQualifiedResourcesEnumerator>::
+            Make<EnumeratorCom<IAppxManifestQualifiedResourcesEnumerator,IAppxManifestQualifiedResource>>(
+                Load(m_resources, &AppxManifestObject::ReadResources)).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
 
+    std::vector<ComPtr<IAppxManifestQualifiedResource>> AppxManifestObject::ReadResources()
+    {
         std::vector<ComPtr<IAppxManifestQualifiedResource>> qualifiedResources;
         struct _context
         {
@@ -379,15 +446,13 @@ namespace MSIX {
             return true;
         });
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Resources_Resource, visitorResource);
-        *resources = ComPtr<IAppxManifestQualifiedResourcesEnumerator>::
-            Make<EnumeratorCom<IAppxManifestQualifiedResourcesEnumerator,IAppxManifestQualifiedResource>>(qualifiedResources).Detach();
-        return static_cast<HRESULT>(Error::OK);
+        return qualifiedResources;
     }
 
     // IAppxManifestReader3
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetCapabilitiesByCapabilityClass(
         APPX_CAPABILITY_CLASS_TYPE capabilityClass,
-        IAppxManifestCapabilitiesEnumerator **capabilities) noexcept
+        IAppxManifestCapabilitiesEnumerator **capabilities) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (capabilities == nullptr), "bad pointer");
 
@@ -395,37 +460,54 @@ namespace MSIX {
         auto capabilitiesNames = GetCapabilities(capabilityClass);
         *capabilities = ComPtr<IAppxManifestCapabilitiesEnumerator>::Make<EnumeratorString<IAppxManifestCapabilitiesEnumerator, IAppxManifestCapabilitiesEnumeratorUtf8>>(m_factory.Get(), capabilitiesNames).Detach();
         return static_cast<HRESULT>(Error::OK);
-    }
+    } CATCH_RETURN();
 
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetTargetDeviceFamilies(IAppxManifestTargetDeviceFamiliesEnumerator **targetDeviceFamilies) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (targetDeviceFamilies == nullptr || *targetDeviceFamilies != nullptr), "bad pointer");
         *targetDeviceFamilies = ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator>::
-            Make<EnumeratorCom<IAppxManifestTargetDeviceFamiliesEnumerator, IAppxManifestTargetDeviceFamily>>(m_tdf).Detach();
+            Make<EnumeratorCom<IAppxManifestTargetDeviceFamiliesEnumerator, IAppxManifestTargetDeviceFamily>>(
+                Load(m_tdf, &AppxManifestObject::ReadTargetDeviceFamilies)).Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
-    // IAppxManifestReader4
-    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetOptionalPackageInfo(IAppxManifestOptionalPackageInfo **optionalPackageInfo) noexcept try
+    std::vector<ComPtr<IAppxManifestTargetDeviceFamily>> AppxManifestObject::ReadTargetDeviceFamilies()
     {
-        ThrowErrorIf(Error::InvalidParameter, (optionalPackageInfo == nullptr || *optionalPackageInfo != nullptr), "bad pointer.");
-
+        std::vector<ComPtr<IAppxManifestTargetDeviceFamily>> tdfs;
         struct _context
         {
-            std::string mainPackageName;
+            AppxManifestObject* self;
+            std::vector<ComPtr<IAppxManifestTargetDeviceFamily>>* tdfs;
         };
-        _context context = {};
+        _context context = { this, &tdfs };
 
-        // Parse MainPackageDependency elements
-        XmlVisitor visitorMainPackageDependencies(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& dependencyNode)->bool
+        // Parse TargetDeviceFamily elements
+        XmlVisitor visitorTDF(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& tdfNode)->bool
         {
             _context* context = reinterpret_cast<_context*>(c);
-            auto name = dependencyNode->GetAttributeValue(XmlAttributeName::Name);
-            context->mainPackageName = name;
-            return false;
+            auto name = tdfNode->GetAttributeValue(XmlAttributeName::Name);
+            auto min = tdfNode->GetAttributeValue(XmlAttributeName::MinVersion);
+            auto max = tdfNode->GetAttributeValue(XmlAttributeName::Dependencies_Tdf_MaxVersionTested);
+            auto tdf = ComPtr<IAppxManifestTargetDeviceFamily>::Make<AppxManifestTargetDeviceFamily>(context->self->m_factory.Get(), name, min, max);
+            context->tdfs->push_back(std::move(tdf));
+            return true;
         });
-        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_MainPackageDependency, visitorMainPackageDependencies);
-        *optionalPackageInfo = ComPtr<IAppxManifestOptionalPackageInfo>::Make<AppxManifestOptionalPackageInfo>(this->m_factory.Get(), context.mainPackageName).Detach();
+        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_TargetDeviceFamily, visitorTDF);
+        return tdfs;
+    }
+
+    // IAppxManifestReader4
+    HRESULT STDMETHODCALLTYPE AppxManifestObject::GetOptionalPackageInfo(IAppxManifestOptionalPackageInfo **optionalPackageInfo) noexcept try
+    {
+        ThrowErrorIf(Error::InvalidParameter, (optionalPackageInfo == nullptr || *optionalPackageInfo != nullptr), "bad pointer.");
+
+        std::string mainPackageName;
+        const auto& mainPackageDependencies = Load(m_mainPackageDependencies, &AppxManifestObject::ReadMainPackageDependencies);
+        if (!mainPackageDependencies.empty())
+        {
+            mainPackageName = mainPackageDependencies.front().As<IAppxManifestMainPackageDependencyInternal>()->GetName();
+        }
+        *optionalPackageInfo = ComPtr<IAppxManifestOptionalPackageInfo>::Make<AppxManifestOptionalPackageInfo>(this->m_factory.Get(), mainPackageName).Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
@@ -433,6 +515,14 @@ namespace MSIX {
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetMainPackageDependencies(IAppxManifestMainPackageDependenciesEnumerator **mainPackageDependencies) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (mainPackageDependencies == nullptr || *mainPackageDependencies != nullptr), "bad pointer.");
+        *mainPackageDependencies = ComPtr<IAppxManifestMainPackageDependenciesEnumerator>::
+            Make<EnumeratorCom<IAppxManifestMainPackageDependenciesEnumerator, IAppxManifestMainPackageDependency>>(
+                Load(m_mainPackageDependencies, &AppxManifestObject::ReadMainPackageDependencies)).Detach();
+        return static_cast<HRESULT>(Error::OK);
+    } CATCH_RETURN();
+
+    std::vector<ComPtr<IAppxManifestMainPackageDependency>> AppxManifestObject::ReadMainPackageDependencies()
+    {
         std::vector<ComPtr<IAppxManifestMainPackageDependency>> packageDependencies;
 
         struct _context
@@ -467,16 +557,32 @@ namespace MSIX {
         });
 
         m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Dependencies_MainPackageDependency, visitorMainPackageDependencies);
-        *mainPackageDependencies = ComPtr<IAppxManifestMainPackageDependenciesEnumerator>::
-            Make<EnumeratorCom<IAppxManifestMainPackageDependenciesEnumerator, IAppxManifestMainPackageDependency>>(packageDependencies).Detach();
-        return static_cast<HRESULT>(Error::OK);
-    } CATCH_RETURN();
+        return packageDependencies;
+    }
 
     // IMsixDocumentElement
     HRESULT STDMETHODCALLTYPE AppxManifestObject::GetDocumentElement(IMsixElement** documentElement) noexcept try
     {
         ThrowErrorIf(Error::InvalidParameter, (documentElement == nullptr || *documentElement != nullptr), "bad pointer");
-        *documentElement = m_dom->GetDocument().As<IMsixElement>().Detach();
+        if (!m_documentShared)
+        {   // Only this object reads the document
+            std::lock_guard<std::mutex> lock(m_document->lock);
+            *documentElement = m_dom->GetDocument().As<IMsixElement>().Detach();
+            return static_cast<HRESULT>(Error::OK);
+        }
+
+        // The elements are read by the caller without the document lock, so they can't come from the DOM shared
+        // through the document cache. The caller gets a DOM of its own, parsed again from the manifest stream.
+        std::lock_guard<std::mutex> lock(m_callerDomLock);
+        if (!m_callerDom)
+        {
+            ComPtr<IXmlFactory> xmlFactory;
+            ThrowHrIfFailed(m_factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
+            LARGE_INTEGER start = { 0 };
+            ThrowHrIfFailed(m_stream->Seek(start, StreamBase::Reference::START, nullptr));
+            m_callerDom = xmlFactory->CreateDomFromStream(XmlContentType::AppxManifestXml, m_stream);
+        }
+        *documentElement = m_callerDom->GetDocument().As<IMsixElement>().Detach();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
@@ -487,100 +593,42 @@ namespace MSIX {
             "Invalid capability class.");
 
         std::vector<std::string> capabilitiesNames;
-        struct _context
+        for (const auto& capability : Load(m_capabilities, &AppxManifestObject::ReadCapabilities))
         {
-            APPX_CAPABILITY_CLASS_TYPE capabilityClass;
-            std::vector<std::string>& capabilitiesNames;
-        };
-        _context context = { capabilityClass, capabilitiesNames};
-
-        // Parse Capability elements.
-        if (capabilityClass != APPX_CAPABILITY_CLASS_CUSTOM)
-        {
-            XmlVisitor visitorCapabilities(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& capabilitiesNode)->bool
+            if (capabilityClass == APPX_CAPABILITY_CLASS_ALL || capabilityClass == capability.second ||
+                (capabilityClass == APPX_CAPABILITY_CLASS_DEFAULT && capability.second == APPX_CAPABILITY_CLASS_GENERAL))
             {
-                _context* context = reinterpret_cast<_context*>(c);
-                std::string prefix = capabilitiesNode->GetPrefix();
-                auto name = capabilitiesNode->GetAttributeValue(XmlAttributeName::Name);
-
-                static std::array<std::string, 11> generalCapabilities = 
-                {
-                    "foundation",
-                    "uap",
-                    "win10foundation",
-                    "win10uap",
-                    "uap2",
-                    "uap3",
-                    "uap4",
-                    "uap6",
-                    "uap7",
-                    "win10mobile",
-                    "", // If no prefix then default namespace for AppxManifest is win10foundation.
-                };
-
-                static std::array<std::string, 2> restrictedCapabilities = 
-                {
-                    "rescap",
-                    "win10rescap",
-                };
-
-                static std::array<std::string, 2> windowsCapabilities = 
-                {
-                    "wincap",
-                    "win10wincap",
-                };
-
-                if (context->capabilityClass == APPX_CAPABILITY_CLASS_GENERAL ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_DEFAULT ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_ALL)
-                {
-                    auto found = std::find(generalCapabilities.begin(), generalCapabilities.end(), prefix);
-                    if (found != generalCapabilities.end())
-                    {
-                        context->capabilitiesNames.push_back(name);
-                        return true;
-                    }
-                }
-
-                if (context->capabilityClass == APPX_CAPABILITY_CLASS_RESTRICTED ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_ALL)
-                { 
-                    auto found = std::find(restrictedCapabilities.begin(), restrictedCapabilities.end(), prefix);
-                    if (found != restrictedCapabilities.end())
-                    {
-                        context->capabilitiesNames.push_back(name);
-                        return true;
-                    }
-                }
-
-                if (context->capabilityClass == APPX_CAPABILITY_CLASS_WINDOWS ||
-                    context->capabilityClass == APPX_CAPABILITY_CLASS_ALL)
-                {
-                    auto found = std::find(windowsCapabilities.begin(), windowsCapabilities.end(), prefix);
-                    if (found != windowsCapabilities.end())
-                    {
-                        context->capabilitiesNames.push_back(name);
-                        return true;
-                    }
-                }
-
-                return true;
-            });
-            m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_Capability, visitorCapabilities);
+                capabilitiesNames.push_back(capability.first);
+            }
         }
+        return capabilitiesNames;
+    }
 
-        if (capabilityClass == APPX_CAPABILITY_CLASS_CUSTOM || capabilityClass == APPX_CAPABILITY_CLASS_ALL)
+    // Reads the names of the Capability elements of known namespaces, followed by the CustomCapability elements,
+    // with their class
+    std::vector<std::pair<std::string, APPX_CAPABILITY_CLASS_TYPE>> AppxManifestObject::ReadCapabilities()
+    {
+        std::vector<std::pair<std::string, APPX_CAPABILITY_CLASS_TYPE>> capabilities;
+        XmlVisitor visitorCapabilities(static_cast<void*>(&capabilities), [](void* c, const ComPtr<IXmlElement>& capabilitiesNode)->bool
         {
-            XmlVisitor visitorCustomCapabilities(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& capabilitiesNode)->bool
+            auto capabilities = reinterpret_cast<std::vector<std::pair<std::string, APPX_CAPABILITY_CLASS_TYPE>>*>(c);
+            auto prefix = capabilitiesNode->GetPrefixView();
+            const auto capabilityClass = GetCapabilityClassTable().Find(prefix.data(), prefix.size());
+            if (capabilityClass != nullptr)
             {
-                _context* context = reinterpret_cast<_context*>(c);
-                auto name = capabilitiesNode->GetAttributeValue(XmlAttributeName::Name);
-                context->capabilitiesNames.push_back(name);
-                return true;
-            });
-            m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_CustomCapability, visitorCustomCapabilities);
-        }
+                capabilities->emplace_back(capabilitiesNode->GetAttributeValue(XmlAttributeName::Name), *capabilityClass);
+            }
+            return true;
+        });
+        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_Capability, visitorCapabilities);
 
-        return capabilitiesNames;
+        XmlVisitor visitorCustomCapabilities(static_cast<void*>(&capabilities), [](void* c, const ComPtr<IXmlElement>& capabilitiesNode)->bool
+        {
+            auto capabilities = reinterpret_cast<std::vector<std::pair<std::string, APPX_CAPABILITY_CLASS_TYPE>>*>(c);
+            capabilities->emplace_back(capabilitiesNode->GetAttributeValue(XmlAttributeName::Name), APPX_CAPABILITY_CLASS_CUSTOM);
+            return true;
+        });
+        m_dom->ForEachElementIn(m_dom->GetDocument(), XmlQueryName::Package_Capabilities_CustomCapability, visitorCustomCapabilities);
+        return capabilities;
     }
 }
@@ -3,7 +3,7 @@
 //  See LICENSE file in the project root for full license information.
 //
 
-#include <regex>
+#include <algorithm>
 #include <string>
 
 #include "AppxManifestValidation.hpp"
@@ -36,7 +36,7 @@ namespace MSIX {
             XmlVisitor visitor{ &result,
                 [](void* c, const MSIX::ComPtr<IXmlElement>& element)
             {
-                *reinterpret_cast<bool*>(c) = (element->GetText() == "true");
+                *reinterpret_cast<bool*>(c) = (element->GetTextView() == "true");
                 return false;
             }};
             manifest->ForEachElementIn(query, visitor);
@@ -70,9 +70,7 @@ namespace MSIX {
             {
                 context& thisContext = *reinterpret_cast<context*>(c);
 
-                std::string attributeValue = element->GetAttributeValue(thisContext.attribute);
-
-                if (!attributeValue.empty())
+                if (!element->GetAttributeValueView(thisContext.attribute).empty())
                 {
                     thisContext.result = true;
                     return false;
@@ -263,16 +261,39 @@ namespace MSIX {
     bool AppxManifestValidation::IsIdentifierValid(const std::string& identifier)
     {
 #if !VALIDATING
-        // If the schema didn't check for us, do it now.
-        std::regex e("[a-zA-Z0-9\\.\\-]+"); // valid characters
-        if (!std::regex_match(identifier, e))
+        // If the schema didn't check for us, do it now. Valid characters are [a-zA-Z0-9.-]+
+        if (identifier.empty())
         {
             return false;
         }
+        for (auto c : identifier)
+        {
+            if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.' || c == '-'))
+            {
+                return false;
+            }
+        }
 #endif
         return FileNameValidation::IsIdentifierValid(identifier);
     }
 
+    bool AppxManifestValidation::IsPackageFileNameValid(const std::string& fileName)
+    {
+        // Same as the regex .+\.((appx)|(msix)), where . doesn't match line terminators
+        constexpr std::size_t extensionSize = 5;
+        if (fileName.size() <= extensionSize)
+        {
+            return false;
+        }
+        auto extension = fileName.size() - extensionSize;
+        if (fileName.compare(extension, extensionSize, ".appx") != 0 && fileName.compare(extension, extensionSize, ".msix") != 0)
+        {
+            return false;
+        }
+        return std::find_if(fileName.begin(), fileName.begin() + extension, [](char c) { return c == '\n' || c == '\r'; }) ==
+            fileName.begin() + extension;
+    }
+
     void AppxManifestValidation::ValidateManifest(IXmlDom* manifest)
     {
         ValidateIdentifiers(manifest);
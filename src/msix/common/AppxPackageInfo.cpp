@@ -10,7 +10,6 @@
 #include "Enumerators.hpp"
 #include "IXml.hpp"
 
-#include <regex>
 #include <array>
 #include <string>
 
@@ -0,0 +1,208 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "Base64.hpp"
+#include "Exceptions.hpp"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define MSIX_BASE64_SSSE3 1
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// The SSSE3 kernels are compiled for SSSE3 regardless of the flags of the build and only called if the processor
+// supports it. MSVC doesn't need the attribute to use the intrinsics.
+#if defined(MSIX_BASE64_SSSE3) && (defined(__GNUC__) || defined(__clang__))
+#define MSIX_TARGET_SSSE3 __attribute__((target("ssse3")))
+#else
+#define MSIX_TARGET_SSSE3
+#endif
+
+namespace MSIX {
+
+    namespace {
+
+        const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+        const std::uint8_t Invalid = 0xFF;
+        const std::uint8_t Padding = 64;
+
+        // Value of each character, Padding for '=' and Invalid for the rest, including anything above 127.
+        struct DecoderRing
+        {
+            std::uint8_t values[256];
+
+            DecoderRing()
+            {
+                for (auto& value : values) { value = Invalid; }
+                for (std::uint8_t i = 0; i < 64; i++) { values[static_cast<std::uint8_t>(base64Alphabet[i])] = i; }
+                values[static_cast<std::uint8_t>('=')] = Padding;
+            }
+        };
+
+        const DecoderRing decoderRing;
+
+        // Encodes whole groups of three bytes
+        void EncodeScalar(const std::uint8_t* data, std::size_t size, char* output)
+        {
+            for (std::size_t i = 0; i + 3 <= size; i += 3, output += 4)
+            {
+                std::uint32_t value = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+                output[0] = base64Alphabet[(value >> 18) & 0x3F];
+                output[1] = base64Alphabet[(value >> 12) & 0x3F];
+                output[2] = base64Alphabet[(value >> 6) & 0x3F];
+                output[3] = base64Alphabet[value & 0x3F];
+            }
+        }
+
+        // Decodes one group of four characters. A group may end with padding.
+        std::size_t DecodeGroup(const char* data, std::uint8_t* output)
+        {
+            auto v1 = decoderRing.values[static_cast<std::uint8_t>(data[0])];
+            auto v2 = decoderRing.values[static_cast<std::uint8_t>(data[1])];
+            auto v3 = decoderRing.values[static_cast<std::uint8_t>(data[2])];
+            auto v4 = decoderRing.values[static_cast<std::uint8_t>(data[3])];
+
+            ThrowErrorIf(Error::InvalidParameter,(((v1 | v2) >= 64) || ((v3 | v4) == Invalid)), "first two chars of a four char base64 sequence can't be ==, and must be valid");
+            ThrowErrorIf(Error::InvalidParameter,(v3 == Padding && v4 != Padding), "if the third char is = then the fourth char must be =");
+            output[0] = static_cast<std::uint8_t>((v1 << 2) | (v2 >> 4));
+            if (v3 == Padding) { return 1; }
+            output[1] = static_cast<std::uint8_t>((v2 << 4) | (v3 >> 2));
+            if (v4 == Padding) { return 2; }
+            output[2] = static_cast<std::uint8_t>((v3 << 6) | v4);
+            return 3;
+        }
+
+#ifdef MSIX_BASE64_SSSE3
+        bool HasSsse3()
+        {
+#if defined(__SSSE3__)
+            return true;
+#elif defined(_MSC_VER)
+            int info[4];
+            __cpuid(info, 1);
+            return (info[2] & (1 << 9)) != 0;
+#else
+            // This runs during static initialization, maybe before the constructor of libgcc.
+            __builtin_cpu_init();
+            return __builtin_cpu_supports("ssse3") != 0;
+#endif
+        }
+
+        const bool hasSsse3 = HasSsse3();
+
+        // Encodes 12 bytes to 16 characters per iteration. Reads 16 bytes, so it stops while 16 bytes are left.
+        // Returns the number of bytes encoded.
+        MSIX_TARGET_SSSE3 std::size_t EncodeSsse3(const std::uint8_t* data, std::size_t size, char* output)
+        {
+            const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+            const __m128i shiftLut = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+            std::size_t i = 0;
+            for (; i + 16 <= size; i += 12, output += 16)
+            {
+                __m128i in = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i)), shuffle);
+                // Move each 6 bits to their own byte
+                __m128i high = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+                __m128i low = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+                __m128i indices = _mm_or_si128(high, low);
+                // Offset from the index to the character, selected by range
+                __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+                range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indices), _mm_set1_epi8(13)));
+                __m128i result = _mm_add_epi8(_mm_shuffle_epi8(shiftLut, range), indices);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output), result);
+            }
+            return i;
+        }
+
+        // Decodes 16 characters to 12 bytes per iteration. Writes 16 bytes, so it stops while 24 characters are
+        // left. Stops at the first block with padding or an invalid character, the scalar code handles it.
+        // Returns the number of characters decoded.
+        MSIX_TARGET_SSSE3 std::size_t DecodeSsse3(const char* data, std::size_t size, std::uint8_t* output)
+        {
+            // Indexed by the high nibble, offset from the character to its value
+            const __m128i shiftLut = _mm_setr_epi8(0, 0, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+            // Indexed by the low nibble, bit n is set if the character with high nibble n is valid
+            const __m128i maskLut = _mm_setr_epi8(static_cast<char>(0xa8), static_cast<char>(0xf8), static_cast<char>(0xf8),
+                static_cast<char>(0xf8), static_cast<char>(0xf8), static_cast<char>(0xf8), static_cast<char>(0xf8),
+                static_cast<char>(0xf8), static_cast<char>(0xf8), static_cast<char>(0xf8), static_cast<char>(0xf0),
+                0x54, 0x50, 0x50, 0x50, 0x54);
+            const __m128i bitLut = _mm_setr_epi8(0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>(0x80),
+                0, 0, 0, 0, 0, 0, 0, 0);
+            const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+            std::size_t i = 0;
+            for (; i + 24 <= size; i += 16, output += 12)
+            {
+                __m128i in = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                __m128i highNibble = _mm_and_si128(_mm_srli_epi32(in, 4), _mm_set1_epi8(0x0f));
+                __m128i lowNibble = _mm_and_si128(in, _mm_set1_epi8(0x0f));
+                __m128i valid = _mm_and_si128(_mm_shuffle_epi8(maskLut, lowNibble), _mm_shuffle_epi8(bitLut, highNibble));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(valid, _mm_setzero_si128())) != 0)
+                {
+                    break;
+                }
+                // '/' shares the high nibble of '+' but is 3 positions after it
+                __m128i shift = _mm_shuffle_epi8(shiftLut, highNibble);
+                shift = _mm_add_epi8(shift, _mm_and_si128(_mm_cmpeq_epi8(in, _mm_set1_epi8('/')), _mm_set1_epi8(-3)));
+                __m128i values = _mm_add_epi8(in, shift);
+                // Join four 6 bits values into 24 bits and remove the gaps
+                __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+                merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(output), _mm_shuffle_epi8(merged, pack));
+            }
+            return i;
+        }
+#endif
+    }
+
+    void Base64::Encode(const std::uint8_t* data, std::size_t size, char* output)
+    {
+        std::size_t i = 0;
+#ifdef MSIX_BASE64_SSSE3
+        if (hasSsse3) { i = EncodeSsse3(data, size, output); }
+#endif
+        output += (i / 3) * 4;
+        EncodeScalar(data + i, size - i, output);
+        output += ((size - i) / 3) * 4;
+        i += ((size - i) / 3) * 3;
+
+        auto remaining = size - i;
+        if (remaining != 0)
+        {
+            std::uint32_t value = (data[i] << 16) | ((remaining == 2) ? (data[i + 1] << 8) : 0);
+            output[0] = base64Alphabet[(value >> 18) & 0x3F];
+            output[1] = base64Alphabet[(value >> 12) & 0x3F];
+            output[2] = (remaining == 2) ? base64Alphabet[(value >> 6) & 0x3F] : '=';
+            output[3] = '=';
+        }
+    }
+
+    std::size_t Base64::Decode(const char* data, std::size_t size, std::uint8_t* output)
+    {
+        ThrowErrorIfNot(Error::InvalidParameter, (0 == (size % 4)), "invalid base64 encoding");
+        std::size_t i = 0;
+        std::uint8_t* position = output;
+#ifdef MSIX_BASE64_SSSE3
+        if (hasSsse3) { i = DecodeSsse3(data, size, output); }
+#endif
+        position += (i / 4) * 3;
+        for (; i < size; i += 4)
+        {
+            position += DecodeGroup(data + i, position);
+        }
+        return static_cast<std::size_t>(position - output);
+    }
+
+    std::string Base64::ComputeBase64(const std::vector<std::uint8_t>& buffer)
+    {
+        std::string result(GetEncodedSize(buffer.size()), '\0');
+        if (!result.empty())
+        {
+            Encode(buffer.data(), buffer.size(), &result[0]);
+        }
+        return result;
+    }
+}
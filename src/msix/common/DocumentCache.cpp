@@ -0,0 +1,120 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "DocumentCache.hpp"
+#include "Crypto.hpp"
+#include "Exceptions.hpp"
+#include "StreamHelper.hpp"
+#include "VectorStream.hpp"
+
+namespace MSIX {
+
+    DocumentCache::Value DocumentCache::GetValue(Document document, const ComPtr<IStream>& stream, void* context, Parse parse,
+        bool* shared)
+    {
+        bool enabled = IsEnabled();
+        if (shared != nullptr) { *shared = enabled; }
+        if (!enabled)
+        {
+            std::uint64_t size = 0;
+            return parse(context, stream, size);
+        }
+
+        // Reading the whole stream also completes its validation, if it is a validation stream.
+        auto buffer = Helper::CreateBufferFromStream(stream);
+        std::vector<std::uint8_t> hash;
+        ThrowErrorIfNot(Error::Unexpected,
+            SHA256::ComputeHash(buffer.data(), static_cast<std::uint32_t>(buffer.size()), hash),
+            "Failed computing hash");
+        std::string key(1, static_cast<char>(document));
+        key.append(hash.begin(), hash.end());
+
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            auto entry = m_entries.find(key);
+            if (entry != m_entries.end())
+            {
+                m_hits++;
+                m_uses.splice(m_uses.end(), m_uses, entry->second.use);
+                return entry->second.value;
+            }
+            m_misses++;
+        }
+
+        // Parse without the lock, other documents can be looked up meanwhile.
+        std::uint64_t size = 0;
+        auto value = parse(context, ComPtr<IStream>::Make<VectorStream>(std::move(buffer)), size);
+        size += sizeof(Entry) + key.size();
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto existing = m_entries.find(key);
+        if (existing != m_entries.end())
+        {   // Parsed by another thread at the same time, share its value.
+            m_uses.splice(m_uses.end(), m_uses, existing->second.use);
+            return existing->second.value;
+        }
+        if (size <= m_sizeLimit)
+        {
+            m_size += size;
+            auto use = m_uses.insert(m_uses.end(), key);
+            m_entries.emplace(key, Entry{ value, size, use });
+            EvictLocked();
+        }
+        return value;
+    }
+
+    void DocumentCache::EvictLocked()
+    {
+        while (m_size > m_sizeLimit)
+        {
+            auto evicted = m_entries.find(m_uses.front());
+            m_size -= evicted->second.size;
+            m_entries.erase(evicted);
+            m_uses.pop_front();
+            m_evictions++;
+        }
+    }
+
+    void DocumentCache::ClearLocked()
+    {
+        m_entries.clear();
+        m_uses.clear();
+        m_size = 0;
+    }
+
+    bool DocumentCache::IsEnabled()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        return m_sizeLimit != 0;
+    }
+
+    void DocumentCache::SetSizeLimit(std::uint64_t sizeLimit)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_sizeLimit = sizeLimit;
+        if (m_sizeLimit == 0)
+        {
+            ClearLocked();
+        }
+        EvictLocked();
+    }
+
+    void DocumentCache::Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        ClearLocked();
+    }
+
+    MSIX_DOCUMENT_CACHE_STATISTICS DocumentCache::GetStatistics()
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        MSIX_DOCUMENT_CACHE_STATISTICS statistics = {};
+        statistics.hits = m_hits;
+        statistics.misses = m_misses;
+        statistics.evictions = m_evictions;
+        statistics.entries = static_cast<UINT64>(m_entries.size());
+        statistics.size = m_size;
+        return statistics;
+    }
+}
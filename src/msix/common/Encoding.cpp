@@ -4,150 +4,171 @@
 //
 
 #include <string>
-#include <algorithm>
+#include <cstring>
 #include <vector>
-#include <array>
 
 #include "Encoding.hpp"
+#include "Base64.hpp"
 #include "Exceptions.hpp"
 #include "UnicodeConversion.hpp"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MSIX_ENCODING_SSE2 1
+#include <emmintrin.h>
+#endif
+
 namespace MSIX { namespace Encoding {
 
-    const std::size_t PercentageEncodingTableSize = 0x7F;
-    const std::array<const wchar_t*, PercentageEncodingTableSize> PercentageEncoding =
-    {   nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        L"%20",  L"%21",  nullptr, L"%23",  L"%24",  L"%25",  L"%26",  L"%27",   // [space] ! # $ % & '
-        L"%28",  L"%29",  nullptr, L"%2B",  L"%2C",  nullptr, nullptr, nullptr, // ( ) + ,
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, L"%3B",  nullptr, L"%3D",  nullptr, nullptr, // ; =
-        L"%40",  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, // @
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, L"%5B",  nullptr, L"%5D",  L"%5E",  nullptr, // [ ] ^
-        L"%60",  nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, // `
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr,
-        nullptr, nullptr, nullptr, L"%7B",  nullptr, L"%7D",  nullptr,          // { }
-    };
-
-    struct EncodingChar
-    {
-        const wchar_t* encode;
-        wchar_t        decode;
+    namespace {
 
-        bool operator==(const std::wstring& rhs) const {
-            return rhs == encode;
-        }
-        EncodingChar(const wchar_t* e, wchar_t d) : encode(e), decode(d) {}
-    };
+        // What the encoder does with each byte. Everything from 0x80 up is part of a UTF-8 sequence and gets escaped
+        // byte by byte, which is the same as escaping the UTF-8 sequence of the code point.
+        const std::uint8_t Plain = 0;
+        const std::uint8_t Escape = 1;
+        const std::uint8_t Backslash = 2;
+        const std::uint8_t Null = 3;
 
-    // Returns the file name percentage encoded.
-    std::string EncodeFileName(const std::string& fileName)
-    {
-        ThrowErrorIf(Error::InvalidParameter, fileName.empty(), "Empty value tries to be encoded");
-        std::wstring fileNameW = utf8_to_wstring(fileName);
-        std::wstring result = L"";
+        const std::uint8_t InvalidHex = 0xFF;
+
+        const char hexadecimal[] = "0123456789ABCDEF";
 
-        for (std::uint32_t index = 0; index < fileNameW.length(); index++)
+        struct ByteTables
         {
-            std::uint32_t codepoint = static_cast<std::uint32_t>(fileNameW[index]);
+            std::uint8_t encode[256];
+            std::uint8_t hex[256];
 
-            // Start of double wchar UTF-16 sequence
-            if ((codepoint & 0xFC00) == 0xD800)
+            ByteTables()
             {
-                if ((fileNameW[index] & 0xFC00) == 0xD800 &&
-                    (fileNameW[index+1] & 0xFC00) == 0xDC00)
+                for (std::size_t i = 0; i < 256; i++)
                 {
-                    codepoint = (((fileNameW[index] & 0x03C0) + 0x0040) | (fileNameW[index] & 0x003F)) << 10;
-                    codepoint |= (fileNameW[index+1] & 0x03FF);
+                    encode[i] = (i < 0x80) ? Plain : Escape;
+                    hex[i] = InvalidHex;
                 }
-                else
+                for (auto c : " !#$%&'()+,;=@[]^`{}") { encode[static_cast<std::uint8_t>(c)] = Escape; }
+                encode[static_cast<std::uint8_t>('\\')] = Backslash;
+                encode[0] = Null;
+                for (std::uint8_t i = 0; i < 10; i++) { hex['0' + i] = i; }
+                for (std::uint8_t i = 0; i < 6; i++) { hex['A' + i] = 10 + i; hex['a' + i] = 10 + i; }
+            }
+        };
+
+        const ByteTables byteTables;
+
+        // Returns true if no byte needs encoding. Names are almost always made of letters, digits and . - _ /, which
+        // are checked a vector at a time. Blocks with anything else go through the table.
+        bool IsEncoded(const char* data, std::size_t size)
+        {
+            auto bytes = reinterpret_cast<const std::uint8_t*>(data);
+            std::size_t i = 0;
+            #if defined(MSIX_ENCODING_SSE2)
+            for (; i + 16 <= size; i += 16)
+            {   // Bytes from 0x80 up are negative, so they fail every signed range check.
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+                __m128i folded = _mm_or_si128(v, _mm_set1_epi8(0x20)); // A-Z to a-z
+                __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(folded, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(folded, _mm_set1_epi8('z' + 1)));
+                __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('-' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1))); // - . / 0-9
+                __m128i plain = _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+                if (_mm_movemask_epi8(plain) != 0xFFFF)
                 {
-                    ThrowError(Error::InvalidParameter);
+                    for (std::size_t j = i; j < i + 16; j++) { if (byteTables.encode[bytes[j]] != Plain) { return false; } }
                 }
-                index++;
             }
-            else if ((codepoint & 0xFC00) == 0xDC00)
+            #endif
+            for (; i < size; i++)
             {
-                ThrowErrorAndLog(Error::InvalidParameter, "The second surrogate pair may not exist alone");
+                if (byteTables.encode[bytes[i]] != Plain) { return false; }
             }
+            return true;
+        }
 
-            // See if it's one of the special cases we encode
-            if (codepoint < PercentageEncodingTableSize && PercentageEncoding[codepoint] != nullptr)
-            {   result += PercentageEncoding[codepoint];
+        // Returns true if there's nothing to decode: no '%', null character or UTF-8 sequence.
+        bool IsDecoded(const char* data, std::size_t size)
+        {
+            auto bytes = reinterpret_cast<const std::uint8_t*>(data);
+            std::size_t i = 0;
+            #if defined(MSIX_ENCODING_SSE2)
+            const __m128i percent = _mm_set1_epi8('%');
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+                __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, percent), _mm_cmpeq_epi8(v, zero)), v);
+                if (_mm_movemask_epi8(special) != 0) { return false; }
             }
-            else if (fileNameW[index] == '\\') // replace backslash
-            {   result.push_back('/');
+            #endif
+            for (; i < size; i++)
+            {
+                if (bytes[i] == '%' || bytes[i] == 0 || bytes[i] >= 0x80) { return false; }
             }
-            else if (codepoint > PercentageEncodingTableSize)
-            {   // Returns the length of the UTF-8 byte sequence associated with the given codepoint
-                // We already know is > 0x7F, so it can't be 1 byte
-                std::uint8_t totalBytes = 0;
-                if (codepoint <= 0x07FF) { totalBytes = 2; }
-                else if (codepoint <= 0xFFFF) { totalBytes = 3; }
-                else { totalBytes = 4; }
-
-                const std::wstring hexadecimal = L"0123456789ABCDEF";
-                for (size_t byteIndex = 0; byteIndex < totalBytes; byteIndex++)
-                {
-                    std::uint32_t mychar;
-                    switch (totalBytes - byteIndex)
-                    {
-                    case 1:
-                        if (totalBytes == 1) { mychar = codepoint; } 
-                        else { mychar = 0x80 | (codepoint & 0x003F); }
-                        break;
-                    case 2:
-                        if (totalBytes == 2) { mychar = 0xC0 | ((codepoint & 0x07C0) >> 6); } 
-                        else { mychar = 0x80 | ((codepoint & 0x0FC0) >> 6); }
-                        break;
-                    case 3:
-                        if (totalBytes == 3) { mychar = 0xE0 | ((codepoint & 0xF000) >> 12); } 
-                        else { mychar = 0x80 | ((codepoint & 0x03F000) >> 12); }
-                        break;
-                    case 4:
-                        mychar = 0xF0 | ((codepoint & 0x1C0000) >> 18);
-                        break;
-                    default:
-                        ThrowError(Error::Unexpected); // This should never happen.
-                        break;
-                    }
+            return true;
+        }
 
-                    auto highDigit = mychar / hexadecimal.size();
-                    auto lowDigit = mychar % hexadecimal.size();
+        // Decodes the %XX at data[index] and moves index past it
+        std::uint32_t DecodeHex(const char* data, std::size_t size, std::size_t& index)
+        {
+            ThrowErrorIf(Error::UnknownFileNameEncoding, index + 2 >= size, "Invalid encoding");
+            auto high = byteTables.hex[static_cast<std::uint8_t>(data[index + 1])];
+            auto low = byteTables.hex[static_cast<std::uint8_t>(data[index + 2])];
+            ThrowErrorIf(Error::Unexpected, (high == InvalidHex || low == InvalidHex), "Invalid hexadecimal");
+            index += 3;
+            return (high << 4) | low;
+        }
 
-                    ThrowErrorIf(Error::InvalidParameter, (highDigit > hexadecimal.size() || lowDigit  > hexadecimal.size()), "Invalid");
-                    result.push_back('%'); // we are percentage encoding
-                    result.push_back(hexadecimal[highDigit]);
-                    result.push_back(hexadecimal[lowDigit]);
-                }
-            }
-            else
-            {   result.push_back(fileNameW[index]);
+        // Returns the number of bytes written
+        std::size_t WriteUtf8(std::uint32_t codepoint, char* output)
+        {
+            if (codepoint < 0x80)
+            {
+                *output = static_cast<char>(codepoint);
+                return 1;
             }
+            char32_t value = codepoint;
+            return Unicode::Utf32ToUtf8(&value, 1, output);
         }
-        return wstring_to_utf8(result);
     }
 
-    const EncodingChar EncodingToChar[] =
-    {   EncodingChar(L"20", ' '), EncodingChar(L"21", '!'), EncodingChar(L"23", '#'),  EncodingChar(L"24", '$'),
-        EncodingChar(L"25", '%'), EncodingChar(L"26", '&'), EncodingChar(L"27", '\''), EncodingChar(L"28", '('),
-        EncodingChar(L"29", ')'), EncodingChar(L"2B", '+'), EncodingChar(L"2C", ','),  EncodingChar(L"3B", ';'),
-        EncodingChar(L"3D", '='), EncodingChar(L"40", '@'), EncodingChar(L"5B", '['),  EncodingChar(L"5D", ']'),
-        EncodingChar(L"5E", '^'), EncodingChar(L"60", '`'), EncodingChar(L"7B", '{'),  EncodingChar(L"7D", '}')
-    };
+    // Returns the file name percentage encoded.
+    std::string EncodeFileName(const std::string& fileName)
+    {
+        std::string buffer;
+        const auto& result = EncodeFileName(fileName, buffer);
+        return (&result == &fileName) ? fileName : buffer;
+    }
 
-    // Convert a single hex digit to its corresponding value
-    inline std::uint32_t ConvertHex(wchar_t ch)
+    const std::string& EncodeFileName(const std::string& fileName, std::string& buffer)
     {
-        if (ch >= '0' && ch <= '9') { return ch - '0'; }
-        else if (ch >= 'A' && ch <= 'F') { return ch - 'A' + 10; }
-        else if (ch >= 'a' && ch <= 'f') { return ch - 'a' + 10; }
-        ThrowErrorAndLog(Error::Unexpected, "Invalid hexadecimal");
+        ThrowErrorIf(Error::InvalidParameter, fileName.empty(), "Empty value tries to be encoded");
+        if (IsEncoded(fileName.data(), fileName.size()))
+        {
+            return fileName;
+        }
+
+        // The name ends at the first null character
+        auto size = std::char_traits<char>::length(fileName.c_str());
+        Unicode::ValidateUtf8(fileName.data(), size);
+        buffer.resize(size * 3);
+        char* output = &buffer[0];
+        for (std::size_t index = 0; index < size; index++)
+        {
+            auto byte = static_cast<std::uint8_t>(fileName[index]);
+            switch (byteTables.encode[byte])
+            {
+            case Plain:
+                *output++ = fileName[index];
+                break;
+            case Backslash: // replace backslash
+                *output++ = '/';
+                break;
+            default:
+                output[0] = '%';
+                output[1] = hexadecimal[byte >> 4];
+                output[2] = hexadecimal[byte & 0x0F];
+                output += 3;
+                break;
+            }
+        }
+        buffer.resize(output - &buffer[0]);
+        return buffer;
     }
 
     //+----------------------------------------------------------------------------
@@ -217,128 +238,96 @@ namespace MSIX { namespace Encoding {
     // Decodes a percentage encoded string
     std::string DecodeFileName(const std::string& fileName)
     {
-        std::wstring fileNameW = utf8_to_wstring(fileName);
-        std::wstring result = L"";
-        for (std::uint32_t index = 0; index < fileNameW.length(); index++)
+        std::string buffer;
+        const auto& result = DecodeFileName(fileName, buffer);
+        return (&result == &fileName) ? fileName : buffer;
+    }
+
+    const std::string& DecodeFileName(const std::string& fileName, std::string& buffer)
+    {
+        if (IsDecoded(fileName.data(), fileName.size()))
         {
-            if(fileName[index] == '%')
+            return fileName;
+        }
+
+        // The name ends at the first null character
+        const char* data = fileName.data();
+        auto size = std::char_traits<char>::length(fileName.c_str());
+        Unicode::ValidateUtf8(data, size);
+        const char* percent = static_cast<const char*>(std::memchr(data, '%', size));
+        if (percent == nullptr && size == fileName.size())
+        {
+            return fileName;
+        }
+
+        // Every %XX decodes to at most one byte, except that a lone four byte lead at the end keeps 3 bits of a
+        // code point above U+FFFF and takes four.
+        buffer.resize(size + 1);
+        char* output = &buffer[0];
+        std::size_t index = 0;
+        while (percent != nullptr)
+        {
+            std::size_t count = percent - (data + index);
+            std::memcpy(output, data + index, count);
+            output += count;
+            index += count;
+
+            std::uint32_t decoded = DecodeHex(data, size, index);
+            if (decoded <= 0x7F)
+            {
+                *output++ = static_cast<char>(decoded);
+            }
+            else
             {
-                ThrowErrorIf(Error::UnknownFileNameEncoding, index+2 >= fileNameW.length(), "Invalid encoding.")
-                auto encoding = fileNameW.substr(index+1, 2);
-                const auto& found = std::find(std::begin(EncodingToChar), std::end(EncodingToChar), fileNameW.substr(index+1, 2));
-                if (found != std::end(EncodingToChar))
-                {   // Use special cheat table
-                    result.push_back(found->decode);
-                    index += 2;
+                std::uint32_t codepoint = 0;
+                std::uint32_t sequenceSize = 1;
+                std::uint8_t minNextSequenceValue = 0x80;
+                std::uint8_t maxNextSequenceValue = 0xBF;
+                if ((decoded & 0xE0) == 0xC0 && decoded >= 0xC2) // 2 Byte sequence starts with 110y,yyyy
+                {
+                    sequenceSize = 2;
+                    codepoint = (decoded & 0x1F) << 6;
                 }
-                else
+                else if ((decoded & 0xF0) == 0xE0) // 3 Byte sequence starts with 1110,zzzz
                 {
-                    std::uint32_t codepoint = 0;
-                    std::uint32_t sequenceSize = 1;
-                    std::uint32_t sequenceIndex = 0;
-                    std::uint8_t minNextSequenceValue = 0;
-                    std::uint8_t maxNextSequenceValue = 0;
-                    bool done = false;
-
-                    // Ok, here we go...
-                    while (index < fileNameW.length() && !done)
-                    {
-                        if (fileNameW[index] == '%')
-                        {
-                            ThrowErrorIf(Error::UnknownFileNameEncoding,  index+2 >= fileNameW.length(), "Invalid encoding");
-
-                            auto decoded = ConvertHex(fileNameW[++index]) * 16; // hi nibble
-                            decoded += ConvertHex(fileNameW[++index]); // low nibble
-
-                            if (sequenceIndex == 0)
-                            {
-                                if (decoded <= 0x7F)
-                                {   // Actually, because of EncodingToChar, 0x7F is the only case here. <= just in case...
-                                    codepoint = decoded;
-                                    done = true;
-                                }
-                                else if (decoded >= 0xC2 && decoded <= 0xF4)
-                                {   // decode and reset values for UTF-8 sequence
-                                    if ((decoded & 0xE0) == 0xC0) // 2 Byte sequence starts with 110y,yyyy
-                                    {
-                                        sequenceSize = 2;
-                                        codepoint = (decoded & 0x1F) << 6;
-                                        minNextSequenceValue = 0x80;
-                                        maxNextSequenceValue = 0xBF;
-                                    }
-                                    else if ((decoded & 0xF0) == 0xE0) // 3 Byte sequence starts with 1110,zzzz
-                                    {
-                                        sequenceSize = 3;
-                                        codepoint = (decoded & 0x0F) << 12;
-                                        minNextSequenceValue = (decoded == 0xE0 ? 0xA0 : 0x80);
-                                        maxNextSequenceValue = (decoded == 0xED ? 0x9F : 0xBF);
-                                    }
-                                    else if ((decoded & 0xF8) == 0xF0) // 4 Byte sequence starts with 1111,0uuu
-                                    {
-                                        sequenceSize = 4;
-                                        codepoint = ((decoded & 0x07) << 18);
-                                        minNextSequenceValue = (decoded == 0xF0 ? 0x90 : 0x80);
-                                        maxNextSequenceValue = (decoded == 0xF4 ? 0x8F : 0xBF);
-                                    }
-                                    else { ThrowError(Error::UnknownFileNameEncoding); }
-                                }
-                                else { ThrowError(Error::UnknownFileNameEncoding); }
-                            }
-                            else
-                            {   // continue UTF-8 sequence
-                                if (decoded >= minNextSequenceValue && decoded <= maxNextSequenceValue)
-                                {   // Adjust codepoint with new bits. Trailing bytes can only contain 6 bits of information
-                                    std::uint32_t shiftDistance = ((sequenceSize - sequenceIndex) - 1) * 6;
-                                    codepoint |= (decoded & 0x3F) << shiftDistance;
-
-                                    // Set values for next byte in sequence
-                                    minNextSequenceValue = 0x80;
-                                    maxNextSequenceValue = 0xBF;
-
-                                    // If full sequence then we're done!
-                                    if (sequenceSize == sequenceIndex + 1) { done = true; }
-                                }
-                                else { ThrowErrorAndLog(Error::UnknownFileNameEncoding, "Unexpected next sequence value"); }
-                            }
-
-                            if (!done)
-                            {   // We are not done! Point to the next % encoded UTF-8 seq
-                                sequenceIndex++;
-                                index++;
-                            }
-                        }
-                        else
-                        {   // We are looking for a % and we are not done. Abort!
-                            ThrowError(Error::UnknownFileNameEncoding);
-                        }
-                    }
-                    ValidateCodepoint(codepoint, sequenceSize);
-
-                    if (codepoint <= 0xFFFF) { result.push_back(codepoint); }
-                    else
-                    {   // Because of the expected range of codepoints [0x010000, 0x10FFFF], the
-                        // subtraction never underflows.  What you end up with is the 11 bits after
-                        // the first 10 of the codepoint minus 0x1000 OR'ed with 0xD800.  Since the
-                        // max for the codepoint is 0x10FFFF, the max for the 11 bits minus 0x1000
-                        // is 0x3FF (and the minimum is 0). OR'ed with D800 gives the range
-                        // [0xD800, 0xDBFF] which is the range of the high surrogate.
-                        wchar_t ch1 = ((codepoint & 0x00FC00) >> 10) |
-                                      (((codepoint & 0x1F0000) - 0x010000) >> 10) |
-                                      0x00D800;
-                        result.push_back(ch1);
-                        // Since the codepoint is AND'ed with 0x3FF (the bottom 10 bits of the
-                        // codepoint) and OR'ed with 0xDC00, the possible range is 0xDC00 through
-                        // 0xDFFF. This is exactly the range of the low surrogates.
-                        wchar_t ch2 = (codepoint & 0x0003FF) | 0x00DC00;
-                        result.push_back(ch2);
-                    }
+                    sequenceSize = 3;
+                    codepoint = (decoded & 0x0F) << 12;
+                    minNextSequenceValue = (decoded == 0xE0 ? 0xA0 : 0x80);
+                    maxNextSequenceValue = (decoded == 0xED ? 0x9F : 0xBF);
                 }
+                else if ((decoded & 0xF8) == 0xF0 && decoded <= 0xF4) // 4 Byte sequence starts with 1111,0uuu
+                {
+                    sequenceSize = 4;
+                    codepoint = ((decoded & 0x07) << 18);
+                    minNextSequenceValue = (decoded == 0xF0 ? 0x90 : 0x80);
+                    maxNextSequenceValue = (decoded == 0xF4 ? 0x8F : 0xBF);
+                }
+                else { ThrowError(Error::UnknownFileNameEncoding); }
+
+                // A sequence cut short by the end of the name keeps the bits decoded so far.
+                for (std::uint32_t sequenceIndex = 1; sequenceIndex < sequenceSize && index < size; sequenceIndex++)
+                {   // We are looking for a % and we are not done. Abort!
+                    ThrowErrorIf(Error::UnknownFileNameEncoding, data[index] != '%', "Incomplete UTF-8 sequence");
+                    decoded = DecodeHex(data, size, index);
+                    ThrowErrorIf(Error::UnknownFileNameEncoding, (decoded < minNextSequenceValue || decoded > maxNextSequenceValue),
+                        "Unexpected next sequence value");
+                    // Adjust codepoint with new bits. Trailing bytes can only contain 6 bits of information
+                    codepoint |= (decoded & 0x3F) << ((sequenceSize - sequenceIndex - 1) * 6);
+                    minNextSequenceValue = 0x80;
+                    maxNextSequenceValue = 0xBF;
+                }
+                ValidateCodepoint(codepoint, sequenceSize);
+                output += WriteUtf8(codepoint, output);
             }
-            else
-            {   result += fileNameW[index];
-            }
+            percent = static_cast<const char*>(std::memchr(data + index, '%', size - index));
         }
-        return wstring_to_utf8(result);
+        std::memcpy(output, data + index, size - index);
+        output += size - index;
+
+        buffer.resize(output - &buffer[0]);
+        // A decoded null character ends the name
+        buffer.resize(std::char_traits<char>::length(buffer.c_str()));
+        return buffer;
     }
 
     // Douglas Crockford's base 32 alphabet variant is 0-9, A-Z except for i, l, o, and u.
@@ -404,47 +393,10 @@ namespace MSIX { namespace Encoding {
         return std::string(output);
     }
 
-    const std::uint8_t base64DecoderRing[128] =
-    {
-        /*    0-15 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-        /*   16-31 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-        /*   32-47 */ 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,   62, 0xFF, 0xFF, 0xFF,   63,
-        /*   48-63 */   52,   53,   54,   55,   56,   57,   58,   59,   60,   61, 0xFF, 0xFF, 0xFF,   64, 0xFF, 0xFF,
-        /*   64-79 */ 0xFF,    0,    1,    2,    3,    4,    5,    6,    7,    8,    9,   10,   11,   12,   13,   14,
-        /*   80-95 */   15,   16,   17,   18,   19,   20,   21,   22,   23,   24,   25, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-        /*  96-111 */ 0xFF,   26,   27,   28,   29,   30,   31,   32,   33,   34,   35,   36,   37,   38,   39,   40,
-        /* 112-127 */   41,   42,   43,   44,   45,   46,   47,   48,   49,   50,   51, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
-    };
-
     std::vector<std::uint8_t> GetBase64DecodedValue(const std::string& value)
     {
-        std::vector<std::uint8_t> result;
-
-        ThrowErrorIfNot(Error::InvalidParameter, (0 == (value.length() % 4)), "invalid base64 encoding");
-        for(std::size_t index=0; index < value.length(); index += 4)
-        {
-            ThrowErrorIf(Error::InvalidParameter,(
-            (value[index+0] | value[index+1] | value[index+2] | value[index+3]) >= 128
-            ), "invalid base64 encoding");
-
-            auto v1 = base64DecoderRing[value[index+0]];
-            auto v2 = base64DecoderRing[value[index+1]];
-            auto v3 = base64DecoderRing[value[index+2]];
-            auto v4 = base64DecoderRing[value[index+3]];
-
-            ThrowErrorIf(Error::InvalidParameter,(((v1 | v2) >= 64) || ((v3 | v4) == 0xFF)), "first two chars of a four char base64 sequence can't be ==, and must be valid");
-            ThrowErrorIf(Error::InvalidParameter,(v3 == 64 && v4 != 64), "if the third char is = then the fourth char must be =");
-            std::size_t byteCount = (v4 != 64 ? 3 : (v3 != 64 ? 2 : 1));
-            result.push_back(static_cast<std::uint8_t>(((v1 << 2) | ((v2 >> 4) & 0x03))));
-            if (byteCount >1)
-            {
-                result.push_back(static_cast<std::uint8_t>(((v2 << 4) | ((v3 >> 2) & 0x0F)) & 0xFF));
-                if (byteCount >2)
-                {
-                    result.push_back(static_cast<std::uint8_t>(((v3 << 6) | ((v4 >> 0) & 0x3F)) & 0xFF));
-                }
-            }
-        }
+        std::vector<std::uint8_t> result(Base64::GetMaxDecodedSize(value.size()));
+        result.resize(Base64::Decode(value.data(), value.size(), result.data()));
         return result;
     }
 
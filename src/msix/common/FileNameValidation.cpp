@@ -32,100 +32,43 @@ namespace MSIX {
             false, false, false, false, true                        // character |
         };
 
-        const std::string ProhibitedFileNames[] = {
-            ".",
-            "..",
-            "con",
-            "prn",
-            "aux",
-            "nul",
-            "com1",
-            "com2",
-            "com3",
-            "com4",
-            "com5",
-            "com6",
-            "com7",
-            "com8",
-            "com9",
-            "lpt1",
-            "lpt2",
-            "lpt3",
-            "lpt4",
-            "lpt5",
-            "lpt6",
-            "lpt7",
-            "lpt8",
-            "lpt9",
-        };
-
-        // Caller must pass in a lowercase string!
-        bool IsProhibitedFileName(const std::string& identifier)
+        char ToLowerAscii(char c)
         {
-            for (const auto& name : ProhibitedFileNames)
-            {
-                if (identifier == name)
-                {
-                    return true;
-                }
-            }
-            return false;
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
         }
 
-        const std::string ProhibitedPrefixes[] = {
-            "con.",
-            "prn.",
-            "aux.",
-            "nul.",
-            "com1.",
-            "com2.",
-            "com3.",
-            "com4.",
-            "com5.",
-            "com6.",
-            "com7.",
-            "com8.",
-            "com9.",
-            "lpt1.",
-            "lpt2.",
-            "lpt3.",
-            "lpt4.",
-            "lpt5.",
-            "lpt6.",
-            "lpt7.",
-            "lpt8.",
-            "lpt9.",
-            "xn--",
-        };
-
-        bool HasProhibitedPrefix(const std::string& identifier)
+        // Case insensitive compare of the start of the identifier with a lower case ASCII string
+        bool StartsWith(const std::string& identifier, const char* prefix, std::size_t size)
         {
-            for (const auto& prefix : ProhibitedPrefixes)
+            if (identifier.size() < size)
+            {
+                return false;
+            }
+            for (std::size_t i = 0; i < size; i++)
             {
-                if (identifier.size() >= prefix.size() &&
-                    identifier.substr(0, prefix.size()) == prefix)
+                if (ToLowerAscii(identifier[i]) != prefix[i])
                 {
-                    return true;
+                    return false;
                 }
             }
-            return false;
+            return true;
         }
 
-        const std::string ProhibitedSuffixes[] = {
-            ".",
-        };
-
-        bool HasProhibitedSuffix(const std::string& identifier)
+        // Returns the size of the device name (con, prn, aux, nul, com1-com9 or lpt1-lpt9) the identifier starts with,
+        // or 0 if it doesn't start with one.
+        std::size_t GetDeviceNameSize(const std::string& identifier)
         {
-            for (const auto& suffix : ProhibitedSuffixes)
+            if (StartsWith(identifier, "con", 3) || StartsWith(identifier, "prn", 3) ||
+                StartsWith(identifier, "aux", 3) || StartsWith(identifier, "nul", 3))
             {
-                if (identifier.size() >= suffix.size() &&
-                    identifier.substr(identifier.size() - suffix.size()) == suffix)
-                {
-                    return true;
-                }
+                return 3;
             }
-            return false;
+            if ((StartsWith(identifier, "com", 3) || StartsWith(identifier, "lpt", 3)) &&
+                identifier.size() > 3 && identifier[3] >= '1' && identifier[3] <= '9')
+            {
+                return 4;
+            }
+            return 0;
         }
 
         constexpr wchar_t highSurrogateStart = 0xd800;
@@ -284,8 +227,18 @@ namespace MSIX {
 
     bool FileNameValidation::IsIdentifierValid(const std::string& identifier)
     {
-        std::string lowSegment = Helper::tolower(identifier);
-        return !IsProhibitedFileName(lowSegment) && !HasProhibitedPrefix(lowSegment) && !HasProhibitedSuffix(lowSegment);
+        // Prohibited are ".", "..", device names alone or followed by an extension, names starting with "xn--" and
+        // names ending with a dot.
+        if (identifier.empty())
+        {
+            return true;
+        }
+        if (identifier.back() == '.' || StartsWith(identifier, "xn--", 4))
+        {
+            return false;
+        }
+        auto deviceNameSize = GetDeviceNameSize(identifier);
+        return (deviceNameSize == 0) || (identifier.size() > deviceNameSize && identifier[deviceNameSize] != '.');
     }
 
     bool FileNameValidation::IsFootPrintFile(const std::string& fileName, bool isBundle)
@@ -64,10 +64,10 @@ static const MSIX::XmlQueryNameCharType* xPaths[] = {
     /* Package_Properties_SupportedUsers             */L"/*[local-name()='Package']/*[local-name()='Properties']/*[local-name()='SupportedUsers']",
     /* Package_Capabilities_CustomCapability         */L"/*[local-name()='Package']/*[local-name()='Capabilities']/*[local-name()='CustomCapability']",
 };
-#else
+#endif
 
-// must remain in same order as XmlQueryName
-static const MSIX::XmlQueryNameCharType* xPaths[] = {
+// must remain in same order as XmlQueryName. Used by the parsers without XPath support.
+static const char* queryPaths[] = {
     /* Package_Identity                              */"/Package/Identity",
     /* BlockMap_File                                 */"/BlockMap/File",
     /* Child_Block                                   */"./Block",
@@ -97,13 +97,16 @@ static const MSIX::XmlQueryNameCharType* xPaths[] = {
     /* Package_Properties_SupportedUsers             */"/Package/Properties/SupportedUsers",
     /* Package_Capabilities_CustomCapability         */"/Package/Capabilities/CustomCapability",
 };
-#endif
 
 namespace MSIX {
 
     const XmlQueryNameCharType* GetQueryString(XmlQueryName query)
     {
+#ifdef USING_MSXML
         return xPaths[static_cast<std::underlying_type_t<XmlQueryName>>(query)];
+#else
+        return queryPaths[static_cast<std::underlying_type_t<XmlQueryName>>(query)];
+#endif
     }
 
     std::string GetQueryStringUtf8(XmlQueryName query)
@@ -115,6 +118,49 @@ namespace MSIX {
 #endif
     }
 
+    std::size_t GetQueryCount()
+    {
+        return std::extent<decltype(queryPaths)>::value;
+    }
+
+    XmlQueryPath ParseQueryPath(const std::string& path)
+    {
+        XmlQueryPath result;
+        std::size_t start = 0;
+        if (path.compare(0, 2, "./") == 0)
+        {
+            start = 2;
+        }
+        else if (path.compare(0, 1, "/") == 0)
+        {
+            result.fromRoot = true;
+            start = 1;
+        }
+        while (start <= path.size())
+        {
+            std::size_t end = path.find('/', start);
+            if (end == std::string::npos) { end = path.size(); }
+            ThrowErrorIf(Error::InvalidParameter, end == start, "Empty step in query path");
+            result.steps.push_back(path.substr(start, end - start));
+            start = end + 1;
+        }
+        return result;
+    }
+
+    const XmlQueryPath& GetQueryPath(XmlQueryName query)
+    {
+        static const std::vector<XmlQueryPath> paths = []()
+        {
+            std::vector<XmlQueryPath> result;
+            for (const auto& path : queryPaths)
+            {
+                result.push_back(ParseQueryPath(path));
+            }
+            return result;
+        }();
+        return paths[static_cast<std::underlying_type_t<XmlQueryName>>(query)];
+    }
+
     std::wstring GetAttributeNameString(XmlAttributeName attr)
     {
         return utf8_to_wstring(GetAttributeNameStringUtf8(attr));
@@ -125,4 +171,9 @@ namespace MSIX {
         return attributeNames[static_cast<std::underlying_type_t<XmlAttributeName>>(attr)];
     }
 
+    std::size_t GetAttributeNameCount()
+    {
+        return std::extent<decltype(attributeNames)>::value;
+    }
+
 }
@@ -4,12 +4,24 @@
 // 
 #include "Log.hpp"
 #include <sstream>
+#include <mutex>
+#include <utility>
 
 namespace MSIX { namespace Global { namespace Log {
 static std::stringstream g_content;
+static std::mutex g_lock;
+static thread_local std::vector<std::string>* t_capture = nullptr;
 
-void Append(const std::string& comment) { ((!comment.empty()) ? g_content << '\n' : g_content) << comment; }
-std::string Text() { return g_content.str(); }
-void Clear() { g_content.str(""), g_content.clear(); }
+void Append(const std::string& comment)
+{
+    if (t_capture != nullptr) { t_capture->push_back(comment); return; }
+    std::lock_guard<std::mutex> lock(g_lock);
+    ((!comment.empty()) ? g_content << '\n' : g_content) << comment;
+}
+std::string Text() { std::lock_guard<std::mutex> lock(g_lock); return g_content.str(); }
+void Clear() { std::lock_guard<std::mutex> lock(g_lock); g_content.str(""), g_content.clear(); }
+
+std::vector<std::string>* BeginThreadCapture(std::vector<std::string>* capture) { std::swap(t_capture, capture); return capture; }
+void EndThreadCapture(std::vector<std::string>* previous) { t_capture = previous; }
 
 } /* log */ } /* Global */ } /* msix */
\ No newline at end of file
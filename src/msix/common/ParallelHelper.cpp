@@ -0,0 +1,106 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "ParallelHelper.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#ifdef WIN32
+#include <objbase.h>
+#endif
+
+namespace MSIX { namespace Helper {
+
+    std::size_t GetWorkerCount(std::size_t tasks)
+    {
+        #ifdef USING_JAVAXML
+        // The java parser is used through JNI and the worker threads are not attached to the VM.
+        return (tasks > 0) ? 1 : 0;
+        #else
+        std::size_t hardware = static_cast<std::size_t>(std::thread::hardware_concurrency());
+        return std::min(tasks, std::max<std::size_t>(hardware, 1));
+        #endif
+    }
+
+    ParallelTaskResult RunCaptured(const std::function<void()>& task)
+    {
+        ParallelTaskResult result;
+        auto previousCapture = Global::Log::BeginThreadCapture(&result.log);
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            result.error = std::current_exception();
+        }
+        Global::Log::EndThreadCapture(previousCapture);
+        return result;
+    }
+
+    std::vector<ParallelTaskResult> ParallelFor(std::size_t count, const std::function<void(std::size_t)>& task)
+    {
+        std::vector<ParallelTaskResult> results(count);
+        std::atomic<std::size_t> next(0);
+
+        auto worker = [&]()
+        {
+            #ifdef WIN32
+            // msxml6 is used through COM
+            bool coInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+            #endif
+            for (std::size_t index = next++; index < count; index = next++)
+            {
+                results[index] = RunCaptured([&]() { task(index); });
+            }
+            #ifdef WIN32
+            if (coInitialized) { CoUninitialize(); }
+            #endif
+        };
+
+        // The calling thread is one of the workers, so nothing is started for a single task.
+        std::vector<std::thread> threads;
+        std::size_t workers = GetWorkerCount(count);
+        for (std::size_t i = 1; i < workers; i++)
+        {
+            try
+            {
+                threads.emplace_back(worker);
+            }
+            catch (...)
+            {   // Couldn't start another thread, the ones already running take its share.
+                break;
+            }
+        }
+        worker();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+        return results;
+    }
+
+    void MergeParallelResults(std::vector<ParallelTaskResult>& results)
+    {
+        for (auto& result : results)
+        {
+            MergeParallelResult(result);
+        }
+    }
+
+    void MergeParallelResult(ParallelTaskResult& result)
+    {
+        for (const auto& comment : result.log)
+        {
+            Global::Log::Append(comment);
+        }
+        if (result.error)
+        {
+            std::rethrow_exception(result.error);
+        }
+    }
+} /* Helper */ } /* MSIX */
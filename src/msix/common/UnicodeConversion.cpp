@@ -2,70 +2,350 @@
 //  Copyright (C) 2017 Microsoft.  All rights reserved.
 //  See LICENSE file in the project root for full license information.
 // 
-#include <memory>
-#include <iostream>
-#include <sstream>
-
-#ifdef WIN32
-#include <windows.h>
-#include <stringapiset.h>
-#endif
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
 
 #include "UnicodeConversion.hpp"
 #include "Exceptions.hpp"
 
+// SSE2 is part of the x64 baseline, so the ASCII kernels don't need runtime detection.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MSIX_UNICODE_SSE2 1
+#include <emmintrin.h>
+#endif
+
 namespace MSIX {
 
+    namespace {
+
+        // Code units of 2 bytes are UTF-16 and of 4 bytes UTF-32. Dispatching on the size lets wchar_t share the
+        // implementation without casting between character types.
+        template <typename T>
+        using UnitSize = std::integral_constant<std::size_t, sizeof(T)>;
+        using Utf16 = std::integral_constant<std::size_t, 2>;
+        using Utf32 = std::integral_constant<std::size_t, 4>;
+
+        // Widens the leading ASCII characters of data into output. Returns how many were converted.
+        template <typename T>
+        std::size_t WidenAscii(const std::uint8_t* data, std::size_t size, T* output)
+        {
+            std::size_t i = 0;
+            #if defined(MSIX_UNICODE_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= size; i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                if (_mm_movemask_epi8(bytes) != 0) { break; }
+                __m128i low = _mm_unpacklo_epi8(bytes, zero);
+                __m128i high = _mm_unpackhi_epi8(bytes, zero);
+                __m128i* out = reinterpret_cast<__m128i*>(output + i);
+                if (sizeof(T) == 2)
+                {
+                    _mm_storeu_si128(out, low);
+                    _mm_storeu_si128(out + 1, high);
+                }
+                else
+                {
+                    _mm_storeu_si128(out, _mm_unpacklo_epi16(low, zero));
+                    _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(low, zero));
+                    _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(high, zero));
+                    _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(high, zero));
+                }
+            }
+            #else
+            for (; i + 8 <= size; i += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + i, sizeof(word));
+                if ((word & 0x8080808080808080ull) != 0) { break; }
+                for (std::size_t j = 0; j < 8; j++) { output[i + j] = static_cast<T>(data[i + j]); }
+            }
+            #endif
+            for (; i < size && data[i] < 0x80; i++) { output[i] = static_cast<T>(data[i]); }
+            return i;
+        }
+
+        // Returns the number of leading ASCII characters of data
+        std::size_t CountAscii(const std::uint8_t* data, std::size_t size)
+        {
+            std::size_t i = 0;
+            #if defined(MSIX_UNICODE_SSE2)
+            for (; i + 16 <= size; i += 16)
+            {
+                if (_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i))) != 0) { break; }
+            }
+            #else
+            for (; i + 8 <= size; i += 8)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + i, sizeof(word));
+                if ((word & 0x8080808080808080ull) != 0) { break; }
+            }
+            #endif
+            for (; i < size && data[i] < 0x80; i++) {}
+            return i;
+        }
+
+        // Narrows the leading ASCII characters of data into output. Returns how many were converted.
+        template <typename T>
+        std::size_t NarrowAscii(const T* data, std::size_t size, char* output)
+        {
+            std::size_t i = 0;
+            #if defined(MSIX_UNICODE_SSE2)
+            const __m128i zero = _mm_setzero_si128();
+            if (sizeof(T) == 2)
+            {
+                const __m128i nonAscii = _mm_set1_epi16(static_cast<short>(0xFF80));
+                for (; i + 8 <= size; i += 8)
+                {
+                    __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), zero)) != 0xFFFF) { break; }
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(units, units));
+                }
+            }
+            else
+            {
+                const __m128i nonAscii = _mm_set1_epi32(static_cast<int>(0xFFFFFF80));
+                for (; i + 8 <= size; i += 8)
+                {
+                    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 4));
+                    if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(_mm_or_si128(low, high), nonAscii), zero)) != 0xFFFF) { break; }
+                    __m128i words = _mm_packs_epi32(low, high);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(output + i), _mm_packus_epi16(words, words));
+                }
+            }
+            #endif
+            for (; i < size && static_cast<std::uint32_t>(data[i]) < 0x80; i++) { output[i] = static_cast<char>(data[i]); }
+            return i;
+        }
+
+        // Decodes the multi-byte sequence at data[i] and advances i past it.
+        char32_t DecodeUtf8(const std::uint8_t* data, std::size_t size, std::size_t& i)
+        {
+            std::uint8_t lead = data[i];
+            std::size_t length;
+            char32_t codePoint;
+            // Restricting the second byte rejects overlong encodings, surrogates and values above 10FFFF
+            std::uint8_t lower = 0x80;
+            std::uint8_t upper = 0xBF;
+            if (lead >= 0xC2 && lead <= 0xDF)
+            {
+                length = 2;
+                codePoint = lead & 0x1F;
+            }
+            else if (lead >= 0xE0 && lead <= 0xEF)
+            {
+                length = 3;
+                codePoint = lead & 0x0F;
+                if (lead == 0xE0) { lower = 0xA0; }
+                else if (lead == 0xED) { upper = 0x9F; }
+            }
+            else if (lead >= 0xF0 && lead <= 0xF4)
+            {
+                length = 4;
+                codePoint = lead & 0x07;
+                if (lead == 0xF0) { lower = 0x90; }
+                else if (lead == 0xF4) { upper = 0x8F; }
+            }
+            else
+            {
+                ThrowErrorAndLog(Error::Unexpected, "Invalid UTF-8 lead byte");
+            }
+            ThrowErrorIf(Error::Unexpected, size - i < length, "Truncated UTF-8 sequence");
+            for (std::size_t j = 1; j < length; j++)
+            {
+                std::uint8_t next = data[i + j];
+                ThrowErrorIf(Error::Unexpected, next < lower || next > upper, "Invalid UTF-8 continuation byte");
+                codePoint = (codePoint << 6) | (next & 0x3F);
+                lower = 0x80;
+                upper = 0xBF;
+            }
+            i += length;
+            return codePoint;
+        }
+
+        // Reads the non-ASCII code point at data[i] and advances i past it.
+        template <typename T>
+        char32_t ReadCodePoint(const T* data, std::size_t size, std::size_t& i, Utf16)
+        {
+            char32_t unit = static_cast<char16_t>(data[i++]);
+            if (unit < 0xD800 || unit > 0xDFFF) { return unit; }
+            ThrowErrorIf(Error::Unexpected, unit > 0xDBFF, "Unexpected UTF-16 low surrogate");
+            ThrowErrorIf(Error::Unexpected, i == size, "Incomplete UTF-16 surrogate pair");
+            char32_t low = static_cast<char16_t>(data[i]);
+            ThrowErrorIf(Error::Unexpected, low < 0xDC00 || low > 0xDFFF, "Incomplete UTF-16 surrogate pair");
+            i++;
+            return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+        }
+
+        template <typename T>
+        char32_t ReadCodePoint(const T* data, std::size_t, std::size_t& i, Utf32)
+        {
+            char32_t codePoint = static_cast<char32_t>(data[i++]);
+            ThrowErrorIf(Error::Unexpected, codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF), "Invalid UTF-32 code point");
+            return codePoint;
+        }
+
+        // Writes a non-ASCII code point. Returns the number of code units written.
+        template <typename T>
+        std::size_t WriteCodePoint(char32_t codePoint, T* output, Utf16)
+        {
+            if (codePoint < 0x10000)
+            {
+                output[0] = static_cast<T>(codePoint);
+                return 1;
+            }
+            codePoint -= 0x10000;
+            output[0] = static_cast<T>(0xD800 + (codePoint >> 10));
+            output[1] = static_cast<T>(0xDC00 + (codePoint & 0x3FF));
+            return 2;
+        }
+
+        template <typename T>
+        std::size_t WriteCodePoint(char32_t codePoint, T* output, Utf32)
+        {
+            output[0] = static_cast<T>(codePoint);
+            return 1;
+        }
+
+        std::size_t EncodeUtf8(char32_t codePoint, char* output)
+        {
+            if (codePoint < 0x800)
+            {
+                output[0] = static_cast<char>(0xC0 | (codePoint >> 6));
+                output[1] = static_cast<char>(0x80 | (codePoint & 0x3F));
+                return 2;
+            }
+            if (codePoint < 0x10000)
+            {
+                output[0] = static_cast<char>(0xE0 | (codePoint >> 12));
+                output[1] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+                output[2] = static_cast<char>(0x80 | (codePoint & 0x3F));
+                return 3;
+            }
+            output[0] = static_cast<char>(0xF0 | (codePoint >> 18));
+            output[1] = static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+            output[2] = static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+            output[3] = static_cast<char>(0x80 | (codePoint & 0x3F));
+            return 4;
+        }
+
+        template <typename T>
+        std::size_t FromUtf8(const char* data, std::size_t size, T* output)
+        {
+            auto bytes = reinterpret_cast<const std::uint8_t*>(data);
+            std::size_t i = 0;
+            std::size_t written = 0;
+            while (i < size)
+            {
+                std::size_t ascii = WidenAscii(bytes + i, size - i, output + written);
+                i += ascii;
+                written += ascii;
+                if (i == size) { break; }
+                written += WriteCodePoint(DecodeUtf8(bytes, size, i), output + written, UnitSize<T>{});
+            }
+            return written;
+        }
+
+        template <typename T>
+        std::size_t ToUtf8(const T* data, std::size_t size, char* output)
+        {
+            std::size_t i = 0;
+            std::size_t written = 0;
+            while (i < size)
+            {
+                std::size_t ascii = NarrowAscii(data + i, size - i, output + written);
+                i += ascii;
+                written += ascii;
+                if (i == size) { break; }
+                written += EncodeUtf8(ReadCodePoint(data, size, i, UnitSize<T>{}), output + written);
+            }
+            return written;
+        }
+
+        // Length up to the first null character. std::char_traits<char16_t>::length checks one unit at a time, this
+        // checks four. Only a zero unit sets the high bit of its lane before any borrow, so the first hit is exact.
+        std::size_t Length(const std::u16string& value)
+        {
+            const char16_t* data = value.data();
+            std::size_t size = value.size();
+            std::size_t i = 0;
+            for (; i + 4 <= size; i += 4)
+            {
+                std::uint64_t word;
+                std::memcpy(&word, data + i, sizeof(word));
+                if (((word - 0x0001000100010001ull) & ~word & 0x8000800080008000ull) != 0) { break; }
+            }
+            for (; i < size && data[i] != 0; i++) {}
+            return i;
+        }
+    }
+
+    std::size_t Unicode::Utf8ToUtf16(const char* data, std::size_t size, char16_t* output) { return FromUtf8(data, size, output); }
+    std::size_t Unicode::Utf8ToUtf32(const char* data, std::size_t size, char32_t* output) { return FromUtf8(data, size, output); }
+    std::size_t Unicode::Utf8ToWide(const char* data, std::size_t size, wchar_t* output) { return FromUtf8(data, size, output); }
+    std::size_t Unicode::Utf16ToUtf8(const char16_t* data, std::size_t size, char* output) { return ToUtf8(data, size, output); }
+    std::size_t Unicode::Utf32ToUtf8(const char32_t* data, std::size_t size, char* output) { return ToUtf8(data, size, output); }
+    std::size_t Unicode::WideToUtf8(const wchar_t* data, std::size_t size, char* output) { return ToUtf8(data, size, output); }
+
+    void Unicode::ValidateUtf8(const char* data, std::size_t size)
+    {
+        auto bytes = reinterpret_cast<const std::uint8_t*>(data);
+        std::size_t i = 0;
+        while (i < size)
+        {
+            i += CountAscii(bytes + i, size - i);
+            if (i == size) { break; }
+            DecodeUtf8(bytes, size, i);
+        }
+    }
+
     StringType utf8_to_utf16(const std::string& utf8string)
     {
-        return StringConvert{}.from_bytes(utf8string.data());
+        auto size = std::char_traits<char>::length(utf8string.c_str());
+        StringType result(Unicode::GetMaxUtf16Size(size), 0);
+        result.resize(FromUtf8(utf8string.data(), size, &result[0]));
+        return result;
     }
 
     std::wstring utf8_to_wstring(const std::string& utf8string)
     {
-        if (utf8string.empty()) { return {}; }
-        #ifdef WIN32
-        int size = MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, utf8string.data(), static_cast<int>(utf8string.size()), nullptr, 0);
-        ThrowLastErrorIf(size == 0, "Error converting to wstring");
-        std::wstring result(size, 0);
-        MultiByteToWideChar(CP_UTF8, MB_ERR_INVALID_CHARS, utf8string.data(), static_cast<int>(utf8string.size()), &result[0], size);
-        #else
-        auto converted = utf8_to_utf16(utf8string);
-        std::wstring result(converted.begin(), converted.end());
-        #endif
+        auto size = std::char_traits<char>::length(utf8string.c_str());
+        std::wstring result(Unicode::GetMaxWideSize(size), 0);
+        result.resize(Unicode::Utf8ToWide(utf8string.data(), size, &result[0]));
         return result;
     }
 
     std::u16string utf8_to_u16string(const std::string& utf8string)
     {
-        auto converted = utf8_to_utf16(utf8string);
-        std::u16string result(converted.begin(), converted.end());
+        auto size = std::char_traits<char>::length(utf8string.c_str());
+        std::u16string result(Unicode::GetMaxUtf16Size(size), 0);
+        result.resize(Unicode::Utf8ToUtf16(utf8string.data(), size, &result[0]));
         return result;
     }
 
     std::string wstring_to_utf8(const std::wstring& utf16string)
     {
-        if (utf16string.empty()) { return {}; }
-        #ifdef WIN32
-        int size = WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, utf16string.data(), static_cast<int>(utf16string.size()), nullptr, 0, nullptr, nullptr);
-        ThrowLastErrorIf(size == 0, "Error converting to string");
-        std::string result(size, 0);
-        WideCharToMultiByte(CP_UTF8, WC_ERR_INVALID_CHARS, utf16string.data(), static_cast<int>(utf16string.size()), &result[0], size, nullptr, nullptr);
-        #else
-        auto result = std::wstring_convert<std::codecvt_utf8<wchar_t>>{}.to_bytes(utf16string.data());
-        #endif
+        return wstring_to_utf8(utf16string.c_str());
+    }
+
+    std::string wstring_to_utf8(const wchar_t* utf16string)
+    {
+        ThrowErrorIfNot(Error::InvalidParameter, utf16string, "Invalid string");
+        auto size = std::char_traits<wchar_t>::length(utf16string);
+        std::string result(Unicode::GetMaxUtf8SizeFromWide(size), 0);
+        result.resize(Unicode::WideToUtf8(utf16string, size, &result[0]));
         return result;
     }
 
     std::string u16string_to_utf8(const std::u16string& utf16string)
     {
-        #ifdef WIN32
-        std::wstring intermediate(utf16string.begin(), utf16string.end());
-        auto result = wstring_to_utf8(intermediate);
-        #else
-        auto result = StringConvert{}.to_bytes(utf16string.data());
-        #endif
+        auto size = Length(utf16string);
+        std::string result(Unicode::GetMaxUtf8SizeFromUtf16(size), 0);
+        result.resize(Unicode::Utf16ToUtf8(utf16string.data(), size, &result[0]));
         return result;
     }
 
-} // namespace MSIX
\ No newline at end of file
+} // namespace MSIX
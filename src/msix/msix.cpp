@@ -24,6 +24,13 @@
 #include "MappingFileParser.hpp"
 #include "FileStream.hpp"
 #include "VectorStream.hpp"
+#include "TarDirectoryObject.hpp"
+#include "PackStatistics.hpp"
+
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
 
 #ifndef WIN32
 // on non-win32 platforms, compile with -fvisibility=hidden
@@ -194,6 +201,68 @@ MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackageFromStream(
     return static_cast<HRESULT>(MSIX::Error::OK);
 } CATCH_RETURN();
 
+MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackageToTar(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8SourcePackage,
+    char* utf8TarFile) noexcept try
+{
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter,
+        (utf8SourcePackage != nullptr && utf8TarFile != nullptr),
+        "Invalid parameters"
+    );
+
+    MSIX::ComPtr<IStream> stream;
+    ThrowHrIfFailed(CreateStreamOnFile(utf8SourcePackage, true, &stream));
+
+    MSIX::ComPtr<IAppxFactory> factory;
+    ThrowHrIfFailed(CoCreateAppxFactoryWithHeap(InternalAllocate, InternalFree, validationOption, &factory));
+
+    MSIX::ComPtr<IAppxPackageReader> reader;
+    ThrowHrIfFailed(factory->CreatePackageReader(stream.Get(), &reader));
+
+    MSIX::ComPtr<IStream> tarStream;
+    if (std::string(utf8TarFile) == "-")
+    {
+        #ifdef WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+        #endif
+        tarStream = MSIX::ComPtr<IStream>::Make<MSIX::FileStream>(stdout, "stdout");
+    }
+    else
+    {
+        ThrowHrIfFailed(CreateStreamOnFile(utf8TarFile, false, &tarStream));
+    }
+
+    ThrowHrIfFailed(UnpackPackageFromPackageReaderToTarStream(packUnpackOptions, reader.Get(), tarStream.Get()));
+    return static_cast<HRESULT>(MSIX::Error::OK);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE UnpackPackageFromPackageReaderToTarStream(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    IAppxPackageReader* packageReader,
+    IStream* tarStream) noexcept try
+{
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter,
+        (packageReader != nullptr && tarStream != nullptr),
+        "Invalid parameters"
+    );
+
+    MSIX::ComPtr<IPackage> package;
+    ThrowHrIfFailed(packageReader->QueryInterface(UuidOfImpl<IPackage>::iid, reinterpret_cast<void**>(&package)));
+
+    auto to = MSIX::ComPtr<ITarDirectoryObject>::Make<MSIX::TarDirectoryObject>(tarStream);
+    auto abort = MSIX::scope_exit([&to]
+    {
+        to->Abort(MSIX::Global::Log::Text());
+    });
+
+    package->Unpack(packUnpackOptions, to.As<IDirectoryObject>());
+    to->Close();
+    abort.release();
+    return static_cast<HRESULT>(MSIX::Error::OK);
+} CATCH_RETURN();
+
 MSIX_API HRESULT STDMETHODCALLTYPE UnpackBundle(
     MSIX_PACKUNPACK_OPTION packUnpackOptions,
     MSIX_VALIDATION_OPTION validationOption,
@@ -260,11 +329,52 @@ MSIX_API HRESULT STDMETHODCALLTYPE UnpackBundleFromStream(
 
 #ifdef MSIX_PACK
 
+namespace {
+    // "-" is stdout. The package is written from start to end without seeking back, so it can be a pipe.
+    MSIX::ComPtr<IStream> CreateOutputPackageStream(char* outputPackage)
+    {
+        MSIX::ComPtr<IStream> stream;
+        if (std::string(outputPackage) == "-")
+        {
+            #ifdef WIN32
+            _setmode(_fileno(stdout), _O_BINARY);
+            #endif
+            stream = MSIX::ComPtr<IStream>::Make<MSIX::FileStream>(stdout, "stdout");
+        }
+        else
+        {
+            ThrowHrIfFailed(CreateStreamOnFile(outputPackage, false, &stream));
+        }
+        return stream;
+    }
+
+    void DeleteOutputPackage(char* outputPackage)
+    {
+        if (std::string(outputPackage) != "-")
+        {
+            remove(outputPackage);
+        }
+    }
+}
+
 MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
     MSIX_PACKUNPACK_OPTION packUnpackOptions,
     MSIX_VALIDATION_OPTION validationOption,
     char* directoryPath,
     char* outputPackage
+) noexcept
+{
+    return PackPackageWithBlockCache(packUnpackOptions, validationOption, directoryPath, outputPackage, nullptr, nullptr, 0);
+}
+
+MSIX_API HRESULT STDMETHODCALLTYPE PackPackageWithBlockCache(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* directoryPath,
+    char* outputPackage,
+    char* utf8CacheDirectory,
+    char* utf8SeedPackage,
+    UINT64 cacheSizeLimit
 ) noexcept try
 {
     ThrowErrorIfNot(MSIX::Error::InvalidParameter, 
@@ -275,21 +385,89 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackPackage(
     // PackPackage assumes AppxManifest.xml to be in the directory provided.
     auto manifest = from.As<IStorageObject>()->GetFile(MSIX::footprintFiles[APPX_FOOTPRINT_FILE_TYPE_MANIFEST]);
 
+    MSIX::ComPtr<IAppxFactory> factory;
+    ThrowHrIfFailed(CoCreateAppxFactoryWithHeap(InternalAllocate, InternalFree, validationOption, &factory));
+
+    // The seed package is read before the output is created, it can be the same file.
+    std::shared_ptr<MSIX::BlockCache> cache;
+    MSIX::ComPtr<IDirectoryObject> cacheDirectory;
+    if (utf8CacheDirectory != nullptr || utf8SeedPackage != nullptr)
+    {
+        cache = std::make_shared<MSIX::BlockCache>((cacheSizeLimit == 0) ? MSIX::DefaultBlockCacheSizeLimit : cacheSizeLimit);
+        if (utf8CacheDirectory != nullptr)
+        {
+            cacheDirectory = MSIX::ComPtr<IDirectoryObject>::Make<MSIX::DirectoryObject>(utf8CacheDirectory, true);
+            cache->Load(cacheDirectory);
+        }
+        if (utf8SeedPackage != nullptr)
+        {
+            MSIX::ComPtr<IStream> seed;
+            ThrowHrIfFailed(CreateStreamOnFile(utf8SeedPackage, true, &seed));
+            cache->Seed(factory.As<IMsixFactory>().Get(), seed);
+        }
+    }
+
     auto deleteFile = MSIX::scope_exit([&outputPackage]
     {
-        remove(outputPackage);
+        DeleteOutputPackage(outputPackage);
     });
 
-    MSIX::ComPtr<IStream> stream;
-    ThrowHrIfFailed(CreateStreamOnFile(outputPackage, false, &stream));
+    auto stream = CreateOutputPackageStream(outputPackage);
+
+    MSIX::ComPtr<IAppxPackageWriter> writer;
+    ThrowHrIfFailed(factory->CreatePackageWriter(stream.Get(), nullptr, &writer));
+    writer.As<IPackageWriter>()->SetBlockCache(cache);
+    writer.As<IPackageWriter>()->PackPayloadFiles(from);
+    ThrowHrIfFailed(writer->Close(manifest.Get()));
+    deleteFile.release();
+    if (cacheDirectory)
+    {
+        cache->Save(cacheDirectory);
+    }
+    return static_cast<HRESULT>(MSIX::Error::OK);
+} CATCH_RETURN();
+
+MSIX_API HRESULT STDMETHODCALLTYPE PackPackageFromTar(
+    MSIX_PACKUNPACK_OPTION packUnpackOptions,
+    MSIX_VALIDATION_OPTION validationOption,
+    char* utf8TarFile,
+    char* outputPackage
+) noexcept try
+{
+    ThrowErrorIfNot(MSIX::Error::InvalidParameter,
+        (utf8TarFile != nullptr && outputPackage != nullptr),
+        "Invalid parameters");
+
+    MSIX::ComPtr<IStream> tarStream;
+    if (std::string(utf8TarFile) == "-")
+    {
+        #ifdef WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+        #endif
+        tarStream = MSIX::ComPtr<IStream>::Make<MSIX::FileStream>(stdin, "stdin");
+    }
+    else
+    {
+        ThrowHrIfFailed(CreateStreamOnFile(utf8TarFile, true, &tarStream));
+    }
+
+    auto deleteFile = MSIX::scope_exit([&outputPackage]
+    {
+        DeleteOutputPackage(outputPackage);
+    });
+
+    auto stream = CreateOutputPackageStream(outputPackage);
 
     MSIX::ComPtr<IAppxFactory> factory;
     ThrowHrIfFailed(CoCreateAppxFactoryWithHeap(InternalAllocate, InternalFree, validationOption, &factory));
 
     MSIX::ComPtr<IAppxPackageWriter> writer;
     ThrowHrIfFailed(factory->CreatePackageWriter(stream.Get(), nullptr, &writer));
-    writer.As<IPackageWriter>()->PackPayloadFiles(from);
-    ThrowHrIfFailed(writer->Close(manifest.Get()));
+    std::vector<std::uint8_t> manifest;
+    ThrowErrorIfNot(MSIX::Error::MissingAppxManifestXML, writer.As<IPackageWriter>()->PackPayloadTar(tarStream, manifest),
+        "The tar stream doesn't have an AppxManifest.xml");
+    auto manifestStream = MSIX::ComPtr<IStream>::Make<MSIX::VectorStream>(&manifest);
+    ThrowHrIfFailed(writer->Close(manifestStream.Get()));
     deleteFile.release();
     return static_cast<HRESULT>(MSIX::Error::OK);
 } CATCH_RETURN();
@@ -338,6 +516,13 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackBundle(
         manifestOnly = true;
     }
 
+    MSIX_VALIDATION_OPTION validationOptions = MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL;
+    validationOptions = static_cast<MSIX_VALIDATION_OPTION>(validationOptions | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE);
+    if (bundleOptions & MSIX_BUNDLE_OPTIONS::MSIX_BUNDLE_OPTION_SKIPPACKAGEVALIDATION)
+    {
+        validationOptions = static_cast<MSIX_VALIDATION_OPTION>(validationOptions | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPPACKAGEVALIDATION);
+    }
+
     if (bundleOptions & MSIX_BUNDLE_OPTIONS::MSIX_OPTION_VERBOSE)
     {
         //TODO: Process option for verbose
@@ -386,9 +571,6 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackBundle(
     }
 
     MSIX::ComPtr<IAppxBundleFactory> factory;
-    MSIX_VALIDATION_OPTION validationOptions = MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL;
-    validationOptions = static_cast<MSIX_VALIDATION_OPTION>(validationOptions | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE);
-
     ThrowHrIfFailed(CoCreateAppxBundleFactoryWithHeap(InternalAllocate, InternalFree, 
         validationOptions,
         MSIX_APPLICABILITY_OPTIONS::MSIX_APPLICABILITY_OPTION_FULL,
@@ -494,5 +676,28 @@ MSIX_API HRESULT STDMETHODCALLTYPE PackBundle(
 
 } CATCH_RETURN();
 
+MSIX_API HRESULT STDMETHODCALLTYPE MsixGetPackStatistics(MSIX_PACK_STATISTICS* statistics, bool reset) noexcept try
+{
+    ThrowErrorIf(MSIX::Error::InvalidParameter, statistics == nullptr, "bad pointer");
+    auto& counters = MSIX::Global::PackStatistics::Get();
+    statistics->blocks = counters.blocks;
+    statistics->bufferAllocations = counters.bufferAllocations;
+    statistics->bufferReuses = counters.bufferReuses;
+    statistics->zipRecordWrites = counters.zipRecordWrites;
+    statistics->zipRecordBytes = counters.zipRecordBytes;
+    statistics->cacheHits = counters.cacheHits;
+    statistics->cacheMisses = counters.cacheMisses;
+    statistics->cacheEvictions = counters.cacheEvictions;
+    statistics->scannedDirectories = counters.scannedDirectories;
+    statistics->scannedFiles = counters.scannedFiles;
+    statistics->scanMicroseconds = counters.scanMicroseconds;
+    statistics->packMicroseconds = counters.packMicroseconds;
+    if (reset)
+    {
+        counters.Reset();
+    }
+    return static_cast<HRESULT>(MSIX::Error::OK);
+} CATCH_RETURN();
+
 #endif // MSIX_PACK
 
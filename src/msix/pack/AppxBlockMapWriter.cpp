@@ -6,6 +6,7 @@
 #include "XmlWriter.hpp"
 #include "AppxBlockMapWriter.hpp"
 #include "StringHelper.hpp"
+#include "SpillStream.hpp"
 
 #include <vector>
 
@@ -44,7 +45,9 @@ namespace MSIX {
 
     // <BlockMap HashMethod="http://www.w3.org/2001/04/xmlenc#sha256" xmlns="http://schemas.microsoft.com/appx/2010/blockmap" 
     //   xmlns:b4 = "http://schemas.microsoft.com/appx/2021/blockmap" IgnorableNamespaces = "b4">
-    BlockMapWriter::BlockMapWriter() : m_xmlWriter(XmlWriter(blockMapElement))
+    // The blockmap grows with the number of blocks in the package, it goes to a temporary file once it is too
+    // big to be kept in memory.
+    BlockMapWriter::BlockMapWriter() : m_xmlWriter(XmlWriter(blockMapElement, ComPtr<IStream>::Make<SpillStream>().Get()))
     {
         m_xmlWriter.AddAttribute(xmlnsAttribute, blockMapNamespace);
         m_xmlWriter.AddAttribute(xmlnsAttributeV4, blockMapNamespaceV4);
@@ -61,14 +64,13 @@ namespace MSIX {
         std::string winName = Helper::toBackSlash(name);
         m_xmlWriter.StartElement(fileElement);
         m_xmlWriter.AddAttribute(nameAttribute, winName);
-        m_xmlWriter.AddAttribute(sizeAttribute, std::to_string(uncompressedSize));
-        m_xmlWriter.AddAttribute(lfhSizeAttribute, std::to_string(lfh));
+        m_xmlWriter.AddAttribute(sizeAttribute, uncompressedSize);
+        m_xmlWriter.AddAttribute(lfhSizeAttribute, lfh);
 
         if (uncompressedSize > DefaultBlockSize)
         {
             // If the file size is more than a block (64KB), we will add <FileHash> element after all the <Block> elements.
             // Otherwise, file hash is the same as the block hash, as there is only 1 block in the file.
-            m_fileHashEngine.Reset();
             m_addFileHash = true;
         }
         else
@@ -78,40 +80,26 @@ namespace MSIX {
     }
 
     // <Block Size="2948" Hash="ORIk+3QF9mSpuOq51oT3Xqn0Gy0vcGbnBRn5lBg5irM="/>
-    void BlockMapWriter::AddBlock(const std::vector<std::uint8_t>& block, ULONG size, bool isCompressed)
+    void BlockMapWriter::AddBlockHash(const std::vector<std::uint8_t>& hash, ULONG size, bool isCompressed)
     {
-        // hash block
-        std::vector<std::uint8_t> hash;
-        ThrowErrorIfNot(MSIX::Error::BlockMapInvalidData,
-            MSIX::SHA256::ComputeHash(block.data(), static_cast<uint32_t>(block.size()), hash), 
-            "Failed computing hash");
-
         m_xmlWriter.StartElement(blockElement);
-        m_xmlWriter.AddAttribute(hashAttribute, Base64::ComputeBase64(hash));
+        m_xmlWriter.AddBase64Attribute(hashAttribute, hash);
         // We only add the size attribute for compressed files, we cannot just check for the 
         // size of the block because the last block is going to be smaller than the default.
         if(isCompressed)
         {
-            m_xmlWriter.AddAttribute(sizeAttribute, std::to_string(size));
+            m_xmlWriter.AddAttribute(sizeAttribute, size);
         }
         m_xmlWriter.CloseElement();
-
-        if (m_addFileHash)
-        {
-            m_fileHashEngine.HashData(block.data(), static_cast<uint32_t>(block.size()));
-        }
     }
 
-    void BlockMapWriter::CloseFile()
+    void BlockMapWriter::CloseFile(const std::vector<std::uint8_t>& fileHash)
     {
         if (m_addFileHash)
         {
-            std::vector<std::uint8_t> hash;
-            m_fileHashEngine.FinalizeAndGetHashValue(hash);
-
             // <b4:FileHash Hash="4EsIP4hU04SShLPR1KIiRBzuYpLVPcETqMp1HZaKdfc="/>
             m_xmlWriter.StartElement(fileHashElementV4);
-            m_xmlWriter.AddAttribute(hashAttribute, Base64::ComputeBase64(hash));
+            m_xmlWriter.AddBase64Attribute(hashAttribute, fileHash);
             m_xmlWriter.CloseElement();
         }
 
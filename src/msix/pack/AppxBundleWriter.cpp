@@ -10,11 +10,15 @@
 #include "ContentType.hpp"
 #include "Encoding.hpp"
 #include "ZipObjectWriter.hpp"
+#include "ZipObjectReader.hpp"
+#include "AppxPackageObject.hpp"
+#include "ParallelHelper.hpp"
 #include "AppxManifestObject.hpp"
 #include "ScopeExit.hpp"
 #include "FileNameValidation.hpp"
 #include "StringHelper.hpp"
 #include "VectorStream.hpp"
+#include "PackStatistics.hpp"
 
 #include <ctime>
 #include <iomanip>
@@ -49,21 +53,36 @@ namespace MSIX {
                 this->m_state = WriterState::Failed;
             });
 
-        auto fileMap = from->GetFilesByLastModDate();
+        auto& statistics = Global::PackStatistics::Get();
+        std::multimap<std::uint64_t, std::string> fileMap;
+        {
+            Global::PackTimer timer(statistics.scanMicroseconds);
+            fileMap = from->GetFilesByLastModDate();
+        }
+        statistics.scannedFiles += fileMap.size();
+
+        Global::PackTimer timer(statistics.packMicroseconds);
+        auto storage = from.As<IStorageObject>();
+        std::vector<std::pair<std::string, std::string>> references;
         for (const auto& file : fileMap)
         {
             if (!(FileNameValidation::IsFootPrintFile(file.second, true)))
             {
-                std::string ext = Helper::tolower(file.second.substr(file.second.find_last_of(".") + 1));
-                auto contentType = ContentType::GetContentTypeByExtension(ext);
-                auto stream = from.As<IStorageObject>()->GetFile(file.second);
-
                 if (flatBundle)
                 {
-                    ThrowHrIfFailed(AddPackageReference(utf8_to_wstring(file.second).c_str(), stream.Get(), false));
+                    references.emplace_back(file.second, file.second);
+                }
+                else
+                {
+                    auto stream = storage->GetFile(file.second);
+                    AddPayloadPackageInternal(file.second, stream.Get(), false);
                 }
             }
         }
+        AddPackageReferences(references, [&storage](const std::string& path)
+            {
+                return storage->GetFile(path);
+            });
 
         failState.release();
     }
@@ -76,6 +95,7 @@ namespace MSIX {
                 this->m_state = WriterState::Failed;
             });
 
+        std::vector<std::pair<std::string, std::string>> references;
         std::map<std::string, std::string>::iterator fileListIterator;
         for (fileListIterator = fileList.begin(); fileListIterator != fileList.end(); fileListIterator++)
         {
@@ -84,16 +104,21 @@ namespace MSIX {
 
             if (!(FileNameValidation::IsFootPrintFile(inputPath, true)))
             {
-                std::string ext = Helper::tolower(inputPath.substr(inputPath.find_last_of(".") + 1));
-                auto contentType = ContentType::GetContentTypeByExtension(ext);
-                auto stream = ComPtr<IStream>::Make<FileStream>(inputPath, FileStream::Mode::READ);
-
                 if (flatBundle)
                 {
-                    ThrowHrIfFailed(AddPackageReference(utf8_to_wstring(outputPath).c_str(), stream.Get(), false));
+                    references.emplace_back(outputPath, inputPath);
+                }
+                else
+                {
+                    auto stream = ComPtr<IStream>::Make<FileStream>(inputPath, FileStream::Mode::READ);
+                    AddPayloadPackageInternal(outputPath, stream.Get(), false);
                 }
             }
         }
+        AddPackageReferences(references, [](const std::string& path)
+            {
+                return ComPtr<IStream>::Make<FileStream>(path, FileStream::Mode::READ);
+            });
         failState.release();
     }
 
@@ -116,8 +141,7 @@ namespace MSIX {
     // IAppxBundleWriter
     HRESULT STDMETHODCALLTYPE AppxBundleWriter::AddPayloadPackage(LPCWSTR fileName, IStream* packageStream) noexcept try
     {
-        // TODO: implement
-        NOTIMPLEMENTED;
+        return AddPayloadPackage(fileName, packageStream, FALSE);
     } CATCH_RETURN();
 
     HRESULT STDMETHODCALLTYPE AppxBundleWriter::Close() noexcept try
@@ -163,23 +187,112 @@ namespace MSIX {
     void AppxBundleWriter::AddPackageReferenceInternal(std::string fileName, IStream* packageStream,
         bool isDefaultApplicablePackage)
     {
-        auto appxFactory = m_factory.As<IAppxFactory>();
-
-        ComPtr<IAppxPackageReader> reader;
-        ThrowHrIfFailed(appxFactory->CreatePackageReader(packageStream, &reader));
+        auto manifestReader = ReadReferencedPackage(packageStream);
 
         std::uint64_t packageStreamSize = this->m_bundleWriterHelper.GetStreamSize(packageStream);
                 
-        this->m_bundleWriterHelper.AddPackage(fileName, reader.Get(), 0, packageStreamSize, isDefaultApplicablePackage);
+        this->m_bundleWriterHelper.AddPackage(fileName, manifestReader.Get(), 0, packageStreamSize, isDefaultApplicablePackage);
+    }
+
+    // The bundle only needs the manifest of a referenced package. By default the whole package is validated
+    // and the manifest comes from its package reader. If package validation is skipped, only the manifest is
+    // read, after checking its blocks against the blockmap.
+    ComPtr<IAppxManifestReader> AppxBundleWriter::ReadReferencedPackage(IStream* packageStream)
+    {
+        ComPtr<IAppxManifestReader> manifestReader;
+        if ((m_factory->GetValidationOptions() & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPPACKAGEVALIDATION) == 0)
+        {
+            auto appxFactory = m_factory.As<IAppxFactory>();
+            ComPtr<IAppxPackageReader> reader;
+            ThrowHrIfFailed(appxFactory->CreatePackageReader(packageStream, &reader));
+            ThrowHrIfFailed(reader->GetManifest(&manifestReader));
+        }
+        else
+        {
+            ComPtr<IStream> stream(packageStream);
+            auto container = ComPtr<IStorageObject>::Make<ZipObjectReader>(stream);
+            manifestReader = ReadPackageManifest(m_factory.Get(), container);
+        }
+        return manifestReader;
+    }
+
+    // Adds references to the packages of a flat bundle. packages holds the name in the bundle and the path
+    // given to open of each package. The packages are read concurrently, each one from a stream of its own,
+    // and then added to the bundle manifest in order.
+    void AppxBundleWriter::AddPackageReferences(const std::vector<std::pair<std::string, std::string>>& packages,
+        const std::function<ComPtr<IStream>(const std::string&)>& open)
+    {
+        std::vector<ComPtr<IAppxManifestReader>> manifests(packages.size());
+        std::vector<std::uint64_t> sizes(packages.size());
+        auto results = Helper::ParallelFor(packages.size(), [&](std::size_t index)
+        {
+            auto stream = open(packages[index].second);
+            manifests[index] = ReadReferencedPackage(stream.Get());
+            sizes[index] = m_bundleWriterHelper.GetStreamSize(stream.Get());
+        });
+
+        for (std::size_t index = 0; index < packages.size(); index++)
+        {
+            Helper::MergeParallelResult(results[index]);
+            m_bundleWriterHelper.AddPackage(packages[index].first, manifests[index].Get(), 0, sizes[index], false);
+        }
     }
 
     HRESULT STDMETHODCALLTYPE AppxBundleWriter::AddPayloadPackage(LPCWSTR fileName, IStream* packageStream, 
         BOOL isDefaultApplicablePackage) noexcept try
     {
-        // TODO: implement
-        NOTIMPLEMENTED;
+        ThrowErrorIf(Error::InvalidParameter, (fileName == nullptr || packageStream == nullptr), "Invalid parameter");
+        AddPayloadPackageInternal(wstring_to_utf8(fileName), packageStream, !!isDefaultApplicablePackage);
+        return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
+    // The package is stored as is, without recompressing it. Payload packages are not described in the
+    // bundle blockmap, their own blockmap and signature cover their contents.
+    void AppxBundleWriter::AddPayloadPackageInternal(const std::string& fileName, IStream* packageStream,
+        bool isDefaultApplicablePackage)
+    {
+        ThrowErrorIf(Error::InvalidState, m_state != WriterState::Open, "Invalid package writer state");
+        auto failState = MSIX::scope_exit([this]
+            {
+                this->m_state = WriterState::Failed;
+            });
+
+        ThrowErrorIfNot(Error::InvalidParameter, FileNameValidation::IsFileNameValid(fileName), "Invalid file name");
+        ThrowErrorIf(Error::InvalidParameter, FileNameValidation::IsFootPrintFile(fileName, true), "Trying to add footprint file to bundle");
+
+        // Validate the package before anything is written to the bundle
+        auto appxFactory = m_factory.As<IAppxFactory>();
+        ComPtr<IAppxPackageReader> reader;
+        ThrowHrIfFailed(appxFactory->CreatePackageReader(packageStream, &reader));
+
+        APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE packageType = APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE::APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE_APPLICATION;
+        ComPtr<IAppxManifestPackageId> packageId;
+        ComPtr<IAppxManifestQualifiedResourcesEnumerator> resources;
+        ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator> tdfs;
+        ComPtr<IAppxManifestReader> manifestReader;
+        ThrowHrIfFailed(reader->GetManifest(&manifestReader));
+        m_bundleWriterHelper.GetValidatedPackageData(fileName, manifestReader.Get(), &packageType, &packageId, &resources, &tdfs);
+
+        std::uint64_t packageSize = m_bundleWriterHelper.GetStreamSize(packageStream);
+        LARGE_INTEGER start = { 0 };
+        ThrowHrIfFailed(packageStream->Seek(start, StreamBase::Reference::START, nullptr));
+
+        std::string ext = Helper::tolower(fileName.substr(fileName.find_last_of(".") + 1));
+        auto contentType = ContentType::GetContentTypeByExtension(ext);
+        std::string encodedName;
+        auto fileInfo = m_zipWriter->PrepareToAddRawFile(Encoding::EncodeFileName(fileName, encodedName), false);
+        std::uint64_t offset = m_zipWriter->GetFileDataOffset();
+        m_contentTypeWriter.AddContentType(fileName, contentType.GetContentType());
+
+        auto pipeline = m_pipelines.Acquire();
+        auto result = pipeline->Process(packageStream, packageSize, false, fileInfo.second.Get(), nullptr, nullptr);
+        m_zipWriter->EndFile(result.crc, result.outputSize, packageSize, true);
+
+        m_bundleWriterHelper.AddValidatedPackageData(fileName, offset, packageSize, packageType, packageId,
+            isDefaultApplicablePackage, resources.Get(), tdfs.Get());
+        failState.release();
+    }
+
     HRESULT STDMETHODCALLTYPE AppxBundleWriter::AddExternalPackageReference(LPCWSTR fileName,
         IStream* inputStream, BOOL isDefaultApplicablePackage) noexcept try
     {
@@ -225,17 +338,10 @@ namespace MSIX {
     void AppxBundleWriter::AddFileToPackage(const std::string& name, IStream* stream, bool toCompress,
         bool addToBlockMap, const char* contentType, bool forceContentTypeOverride)
     {
-        std::string opcFileName;
+        std::string encodedName;
         // Don't encode [Content Type].xml
-        if (contentType != nullptr)
-        {
-            opcFileName = Encoding::EncodeFileName(name);
-        }
-        else
-        {
-            opcFileName = name;
-        }
-        auto fileInfo = m_zipWriter->PrepareToAddFile(opcFileName, toCompress);
+        const auto& opcFileName = (contentType != nullptr) ? Encoding::EncodeFileName(name, encodedName) : name;
+        auto fileInfo = m_zipWriter->PrepareToAddRawFile(opcFileName, toCompress);
 
         // Add content type to [Content Types].xml
         if (contentType != nullptr)
@@ -256,53 +362,27 @@ namespace MSIX {
             m_blockMapWriter.AddFile(name, uncompressedSize, fileInfo.first);
         }
 
-        auto& zipFileStream = fileInfo.second;
-
-        std::uint64_t bytesToRead = uncompressedSize;
-        std::uint32_t crc = 0;
-        while (bytesToRead > 0)
+        // The data is deflated by the pipeline and written straight to the zip
+        auto pipeline = m_pipelines.Acquire();
+        std::vector<std::uint8_t> fileHash;
+        BlockPipeline::BlockCallback onBlock;
+        if (addToBlockMap)
         {
-            // Calculate the size of the next block to add
-            std::uint32_t blockSize = (bytesToRead > DefaultBlockSize) ? DefaultBlockSize : static_cast<std::uint32_t>(bytesToRead);
-            bytesToRead -= blockSize;
-
-            // read block from stream
-            std::vector<std::uint8_t> block;
-            block.resize(blockSize);
-            ULONG bytesRead;
-            ThrowHrIfFailed(stream->Read(static_cast<void*>(block.data()), static_cast<ULONG>(blockSize), &bytesRead));
-            ThrowErrorIfNot(Error::FileRead, (static_cast<ULONG>(blockSize) == bytesRead), "Read stream file failed");
-            crc = crc32(crc, block.data(), static_cast<uInt>(block.size()));
-
-            // Write block and compress if needed
-            ULONG bytesWritten = 0;
-            ThrowHrIfFailed(zipFileStream->Write(block.data(), static_cast<ULONG>(block.size()), &bytesWritten));
-
-            // Add block to blockmap
-            if (addToBlockMap)
+            onBlock = [this, toCompress](const std::vector<std::uint8_t>& hash, ULONG outputSize)
             {
-                m_blockMapWriter.AddBlock(block, bytesWritten, toCompress);
-            }
-
-        }
-
-        if (toCompress)
-        {
-            // Put the stream termination on
-            std::vector<std::uint8_t> buffer;
-            ULONG bytesWritten = 0;
-            ThrowHrIfFailed(zipFileStream->Write(buffer.data(), static_cast<ULONG>(buffer.size()), &bytesWritten));
+                m_blockMapWriter.AddBlockHash(hash, outputSize, toCompress);
+            };
         }
+        auto result = pipeline->Process(stream, uncompressedSize, toCompress, fileInfo.second.Get(),
+            onBlock, addToBlockMap ? &fileHash : nullptr);
 
         // Close File element
         if (addToBlockMap)
         {
-            m_blockMapWriter.CloseFile();
+            m_blockMapWriter.CloseFile(fileHash);
         }
 
-        // This could be the compressed or uncompressed size
-        auto streamSize = zipFileStream.As<IStreamInternal>()->GetSize();
-        m_zipWriter->EndFile(crc, streamSize, uncompressedSize, true);
+        m_zipWriter->EndFile(result.crc, result.outputSize, uncompressedSize, true);
     }
 
     void AppxBundleWriter::ValidateCompressionOption(APPX_COMPRESSION_OPTION compressionOpt)
@@ -14,21 +14,64 @@
 #include "ScopeExit.hpp"
 #include "FileNameValidation.hpp"
 #include "StringHelper.hpp"
+#include "VectorStream.hpp"
+#include "ParallelHelper.hpp"
+#include "PackStatistics.hpp"
+#include "StreamHelper.hpp"
+#include "TarReader.hpp"
 
 #include <string>
 #include <memory>
 #include <future>
 #include <algorithm>
 #include <functional>
+#include <limits>
+
+#include <zlib.h>
 
 namespace MSIX {
 
+    namespace {
+        // This might be called with external IStream implementations. Don't rely on internal implementation of FileStream
+        std::uint64_t GetStreamSize(IStream* stream)
+        {
+            LARGE_INTEGER start = { 0 };
+            ULARGE_INTEGER end = { 0 };
+            ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::END, &end));
+            ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
+            return static_cast<std::uint64_t>(end.QuadPart);
+        }
+
+        // Upper bound of the data BlockPipeline outputs for a file. Each block is deflated on its own and ends
+        // with a full flush, which deflateBound doesn't account for (see BlockPipeline).
+        std::uint64_t GetOutputSizeBound(std::uint64_t size, bool toCompress)
+        {
+            if (!toCompress)
+            {
+                return size;
+            }
+            std::uint64_t fullBlocks = size / DefaultBlockSize;
+            uLong remainder = static_cast<uLong>(size % DefaultBlockSize);
+            std::uint64_t bound = fullBlocks * (deflateBound(nullptr, DefaultBlockSize) + 16);
+            if (remainder != 0)
+            {
+                bound += deflateBound(nullptr, remainder) + 16;
+            }
+            return bound;
+        }
+    }
+
     AppxPackageWriter::AppxPackageWriter(IMsixFactory* factory, const ComPtr<IZipWriter>& zip) : m_factory(factory), m_zipWriter(zip)
     {
         m_state = WriterState::Open;
     }
 
     // IPackageWriter
+    void AppxPackageWriter::SetBlockCache(const std::shared_ptr<BlockCache>& cache)
+    {
+        m_pipelines.SetCache(cache);
+    }
+
     void AppxPackageWriter::PackPayloadFiles(const ComPtr<IDirectoryObject>& from)
     {
         ThrowErrorIf(Error::InvalidState, m_state != WriterState::Open, "Invalid package writer state");
@@ -37,7 +80,17 @@ namespace MSIX {
             this->m_state = WriterState::Failed;
         });
 
-        auto fileMap = from->GetFilesByLastModDate();
+        auto& statistics = Global::PackStatistics::Get();
+        std::multimap<std::uint64_t, std::string> fileMap;
+        {
+            Global::PackTimer timer(statistics.scanMicroseconds);
+            fileMap = from->GetFilesByLastModDate();
+        }
+        statistics.scannedFiles += fileMap.size();
+
+        Global::PackTimer timer(statistics.packMicroseconds);
+        auto storage = from.As<IStorageObject>();
+        std::vector<PayloadFile> files;
         for(const auto& file : fileMap)
         {
             // If any footprint file is present, ignore it. We only require the AppxManifest.xml
@@ -46,13 +99,79 @@ namespace MSIX {
             {
                 std::string ext = Helper::tolower(file.second.substr(file.second.find_last_of(".") + 1));
                 auto contentType = ContentType::GetContentTypeByExtension(ext);
-                auto stream = from.As<IStorageObject>()->GetFile(file.second);
-                ValidateAndAddPayloadFile(file.second, stream.Get(), contentType.GetCompressionOpt(), contentType.GetContentType().c_str());
+                std::string name = file.second;
+                files.push_back({ name, contentType.GetContentType(), contentType.GetCompressionOpt(),
+                    [storage, name]() { return storage->GetFile(name); } });
             }
         }
+        AddPayloadFilesInternal(files, DefaultPackMemoryLimit);
         failState.release();
     }
 
+    bool AppxPackageWriter::PackPayloadTar(const ComPtr<IStream>& tar, std::vector<std::uint8_t>& manifest)
+    {
+        ThrowErrorIf(Error::InvalidState, m_state != WriterState::Open, "Invalid package writer state");
+        auto failState = MSIX::scope_exit([this]
+        {
+            this->m_state = WriterState::Failed;
+        });
+
+        // The tar stream can only be read forward. Files are read into memory and compressed in batches like
+        // PackPayloadFiles does; half of the memory limit is left for their compressed data. Bigger files are
+        // compressed while they are read from the stream.
+        const std::uint64_t bufferLimit = DefaultPackMemoryLimit / 2;
+        std::vector<PayloadFile> batch;
+        std::uint64_t batchSize = 0;
+        auto addBatch = [&]()
+        {
+            AddPayloadFilesInternal(batch, DefaultPackMemoryLimit - bufferLimit);
+            batch.clear();
+            batchSize = 0;
+        };
+
+        bool hasManifest = false;
+        TarReader reader(tar);
+        std::string name;
+        std::uint64_t size = 0;
+        while (reader.NextFile(name, size))
+        {
+            if (name == APPXMANIFEST_XML)
+            {
+                ThrowErrorIf(Error::InvalidParameter, hasManifest, "AppxManifest.xml is more than once in the tar stream");
+                ThrowErrorIf(Error::InvalidParameter, size > bufferLimit, "AppxManifest.xml is too big");
+                manifest = Helper::CreateBufferFromStream(reader.GetFileStream());
+                hasManifest = true;
+                continue;
+            }
+            // Same as PackPayloadFiles, other footprint files are ignored.
+            if (FileNameValidation::IsFootPrintFile(name, false) || FileNameValidation::IsReservedFolder(name))
+            {
+                continue;
+            }
+
+            std::string ext = Helper::tolower(name.substr(name.find_last_of(".") + 1));
+            auto contentType = ContentType::GetContentTypeByExtension(ext);
+            if (size > bufferLimit - batchSize)
+            {
+                addBatch();
+            }
+            if (size > bufferLimit)
+            {
+                ValidateAndAddPayloadFile(name, reader.GetFileStream().Get(), contentType.GetCompressionOpt(),
+                    contentType.GetContentType().c_str());
+                continue;
+            }
+
+            auto data = std::make_shared<std::vector<std::uint8_t>>(Helper::CreateBufferFromStream(reader.GetFileStream()));
+            batch.push_back({ name, contentType.GetContentType(), contentType.GetCompressionOpt(),
+                [data]() { return ComPtr<IStream>::Make<VectorStream>(data.get()); } });
+            batchSize += size;
+        }
+        addBatch();
+        failState.release();
+        return hasManifest;
+    }
+
     // IAppxPackageWriter
     HRESULT STDMETHODCALLTYPE AppxPackageWriter::AddPayloadFile(LPCWSTR fileName, LPCWSTR contentType,
         APPX_COMPRESSION_OPTION compressionOption, IStream *inputStream) noexcept try
@@ -114,18 +233,18 @@ namespace MSIX {
         APPX_PACKAGE_WRITER_PAYLOAD_STREAM* payloadFiles, UINT64 memoryLimit) noexcept try
     {
         ThrowErrorIf(Error::InvalidState, m_state != WriterState::Open, "Invalid package writer state");
-            auto failState = MSIX::scope_exit([this]
+        auto failState = MSIX::scope_exit([this]
         {
             this->m_state = WriterState::Failed;
         });
-        // TODO: use memoryLimit for how many files are going to be added
+        std::vector<PayloadFile> files;
         for(UINT32 i = 0; i < fileCount; i++)
         {
-            std::string fileName = wstring_to_utf8(payloadFiles[i].fileName);
             ComPtr<IStream> stream(payloadFiles[i].inputStream);
-            std::string contentType = wstring_to_utf8(payloadFiles[i].contentType);
-            ValidateAndAddPayloadFile(fileName, stream.Get(), payloadFiles[i].compressionOption, contentType.c_str());
+            files.push_back({ wstring_to_utf8(payloadFiles[i].fileName), wstring_to_utf8(payloadFiles[i].contentType),
+                payloadFiles[i].compressionOption, [stream]() { return stream; } });
         }
+        AddPayloadFilesInternal(files, memoryLimit);
         failState.release();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
@@ -139,40 +258,141 @@ namespace MSIX {
         {
             this->m_state = WriterState::Failed;
         });
-        // TODO: use memoryLimit for how many files are going to be added
+        std::vector<PayloadFile> files;
         for(UINT32 i = 0; i < fileCount; i++)
         {
+            ThrowErrorIf(Error::InvalidParameter, (payloadFiles[i].fileName == nullptr) || (payloadFiles[i].contentType == nullptr),
+                "Invalid payload file");
             ComPtr<IStream> stream(payloadFiles[i].inputStream);
-            ValidateAndAddPayloadFile(payloadFiles[i].fileName, stream.Get(), payloadFiles[i].compressionOption, payloadFiles[i].contentType);
+            files.push_back({ payloadFiles[i].fileName, payloadFiles[i].contentType,
+                payloadFiles[i].compressionOption, [stream]() { return stream; } });
         }
+        AddPayloadFilesInternal(files, memoryLimit);
         failState.release();
         return static_cast<HRESULT>(Error::OK);
     } CATCH_RETURN();
 
-    void AppxPackageWriter::ValidateAndAddPayloadFile(const std::string& name, IStream* stream,
-        APPX_COMPRESSION_OPTION compressionOpt, const char* contentType)
+    // Files are compressed concurrently in batches that fit in memoryLimit and are written in the order
+    // they were given, so the package is the same as if they were added one by one. A file that doesn't
+    // fit by itself is compressed while it's written, like AddPayloadFile does.
+    void AppxPackageWriter::AddPayloadFilesInternal(const std::vector<PayloadFile>& files, std::uint64_t memoryLimit)
+    {
+        std::size_t index = 0;
+        ComPtr<IStream> nextStream;
+        while (index < files.size())
+        {
+            std::vector<PreparedPayloadFile> batch;
+            std::uint64_t batchSize = 0;
+            while ((index + batch.size() < files.size()) && (batch.size() < MaxPayloadFilesInBatch))
+            {
+                const auto& file = files[index + batch.size()];
+                if (!nextStream)
+                {
+                    nextStream = file.open();
+                }
+                // Budget the worst case of the compressed data, incompressible files grow a little.
+                std::uint64_t size = GetStreamSize(nextStream.Get());
+                std::uint64_t bound = GetOutputSizeBound(size, file.compressionOpt != APPX_COMPRESSION_OPTION_NONE);
+                if ((bound > memoryLimit - batchSize) || (bound > std::numeric_limits<std::uint32_t>::max()))
+                {
+                    break;
+                }
+                PreparedPayloadFile prepared;
+                prepared.file = &file;
+                prepared.stream = std::move(nextStream);
+                prepared.uncompressedSize = size;
+                prepared.crc = 0;
+                batch.push_back(std::move(prepared));
+                batchSize += bound;
+            }
+
+            if (batch.empty())
+            {
+                const auto& file = files[index++];
+                ValidateAndAddPayloadFile(file.name, nextStream.Get(), file.compressionOpt, file.contentType.c_str());
+                nextStream = nullptr;
+                continue;
+            }
+
+            auto results = Helper::ParallelFor(batch.size(), [&](std::size_t i)
+            {
+                PreparePayloadFile(batch[i]);
+            });
+            for (std::size_t i = 0; i < batch.size(); i++)
+            {
+                Helper::MergeParallelResult(results[i]);
+                AddPreparedFileToPackage(batch[i]);
+            }
+            index += batch.size();
+        }
+    }
+
+    // Runs in a worker thread, only touches the file it is given.
+    void AppxPackageWriter::PreparePayloadFile(PreparedPayloadFile& prepared)
+    {
+        const auto& file = *prepared.file;
+        ValidatePayloadFile(file.name, file.compressionOpt);
+        bool toCompress = file.compressionOpt != APPX_COMPRESSION_OPTION_NONE;
+
+        prepared.data.reserve(static_cast<std::size_t>(GetOutputSizeBound(prepared.uncompressedSize, toCompress)));
+        auto output = ComPtr<IStream>::Make<VectorStream>(&prepared.data);
+        auto pipeline = m_pipelines.Acquire();
+        auto result = pipeline->Process(prepared.stream.Get(), prepared.uncompressedSize, toCompress, output.Get(),
+            [&prepared](const std::vector<std::uint8_t>& hash, ULONG outputSize)
+            {
+                prepared.blocks.emplace_back(hash, outputSize);
+            }, &prepared.fileHash);
+        prepared.crc = result.crc;
+        prepared.stream = nullptr;
+    }
+
+    void AppxPackageWriter::AddPreparedFileToPackage(PreparedPayloadFile& prepared)
+    {
+        const auto& file = *prepared.file;
+        bool toCompress = file.compressionOpt != APPX_COMPRESSION_OPTION_NONE;
+
+        std::string encodedName;
+        auto fileInfo = m_zipWriter->PrepareToAddRawFile(Encoding::EncodeFileName(file.name, encodedName), toCompress);
+        m_contentTypeWriter.AddContentType(file.name, file.contentType);
+        m_blockMapWriter.AddFile(file.name, prepared.uncompressedSize, fileInfo.first);
+
+        ULONG bytesWritten = 0;
+        ThrowHrIfFailed(fileInfo.second->Write(prepared.data.data(), static_cast<ULONG>(prepared.data.size()), &bytesWritten));
+
+        for (const auto& block : prepared.blocks)
+        {
+            m_blockMapWriter.AddBlockHash(block.first, block.second, toCompress);
+        }
+        m_blockMapWriter.CloseFile(prepared.fileHash);
+
+        m_zipWriter->EndFile(prepared.crc, static_cast<std::uint64_t>(prepared.data.size()), prepared.uncompressedSize, true);
+
+        // Release the memory for the next batch
+        std::vector<std::uint8_t>().swap(prepared.data);
+    }
+
+    void AppxPackageWriter::ValidatePayloadFile(const std::string& name, APPX_COMPRESSION_OPTION compressionOpt)
     {
         ThrowErrorIfNot(Error::InvalidParameter, FileNameValidation::IsFileNameValid(name), "Invalid file name");
         ThrowErrorIf(Error::InvalidParameter, FileNameValidation::IsFootPrintFile(name, false), "Trying to add footprint file to package");
         ThrowErrorIf(Error::InvalidParameter, FileNameValidation::IsReservedFolder(name), "Trying to add file in reserved folder");
         ValidateCompressionOption(compressionOpt);
+    }
+
+    void AppxPackageWriter::ValidateAndAddPayloadFile(const std::string& name, IStream* stream,
+        APPX_COMPRESSION_OPTION compressionOpt, const char* contentType)
+    {
+        ValidatePayloadFile(name, compressionOpt);
         AddFileToPackage(name, stream, compressionOpt != APPX_COMPRESSION_OPTION_NONE, true, contentType);
     }
 
     void AppxPackageWriter::AddFileToPackage(const std::string& name, IStream* stream, bool toCompress,
         bool addToBlockMap, const char* contentType, bool forceContentTypeOverride)
     {
-        std::string opcFileName;
+        std::string encodedName;
         // Don't encode [Content Type].xml
-        if (contentType != nullptr)
-        {
-            opcFileName = Encoding::EncodeFileName(name);
-        }
-        else
-        {
-            opcFileName = name;
-        }
-        auto fileInfo = m_zipWriter->PrepareToAddFile(opcFileName, toCompress);
+        const auto& opcFileName = (contentType != nullptr) ? Encoding::EncodeFileName(name, encodedName) : name;
+        auto fileInfo = m_zipWriter->PrepareToAddRawFile(opcFileName, toCompress);
 
         // Add content type to [Content Types].xml
         if (contentType != nullptr)
@@ -180,12 +400,7 @@ namespace MSIX {
             m_contentTypeWriter.AddContentType(name, contentType, forceContentTypeOverride);
         }
 
-        // This might be called with external IStream implementations. Don't rely on internal implementation of FileStream
-        LARGE_INTEGER start = { 0 };
-        ULARGE_INTEGER end = { 0 };
-        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::END, &end));
-        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
-        std::uint64_t uncompressedSize = static_cast<std::uint64_t>(end.QuadPart);
+        std::uint64_t uncompressedSize = GetStreamSize(stream);
 
         // Add file to block map.
         if (addToBlockMap)
@@ -193,53 +408,27 @@ namespace MSIX {
             m_blockMapWriter.AddFile(name, uncompressedSize, fileInfo.first);
         }
 
-        auto& zipFileStream = fileInfo.second;
-
-        std::uint64_t bytesToRead = uncompressedSize;
-        std::uint32_t crc = 0;
-        while (bytesToRead > 0)
+        // The data is deflated by the pipeline and written straight to the zip
+        auto pipeline = m_pipelines.Acquire();
+        std::vector<std::uint8_t> fileHash;
+        BlockPipeline::BlockCallback onBlock;
+        if (addToBlockMap)
         {
-            // Calculate the size of the next block to add
-            std::uint32_t blockSize = (bytesToRead > DefaultBlockSize) ? DefaultBlockSize : static_cast<std::uint32_t>(bytesToRead);
-            bytesToRead -= blockSize;
-
-            // read block from stream
-            std::vector<std::uint8_t> block;
-            block.resize(blockSize);
-            ULONG bytesRead;
-            ThrowHrIfFailed(stream->Read(static_cast<void*>(block.data()), static_cast<ULONG>(blockSize), &bytesRead));
-            ThrowErrorIfNot(Error::FileRead, (static_cast<ULONG>(blockSize) == bytesRead), "Read stream file failed");
-            crc = crc32(crc, block.data(), static_cast<uInt>(block.size()));
-
-            // Write block and compress if needed
-            ULONG bytesWritten = 0;
-            ThrowHrIfFailed(zipFileStream->Write(block.data(), static_cast<ULONG>(block.size()), &bytesWritten));
-
-            // Add block to blockmap
-            if (addToBlockMap)
+            onBlock = [this, toCompress](const std::vector<std::uint8_t>& hash, ULONG outputSize)
             {
-                m_blockMapWriter.AddBlock(block, bytesWritten, toCompress);
-            }
-
-        }
-
-        if (toCompress)
-        {
-            // Put the stream termination on
-            std::vector<std::uint8_t> buffer;
-            ULONG bytesWritten = 0;
-            ThrowHrIfFailed(zipFileStream->Write(buffer.data(), static_cast<ULONG>(buffer.size()), &bytesWritten));
+                m_blockMapWriter.AddBlockHash(hash, outputSize, toCompress);
+            };
         }
+        auto result = pipeline->Process(stream, uncompressedSize, toCompress, fileInfo.second.Get(),
+            onBlock, addToBlockMap ? &fileHash : nullptr);
 
         // Close File element
         if (addToBlockMap)
         {
-            m_blockMapWriter.CloseFile();
+            m_blockMapWriter.CloseFile(fileHash);
         }
 
-        // This could be the compressed or uncompressed size
-        auto streamSize = zipFileStream.As<IStreamInternal>()->GetSize();
-        m_zipWriter->EndFile(crc, streamSize, uncompressedSize, true);
+        m_zipWriter->EndFile(result.crc, result.outputSize, uncompressedSize, true);
     }
 
     void AppxPackageWriter::ValidateCompressionOption(APPX_COMPRESSION_OPTION compressionOpt)
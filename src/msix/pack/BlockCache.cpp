@@ -0,0 +1,266 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "BlockCache.hpp"
+#include "BlockPipeline.hpp"
+#include "AppxBlockMapObject.hpp"
+#include "AppxBlockMapWriter.hpp"
+#include "Crypto.hpp"
+#include "ZipObjectReader.hpp"
+#include "Encoding.hpp"
+#include "Exceptions.hpp"
+#include "PackStatistics.hpp"
+#include "SerializationHelper.hpp"
+#include "StreamHelper.hpp"
+#include "StringHelper.hpp"
+
+#include <algorithm>
+
+#include <zlib.h>
+
+namespace MSIX {
+
+    namespace {
+
+        // Cache file layout, all integers little endian:
+        //   magic 'MXBC', version, zlib version, block count
+        //   per block, least recently used first: key length, key, data length, data
+        const std::uint32_t CacheSignature = 0x4342584D;
+        const std::uint32_t CacheVersion = 1;
+        const char* const BlockCacheTempSuffix = ".msixtmp";
+
+        // Inflates a deflated block. Fails if the data is not a valid deflate stream or is bigger than a block.
+        bool InflateBlock(const std::vector<std::uint8_t>& compressed, std::vector<std::uint8_t>& block)
+        {
+            // One extra byte to detect blocks that inflate to more than the block size
+            block.resize(DefaultBlockSize + 1);
+            z_stream inflater = {};
+            if (inflateInit2(&inflater, -MAX_WBITS) != Z_OK) { return false; }
+            inflater.next_in = const_cast<Bytef*>(compressed.data());
+            inflater.avail_in = static_cast<uInt>(compressed.size());
+            inflater.next_out = block.data();
+            inflater.avail_out = static_cast<uInt>(block.size());
+            auto result = inflate(&inflater, Z_SYNC_FLUSH);
+            bool inflated = ((result == Z_OK) || (result == Z_STREAM_END)) && (inflater.avail_in == 0) && (inflater.avail_out != 0);
+            block.resize(block.size() - inflater.avail_out);
+            inflateEnd(&inflater);
+            return inflated;
+        }
+
+        // Checks a deflated block inflates to data with the hash it is keyed by. Blocks that come from
+        // a seed package or the cache file are not trusted until they pass this check.
+        bool InflatesToHash(const std::vector<std::uint8_t>& compressed, const std::uint8_t* hash, std::size_t hashSize,
+            std::vector<std::uint8_t>& block, std::vector<std::uint8_t>& blockHash)
+        {
+            return InflateBlock(compressed, block) &&
+                SHA256::ComputeHash(block.data(), static_cast<std::uint32_t>(block.size()), blockHash) &&
+                (blockHash.size() == hashSize) && std::equal(blockHash.begin(), blockHash.end(), hash);
+        }
+
+        // Inflates a deflated block and deflates it again the way BlockPipeline does.
+        bool DeflatesTheSame(const std::vector<std::uint8_t>& compressed)
+        {
+            std::vector<std::uint8_t> block;
+            if (!InflateBlock(compressed, block)) { return false; }
+
+            std::vector<std::uint8_t> recompressed(deflateBound(nullptr, DefaultBlockSize) + 16);
+            z_stream deflater = {};
+            if (deflateInit2(&deflater, BlockPipeline::CompressionLevel, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+            {
+                return false;
+            }
+            deflater.next_in = block.data();
+            deflater.avail_in = static_cast<uInt>(block.size());
+            deflater.next_out = recompressed.data();
+            deflater.avail_out = static_cast<uInt>(recompressed.size());
+            auto result = deflate(&deflater, BlockPipeline::FlushMode);
+            bool deflated = (result == Z_OK) && (deflater.avail_out != 0);
+            recompressed.resize(recompressed.size() - deflater.avail_out);
+            deflateEnd(&deflater);
+            return deflated && (recompressed == compressed);
+        }
+    }
+
+    void BlockCache::MakeKey(std::string& key, const std::vector<std::uint8_t>& hash, int level, int flush)
+    {
+        key.assign(hash.begin(), hash.end());
+        key.push_back(static_cast<char>(level));
+        key.push_back(static_cast<char>(flush));
+    }
+
+    BlockCache::Data BlockCache::Find(const std::string& key)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto entry = m_entries.find(key);
+        if (entry == m_entries.end())
+        {
+            m_misses++;
+            Global::PackStatistics::Get().cacheMisses++;
+            return Data();
+        }
+        m_hits++;
+        Global::PackStatistics::Get().cacheHits++;
+        m_uses.splice(m_uses.end(), m_uses, entry->second.use);
+        return entry->second.data;
+    }
+
+    void BlockCache::Insert(const std::string& key, const std::uint8_t* data, std::size_t size)
+    {
+        auto copy = std::make_shared<const std::vector<std::uint8_t>>(data, data + size);
+        std::lock_guard<std::mutex> lock(m_lock);
+        InsertLocked(key, std::move(copy));
+    }
+
+    void BlockCache::InsertLocked(const std::string& key, Data data)
+    {
+        auto existing = m_entries.find(key);
+        if (existing != m_entries.end())
+        {
+            m_uses.splice(m_uses.end(), m_uses, existing->second.use);
+            return;
+        }
+        if (data->size() > m_sizeLimit)
+        {
+            return;
+        }
+
+        m_size += data->size();
+        auto use = m_uses.insert(m_uses.end(), key);
+        m_entries.emplace(key, Entry{ std::move(data), use });
+
+        while (m_size > m_sizeLimit)
+        {
+            auto evicted = m_entries.find(m_uses.front());
+            m_size -= evicted->second.data->size();
+            m_entries.erase(evicted);
+            m_uses.pop_front();
+            Global::PackStatistics::Get().cacheEvictions++;
+        }
+    }
+
+    void BlockCache::Seed(IMsixFactory* factory, const ComPtr<IStream>& package)
+    {
+        auto zip = ComPtr<ZipObjectReader>::Make<ZipObjectReader>(package);
+        auto blockMapStream = zip->GetFile(APPXBLOCKMAP_XML);
+        ThrowErrorIfNot(Error::MissingAppxBlockMapXML, blockMapStream, "Package to seed the block cache from has no blockmap");
+        auto blockMap = ComPtr<IAppxBlockMapInternal>::Make<AppxBlockMapObject>(factory, blockMapStream);
+
+        std::vector<std::pair<std::string, Data>> blocks;
+        bool checked = false;
+        std::string key;
+        std::vector<std::uint8_t> block;
+        std::vector<std::uint8_t> blockHash;
+        for (const auto& name : blockMap->GetFileNames())
+        {
+            std::string zipName = name;
+            std::replace(zipName.begin(), zipName.end(), '\\', '/');
+            std::string encodedName;
+            auto stream = zip->GetRawFile(Encoding::EncodeFileName(zipName, encodedName));
+            if (!stream || !stream.As<IStreamInternal>()->IsCompressed())
+            {
+                continue;
+            }
+            for (const auto& blockInfo : blockMap->GetBlocks(name))
+            {
+                auto data = std::make_shared<std::vector<std::uint8_t>>(static_cast<std::size_t>(blockInfo.compressedSize));
+                ULONG read = 0;
+                ThrowHrIfFailed(stream->Read(data->data(), static_cast<ULONG>(data->size()), &read));
+                ThrowErrorIf(Error::FileRead, read != data->size(), "Package to seed the block cache from is truncated");
+                if (!checked)
+                {
+                    if (!DeflatesTheSame(*data))
+                    {
+                        return;
+                    }
+                    checked = true;
+                }
+                // The seed is not validated against its signature, a block that doesn't match its hash is skipped
+                if (!InflatesToHash(*data, blockInfo.hash.data(), blockInfo.hash.size(), block, blockHash))
+                {
+                    continue;
+                }
+                MakeKey(key, blockInfo.hash, BlockPipeline::CompressionLevel, BlockPipeline::FlushMode);
+                blocks.emplace_back(key, std::move(data));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto& block : blocks)
+        {
+            InsertLocked(block.first, std::move(block.second));
+        }
+    }
+
+    void BlockCache::Load(const ComPtr<IDirectoryObject>& directory)
+    {
+        if (!directory->FileExists(BLOCK_CACHE_FILE))
+        {
+            return;
+        }
+        auto buffer = Helper::CreateBufferFromStream(directory->OpenFile(BLOCK_CACHE_FILE, FileStream::Mode::READ));
+
+        Serialization::Reader reader(buffer);
+        std::uint32_t signature = 0, version = 0, count = 0;
+        const std::uint8_t* bytes = nullptr;
+        std::uint32_t size = 0;
+        if (!reader.ReadNumber(signature) || signature != CacheSignature ||
+            !reader.ReadNumber(version) || version != CacheVersion ||
+            !reader.ReadBytes(bytes, size) || std::string(bytes, bytes + size) != zlibVersion() ||
+            !reader.ReadNumber(count))
+        {
+            return;
+        }
+
+        std::vector<std::pair<std::string, Data>> blocks;
+        std::vector<std::uint8_t> block;
+        std::vector<std::uint8_t> blockHash;
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            const std::uint8_t* key = nullptr;
+            std::uint32_t keySize = 0;
+            if (!reader.ReadBytes(key, keySize) || !reader.ReadBytes(bytes, size))
+            {
+                return;
+            }
+            // Keys are the block hash followed by the compression level and flush mode. Blocks that were
+            // modified since they were saved are dropped.
+            auto data = std::make_shared<const std::vector<std::uint8_t>>(bytes, bytes + size);
+            if ((keySize > 2) && InflatesToHash(*data, key, keySize - 2, block, blockHash))
+            {
+                blocks.emplace_back(std::string(key, key + keySize), std::move(data));
+            }
+        }
+        if (!reader.AtEnd())
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(m_lock);
+        for (auto& block : blocks)
+        {
+            InsertLocked(block.first, std::move(block.second));
+        }
+    }
+
+    void BlockCache::Save(const ComPtr<IDirectoryObject>& directory)
+    {
+        using namespace Serialization;
+        std::vector<std::uint8_t> buffer;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            buffer.reserve(static_cast<std::size_t>(m_size + m_entries.size() * 48 + 64));
+            WriteNumber(buffer, CacheSignature);
+            WriteNumber(buffer, CacheVersion);
+            WriteBytes(buffer, std::string(zlibVersion()));
+            WriteNumber(buffer, static_cast<std::uint32_t>(m_entries.size()));
+            for (const auto& key : m_uses)
+            {
+                const auto& data = m_entries[key].data;
+                WriteBytes(buffer, key);
+                WriteBytes(buffer, data->data(), data->size());
+            }
+        }
+        ReplaceFile(directory, BLOCK_CACHE_FILE, BlockCacheTempSuffix, buffer);
+    }
+}
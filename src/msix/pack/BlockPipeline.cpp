@@ -0,0 +1,202 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "BlockPipeline.hpp"
+#include "AppxBlockMapWriter.hpp"
+#include "Exceptions.hpp"
+#include "PackStatistics.hpp"
+
+namespace MSIX {
+
+    BlockPipeline::BlockPipeline()
+    {
+        m_zstrm.zalloc = Z_NULL;
+        m_zstrm.zfree = Z_NULL;
+        m_zstrm.opaque = Z_NULL;
+        // Same parameters as DeflateStream
+        auto result = deflateInit2(&m_zstrm, CompressionLevel, Z_DEFLATED, -MAX_WBITS, MAX_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+        ThrowErrorIf(Error::DeflateInitialize, result != Z_OK, "Error calling deflateinit2");
+
+        // deflateBound doesn't account for the empty stored block added by each Z_FULL_FLUSH and
+        // the end of the stream. Deflate() still handles a full output buffer, this is just the common case.
+        m_input.resize(DefaultBlockSize);
+        m_output.resize(deflateBound(&m_zstrm, DefaultBlockSize) + 16);
+        m_hash.reserve(32);
+        Global::PackStatistics::Get().bufferAllocations += 2;
+    }
+
+    BlockPipeline::~BlockPipeline()
+    {
+        deflateEnd(&m_zstrm);
+    }
+
+    BlockPipeline::Result BlockPipeline::Process(IStream* input, std::uint64_t size, bool compress, IStream* output,
+        const BlockCallback& onBlock, std::vector<std::uint8_t>* fileHash)
+    {
+        auto& statistics = Global::PackStatistics::Get();
+        if (m_used)
+        {
+            statistics.bufferReuses++;
+        }
+        m_used = true;
+
+        if (compress)
+        {
+            ThrowErrorIf(Error::DeflateInitialize, deflateReset(&m_zstrm) != Z_OK, "Error calling deflateReset");
+        }
+        bool addFileHash = (fileHash != nullptr) && (size > DefaultBlockSize);
+        if (addFileHash)
+        {
+            m_fileHashEngine.Reset();
+        }
+
+        Result result = { 0, 0 };
+        std::uint64_t bytesToRead = size;
+        while (bytesToRead > 0)
+        {
+            std::uint32_t blockSize = (bytesToRead > DefaultBlockSize) ? DefaultBlockSize : static_cast<std::uint32_t>(bytesToRead);
+            bytesToRead -= blockSize;
+
+            ULONG bytesRead;
+            ThrowHrIfFailed(input->Read(static_cast<void*>(m_input.data()), static_cast<ULONG>(blockSize), &bytesRead));
+            ThrowErrorIfNot(Error::FileRead, (static_cast<ULONG>(blockSize) == bytesRead), "Read stream file failed");
+            statistics.blocks++;
+
+            result.crc = crc32(result.crc, m_input.data(), static_cast<uInt>(blockSize));
+            // Block hashes are only needed for files described in the blockmap and as block cache keys
+            if (onBlock || compress)
+            {
+                ThrowErrorIfNot(Error::BlockMapInvalidData,
+                    SHA256::ComputeHash(m_input.data(), blockSize, m_hash),
+                    "Failed computing hash");
+            }
+            if (addFileHash)
+            {
+                m_fileHashEngine.HashData(m_input.data(), blockSize);
+            }
+
+            ULONG written = 0;
+            if (compress)
+            {
+                written = DeflateBlock(output, blockSize);
+            }
+            else
+            {
+                ThrowHrIfFailed(output->Write(m_input.data(), blockSize, &written));
+                ThrowErrorIf(Error::FileWrite, written != blockSize, "Did not write as much as requested.");
+            }
+            result.outputSize += written;
+
+            if (onBlock)
+            {
+                onBlock(m_hash, written);
+            }
+        }
+
+        if (compress)
+        {
+            // Put the stream termination on
+            m_zstrm.next_in = nullptr;
+            m_zstrm.avail_in = 0;
+            result.outputSize += Deflate(output, Z_FINISH);
+        }
+
+        if (addFileHash)
+        {
+            m_fileHashEngine.FinalizeAndGetHashValue(*fileHash);
+        }
+        return result;
+    }
+
+    ULONG BlockPipeline::DeflateBlock(IStream* output, std::uint32_t blockSize)
+    {
+        if (m_cache)
+        {
+            // The full flush of the previous block leaves no state behind, so a cached block can
+            // replace the output of deflate as is.
+            BlockCache::MakeKey(m_key, m_hash, CompressionLevel, FlushMode);
+            auto cached = m_cache->Find(m_key);
+            if (cached)
+            {
+                ULONG written = 0;
+                ThrowHrIfFailed(output->Write(cached->data(), static_cast<ULONG>(cached->size()), &written));
+                ThrowErrorIf(Error::FileWrite, written != cached->size(), "Did not write as much as requested.");
+                return written;
+            }
+            m_capture.clear();
+            m_captured = &m_capture;
+        }
+
+        m_zstrm.next_in = m_input.data();
+        m_zstrm.avail_in = blockSize;
+        ULONG written = Deflate(output, FlushMode);
+
+        if (m_captured)
+        {
+            m_cache->Insert(m_key, m_capture.data(), m_capture.size());
+            m_captured = nullptr;
+        }
+        return written;
+    }
+
+    ULONG BlockPipeline::Deflate(IStream* output, int flush)
+    {
+        ULONG total = 0;
+        do
+        {
+            m_zstrm.next_out = m_output.data();
+            m_zstrm.avail_out = static_cast<uInt>(m_output.size());
+            auto result = deflate(&m_zstrm, flush);
+            if (flush == Z_FINISH && result == Z_STREAM_END)
+            {
+                result = Z_OK;
+            }
+            ThrowErrorIf(Error::DeflateWrite, result != Z_OK, "Error deflating stream");
+            ULONG have = static_cast<ULONG>(m_output.size() - m_zstrm.avail_out);
+            if (have > 0)
+            {
+                ULONG written = 0;
+                ThrowHrIfFailed(output->Write(m_output.data(), have, &written));
+                ThrowErrorIf(Error::FileWrite, written != have, "Did not write as much as requested.");
+                if (m_captured)
+                {
+                    m_captured->insert(m_captured->end(), m_output.data(), m_output.data() + have);
+                }
+                total += have;
+            }
+        } while (m_zstrm.avail_out == 0);
+        return total;
+    }
+
+    BlockPipelinePool::Lease BlockPipelinePool::Acquire()
+    {
+        std::unique_ptr<BlockPipeline> pipeline;
+        std::shared_ptr<BlockCache> cache;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            cache = m_cache;
+            if (!m_free.empty())
+            {
+                pipeline = std::move(m_free.back());
+                m_free.pop_back();
+            }
+        }
+        if (!pipeline)
+        {
+            pipeline.reset(new BlockPipeline());
+        }
+        pipeline->SetCache(cache);
+        return Lease(pipeline.release(), [this](BlockPipeline* released)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_free.emplace_back(released);
+        });
+    }
+
+    void BlockPipelinePool::SetCache(const std::shared_ptr<BlockCache>& cache)
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_cache = cache;
+    }
+}
@@ -9,6 +9,7 @@
 #include "StringHelper.hpp"
 #include "AppxManifestObject.hpp"
 
+#include <string>
 #include <vector>
 
 namespace MSIX {
@@ -26,6 +27,8 @@ namespace MSIX {
     static const char* packageArchitectureAttribute = "Architecture";
     static const char* packageResourceIdAttribute = "ResourceId";
     static const char* fileNameAttribute = "FileName";
+    static const char* packageOffsetAttribute = "Offset";
+    static const char* packageSizeAttribute = "Size";
     static const char* resourcesManifestElement = "Resources";
     static const char* resourceManifestElement = "Resource";
     static const char* resourceLanguageAttribute = "Language";
@@ -138,14 +141,15 @@ namespace MSIX {
             m_xmlWriter.AddAttribute(fileNameAttribute, packageInfo.fileName);
         }
 
-        if(packageInfo.offset > 0)
+        // Offset and Size only apply to packages stored inside the bundle, flat bundles reference them externally
+        if (packageInfo.offset > 0)
         {
-            //TODO: not applicable for flat bundle
+            m_xmlWriter.AddAttribute(packageOffsetAttribute, packageInfo.offset);
         }
 
         if (packageInfo.size > 0 && packageInfo.offset > 0)
         {
-            //TODO: not applicable for flat bundles
+            m_xmlWriter.AddAttribute(packageSizeAttribute, packageInfo.size);
         }
 
         //WriteResourcesElement
@@ -17,7 +17,7 @@ namespace MSIX {
         return stat.cbSize.QuadPart;
     }
 
-    void BundleWriterHelper::AddPackage(std::string fileName, IAppxPackageReader* packageReader,
+    void BundleWriterHelper::AddPackage(std::string fileName, IAppxManifestReader* manifestReader,
         std::uint64_t bundleOffset, std::uint64_t packageSize, bool isDefaultApplicableResource)
     {
         ComPtr<IAppxManifestPackageId> packageId;
@@ -25,7 +25,7 @@ namespace MSIX {
         ComPtr<IAppxManifestQualifiedResourcesEnumerator> resources;
         ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator> tdfs;
 
-        GetValidatedPackageData(fileName, packageReader, &packageType, &packageId, &resources, &tdfs);
+        GetValidatedPackageData(fileName, manifestReader, &packageType, &packageId, &resources, &tdfs);
 
         AddValidatedPackageData(fileName, bundleOffset, packageSize, packageType, packageId,
                 isDefaultApplicableResource, resources.Get(), tdfs.Get());
@@ -33,7 +33,7 @@ namespace MSIX {
 
     void BundleWriterHelper::GetValidatedPackageData(
         std::string fileName,
-        IAppxPackageReader* packageReader,
+        IAppxManifestReader* manifestReader,
         APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE* packageType,
         IAppxManifestPackageId** packageId,
         IAppxManifestQualifiedResourcesEnumerator** resources,
@@ -48,8 +48,6 @@ namespace MSIX {
         ComPtr<IAppxManifestQualifiedResourcesEnumerator> loadedResources;
         ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator> loadedTdfs;
 
-        ComPtr<IAppxManifestReader> manifestReader;
-        ThrowHrIfFailed(packageReader->GetManifest(&manifestReader));
         ThrowHrIfFailed(manifestReader->GetPackageId(&loadedPackageId));
 
         ComPtr<IAppxManifestReader3> manifestReader3;
@@ -59,15 +57,15 @@ namespace MSIX {
 
         auto packageIdInternal = loadedPackageId.As<IAppxManifestPackageIdInternal>();
 
-        loadedPackageType = this->m_validationHelper.GetPayloadPackageType(manifestReader.Get(), fileName);
+        loadedPackageType = this->m_validationHelper.GetPayloadPackageType(manifestReader, fileName);
         this->m_validationHelper.AddPackage(loadedPackageType, packageIdInternal.Get(), fileName);
-        this->m_validationHelper.ValidateOSVersion(manifestReader.Get(), fileName);        
+        this->m_validationHelper.ValidateOSVersion(manifestReader, fileName);        
 
         ValidateNameAndPublisher(packageIdInternal.Get(), fileName);
 
         if (loadedPackageType == APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE_APPLICATION)
         {
-            this->m_validationHelper.ValidateApplicationElement(manifestReader.Get(), fileName);
+            this->m_validationHelper.ValidateApplicationElement(manifestReader, fileName);
             if (loadedTdfs.Get() != nullptr)
             {
                 ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator> tdfCopy;
@@ -6,6 +6,7 @@
 #include "XmlWriter.hpp"
 #include "ContentTypeWriter.hpp"
 #include "Encoding.hpp"
+#include "SpillStream.hpp"
 
 #include <map>
 #include <algorithm>
@@ -32,7 +33,8 @@ namespace MSIX {
     static const char* partNameAttribute = "PartName";
 
     // <Types xmlns="http://schemas.openxmlformats.org/package/2006/content-types">
-    ContentTypeWriter::ContentTypeWriter() : m_xmlWriter(XmlWriter(typesElement, true))
+    // Like the blockmap, the overrides can grow with the number of files in the package.
+    ContentTypeWriter::ContentTypeWriter() : m_xmlWriter(XmlWriter(typesElement, ComPtr<IStream>::Make<SpillStream>().Get(), true))
     {
         m_xmlWriter.AddAttribute(xmlnsAttribute, typesNamespace);
     }
@@ -42,7 +44,8 @@ namespace MSIX {
     // if the file doesn't have an extensions AddOverride is called.
     void ContentTypeWriter::AddContentType(const std::string& name, const std::string& contentType, bool forceOverride)
     {
-        auto percentageEncodedName = Encoding::EncodeFileName(name);
+        std::string encodedName;
+        const auto& percentageEncodedName = Encoding::EncodeFileName(name, encodedName);
 
         auto filename = percentageEncodedName;
         auto lastSlash = filename.find_last_of("/");
@@ -0,0 +1,332 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "AppxPackaging.hpp"
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "TarReader.hpp"
+
+#include <string>
+#include <array>
+#include <algorithm>
+#include <limits>
+
+namespace MSIX {
+
+    namespace {
+
+        const std::size_t TarBlockSize = 512;
+
+        // Offsets and lengths of the ustar header fields
+        enum UstarField : std::size_t
+        {
+            Name = 0,       NameLength = 100,
+            Size = 124,     SizeLength = 12,
+            Checksum = 148, ChecksumLength = 8,
+            Type = 156,
+            Magic = 257,
+            Prefix = 345,   PrefixLength = 155,
+        };
+
+        std::string GetString(const std::vector<std::uint8_t>& header, std::size_t offset, std::size_t length)
+        {
+            auto begin = header.begin() + offset;
+            auto end = std::find(begin, begin + length, '\0');
+            return std::string(begin, end);
+        }
+
+        // Octal digits, optionally padded with spaces or nulls. Values that don't fit are stored by GNU tar
+        // as a big endian binary number with the high bit of the first byte set.
+        std::uint64_t GetNumber(const std::vector<std::uint8_t>& header, std::size_t offset, std::size_t length)
+        {
+            std::uint64_t value = 0;
+            if (header[offset] & 0x80)
+            {
+                ThrowErrorIf(Error::FileRead, (header[offset] & 0x7F) != 0, "Tar number too big");
+                for (std::size_t i = 1; i < length; i++)
+                {
+                    ThrowErrorIf(Error::FileRead, (value >> 56) != 0, "Tar number too big");
+                    value = (value << 8) | header[offset + i];
+                }
+                return value;
+            }
+            std::size_t i = offset;
+            while (i < offset + length && header[i] == ' ') { i++; }
+            for (; i < offset + length && header[i] >= '0' && header[i] <= '7'; i++)
+            {
+                ThrowErrorIf(Error::FileRead, (value >> 61) != 0, "Tar number too big");
+                value = (value << 3) | (header[i] - '0');
+            }
+            return value;
+        }
+
+        // Decimal digits only. Parsed here so malformed or too big values are reported as read errors.
+        std::uint64_t ParseSize(const std::string& value)
+        {
+            ThrowErrorIf(Error::FileRead, value.empty(), "Invalid size in pax header");
+            std::uint64_t size = 0;
+            for (auto digit : value)
+            {
+                ThrowErrorIf(Error::FileRead, digit < '0' || digit > '9', "Invalid size in pax header");
+                ThrowErrorIf(Error::FileRead, size > (std::numeric_limits<std::uint64_t>::max() - (digit - '0')) / 10,
+                    "Size in pax header too big");
+                size = size * 10 + (digit - '0');
+            }
+            return size;
+        }
+
+        // Names in tar files are commonly relative to ".", which isn't part of the name in the package
+        std::string NormalizeName(std::string name)
+        {
+            while (name.compare(0, 2, "./") == 0)
+            {
+                name.erase(0, 2);
+            }
+            return name;
+        }
+    }
+
+    // Stream handed out for the current file. Reads go straight to the tar stream. The size of the file is
+    // known, so seeks that only query the size or go back to a position that wasn't read yet are allowed.
+    class TarFileStream final : public StreamBase
+    {
+    public:
+        TarFileStream(TarReader* owner, std::uint64_t entry, const std::string& name, std::uint64_t size) :
+            m_owner(owner), m_entry(entry), m_name(name), m_size(size) {}
+
+        HRESULT STDMETHODCALLTYPE Read(void* buffer, ULONG countBytes, ULONG* bytesRead) noexcept override try
+        {
+            if (bytesRead) { *bytesRead = 0; }
+            ThrowErrorIf(Error::FileSeek, m_position != m_read, "Tar entries can only be read forward");
+            ULONG toRead = static_cast<ULONG>(std::min<std::uint64_t>(countBytes, m_size - m_read));
+            ULONG read = m_owner->ReadFileData(m_entry, buffer, toRead);
+            m_read += read;
+            m_position = m_read;
+            if (bytesRead) { *bytesRead = read; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        HRESULT STDMETHODCALLTYPE Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER* newPosition) noexcept override try
+        {
+            std::int64_t position = 0;
+            switch (origin)
+            {
+            case Reference::CURRENT:
+                position = static_cast<std::int64_t>(m_position) + move.QuadPart;
+                break;
+            case Reference::START:
+                position = move.QuadPart;
+                break;
+            case Reference::END:
+                position = static_cast<std::int64_t>(m_size) + move.QuadPart;
+                break;
+            }
+            ThrowErrorIf(Error::FileSeek, position < 0, "Seek before the start of the tar entry");
+            m_position = static_cast<std::uint64_t>(position);
+            if (newPosition) { newPosition->QuadPart = m_position; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        std::uint64_t GetSize() override { return m_size; }
+        bool IsCompressed() override { return false; }
+        std::string GetName() override { return m_name; }
+
+    protected:
+        TarReader* m_owner;
+        std::uint64_t m_entry;
+        std::string m_name;
+        std::uint64_t m_size;
+        std::uint64_t m_read = 0;
+        std::uint64_t m_position = 0;
+    };
+
+    TarReader::TarReader(const ComPtr<IStream>& stream) : m_stream(stream)
+    {
+    }
+
+    bool TarReader::NextFile(std::string& name, std::uint64_t& size)
+    {
+        Skip(m_remaining + m_padding);
+        m_remaining = 0;
+        m_padding = 0;
+        m_entry++;
+
+        std::vector<std::uint8_t> header(TarBlockSize);
+        std::string paxPath;
+        std::string paxSize;
+        std::string longName;
+        while (!m_ended)
+        {
+            if (!ReadHeader(header))
+            {
+                m_ended = true;
+                break;
+            }
+
+            char type = static_cast<char>(header[UstarField::Type]);
+            std::uint64_t entrySize = paxSize.empty() ? GetNumber(header, UstarField::Size, UstarField::SizeLength) : ParseSize(paxSize);
+            std::uint64_t padding = (TarBlockSize - (entrySize % TarBlockSize)) % TarBlockSize;
+
+            if (type == 'x' || type == 'g' || type == 'L')
+            {
+                std::string data;
+                ReadEntryData(entrySize, data);
+                Skip(padding);
+                if (type == 'x')
+                {
+                    ParsePaxRecords(data, paxPath, paxSize);
+                }
+                else if (type == 'L')
+                {
+                    longName = data.substr(0, data.find('\0'));
+                }
+                // Global pax headers apply to the whole archive, none of their keys matter for pack
+                continue;
+            }
+
+            std::string entryName;
+            if (!paxPath.empty())
+            {
+                entryName = paxPath;
+            }
+            else if (!longName.empty())
+            {
+                entryName = longName;
+            }
+            else
+            {
+                entryName = GetString(header, UstarField::Name, UstarField::NameLength);
+                auto prefix = GetString(header, UstarField::Prefix, UstarField::PrefixLength);
+                if (GetString(header, UstarField::Magic, 5) == "ustar" && !prefix.empty())
+                {
+                    entryName = prefix + "/" + entryName;
+                }
+            }
+            paxPath.clear();
+            paxSize.clear();
+            longName.clear();
+
+            // Regular files. Anything else is skipped with its data, if it has any.
+            if ((type == '0' || type == '\0' || type == '7') && !entryName.empty() && entryName.back() != '/')
+            {
+                m_name = NormalizeName(entryName);
+                m_size = entrySize;
+                m_remaining = entrySize;
+                m_padding = padding;
+                name = m_name;
+                size = m_size;
+                return true;
+            }
+            Skip(entrySize + padding);
+        }
+        return false;
+    }
+
+    ComPtr<IStream> TarReader::GetFileStream()
+    {
+        ThrowErrorIf(Error::InvalidState, m_ended, "No tar entry");
+        return ComPtr<IStream>::Make<TarFileStream>(this, m_entry, m_name, m_size);
+    }
+
+    ULONG TarReader::ReadFileData(std::uint64_t entry, void* buffer, ULONG countBytes)
+    {
+        ThrowErrorIf(Error::InvalidState, entry != m_entry, "Tar entry no longer available");
+        ULONG toRead = static_cast<ULONG>(std::min<std::uint64_t>(countBytes, m_remaining));
+        Read(buffer, toRead);
+        m_remaining -= toRead;
+        return toRead;
+    }
+
+    void TarReader::Read(void* buffer, std::size_t count)
+    {
+        auto bytes = static_cast<std::uint8_t*>(buffer);
+        while (count > 0)
+        {
+            ULONG read = 0;
+            ThrowHrIfFailed(m_stream->Read(bytes, static_cast<ULONG>(count), &read));
+            ThrowErrorIf(Error::FileRead, read == 0, "Unexpected end of tar stream");
+            bytes += read;
+            count -= read;
+        }
+    }
+
+    bool TarReader::ReadHeader(std::vector<std::uint8_t>& header)
+    {
+        // The archive ends with two zero filled blocks. Some writers only put one, or none.
+        ULONG read = 0;
+        ThrowHrIfFailed(m_stream->Read(header.data(), static_cast<ULONG>(header.size()), &read));
+        if (read == 0)
+        {
+            return false;
+        }
+        if (read < header.size())
+        {
+            Read(header.data() + read, header.size() - read);
+        }
+        if (std::all_of(header.begin(), header.end(), [](std::uint8_t byte) { return byte == 0; }))
+        {
+            return false;
+        }
+
+        // The checksum is calculated with the checksum field filled with spaces
+        std::uint64_t checksum = GetNumber(header, UstarField::Checksum, UstarField::ChecksumLength);
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < header.size(); i++)
+        {
+            bool inChecksum = (i >= UstarField::Checksum) && (i < UstarField::Checksum + UstarField::ChecksumLength);
+            sum += inChecksum ? ' ' : header[i];
+        }
+        ThrowErrorIf(Error::FileRead, sum != checksum, "Invalid tar header checksum");
+        return true;
+    }
+
+    void TarReader::ReadEntryData(std::uint64_t size, std::string& data)
+    {
+        // Only used for pax headers and GNU long names, which are small
+        ThrowErrorIf(Error::FileRead, size > 1024 * 1024, "Tar header entry too big");
+        data.resize(static_cast<std::size_t>(size));
+        if (size > 0)
+        {
+            Read(&data[0], data.size());
+        }
+    }
+
+    void TarReader::Skip(std::uint64_t count)
+    {
+        std::array<std::uint8_t, TarBlockSize * 8> buffer;
+        while (count > 0)
+        {
+            std::size_t chunk = static_cast<std::size_t>(std::min<std::uint64_t>(count, buffer.size()));
+            Read(buffer.data(), chunk);
+            count -= chunk;
+        }
+    }
+
+    // A pax record is "<length> <key>=<value>\n" where length includes itself
+    void TarReader::ParsePaxRecords(const std::string& records, std::string& path, std::string& size)
+    {
+        std::size_t position = 0;
+        while (position < records.size())
+        {
+            auto space = records.find(' ', position);
+            ThrowErrorIf(Error::FileRead, space == std::string::npos, "Invalid pax record");
+            auto length = ParseSize(records.substr(position, space - position));
+            ThrowErrorIf(Error::FileRead, (length <= space - position + 1) || (length > records.size() - position) ||
+                (records[position + length - 1] != '\n'), "Invalid pax record");
+            auto record = records.substr(space + 1, position + length - space - 2);
+            auto equals = record.find('=');
+            ThrowErrorIf(Error::FileRead, equals == std::string::npos, "Invalid pax record");
+            auto key = record.substr(0, equals);
+            if (key == "path")
+            {
+                path = record.substr(equals + 1);
+            }
+            else if (key == "size")
+            {
+                size = record.substr(equals + 1);
+            }
+            position += length;
+        }
+    }
+}
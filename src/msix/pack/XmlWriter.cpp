@@ -8,6 +8,7 @@
 #include "Exceptions.hpp"
 #include "MsixErrors.hpp"
 #include "StreamHelper.hpp"
+#include "Base64.hpp"
 
 #include <stack>
 #include <string>
@@ -20,6 +21,7 @@ namespace MSIX {
         // Adds xml header declaration plus the name of the root element
         void XmlWriter::StartWrite(const std::string& root, bool standalone)
         {
+            m_buffer.reserve(BufferSize);
             m_elements.emplace(root);
             Write(xmlStart);
             if (standalone)
@@ -72,17 +74,54 @@ namespace MSIX {
             if (m_elements.size() == 0)
             {
                 m_state = State::Finish;
+                Flush();
             }
         }
 
         void XmlWriter::AddAttribute(const std::string& name, const std::string& value)
         {
-            ThrowErrorIf(Error::XmlError, (m_state == State::Finish) || (m_state == State::ClosedElement), "Invalid call to AddAttribute");
-            Write(" "); // always write a space. We just wrote either an element or an attribute
-            Write(name); // name="value"
-            Write("=\"");
+            StartAttribute(name);
             WriteTextValue(value);
-            Write("\"");
+            Write('"');
+        }
+
+        // Numbers don't need escaping, the digits are written directly without a temporary string
+        void XmlWriter::AddAttribute(const std::string& name, std::uint64_t value)
+        {
+            StartAttribute(name);
+            char digits[20];
+            std::size_t position = sizeof(digits);
+            do
+            {
+                digits[--position] = static_cast<char>('0' + (value % 10));
+                value /= 10;
+            } while (value != 0);
+            Write(digits + position, sizeof(digits) - position);
+            Write('"');
+        }
+
+        // Base64 doesn't need escaping, it is encoded directly into the buffer
+        void XmlWriter::AddBase64Attribute(const std::string& name, const std::vector<std::uint8_t>& value)
+        {
+            StartAttribute(name);
+            auto size = Base64::GetEncodedSize(value.size());
+            if (m_buffer.size() + size > BufferSize)
+            {
+                Flush();
+            }
+            auto position = m_buffer.size();
+            m_buffer.resize(position + size);
+            Base64::Encode(value.data(), value.size(), &m_buffer[position]);
+            Write('"');
+        }
+
+        // name="
+        void XmlWriter::StartAttribute(const std::string& name)
+        {
+            ThrowErrorIf(Error::XmlError, (m_state == State::Finish) || (m_state == State::ClosedElement), "Invalid call to AddAttribute");
+            Write(' '); // always write a space. We just wrote either an element or an attribute
+            Write(name);
+            Write("=\"", 2);
         }
 
         ComPtr<IStream> XmlWriter::GetStream()
@@ -95,42 +134,48 @@ namespace MSIX {
         //  all ampersands (&) are replaced by &amp;
         //  all open angle brackets (<) are replaced by &lt;
         //  all closing angle brackets (>) are replaced by &gt;
-        //  and all #xD characters are replaced by &#xD; 
+        //  all #xD characters are replaced by &#xD;
+        //  and, because attribute values are quoted with them, all quotes (") are replaced by &quot;
+        // Runs of characters that don't need escaping are written at once.
         void XmlWriter::WriteTextValue(const std::string& value)
         {
-            for(int i = 0; i < value.size(); i++)
+            std::size_t start = 0;
+            for (std::size_t i = 0; i < value.size(); i++)
             {
-                if (value[i] == '&')
-                {
-                    Write("&amp;");
-                }
-                else if (value[i] == '<')
-                {
-                    Write("&lt;");
-                }
-                else if (value[i] == '>')
-                {
-                    Write("&gt;");
-                }
-                else if (value[i] == 0xd)
+                const char* replacement = nullptr;
+                std::size_t replacementSize = 0;
+                switch (value[i])
                 {
-                    Write("&#xD;");
-                }
-                else
-                {
-                    Write(value[i]);
+                case '&':  replacement = "&amp;"; replacementSize = 5; break;
+                case '<':  replacement = "&lt;";  replacementSize = 4; break;
+                case '>':  replacement = "&gt;";  replacementSize = 4; break;
+                case 0xd:  replacement = "&#xD;"; replacementSize = 5; break;
+                case '"':  replacement = "&quot;"; replacementSize = 6; break;
+                default: continue;
                 }
+                Write(value.data() + start, i - start);
+                Write(replacement, replacementSize);
+                start = i + 1;
             }
+            Write(value.data() + start, value.size() - start);
         }
 
-        void XmlWriter::Write(const std::string& toWrite)
+        void XmlWriter::Write(const char* toWrite, std::size_t size)
         {
-            Helper::WriteStringToStream(m_stream, toWrite);
+            if (m_buffer.size() + size > BufferSize)
+            {
+                Flush();
+            }
+            m_buffer.append(toWrite, size);
         }
 
-        void XmlWriter::Write(const char toWrite)
+        void XmlWriter::Flush()
         {
-            Helper::WriteStringToStream(m_stream, std::string(1, toWrite));
+            if (!m_buffer.empty())
+            {
+                Helper::WriteStringToStream(m_stream, m_buffer);
+                m_buffer.clear();
+            }
         }
 
 }
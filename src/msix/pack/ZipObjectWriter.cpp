@@ -7,10 +7,12 @@
 #include "ZipObject.hpp"
 #include "MsixErrors.hpp"
 #include "Exceptions.hpp"
-#include "ZipFileStream.hpp"
 #include "DeflateStream.hpp"
 #include "StreamHelper.hpp"
 #include "Encoding.hpp"
+#include "PackStatistics.hpp"
+
+#include <limits>
 
 namespace MSIX {
 
@@ -33,12 +35,43 @@ namespace MSIX {
         }
     };
 
-    ZipObjectWriter::ZipObjectWriter(const ComPtr<IStream>& stream) : ZipObject(stream)
+    // Stream returned to write the data of a file. The data only goes forward, right after the LFH, so the
+    // zip can be written to pipes.
+    class ZipFileDataStream final : public StreamBase
+    {
+    public:
+        ZipFileDataStream(std::string name, IStream* stream) : m_name(std::move(name)), m_stream(stream) {}
+
+        HRESULT STDMETHODCALLTYPE Write(const void *buffer, ULONG countBytes, ULONG *bytesWritten) noexcept override try
+        {
+            ULONG amountWritten = 0;
+            ThrowHrIfFailed(m_stream->Write(buffer, countBytes, &amountWritten));
+            ThrowErrorIf(Error::FileWrite, (countBytes != amountWritten), "Did not write as much as requested.");
+            if (bytesWritten) { *bytesWritten = amountWritten; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        std::string GetName() override { return m_name; }
+
+    protected:
+        std::string m_name;
+        ComPtr<IStream> m_stream;
+    };
+
+    // The output doesn't need to be seekable. If it isn't, the zip is assumed to start at the current position
+    // of the stream and the sizes of the files always go in data descriptors.
+    ZipObjectWriter::ZipObjectWriter(const ComPtr<IStream>& stream) : ZipObject(stream),
+        m_entryNames(0, EntryNameHash{ this }, EntryNameEqual{ this })
     {
+        ULARGE_INTEGER pos = {0};
+        m_seekable = SUCCEEDED(m_stream->Seek({0}, StreamBase::Reference::CURRENT, &pos));
+        m_position = m_seekable ? static_cast<std::uint64_t>(pos.QuadPart) : 0;
     }
 
-    // This is used for editing a package (aka signing)
-    ZipObjectWriter::ZipObjectWriter(const ComPtr<IStorageObject>& storageObject) : ZipObject(storageObject)
+    // This is used for editing a package (aka signing). The central directories of the files already in the
+    // package stay in m_centralDirectories and are written before the ones of the files added.
+    ZipObjectWriter::ZipObjectWriter(const ComPtr<IStorageObject>& storageObject) : ZipObject(storageObject),
+        m_entryNames(0, EntryNameHash{ this }, EntryNameEqual{ this })
     {
         // The storage object provided should had already initialize all the data.
         ThrowErrorIfNot(Error::Zip64EOCDRecord, m_endCentralDirectoryRecord.GetIsZip64(),
@@ -49,6 +82,7 @@ namespace MSIX {
         LARGE_INTEGER pos = {0};
         pos.QuadPart = m_zip64EndOfCentralDirectory.GetOffsetStartOfCD();
         ThrowHrIfFailed(m_stream->Seek(pos, StreamBase::Reference::START, nullptr));
+        m_position = m_zip64EndOfCentralDirectory.GetOffsetStartOfCD();
     }
 
     // IStorage
@@ -67,50 +101,59 @@ namespace MSIX {
     // IZipWriter
     std::pair<std::uint32_t, ComPtr<IStream>> ZipObjectWriter::PrepareToAddFile(const std::string& name, bool isCompressed)
     {
-        ThrowErrorIf(Error::InvalidState, m_state != ZipObjectWriter::State::ReadyForLfhOrClose, "Invalid zip writer state");
-
-        auto result = m_centralDirectories.find(name);
-        if (result != m_centralDirectories.end())
+        auto result = PrepareToAddRawFile(name, isCompressed);
+        if (isCompressed)
         {
-            auto message = "Adding duplicated file " + Encoding::DecodeFileName(name) + "to package";
-            ThrowErrorAndLog(Error::DuplicateFile, message.c_str());
+            result.second = ComPtr<IStream>::Make<DeflateStream>(result.second);
         }
+        return result;
+    }
+
+    std::pair<std::uint32_t, ComPtr<IStream>> ZipObjectWriter::PrepareToAddRawFile(const std::string& name, bool isCompressed)
+    {
+        ThrowErrorIf(Error::InvalidState, m_state != ZipObjectWriter::State::ReadyForLfhOrClose, "Invalid zip writer state");
+        AddEntry(name);
 
         // Get position were the lfh is going to be written
-        ULARGE_INTEGER pos = {0};
-        ThrowHrIfFailed(m_stream->Seek({0}, StreamBase::Reference::CURRENT, &pos));
+        std::uint64_t pos = GetPosition();
 
-        // Write lfh
+        // Write lfh, the data of the file goes right after it
         LocalFileHeader lfh;
         lfh.SetData(name, isCompressed);
-        lfh.WriteTo(m_stream);
+        QueueRecord(lfh);
+        FlushRecords();
 
-        m_lastLFH = std::make_pair(static_cast<std::uint64_t>(pos.QuadPart), std::move(lfh));
+        m_lastLFH = std::make_pair(pos, std::move(lfh));
         m_state = ZipObjectWriter::State::ReadyForFile;
 
-        ComPtr<IStream> zipStream = ComPtr<IStream>::Make<ZipFileStream>(name, isCompressed, m_stream.Get());
-        if (isCompressed)
-        {
-            zipStream = ComPtr<IStream>::Make<DeflateStream>(zipStream);
-        }
-
+        ComPtr<IStream> zipStream = ComPtr<IStream>::Make<ZipFileDataStream>(name, m_stream.Get());
         return std::make_pair(static_cast<std::uint32_t>(m_lastLFH.second.Size()), std::move(zipStream));
     }
 
+    std::uint64_t ZipObjectWriter::GetFileDataOffset()
+    {
+        ThrowErrorIf(Error::InvalidState, m_state != ZipObjectWriter::State::ReadyForFile, "Invalid zip writer state");
+        return m_lastLFH.first + m_lastLFH.second.Size();
+    }
+
     void ZipObjectWriter::EndFile(std::uint32_t crc, std::uint64_t compressedSize, std::uint64_t uncompressedSize, bool forceDataDescriptor)
     {
         ThrowErrorIf(Error::InvalidState, m_state != ZipObjectWriter::State::ReadyForFile, "Invalid zip writer state");
 
+        // The data of the file is already written, the LFH can't be rewritten if the output can't go back
+        m_position += compressedSize;
+        forceDataDescriptor = forceDataDescriptor || !m_seekable;
         if (forceDataDescriptor ||
             compressedSize > MaxSizeToNotUseDataDescriptor ||
             uncompressedSize > MaxSizeToNotUseDataDescriptor)
         {
             // Create and write data descriptor 
             DataDescriptor descriptor = DataDescriptor(crc, compressedSize, uncompressedSize);
-            descriptor.WriteTo(m_stream);
+            QueueRecord(descriptor);
         }
         else
         {
+            FlushRecords();
             // The sizes can fit in the LFH, rewrite it with the new data
             Helper::StreamPositionReset resetAfterLFHWrite{ m_stream.Get() };
 
@@ -126,41 +169,123 @@ namespace MSIX {
             m_lastLFH.second.WriteTo(m_stream);
         }
 
-        // Create and add cdh to map
-        CentralDirectoryFileHeader cdh;
-        cdh.SetData(m_lastLFH.second.GetFileName(), crc, compressedSize, uncompressedSize, m_lastLFH.first, m_lastLFH.second.GetCompressionMethod(), forceDataDescriptor);
-        m_centralDirectories.insert(std::make_pair(m_lastLFH.second.GetFileName(), std::move(cdh)));
+        // Complete the entry added by PrepareToAddRawFile
+        auto& entry = m_entries.back();
+        entry.compressedSize = compressedSize;
+        entry.uncompressedSize = uncompressedSize;
+        entry.lfhOffset = m_lastLFH.first;
+        entry.crc = crc;
+        entry.compressionMethod = m_lastLFH.second.GetCompressionMethod();
+        entry.dataDescriptor = forceDataDescriptor;
         m_state = ZipObjectWriter::State::ReadyForLfhOrClose;
     }
 
+    // Adds the entry of a new file, the rest of it is filled by EndFile. Fails if the name is already in the zip.
+    void ZipObjectWriter::AddEntry(const std::string& name)
+    {
+        ThrowErrorIf(Error::InvalidParameter, name.size() > std::numeric_limits<std::uint16_t>::max(), "File name too long");
+        CentralDirectoryEntry entry = {};
+        entry.nameOffset = m_names.size();
+        entry.nameSize = static_cast<std::uint16_t>(name.size());
+        m_names.append(name);
+        m_entries.push_back(entry);
+        if ((m_centralDirectories.find(name) != m_centralDirectories.end()) ||
+            !m_entryNames.insert(m_entries.size() - 1).second)
+        {
+            m_entries.pop_back();
+            m_names.resize(entry.nameOffset);
+            auto message = "Adding duplicated file " + Encoding::DecodeFileName(name) + "to package";
+            ThrowErrorAndLog(Error::DuplicateFile, message.c_str());
+        }
+    }
+
+    // FNV-1a of the name
+    std::size_t ZipObjectWriter::EntryNameHash::operator()(std::size_t index) const
+    {
+        const auto& entry = writer->m_entries[index];
+        const char* name = writer->m_names.data() + entry.nameOffset;
+        std::uint64_t hash = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < entry.nameSize; i++)
+        {
+            hash = (hash ^ static_cast<std::uint8_t>(name[i])) * 1099511628211ULL;
+        }
+        return static_cast<std::size_t>(hash);
+    }
+
+    bool ZipObjectWriter::EntryNameEqual::operator()(std::size_t left, std::size_t right) const
+    {
+        const auto& leftEntry = writer->m_entries[left];
+        const auto& rightEntry = writer->m_entries[right];
+        return (leftEntry.nameSize == rightEntry.nameSize) &&
+            (writer->m_names.compare(leftEntry.nameOffset, leftEntry.nameSize,
+                writer->m_names, rightEntry.nameOffset, rightEntry.nameSize) == 0);
+    }
+
     void ZipObjectWriter::Close()
     {
         ThrowErrorIf(Error::InvalidState, m_state != ZipObjectWriter::State::ReadyForLfhOrClose, "Invalid zip writer state");
-        // Write central directories
-        ULARGE_INTEGER startOfCdh = {0};
-        ThrowHrIfFailed(m_stream->Seek({0}, StreamBase::Reference::CURRENT, &startOfCdh));
-        std::size_t cdhsSize = 0;
+        // Write central directories, the ones of an edited package first and then the ones of the files added
+        // in the order they were added.
+        std::uint64_t startOfCdh = GetPosition();
+        auto queueCentralDirectory = [this](CentralDirectoryFileHeader& cdh)
+        {
+            QueueRecord(cdh);
+            if (m_records.size() >= MaxQueuedRecordBytes)
+            {
+                FlushRecords();
+            }
+        };
         for (auto& cdh : m_centralDirectories)
         {
-            cdhsSize += cdh.second.Size();
-            cdh.second.WriteTo(m_stream);
+            queueCentralDirectory(cdh.second);
+        }
+        std::string name;
+        for (const auto& entry : m_entries)
+        {
+            name.assign(m_names, entry.nameOffset, entry.nameSize);
+            CentralDirectoryFileHeader cdh;
+            cdh.SetData(name, entry.crc, entry.compressedSize, entry.uncompressedSize, entry.lfhOffset,
+                entry.compressionMethod, entry.dataDescriptor);
+            queueCentralDirectory(cdh);
         }
 
         // Write zip64 end of cds
-        ULARGE_INTEGER startOfZip64EndOfCds = {0};
-        ThrowHrIfFailed(m_stream->Seek({0}, StreamBase::Reference::CURRENT, &startOfZip64EndOfCds));
-        m_zip64EndOfCentralDirectory.SetData(m_centralDirectories.size(), static_cast<std::uint64_t>(cdhsSize), 
-            static_cast<std::uint64_t>(startOfCdh.QuadPart));
-        m_zip64EndOfCentralDirectory.WriteTo(m_stream);
+        std::uint64_t startOfZip64EndOfCds = GetPosition();
+        auto entries = static_cast<std::uint64_t>(m_centralDirectories.size() + m_entries.size());
+        m_zip64EndOfCentralDirectory.SetData(entries, startOfZip64EndOfCds - startOfCdh, startOfCdh);
+        QueueRecord(m_zip64EndOfCentralDirectory);
 
         // Write zip64 locator
-        m_zip64Locator.SetData(static_cast<std::uint64_t>(startOfZip64EndOfCds.QuadPart));
-        m_zip64Locator.WriteTo(m_stream);
+        m_zip64Locator.SetData(startOfZip64EndOfCds);
+        QueueRecord(m_zip64Locator);
 
         // Because we only use zip64, EndCentralDirectoryRecord never changes
-        m_endCentralDirectoryRecord.WriteTo(m_stream);
+        QueueRecord(m_endCentralDirectoryRecord);
+        FlushRecords();
 
         m_state = ZipObjectWriter::State::Closed;
     }
 
+    void ZipObjectWriter::FlushRecords()
+    {
+        if (m_records.empty())
+        {
+            return;
+        }
+        ULONG bytesWritten = 0;
+        ThrowHrIfFailed(m_stream->Write(m_records.data(), static_cast<ULONG>(m_records.size()), &bytesWritten));
+        ThrowErrorIf(Error::FileWrite, bytesWritten != m_records.size(), "Did not write as much as requested.");
+        auto& statistics = Global::PackStatistics::Get();
+        statistics.zipRecordWrites++;
+        statistics.zipRecordBytes += m_records.size();
+        m_position += m_records.size();
+        m_records.clear();
+    }
+
+    // Position in the zip where the next record goes, including the ones not written yet. It is tracked here
+    // instead of asking the stream, which might not be seekable.
+    std::uint64_t ZipObjectWriter::GetPosition()
+    {
+        return m_position + m_records.size();
+    }
 }
\ No newline at end of file
@@ -32,12 +32,25 @@ namespace MSIX {
         Bcp47Entry(u8"zh-tw", u8"zh-Hant-TW"),
     };
 
+    static std::string ToLower(const std::string& value)
+    {
+        std::string result;
+        result.resize(value.size());
+        std::transform(value.begin(), value.end(), result.begin(), ::tolower);
+        return result;
+    }
+
+    // Languages have up to 3 characters and scripts 4, so they fit as they are.
+    static std::uint32_t Pack(const std::string& subtag)
+    {
+        std::uint32_t result = 0;
+        for (auto c : subtag) { result = (result << 8) | static_cast<std::uint8_t>(::tolower(c)); }
+        return result;
+    }
+
     Bcp47Tag::Bcp47Tag(const std::string& fullTag)
     {
-        std::string fullTagLower;
-        fullTagLower.resize(fullTag.size());
-        std::transform(fullTag.begin(), fullTag.end(), fullTagLower.begin(), ::tolower);
-        const auto& tagFound = std::find(std::begin(bcp47List), std::end(bcp47List),fullTagLower.c_str());
+        const auto& tagFound = std::find(std::begin(bcp47List), std::end(bcp47List), ToLower(fullTag).c_str());
         std::string bcp47Tag;
         if (tagFound == std::end(bcp47List))
         {
@@ -73,47 +86,45 @@ namespace MSIX {
                 m_region = tag;
             }
         }
+        Normalize();
     }
 
-    Bcp47ClosenessMeasure Bcp47Tag::Compare(const Bcp47Tag& otherTag)
+    void Bcp47Tag::Normalize()
     {
-        std::string thisLanguage;
-        thisLanguage.resize(m_language.size());
-        std::transform(m_language.begin(), m_language.end(), thisLanguage.begin(), ::tolower);
-
-        std::string otherLanguage;
-        otherLanguage.resize(otherTag.m_language.size());
-        std::transform(otherTag.m_language.begin(), otherTag.m_language.end(), otherLanguage.begin(), ::tolower);
-
-        std::string thisScript;
-        thisScript.resize(m_script.size());
-        std::transform(m_script.begin(), m_script.end(), thisScript.begin(), ::tolower);
-
-        std::string otherScript;
-        otherScript.resize(otherTag.m_script.size());
-        std::transform(otherTag.m_script.begin(), otherTag.m_script.end(), otherScript.begin(), ::tolower);
+        ThrowErrorIf(Error::Unexpected, (m_language.size() > 3 || m_script.size() > 4), "Malformed Bcp47 tag");
+        m_key = (static_cast<std::uint64_t>(Pack(m_language)) << 32) | Pack(m_script);
+        m_normalizedRegion = ToLower(m_region);
+        m_isAnyLanguage = (ToLower(m_language) == "und");
+    }
 
-        std::string thisRegion;
-        thisRegion.resize(m_region.size());
-        std::transform(m_region.begin(), m_region.end(), thisRegion.begin(), ::tolower);
+    Bcp47ClosenessMeasure Bcp47Tag::Compare(const Bcp47Tag& otherTag) const
+    {
+        return Compare(otherTag, m_normalizedRegion);
+    }
 
-        std::string otherRegion;
-        otherRegion.resize(otherTag.m_region.size());
-        std::transform(otherTag.m_region.begin(), otherTag.m_region.end(), otherRegion.begin(), ::tolower);
+    // Compares the neutral form of this Bcp47 tag
+    Bcp47ClosenessMeasure Bcp47Tag::CompareNeutral(const Bcp47Tag& otherTag) const
+    {
+        static const std::string neutral;
+        return Compare(otherTag, neutral);
+    }
 
+    // Compares this tag, with the given region, to the other tag
+    Bcp47ClosenessMeasure Bcp47Tag::Compare(const Bcp47Tag& otherTag, const std::string& region) const
+    {
         // Compare for und-*
-        if (thisLanguage == "und" || otherLanguage == "und")
+        if (m_isAnyLanguage || otherTag.m_isAnyLanguage)
         {
-            if (thisScript == otherScript)
+            if (static_cast<std::uint32_t>(m_key) == static_cast<std::uint32_t>(otherTag.m_key))
             {
                 return Bcp47ClosenessMeasure::AnyMatchWithScript;
             }
             return Bcp47ClosenessMeasure::AnyMatch;
         }
 
-        if (thisLanguage == otherLanguage && thisScript == otherScript)
+        if (m_key == otherTag.m_key)
         {
-            if (thisRegion == otherRegion)
+            if (region == otherTag.m_normalizedRegion)
             {
                 return Bcp47ClosenessMeasure::ExactMatch;
             }
@@ -123,13 +134,6 @@ namespace MSIX {
         return Bcp47ClosenessMeasure::NoMatch;
     }
 
-    // Compares the neutral form of this Bcp47 tag
-    Bcp47ClosenessMeasure Bcp47Tag::CompareNeutral(const Bcp47Tag& otherTag)
-    {
-        Bcp47Tag neutral(m_language, m_script, "");
-        return neutral.Compare(otherTag);
-    }
-
     const std::string Bcp47Tag::GetFullTag() const
     {
         std::string result = m_language;
@@ -141,6 +145,7 @@ namespace MSIX {
     void Applicability::InitializeLanguages()
     {
         m_languages = GetLanguages();
+        IndexLanguages();
     }
 
     void Applicability::InitializeLanguages(IMsixApplicabilityLanguagesEnumerator* languagesEnumerator)
@@ -155,14 +160,47 @@ namespace MSIX {
 
             ThrowHrIfFailed(languagesEnumerator->MoveNext(&hasNext));
         }
+        IndexLanguages();
+    }
+
+    void Applicability::IndexLanguages()
+    {
+        m_firstLanguageByKey.clear();
+        m_firstAnyLanguage = std::string::npos;
+        for (std::size_t i = 0; i < m_languages.size(); i++)
+        {
+            if (m_languages[i].IsAnyLanguage())
+            {
+                m_firstAnyLanguage = std::min(m_firstAnyLanguage, i);
+            }
+            else
+            {   // Keeps the first one
+                m_firstLanguageByKey.emplace(m_languages[i].GetKey(), i);
+            }
+        }
+    }
+
+    // Returns the index of the first user language that is any match for the package language, npos if none.
+    std::size_t Applicability::FindFirstMatchingLanguage(const Bcp47Tag& packageLanguage) const
+    {
+        if (m_languages.empty())
+        {
+            return std::string::npos;
+        }
+        if (packageLanguage.IsAnyLanguage())
+        {
+            return 0;
+        }
+        auto found = m_firstLanguageByKey.find(packageLanguage.GetKey());
+        return std::min(m_firstAnyLanguage, (found == m_firstLanguageByKey.end()) ? std::string::npos : found->second);
     }
 
     void Applicability::AddPackageIfApplicable(ComPtr<IAppxPackageReader>& reader, APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE packageType, const ComPtr<IAppxBundleManifestPackageInfo>& bundlePackageInfo)
     {
         auto bundlePackageInfoInternal = bundlePackageInfo.As<IAppxBundleManifestPackageInfoInternal>();
         auto packageName = bundlePackageInfoInternal->GetFileName();
-        auto packageLanguages = bundlePackageInfoInternal->GetLanguages();
-        auto packageScales = bundlePackageInfoInternal->GetScales();
+        const auto& packageLanguages = bundlePackageInfoInternal->GetLanguages();
+        const auto& packageScales = bundlePackageInfoInternal->GetScales();
         
         // If there are not qualified resources the package is always applicable
         // MSIX_APPLICABILITY_NONE indicates that we should skip all applicability checks
@@ -189,11 +227,20 @@ namespace MSIX {
                 return;
             }
 
+            // Only the first user language that matches any of the package languages decides. The languages before
+            // it don't match any of them, so it is found in the index instead of comparing all of them.
+            std::size_t first = std::string::npos;
+            for (const auto& packageLanguage : packageLanguages)
+            {
+                first = std::min(first, FindFirstMatchingLanguage(packageLanguage));
+            }
+
             bool hasMatch = false;
             bool hasVariantMatch = false;
-            for (auto& systemLanguage : m_languages)
+            if (first != std::string::npos)
             {
-                for (auto& packageLanguage : packageLanguages)
+                const auto& systemLanguage = m_languages[first];
+                for (const auto& packageLanguage : packageLanguages)
                 {
                     auto closeness = systemLanguage.Compare(packageLanguage);
                     if (closeness == Bcp47ClosenessMeasure::ExactMatch)
@@ -220,18 +267,14 @@ namespace MSIX {
                         }
                     }
                 }
-                // If we know this package is applicable there's no need to keep looking
-                // for other system languages
-                if (hasMatch)
-                {
-                    m_applicablePackages.push_back(std::make_pair(packageName,std::move(reader)));
-                    break;
-                }
-                if (hasVariantMatch)
-                {
-                    m_variantFormPackages.push_back(std::make_pair(packageName, std::move(reader)));
-                    break;
-                }
+            }
+            if (hasMatch)
+            {
+                m_applicablePackages.push_back(std::make_pair(packageName,std::move(reader)));
+            }
+            else if (hasVariantMatch)
+            {
+                m_variantFormPackages.push_back(std::make_pair(packageName, std::move(reader)));
             }
             if (packageType == APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE_APPLICATION)
             {
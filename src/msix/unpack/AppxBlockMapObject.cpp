@@ -9,6 +9,7 @@
 #include "BlockMapStream.hpp"
 #include "MSIXResource.hpp"
 #include "Enumerators.hpp"
+#include "DocumentCache.hpp"
 
 /* Example XML:
 <?xml version="1.0" encoding="UTF-8"?>
@@ -49,34 +50,54 @@ namespace MSIX {
         return result;
     }
 
-    AppxBlockMapObject::AppxBlockMapObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
+    // Memory held by the table: the map nodes, the names that don't fit in a std::string and the blocks.
+    static std::uint64_t GetTableSize(const BlockMapTable& table)
+    {
+        const std::size_t nodeOverhead = 4 * sizeof(void*);
+        std::uint64_t size = sizeof(BlockMapTable);
+        for (const auto& file : table)
+        {
+            size += nodeOverhead + sizeof(file) + ((file.first.capacity() > sizeof(std::string)) ? file.first.capacity() : 0);
+            size += file.second.blocks.capacity() * sizeof(Block);
+            for (const auto& block : file.second.blocks)
+            {
+                size += block.hash.capacity();
+            }
+        }
+        return size;
+    }
+
+    static DocumentCache::Value ReadBlockMap(void* factory, const ComPtr<IStream>& stream, std::uint64_t& size)
     {
         ComPtr<IXmlFactory> xmlFactory;
-        ThrowHrIfFailed(factory->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
+        ThrowHrIfFailed(reinterpret_cast<IMsixFactory*>(factory)->QueryInterface(UuidOfImpl<IXmlFactory>::iid, reinterpret_cast<void**>(&xmlFactory)));
         auto dom = xmlFactory->CreateDomFromStream(XmlContentType::AppxBlockMapXml, stream);
+        auto table = std::make_shared<BlockMapTable>();
 
         struct _context
         {
-            AppxBlockMapObject* self;
-            IMsixFactory*       factory;
-            size_t              countFilesFound;
-            IXmlDom*            dom;
+            BlockMapTable* table;
+            IXmlDom*       dom;
         };
-        _context context = { this, factory, 0, dom.Get() };
+        _context context = { table.get(), dom.Get() };
 
         XmlVisitor visitor(static_cast<void*>(&context), [](void* c, const ComPtr<IXmlElement>& fileNode)->bool
         {
-            const auto& name = fileNode->GetAttributeValue(XmlAttributeName::Name);
+            auto name = fileNode->GetAttributeValueView(XmlAttributeName::Name);
             ThrowErrorIf(Error::BlockMapSemanticError, (name == "[Content_Types].xml"), "[Content_Types].xml cannot be in the AppxBlockMap.xml file");
 
             _context* context = reinterpret_cast<_context*>(c);
-            std::ostringstream builder;
-            builder << "Duplicate file: '" << name << "' specified in AppxBlockMap.xml.";
-            ThrowErrorIf(Error::BlockMapSemanticError, (context->self->m_blockMap.find(name) != context->self->m_blockMap.end()), builder.str().c_str());
+            auto entry = context->table->emplace(name.str(), BlockMapEntry());
+            if (!entry.second)
+            {
+                std::ostringstream builder;
+                builder << "Duplicate file: '" << entry.first->first << "' specified in AppxBlockMap.xml.";
+                ThrowErrorAndLog(Error::BlockMapSemanticError, builder.str().c_str());
+            }
 
             std::uint64_t sizeAttribute = GetNumber<std::uint64_t>(fileNode, XmlAttributeName::Size, BLOCKMAP_BLOCK_SIZE);
 
-            std::vector<Block> blocks;
+            auto& blocks = entry.first->second.blocks;
             struct _contextBlock
             {
                 std::vector<Block>* blocks;
@@ -93,31 +114,41 @@ namespace MSIX {
 
             ThrowErrorIf(Error::BlockMapSemanticError, (0 == blocks.size() && 0 != sizeAttribute), "If size is non-zero, then there must be 1+ blocks.");
 
-            context->self->m_blockMap.insert(std::make_pair(name, std::move(blocks)));
-            context->self->m_blockMapFiles.insert(std::make_pair(name,
-                ComPtr<IAppxBlockMapFile>::Make<AppxBlockMapFile>(
-                    context->factory,
-                    &(context->self->m_blockMap[name]),
-                    GetNumber<std::uint32_t>(fileNode, XmlAttributeName::BlockMap_File_LocalFileHeaderSize, 0),
-                    name,
-                    sizeAttribute
-                )));
-            context->countFilesFound++;
+            entry.first->second.localFileHeaderSize = GetNumber<std::uint32_t>(fileNode, XmlAttributeName::BlockMap_File_LocalFileHeaderSize, 0);
+            entry.first->second.uncompressedSize = sizeAttribute;
             return true;
         });
         dom->ForEachElementIn(dom->GetDocument(), XmlQueryName::BlockMap_File, visitor);
-        ThrowErrorIf(Error::XmlError, (0 == context.countFilesFound), "Empty AppxBlockMap.xml");
+        ThrowErrorIf(Error::XmlError, table->empty(), "Empty AppxBlockMap.xml");
+        size = GetTableSize(*table);
+        return table;
+    }
+
+    AppxBlockMapObject::AppxBlockMapObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
+    {
+        m_blockMap = factory->GetDocumentCache().Get<BlockMapTable>(DocumentCache::Document::BlockMap, stream, factory, ReadBlockMap);
+        for (const auto& file : *m_blockMap)
+        {
+            m_blockMapFiles.emplace_hint(m_blockMapFiles.end(), file.first,
+                ComPtr<IAppxBlockMapFile>::Make<AppxBlockMapFile>(
+                    factory,
+                    &file.second.blocks,
+                    file.second.localFileHeaderSize,
+                    file.first,
+                    file.second.uncompressedSize
+                ));
+        }
     }
 
     // IVerifierObject
     ComPtr<IStream> AppxBlockMapObject::GetValidationStream(const std::string& part, const ComPtr<IStream>& stream)
     {
         ThrowErrorIf(Error::InvalidParameter, (part.empty() || !stream), "bad input");
-        auto item = m_blockMap.find(part);
+        auto item = m_blockMap->find(part);
         std::ostringstream builder;
         builder << "file: '" << part << "' not tracked by blockmap.";
-        ThrowErrorIf(Error::BlockMapSemanticError, item == m_blockMap.end(), builder.str().c_str());
-        return ComPtr<IStream>::Make<BlockMapStream>(m_factory, part, stream, item->second);
+        ThrowErrorIf(Error::BlockMapSemanticError, item == m_blockMap->end(), builder.str().c_str());
+        return ComPtr<IStream>::Make<BlockMapStream>(m_factory, part, stream, item->second.blocks);
     }
 
     // IAppxBlockMapReader
@@ -170,9 +201,9 @@ namespace MSIX {
 
     std::vector<Block> AppxBlockMapObject::GetBlocks(const std::string& fileName)
     {
-        auto index = m_blockMap.find(fileName);
-        ThrowErrorIf(Error::FileNotFound, (index == m_blockMap.end()), "File not in blockmap");
-        return index->second;
+        auto index = m_blockMap->find(fileName);
+        ThrowErrorIf(Error::FileNotFound, (index == m_blockMap->end()), "File not in blockmap");
+        return index->second.blocks;
     }
 
     ComPtr<IAppxBlockMapFile> AppxBlockMapObject::GetFile(const std::string& fileName)
@@ -5,13 +5,12 @@
 
 #include "AppxBundleManifest.hpp"
 #include "AppxPackageInfo.hpp"
+#include "AppxManifestValidation.hpp"
 #include "ComHelper.hpp"
 #include "Enumerators.hpp"
 #include "Encoding.hpp"
 #include "IXml.hpp"
 
-#include <regex>
-
 namespace MSIX {
 
     AppxBundleManifestObject::AppxBundleManifestObject(IMsixFactory* factory, const ComPtr<IStream>& stream) : m_factory(factory), m_stream(stream)
@@ -48,17 +47,18 @@ namespace MSIX {
             _context* context = reinterpret_cast<_context*>(c);
             const auto& name = packageNode->GetAttributeValue(XmlAttributeName::Bundle_Package_FileName);
 
-            std::ostringstream builder;
-            builder << "Duplicate file: '" << name << "' specified in AppxBundleManifest.xml.";
-            ThrowErrorIf(Error::AppxManifestSemanticError,
-                std::find(std::begin(context->packageNames), std::end(context->packageNames), name) != context->packageNames.end(),
-                builder.str().c_str());
+            if (std::find(std::begin(context->packageNames), std::end(context->packageNames), name) != context->packageNames.end())
+            {
+                std::ostringstream builder;
+                builder << "Duplicate file: '" << name << "' specified in AppxBundleManifest.xml.";
+                ThrowErrorAndLog(Error::AppxManifestSemanticError, builder.str().c_str());
+            }
             context->packageNames.push_back(name);
 
             const auto& version        = packageNode->GetAttributeValue(XmlAttributeName::Version);
             const auto& resourceId     = packageNode->GetAttributeValue(XmlAttributeName::ResourceId);
             const auto& architecture   = packageNode->GetAttributeValue(XmlAttributeName::Bundle_Package_Architecture);
-            const auto& type           = packageNode->GetAttributeValue(XmlAttributeName::Bundle_Package_Type);
+            const auto type            = packageNode->GetAttributeValueView(XmlAttributeName::Bundle_Package_Type);
             const auto size            = GetNumber<std::uint64_t>(packageNode, XmlAttributeName::Size, 0);
             const auto offset          = GetNumber<std::uint64_t>(packageNode, XmlAttributeName::Bundle_Package_Offset, 0);
 
@@ -79,10 +79,10 @@ namespace MSIX {
                 const auto& language = resourceNode->GetAttributeValue(XmlAttributeName::Language);
                 if (!language.empty()) { resourcesContext->languages.push_back(Bcp47Tag(language)); }
 
-                const auto& scale = resourceNode->GetAttributeValue(XmlAttributeName::Scale);
+                const auto scale = resourceNode->GetAttributeValueView(XmlAttributeName::Scale);
                 if (!scale.empty()) 
                 { 
-                    UINT32 scaleInt = std::stoi(scale);
+                    UINT32 scaleInt = std::stoi(scale.str());
                     resourcesContext->scales.push_back(scaleInt); 
                 }
 
@@ -149,8 +149,7 @@ namespace MSIX {
         APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE packageType):
         m_factory(factory), m_fileName(name), m_size(size), m_offset(offset), m_languages(std::move(languages)), m_scales(scales), m_packageType(packageType)
     {
-        std::regex e (".+\\.((appx)|(msix))");
-        ThrowErrorIf(Error::AppxManifestSemanticError, !std::regex_match(m_fileName, e), "Invalid FileName attribute in AppxBundleManifest.xml");
+        ThrowErrorIf(Error::AppxManifestSemanticError, !AppxManifestValidation::IsPackageFileNameValid(m_fileName), "Invalid FileName attribute in AppxBundleManifest.xml");
         m_packageId = ComPtr<IAppxManifestPackageId>::Make<AppxManifestPackageId>(factory, bundleName, version, resourceId, architecture, publisher);
     }
 
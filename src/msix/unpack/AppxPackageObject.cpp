@@ -19,6 +19,11 @@
 #include "MsixFeatureSelector.hpp"
 #include "ScopeExit.hpp"
 #include "StringHelper.hpp"
+#include "UnpackState.hpp"
+#include "TarDirectoryObject.hpp"
+#include "CursorStream.hpp"
+#include "ParallelHelper.hpp"
+#include "DocumentCache.hpp"
 
 #ifdef BUNDLE_SUPPORT
 #include "Applicability.hpp"
@@ -32,9 +37,127 @@
 #include <limits>
 #include <algorithm>
 #include <array>
+#include <mutex>
 
 namespace MSIX {
 
+#ifdef BUNDLE_SUPPORT
+    namespace {
+
+        // Finds the stream of a package listed in the bundle manifest. isInContainer is set when the package is
+        // stored in the bundle, as opposed to being a separate file of a flat bundle.
+        ComPtr<IStream> LocateInnerPackage(IMsixFactory* factory, IStorageObject* container,
+            const ComPtr<IAppxBundleManifestPackageInfo>& package, bool& isInContainer)
+        {
+            auto bundleInfoInternal = package.As<IAppxBundleManifestPackageInfoInternal>();
+            auto packageName = bundleInfoInternal->GetFileName();
+            auto packageStream = container->GetFile(Encoding::EncodeFileName(packageName));
+            isInContainer = false;
+
+            if (packageStream)
+            {   // The package is in the bundle. Verify is not compressed.
+                auto zipStream = packageStream.As<IStreamInternal>();
+                ThrowErrorIf(Error::AppxManifestSemanticError, zipStream->IsCompressed(), "Packages cannot be compressed");
+                isInContainer = true;
+            }
+            else if (!packageStream && (bundleInfoInternal->GetOffset() == 0)) // This is a flat bundle.
+            {
+                // We should only do this for flat bundles. If we do it for normal bundles and the user specify a 
+                // stream factory we will basically unpack any package the user wants with the same name as the package
+                // we are looking, which sounds dangerous.
+                ComPtr<IUnknown> streamFactoryUnk;
+                auto factoryOverrides = ComPtr<IMsixFactory>(factory).As<IMsixFactoryOverrides>();
+                ThrowHrIfFailed(factoryOverrides->GetCurrentSpecifiedExtension(MSIX_FACTORY_EXTENSION_STREAM_FACTORY, &streamFactoryUnk));
+
+                if(streamFactoryUnk.Get() != nullptr)
+                {
+                    auto streamFactory = streamFactoryUnk.As<IMsixStreamFactory>();
+                    ThrowHrIfFailed(streamFactory->CreateStreamOnRelativePathUtf8(packageName.c_str(), &packageStream));
+                }
+                else
+                {   // User didn't specify a stream factory implementation. Assume packages are in the same location
+                    // as the bundle.
+                    auto containerName = container->GetFileName();
+                    #ifdef WIN32
+                    auto lastSeparator = containerName.find_last_of('\\');
+                    #else
+                    auto lastSeparator = containerName.find_last_of('/');
+                    #endif
+                    auto expandedPackageName = containerName.substr(0, lastSeparator + 1) + packageName;
+                    ThrowHrIfFailed(CreateStreamOnFile(const_cast<char*>(expandedPackageName.c_str()), true, &packageStream));
+                }
+                ThrowErrorIfNot(Error::FileNotFound, packageStream, "Package from a flat bundle is not present");
+            }
+            else
+            {
+                ThrowErrorIfNot(Error::FileNotFound, packageStream, "Package is not in container");
+            }
+
+            // Semantic checks
+            LARGE_INTEGER start = { 0 };
+            ULARGE_INTEGER end = { 0 };
+            ThrowHrIfFailed(packageStream->Seek(start, StreamBase::Reference::END, &end));
+            ThrowHrIfFailed(packageStream->Seek(start, StreamBase::Reference::START, nullptr));
+            
+            UINT64 size;
+            ThrowHrIfFailed(package->GetSize(&size));
+            ThrowErrorIf(Error::AppxManifestSemanticError, end.u.LowPart != size,
+                "Size mistmach of package between AppxManifestBundle.appx and container");
+            return packageStream;
+        }
+
+        // Creates a reader for the package, which validates it, and checks that it matches its entry in the
+        // bundle manifest.
+        ComPtr<IAppxPackageReader> ValidateInnerPackage(IMsixFactory* factory, const ComPtr<IAppxBundleManifestPackageInfo>& package,
+            const ComPtr<IStream>& packageStream)
+        {
+            auto appxFactory = ComPtr<IMsixFactory>(factory).As<IAppxFactory>();
+            ComPtr<IAppxPackageReader> reader;
+            ThrowHrIfFailed(appxFactory->CreatePackageReader(packageStream.Get(), &reader));
+            ComPtr<IAppxManifestReader> innerPackageManifest;
+            ThrowHrIfFailed(reader->GetManifest(&innerPackageManifest));
+            // Do semantic checks to validate the relationship between the AppxBundleManifest and the AppxManifest.
+            ComPtr<IAppxManifestPackageId> bundlePackageId;
+            ThrowHrIfFailed(package->GetPackageId(&bundlePackageId));
+            auto bundlePackageIdInternal = bundlePackageId.As<IAppxManifestPackageIdInternal>();
+
+            ComPtr<IAppxManifestPackageId> innerPackageId;
+            ThrowHrIfFailed(innerPackageManifest->GetPackageId(&innerPackageId));
+            auto innerPackageIdInternal = innerPackageId.As<IAppxManifestPackageIdInternal>();
+            ThrowErrorIf(Error::AppxManifestSemanticError,
+                (innerPackageIdInternal->GetPublisher() != bundlePackageIdInternal->GetPublisher()),
+                "AppxBundleManifest.xml and AppxManifest.xml publisher mismatch");
+            UINT64 bundlePackageVersion = 0;
+            UINT64 innerPackageVersion = 0;
+            ThrowHrIfFailed(bundlePackageId->GetVersion(&bundlePackageVersion));
+            ThrowHrIfFailed(innerPackageId->GetVersion(&innerPackageVersion));
+            ThrowErrorIf(Error::AppxManifestSemanticError,
+                (innerPackageVersion != bundlePackageVersion),
+                "AppxBundleManifest.xml and AppxManifest.xml version mismatch");
+            ThrowErrorIf(Error::AppxManifestSemanticError,
+                (innerPackageIdInternal->GetName() != bundlePackageIdInternal->GetName()),
+                "AppxBundleManifest.xml and AppxManifest.xml name mismatch");
+            ThrowErrorIf(Error::AppxManifestSemanticError,
+                (innerPackageIdInternal->GetArchitecture() != bundlePackageIdInternal->GetArchitecture()) &&
+                !(innerPackageIdInternal->GetArchitecture().empty() && (bundlePackageIdInternal->GetArchitecture() == "neutral")),
+                "AppxBundleManifest.xml and AppxManifest.xml architecture mismatch");
+            return reader;
+        }
+    }
+#endif // BUNDLE_SUPPORT
+
+    ComPtr<IAppxManifestReader> ReadPackageManifest(IMsixFactory* factory, const ComPtr<IStorageObject>& container)
+    {
+        auto file = container->GetFile(APPXBLOCKMAP_XML);
+        ThrowErrorIfNot(Error::MissingAppxBlockMapXML, file, "AppxBlockMap.xml not in archive!");
+        auto blockMap = ComPtr<IVerifierObject>::Make<AppxBlockMapObject>(factory, file);
+
+        file = container->GetFile(APPXMANIFEST_XML);
+        ThrowErrorIfNot(Error::MissingAppxManifestXML, file, "AppxManifest.xml not in archive!");
+        auto stream = blockMap->GetValidationStream(APPXMANIFEST_XML, file);
+        return ComPtr<IAppxManifestReader>::Make<AppxManifestObject>(factory, stream);
+    }
+
     AppxPackageObject::AppxPackageObject(IMsixFactory* factory, MSIX_VALIDATION_OPTION validation,
         MSIX_APPLICABILITY_OPTIONS applicabilityFlags, const ComPtr<IStorageObject>& container) :
         m_factory(factory),
@@ -56,7 +179,14 @@ namespace MSIX {
         file = m_container->GetFile(CONTENT_TYPES_XML);
         ThrowErrorIfNot(Error::MissingContentTypesXML, file, "[Content_Types].xml not in archive!");
         ComPtr<IStream> stream = m_appxSignature->GetValidationStream(CONTENT_TYPES_XML, file);
-        auto contentType = xmlFactory->CreateDomFromStream(XmlContentType::ContentTypeXml, stream);
+        // Nothing is read from the content types, they are only validated. The cache keeps which bytes were valid.
+        factory->GetDocumentCache().Get<bool>(DocumentCache::Document::ContentTypes, stream, xmlFactory.Get(),
+            [](void* xmlFactory, const ComPtr<IStream>& stream, std::uint64_t& size) -> DocumentCache::Value
+            {
+                reinterpret_cast<IXmlFactory*>(xmlFactory)->CreateDomFromStream(XmlContentType::ContentTypeXml, stream);
+                size = sizeof(bool);
+                return std::make_shared<const bool>(true);
+            });
 
         // 3. Get blockmap object using signature object for validation
         file = m_container->GetFile(APPXBLOCKMAP_XML);
@@ -203,7 +333,6 @@ namespace MSIX {
             ThrowErrorIfNot(Error::BlockMapSemanticError, ((blockMapFiles.size() == 1)), "Block map contains invalid files.");
 
             auto bundleInfo = m_appxBundleManifest.As<IBundleInfo>();
-            auto appxFactory = m_factory.As<IAppxFactory>();
 
             Applicability applicability(applicabilityFlags);
 
@@ -221,105 +350,125 @@ namespace MSIX {
                 applicability.InitializeLanguages();
             }
 
+            bool applicableOnly = !(validation & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPPACKAGEVALIDATION) &&
+                (validation & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_VALIDATEAPPLICABLEONLY);
             if (!(validation & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPPACKAGEVALIDATION))
             {
+                // Finding the packages is done here because it can call into the stream factory provided by the
+                // caller. Creating a reader for each package, which validates it, is done concurrently. The results
+                // are merged in the order of the bundle manifest, so the outcome, including which error is reported
+                // when more than one package is invalid, is the same as validating them one after the other.
+                struct InnerPackage
+                {
+                    ComPtr<IAppxBundleManifestPackageInfo> package;
+                    std::string name;
+                    ComPtr<IStream> stream;
+                    ComPtr<IStream> readerStream;
+                    ComPtr<IAppxPackageReader> reader;
+                    APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE packageType = APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE_APPLICATION;
+                };
+                std::vector<InnerPackage> innerPackages;
+                ParallelTaskResult locateFailure;
+
+                // Applicability only uses the bundle manifest. When only applicable packages are validated, it is
+                // decided before any package is opened.
+                std::vector<std::string> applicableNames;
+                if (applicableOnly)
+                {
+                    for (const auto& package : bundleInfo->GetPackages())
+                    {
+                        APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE packageType;
+                        ThrowHrIfFailed(package->GetPackageType(&packageType));
+                        ComPtr<IAppxPackageReader> notOpened;
+                        applicability.AddPackageIfApplicable(notOpened, packageType, package);
+                    }
+                    std::vector<ComPtr<IAppxPackageReader>> notOpened;
+                    applicability.GetApplicablePackages(&notOpened, &applicableNames);
+                }
+
+                // Packages in the bundle are ranges of the bundle stream. Each reader gets its own cursor over
+                // its range, and reads from any of them are serialized by this lock.
+                auto containerLock = std::make_shared<std::mutex>();
                 for (const auto& package : bundleInfo->GetPackages())
                 {
-                    auto bundleInfoInternal = package.As<IAppxBundleManifestPackageInfoInternal>();
-                    auto packageName = bundleInfoInternal->GetFileName();
-                    auto packageStream = m_container->GetFile(Encoding::EncodeFileName(packageName));
-
-                    if (packageStream)
-                    {   // The package is in the bundle. Verify is not compressed.
-                        auto zipStream = packageStream.As<IStreamInternal>();
-                        ThrowErrorIf(Error::AppxManifestSemanticError, zipStream->IsCompressed(), "Packages cannot be compressed");
+                    auto packageName = package.As<IAppxBundleManifestPackageInfoInternal>()->GetFileName();
+                    if (applicableOnly &&
+                        (std::find(applicableNames.begin(), applicableNames.end(), packageName) == applicableNames.end()))
+                    {
+                        UINT64 size = 0;
+                        ThrowHrIfFailed(package->GetSize(&size));
+                        ComPtr<IMsixFactory> factoryRef = m_factory;
+                        ComPtr<IStorageObject> container = m_container;
+                        m_files[packageName] = ComPtr<IAppxFile>::Make<DeferredAppxFile>(m_factory.Get(), packageName, size,
+                            [factoryRef, container, package, containerLock]()
+                            {
+                                bool isInContainer = false;
+                                auto packageStream = LocateInnerPackage(factoryRef.Get(), container.Get(), package, isInContainer);
+                                ValidateInnerPackage(factoryRef.Get(), package,
+                                    isInContainer ? ComPtr<IStream>::Make<CursorStream>(packageStream, containerLock) : packageStream);
+                                return packageStream;
+                            });
+                        continue;
                     }
-                    else if (!packageStream && (bundleInfoInternal->GetOffset() == 0)) // This is a flat bundle.
+
+                    InnerPackage inner;
+                    locateFailure = Helper::RunCaptured([&]()
                     {
-                        // We should only do this for flat bundles. If we do it for normal bundles and the user specify a 
-                        // stream factory we will basically unpack any package the user wants with the same name as the package
-                        // we are looking, which sounds dangerous.
-                        ComPtr<IUnknown> streamFactoryUnk;
-                        ThrowHrIfFailed(factoryOverrides->GetCurrentSpecifiedExtension(MSIX_FACTORY_EXTENSION_STREAM_FACTORY, &streamFactoryUnk));
+                        bool isInContainer = false;
+                        auto packageStream = LocateInnerPackage(m_factory.Get(), m_container.Get(), package, isInContainer);
+                        inner.package = package;
+                        inner.name = packageName;
+                        // Packages of a flat bundle are separate streams and can be read concurrently as they are.
+                        inner.readerStream = isInContainer ? ComPtr<IStream>::Make<CursorStream>(packageStream, containerLock) : packageStream;
+                        inner.stream = std::move(packageStream);
+                    });
+                    if (locateFailure.error)
+                    {   // Packages after this one would not have been looked at.
+                        break;
+                    }
+                    innerPackages.push_back(std::move(inner));
+                }
 
-                        if(streamFactoryUnk.Get() != nullptr)
-                        {
-                            auto streamFactory = streamFactoryUnk.As<IMsixStreamFactory>();
-                            ThrowHrIfFailed(streamFactory->CreateStreamOnRelativePathUtf8(packageName.c_str(), &packageStream));
-                        }
-                        else
-                        {   // User didn't specify a stream factory implementation. Assume packages are in the same location
-                            // as the bundle.
-                            auto containerName = GetFileName();
-                            #ifdef WIN32
-                            auto lastSeparator = containerName.find_last_of('\\');
-                            #else
-                            auto lastSeparator = containerName.find_last_of('/');
-                            #endif
-                            auto expandedPackageName = containerName.substr(0, lastSeparator + 1) + packageName;
-                            ThrowHrIfFailed(CreateStreamOnFile(const_cast<char*>(expandedPackageName.c_str()), true, &packageStream));
-                        }
-                        ThrowErrorIfNot(Error::FileNotFound, packageStream, "Package from a flat bundle is not present");
+                auto results = Helper::ParallelFor(innerPackages.size(), [&](std::size_t index)
+                {
+                    auto& inner = innerPackages[index];
+                    auto reader = ValidateInnerPackage(m_factory.Get(), inner.package, inner.readerStream);
+                    ThrowHrIfFailed(inner.package->GetPackageType(&inner.packageType));
+                    inner.reader = std::move(reader);
+                });
+                if (locateFailure.error)
+                {
+                    results.push_back(std::move(locateFailure));
+                }
+                Helper::MergeParallelResults(results);
+
+                for (auto& inner : innerPackages)
+                {
+                    if (applicableOnly)
+                    {   // Keep the order applicability returned them in
+                        auto position = std::find(applicableNames.begin(), applicableNames.end(), inner.name) - applicableNames.begin();
+                        m_applicablePackages.resize(applicableNames.size());
+                        m_applicablePackages[position] = inner.reader;
                     }
                     else
                     {
-                        ThrowErrorIfNot(Error::FileNotFound, packageStream, "Package is not in container");
+                        // Validation is done, now see if the package is applicable.
+                        applicability.AddPackageIfApplicable(inner.reader, inner.packageType, inner.package);
                     }
 
-                    // Semantic checks
-                    LARGE_INTEGER start = { 0 };
-                    ULARGE_INTEGER end = { 0 };
-                    ThrowHrIfFailed(packageStream->Seek(start, StreamBase::Reference::END, &end));
-                    ThrowHrIfFailed(packageStream->Seek(start, StreamBase::Reference::START, nullptr));
-                    
-                    UINT64 size;
-                    ThrowHrIfFailed(package->GetSize(&size));
-                    ThrowErrorIf(Error::AppxManifestSemanticError, end.u.LowPart != size,
-                        "Size mistmach of package between AppxManifestBundle.appx and container");
-
-                    // Validate the package
-                    ComPtr<IAppxPackageReader> reader;
-                    ThrowHrIfFailed(appxFactory->CreatePackageReader(packageStream.Get(), &reader));
-                    ComPtr<IAppxManifestReader> innerPackageManifest;
-                    ThrowHrIfFailed(reader->GetManifest(&innerPackageManifest));
-                    // Do semantic checks to validate the relationship between the AppxBundleManifest and the AppxManifest.
-                    ComPtr<IAppxManifestPackageId> bundlePackageId;
-                    ThrowHrIfFailed(package->GetPackageId(&bundlePackageId));
-                    auto bundlePackageIdInternal = bundlePackageId.As<IAppxManifestPackageIdInternal>();
-
-                    ComPtr<IAppxManifestPackageId> innerPackageId;
-                    ThrowHrIfFailed(innerPackageManifest->GetPackageId(&innerPackageId));
-                    auto innerPackageIdInternal = innerPackageId.As<IAppxManifestPackageIdInternal>();
-                    ThrowErrorIf(Error::AppxManifestSemanticError,
-                        (innerPackageIdInternal->GetPublisher() != bundlePackageIdInternal->GetPublisher()),
-                        "AppxBundleManifest.xml and AppxManifest.xml publisher mismatch");
-                    UINT64 bundlePackageVersion = 0;
-                    UINT64 innerPackageVersion = 0;
-                    ThrowHrIfFailed(bundlePackageId->GetVersion(&bundlePackageVersion));
-                    ThrowHrIfFailed(innerPackageId->GetVersion(&innerPackageVersion));
-                    ThrowErrorIf(Error::AppxManifestSemanticError,
-                        (innerPackageVersion != bundlePackageVersion),
-                        "AppxBundleManifest.xml and AppxManifest.xml version mismatch");
-                    ThrowErrorIf(Error::AppxManifestSemanticError,
-                        (innerPackageIdInternal->GetName() != bundlePackageIdInternal->GetName()),
-                        "AppxBundleManifest.xml and AppxManifest.xml name mismatch");
-                    ThrowErrorIf(Error::AppxManifestSemanticError,
-                        (innerPackageIdInternal->GetArchitecture() != bundlePackageIdInternal->GetArchitecture()) &&
-                        !(innerPackageIdInternal->GetArchitecture().empty() && (bundlePackageIdInternal->GetArchitecture() == "neutral")),
-                        "AppxBundleManifest.xml and AppxManifest.xml architecture mismatch");
-
-                    APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE packageType;
-                    ThrowHrIfFailed(package->GetPackageType(&packageType));
-                    
-                    // Validation is done, now see if the package is applicable.
-                    applicability.AddPackageIfApplicable(reader, packageType, package);
-
-                    m_files[packageName] = ComPtr<IAppxFile>::Make<MSIX::AppxFile>(m_factory.Get(), packageName, std::move(packageStream));
+                    m_files[inner.name] = ComPtr<IAppxFile>::Make<MSIX::AppxFile>(m_factory.Get(), inner.name, std::move(inner.stream));
                     // Intentionally don't remove from fileToProcess. For bundles, it is possible to don't unpack packages, like
                     // resource packages that are not languages packages.
                 }
+                if (applicableOnly)
+                {
+                    m_applicablePackagesNames = std::move(applicableNames);
+                }
+            }
+            if (!applicableOnly)
+            {
+                applicability.GetApplicablePackages(&m_applicablePackages, &m_applicablePackagesNames);
             }
-            applicability.GetApplicablePackages(&m_applicablePackages, &m_applicablePackagesNames);
 
         }
         else
@@ -329,7 +478,8 @@ namespace MSIX {
             {   auto footPrintFile = std::find(std::begin(footPrintFileNames), std::end(footPrintFileNames), fileName);
                 if (footPrintFile == std::end(footPrintFileNames))
                 {
-                    auto opcFileName = Encoding::EncodeFileName(fileName);
+                    std::string encodedName;
+                    const auto& opcFileName = Encoding::EncodeFileName(fileName, encodedName);
                     m_payloadFiles.push_back(opcFileName);
                     auto fileStream = m_container->GetFile(opcFileName);
                     ThrowErrorIfNot(Error::FileNotFound, fileStream, "File described in blockmap not contained in OPC container");
@@ -398,46 +548,162 @@ namespace MSIX {
 
     void AppxPackageObject::Unpack(MSIX_PACKUNPACK_OPTION options, const ComPtr<IDirectoryObject>& to)
     {
+        std::string packageFolder;
+        if ((options & MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER) || options & MSIX_PACKUNPACK_OPTION_UNPACKWITHFLATSTRUCTURE)
+        {
+            ComPtr<IAppxManifestPackageId> packageId;
+            if (m_isBundle)
+            {
+                auto manifest = m_appxBundleManifest.As<IAppxBundleManifestReader>();
+                ThrowHrIfFailed(manifest->GetPackageId(&packageId));
+            }
+            else
+            {
+                auto manifest = m_appxManifest.As<IAppxManifestReader>();
+                ThrowHrIfFailed(manifest->GetPackageId(&packageId));
+            }
+            // Don't use to->GetPathSeparator(). DirectoryObject::OpenFile created directories
+            // by looking at "/" in the string. If to->GetPathSeparator() is used the subfolder with
+            // the package full name won't be created on Windows, but it will on other platforms.
+            // This means that we have different behaviors in non-Win platforms.
+            packageFolder = packageId.As<IAppxManifestPackageIdInternal>()->GetPackageFullName() + "/";
+        }
+
+        // Incremental unpack keeps a state file in the package folder with what was extracted. Files whose blocks
+        // didn't change since then are left alone; everything else is written to a temporary file and renamed.
+        bool incremental = (options & (MSIX_PACKUNPACK_OPTION_INCREMENTAL |
+            MSIX_PACKUNPACK_OPTION_DELETEREMOVEDFILES | MSIX_PACKUNPACK_OPTION_VERIFYEXISTINGFILES)) != 0;
+        bool verifyExisting = (options & MSIX_PACKUNPACK_OPTION_VERIFYEXISTINGFILES) != 0;
+
+        // Streaming targets need the size of a file before its data is written, and don't have previous files.
+        ComPtr<ITarDirectoryObject> tarTarget;
+        if (SUCCEEDED(to->QueryInterface(UuidOfImpl<ITarDirectoryObject>::iid, reinterpret_cast<void**>(&tarTarget))))
+        {
+            ThrowErrorIf(Error::InvalidParameter, incremental, "Incremental unpack is not supported when unpacking to a stream");
+        }
+        UnpackState previousState;
+        UnpackState currentState;
+        auto blockMapInternal = m_appxBlockMap.As<IAppxBlockMapInternal>();
+        std::vector<std::string> blockMapFiles;
+        if (incremental)
+        {
+            previousState.Load(to, packageFolder + UNPACK_STATE_FILE);
+            blockMapFiles = blockMapInternal->GetFileNames();
+        }
+        bool stateInvalidated = false;
+        auto invalidateState = [&]()
+        {
+            if (!stateInvalidated)
+            {
+                UnpackState::Invalidate(to, packageFolder + UNPACK_STATE_FILE);
+                stateInvalidated = true;
+            }
+        };
+
         auto fileNames = GetFileNames(FileNameOptions::All);
         for (const auto& fileName : fileNames)
         {   // Don't extract packages files
             auto file = std::find(std::begin(m_applicablePackagesNames), std::end(m_applicablePackagesNames), fileName);
             if (file == std::end(m_applicablePackagesNames))
             {
-                std::string targetName = Encoding::DecodeFileName(fileName);
-                if ((options & MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER) || options & MSIX_PACKUNPACK_OPTION_UNPACKWITHFLATSTRUCTURE)
+                std::string decodedName;
+                const auto& nameInPackage = Encoding::DecodeFileName(fileName, decodedName);
+                std::string targetName = packageFolder + nameInPackage;
+
+                if (!incremental)
                 {
-                    ComPtr<IAppxManifestPackageId> packageId;
-                    if (m_isBundle)
+                    auto deleteFile = MSIX::scope_exit([&to, &targetName]
+                    {
+                        to->RemoveFile(targetName);
+                    });
+
+                    auto sourceFile = GetFile(fileName).As<IStream>();
+                    ComPtr<IStream> targetFile;
+                    if (tarTarget)
                     {
-                        auto manifest = m_appxBundleManifest.As<IAppxBundleManifestReader>();
-                        ThrowHrIfFailed(manifest->GetPackageId(&packageId));
+                        LARGE_INTEGER start = { 0 };
+                        ULARGE_INTEGER size = { 0 };
+                        ThrowHrIfFailed(sourceFile->Seek(start, StreamBase::Reference::END, &size));
+                        ThrowHrIfFailed(sourceFile->Seek(start, StreamBase::Reference::START, nullptr));
+                        targetFile = tarTarget->OpenFile(targetName, size.QuadPart);
                     }
                     else
                     {
-                        auto manifest = m_appxManifest.As<IAppxManifestReader>();
-                        ThrowHrIfFailed(manifest->GetPackageId(&packageId));
+                        targetFile = to->OpenFile(targetName, MSIX::FileStream::Mode::WRITE);
                     }
-                    // Don't use to->GetPathSeparator(). DirectoryObject::OpenFile created directories
-                    // by looking at "/" in the string. If to->GetPathSeparator() is used the subfolder with
-                    // the package full name won't be created on Windows, but it will on other platforms.
-                    // This means that we have different behaviors in non-Win platforms.
-                    targetName = packageId.As<IAppxManifestPackageIdInternal>()->GetPackageFullName() + "/" + targetName;
+
+                    ULARGE_INTEGER bytesCount = {0};
+                    bytesCount.QuadPart = std::numeric_limits<std::uint64_t>::max();
+                    ThrowHrIfFailed(sourceFile->CopyTo(targetFile.Get(), bytesCount, nullptr, nullptr));
+                    deleteFile.release();
+                    continue;
                 }
 
-                auto deleteFile = MSIX::scope_exit([&targetName]
+                UnpackStateEntry entry;
+                std::string blockMapName = Helper::toBackSlash(nameInPackage);
+                // GetFileNames returns the blockmap files sorted
+                if (std::binary_search(blockMapFiles.begin(), blockMapFiles.end(), blockMapName))
                 {
-                    remove(targetName.c_str());
-                });
+                    UINT64 size = 0;
+                    ThrowHrIfFailed(blockMapInternal->GetFile(blockMapName)->GetUncompressedSize(&size));
+                    auto blocks = blockMapInternal->GetBlocks(blockMapName);
+                    entry = UnpackState::CreateEntry(size, blocks);
+
+                    bool isUpToDate = false;
+                    if (to->FileExists(targetName))
+                    {
+                        if (verifyExisting)
+                        {
+                            isUpToDate = UnpackState::StreamMatchesBlocks(to->OpenFile(targetName, MSIX::FileStream::Mode::READ), size, blocks);
+                        }
+                        else
+                        {
+                            auto previous = previousState.Find(nameInPackage);
+                            isUpToDate = (previous != nullptr) && previous->Matches(entry);
+                        }
+                    }
+                    if (isUpToDate)
+                    {
+                        currentState.Set(nameInPackage, std::move(entry));
+                        continue;
+                    }
+                }
 
-                auto targetFile = to->OpenFile(targetName, MSIX::FileStream::Mode::WRITE);
-                auto sourceFile = GetFile(fileName).As<IStream>();
+                std::string tempName = targetName + UNPACK_TEMP_SUFFIX;
+                auto deleteFile = MSIX::scope_exit([&to, &tempName]
+                {
+                    to->RemoveFile(tempName);
+                });
+                {
+                    auto targetFile = to->OpenFile(tempName, MSIX::FileStream::Mode::WRITE);
+                    auto sourceFile = GetFile(fileName).As<IStream>();
 
-                ULARGE_INTEGER bytesCount = {0};
-                bytesCount.QuadPart = std::numeric_limits<std::uint64_t>::max();
-                ThrowHrIfFailed(sourceFile->CopyTo(targetFile.Get(), bytesCount, nullptr, nullptr));
+                    ULARGE_INTEGER bytesCount = {0};
+                    bytesCount.QuadPart = std::numeric_limits<std::uint64_t>::max();
+                    ThrowHrIfFailed(sourceFile->CopyTo(targetFile.Get(), bytesCount, nullptr, nullptr));
+                }
+                invalidateState();
+                to->RenameFile(tempName, targetName);
                 deleteFile.release();
+                currentState.Set(nameInPackage, std::move(entry));
+            }
+        }
+
+        if (incremental)
+        {
+            if (options & MSIX_PACKUNPACK_OPTION_DELETEREMOVEDFILES)
+            {
+                for (const auto& previous : previousState.GetEntries())
+                {
+                    if (currentState.Find(previous.first) == nullptr)
+                    {
+                        invalidateState();
+                        std::string removedFile = packageFolder + previous.first;
+                        ThrowErrorIfNot(Error::FileWrite, to->RemoveFile(removedFile), std::string("Failed to delete removed file: " + removedFile).c_str());
+                    }
+                }
             }
+            currentState.Save(to, packageFolder + UNPACK_STATE_FILE);
         }
 
 #ifdef BUNDLE_SUPPORT
@@ -448,6 +714,7 @@ namespace MSIX {
             // since -flat implies we want a bundle folder named according to its full name
             if (options & MSIX_PACKUNPACK_OPTION_CREATEPACKAGESUBFOLDER)
             {
+                ThrowErrorIf(Error::NotSupported, tarTarget, "Unpacking a bundle to a stream doesn't support creating a package subfolder");
                 auto manifest = m_appxBundleManifest.As<IAppxBundleManifestReader>();
                 ComPtr<IAppxManifestPackageId> packageId;
                 ThrowHrIfFailed(manifest->GetPackageId(&packageId));
@@ -0,0 +1,256 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "AppxPackaging.hpp"
+#include "Exceptions.hpp"
+#include "StreamBase.hpp"
+#include "TarDirectoryObject.hpp"
+
+#include <string>
+#include <array>
+#include <algorithm>
+#include <cstdio>
+
+namespace MSIX {
+
+    namespace {
+
+        const std::size_t TarBlockSize = 512;
+        const std::uint64_t UstarMaxSize = 077777777777; // 11 octal digits
+        const std::size_t UstarMaxName = 100;
+
+        const char TarTypeFile = '0';
+        const char TarTypePaxExtended = 'x';
+        const char TarTypePaxGlobal = 'g';
+
+        // Offsets and lengths of the ustar header fields
+        enum UstarField : std::size_t
+        {
+            Name = 0,       NameLength = 100,
+            Mode = 100,     ModeLength = 8,
+            Uid = 108,      UidLength = 8,
+            Gid = 116,      GidLength = 8,
+            Size = 124,     SizeLength = 12,
+            Mtime = 136,    MtimeLength = 12,
+            Checksum = 148, ChecksumLength = 8,
+            Type = 156,
+            Magic = 257,
+            Version = 263,
+        };
+
+        typedef std::array<std::uint8_t, TarBlockSize> TarHeader;
+
+        void SetString(TarHeader& header, std::size_t offset, std::size_t length, const std::string& value)
+        {
+            std::copy_n(value.begin(), std::min(length, value.size()), header.begin() + offset);
+        }
+
+        void SetOctal(TarHeader& header, std::size_t offset, std::size_t length, std::uint64_t value)
+        {
+            // length - 1 digits followed by a null
+            for (std::size_t i = length - 1; i > 0; i--)
+            {
+                header[offset + i - 1] = static_cast<std::uint8_t>('0' + (value & 07));
+                value >>= 3;
+            }
+            header[offset + length - 1] = '\0';
+        }
+
+        // A pax record is "<length> <key>=<value>\n" where length includes itself
+        std::string PaxRecord(const std::string& key, const std::string& value)
+        {
+            std::size_t length = key.size() + value.size() + 3; // space, '=' and '\n'
+            std::size_t digits = std::to_string(length).size();
+            while (std::to_string(length + digits).size() != digits)
+            {
+                digits++;
+            }
+            return std::to_string(length + digits) + " " + key + "=" + value + "\n";
+        }
+
+        bool NeedsPaxPath(const std::string& name)
+        {
+            return (name.size() > UstarMaxName) ||
+                std::any_of(name.begin(), name.end(), [](char c) { return static_cast<unsigned char>(c) > 0x7F; });
+        }
+
+        // ASCII approximation of the name for readers that don't understand pax headers
+        std::string FallbackName(const std::string& name)
+        {
+            std::string result;
+            for (char c : name)
+            {
+                result.push_back((static_cast<unsigned char>(c) > 0x7F) ? '_' : c);
+            }
+            if (result.size() > UstarMaxName)
+            {
+                result = result.substr(result.size() - UstarMaxName);
+            }
+            return result;
+        }
+    }
+
+    // Stream handed out for a single tar entry. Writes go straight to the tar stream.
+    class TarEntryStream final : public StreamBase
+    {
+    public:
+        TarEntryStream(TarDirectoryObject* owner, const std::string& name) : m_owner(owner), m_name(name)
+        {
+            m_ownerRef = ComPtr<IDirectoryObject>(static_cast<IDirectoryObject*>(owner));
+        }
+
+        HRESULT STDMETHODCALLTYPE Write(const void* buffer, ULONG countBytes, ULONG* bytesWritten) noexcept override try
+        {
+            if (bytesWritten) { *bytesWritten = 0; }
+            m_owner->WriteEntryData(buffer, countBytes);
+            if (bytesWritten) { *bytesWritten = countBytes; }
+            return static_cast<HRESULT>(Error::OK);
+        } CATCH_RETURN();
+
+        std::string GetName() override { return m_name; }
+
+    protected:
+        ComPtr<IDirectoryObject> m_ownerRef;
+        TarDirectoryObject* m_owner;
+        std::string m_name;
+    };
+
+    ComPtr<IStream> TarDirectoryObject::OpenFile(const std::string& fileName, FileStream::Mode mode)
+    {
+        ThrowErrorAndLog(Error::NotSupported, "The size of a tar entry must be known before it is opened");
+    }
+
+    ComPtr<IStream> TarDirectoryObject::OpenFile(const std::string& fileName, std::uint64_t size)
+    {
+        ThrowErrorIf(Error::InvalidParameter, fileName.empty(), "Invalid file name");
+        FinishEntry();
+
+        std::string records;
+        if (NeedsPaxPath(fileName))
+        {
+            records += PaxRecord("path", fileName);
+        }
+        if (size > UstarMaxSize)
+        {
+            records += PaxRecord("size", std::to_string(size));
+        }
+        if (!records.empty())
+        {
+            WritePaxHeader(fileName, records, TarTypePaxExtended);
+        }
+        WriteHeader(FallbackName(fileName), (size > UstarMaxSize) ? 0 : size, TarTypeFile);
+
+        m_inEntry = true;
+        m_entrySize = size;
+        m_entryRemaining = size;
+        return ComPtr<IStream>::Make<TarEntryStream>(this, fileName);
+    }
+
+    void TarDirectoryObject::Close()
+    {
+        ThrowErrorIf(Error::Unexpected, m_closed, "Tar stream already closed");
+        FinishEntry();
+        // End of archive is two zero filled blocks
+        WriteZeros(2 * TarBlockSize);
+        m_closed = true;
+    }
+
+    void TarDirectoryObject::Abort(const std::string& reason) noexcept try
+    {
+        if (m_closed)
+        {
+            return;
+        }
+        m_closed = true;
+        if (m_inEntry)
+        {
+            // Keep readers aligned to the header boundaries so they get to the trailer
+            WriteZeros(m_entryRemaining);
+            m_entryRemaining = 0;
+            WriteZeros((TarBlockSize - (m_entrySize % TarBlockSize)) % TarBlockSize);
+            m_inEntry = false;
+        }
+        std::string error = reason.empty() ? "unpack failed" : reason;
+        WritePaxHeader("MSIX_ERROR", PaxRecord("MSIX.error", error), TarTypePaxGlobal);
+
+        // Follow it with a block that is not a valid header and no end of archive marker, so tar readers report
+        // an error instead of treating the stream as complete.
+        TarHeader invalid = {};
+        SetString(invalid, 0, invalid.size(), "MSIX unpack failed: " + error);
+        ULONG written = 0;
+        m_stream->Write(invalid.data(), static_cast<ULONG>(invalid.size()), &written);
+    }
+    catch (...)
+    {
+        // Nothing else can be done, the caller already has a failure to report.
+    }
+
+    void TarDirectoryObject::WriteEntryData(const void* buffer, ULONG countBytes)
+    {
+        ThrowErrorIfNot(Error::Unexpected, m_inEntry, "No tar entry open");
+        ThrowErrorIf(Error::FileWrite, (countBytes > m_entryRemaining), "Writing more data than the size of the tar entry");
+        ULONG written = 0;
+        ThrowHrIfFailed(m_stream->Write(buffer, countBytes, &written));
+        ThrowErrorIf(Error::FileWrite, (written != countBytes), "write failed");
+        m_entryRemaining -= countBytes;
+    }
+
+    void TarDirectoryObject::FinishEntry()
+    {
+        ThrowErrorIf(Error::Unexpected, m_closed, "Tar stream already closed");
+        if (m_inEntry)
+        {
+            ThrowErrorIf(Error::FileWrite, (m_entryRemaining != 0), "Tar entry is smaller than its declared size");
+            WriteZeros((TarBlockSize - (m_entrySize % TarBlockSize)) % TarBlockSize);
+            m_inEntry = false;
+        }
+    }
+
+    void TarDirectoryObject::WriteHeader(const std::string& name, std::uint64_t size, char type)
+    {
+        TarHeader header = {};
+        SetString(header, UstarField::Name, UstarField::NameLength, name);
+        SetOctal(header, UstarField::Mode, UstarField::ModeLength, 0644);
+        SetOctal(header, UstarField::Uid, UstarField::UidLength, 0);
+        SetOctal(header, UstarField::Gid, UstarField::GidLength, 0);
+        SetOctal(header, UstarField::Size, UstarField::SizeLength, size);
+        SetOctal(header, UstarField::Mtime, UstarField::MtimeLength, 0);
+        header[UstarField::Type] = static_cast<std::uint8_t>(type);
+        SetString(header, UstarField::Magic, 6, std::string("ustar\0", 6));
+        SetString(header, UstarField::Version, 2, "00");
+
+        // The checksum is calculated with the checksum field filled with spaces
+        std::fill_n(header.begin() + UstarField::Checksum, UstarField::ChecksumLength, ' ');
+        std::uint32_t checksum = 0;
+        for (auto byte : header) { checksum += byte; }
+        SetOctal(header, UstarField::Checksum, UstarField::ChecksumLength - 1, checksum);
+        header[UstarField::Checksum + UstarField::ChecksumLength - 1] = ' ';
+
+        ULONG written = 0;
+        ThrowHrIfFailed(m_stream->Write(header.data(), static_cast<ULONG>(header.size()), &written));
+        ThrowErrorIf(Error::FileWrite, (written != header.size()), "write failed");
+    }
+
+    void TarDirectoryObject::WritePaxHeader(const std::string& name, const std::string& records, char type)
+    {
+        WriteHeader(FallbackName("PaxHeaders/" + name), records.size(), type);
+        ULONG written = 0;
+        ThrowHrIfFailed(m_stream->Write(records.data(), static_cast<ULONG>(records.size()), &written));
+        ThrowErrorIf(Error::FileWrite, (written != records.size()), "write failed");
+        WriteZeros((TarBlockSize - (records.size() % TarBlockSize)) % TarBlockSize);
+    }
+
+    void TarDirectoryObject::WriteZeros(std::uint64_t count)
+    {
+        static const std::array<std::uint8_t, TarBlockSize> zeros = {};
+        while (count > 0)
+        {
+            ULONG chunk = static_cast<ULONG>(std::min<std::uint64_t>(count, zeros.size()));
+            ULONG written = 0;
+            ThrowHrIfFailed(m_stream->Write(zeros.data(), chunk, &written));
+            ThrowErrorIf(Error::FileWrite, (written != chunk), "write failed");
+            count -= chunk;
+        }
+    }
+}
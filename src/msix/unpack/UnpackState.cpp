@@ -0,0 +1,138 @@
+//
+//  Copyright (C) 2019 Microsoft.  All rights reserved.
+//  See LICENSE file in the project root for full license information.
+//
+#include "AppxPackaging.hpp"
+#include "Exceptions.hpp"
+#include "UnpackState.hpp"
+#include "StreamHelper.hpp"
+#include "Crypto.hpp"
+#include "SerializationHelper.hpp"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+namespace MSIX {
+
+    namespace {
+
+        // State file layout, all integers little endian:
+        //   magic 'MXUS', version, file count
+        //   per file: name length, name, tracked, size, hashes length, hashes
+        const std::uint32_t StateSignature = 0x5355584D;
+        const std::uint32_t StateVersion = 1;
+    }
+
+    void UnpackState::Load(const ComPtr<IDirectoryObject>& directory, const std::string& stateFile)
+    {
+        m_entries.clear();
+        if (!directory->FileExists(stateFile))
+        {
+            return;
+        }
+        auto buffer = Helper::CreateBufferFromStream(directory->OpenFile(stateFile, FileStream::Mode::READ));
+
+        Serialization::Reader reader(buffer);
+        std::uint32_t signature = 0, version = 0, count = 0;
+        if (!reader.ReadNumber(signature) || signature != StateSignature ||
+            !reader.ReadNumber(version) || version != StateVersion ||
+            !reader.ReadNumber(count))
+        {
+            return;
+        }
+
+        std::map<std::string, UnpackStateEntry> entries;
+        for (std::uint32_t i = 0; i < count; i++)
+        {
+            std::string name;
+            std::uint8_t tracked = 0;
+            UnpackStateEntry entry;
+            if (!reader.ReadBytes(name) || !reader.ReadNumber(tracked) ||
+                !reader.ReadNumber(entry.size) || !reader.ReadBytes(entry.hashes))
+            {
+                return;
+            }
+            entry.tracked = (tracked != 0);
+            entries.emplace(std::move(name), std::move(entry));
+        }
+        if (reader.AtEnd())
+        {
+            m_entries = std::move(entries);
+        }
+    }
+
+    void UnpackState::Save(const ComPtr<IDirectoryObject>& directory, const std::string& stateFile)
+    {
+        using namespace Serialization;
+        std::vector<std::uint8_t> buffer;
+        WriteNumber(buffer, StateSignature);
+        WriteNumber(buffer, StateVersion);
+        WriteNumber(buffer, static_cast<std::uint32_t>(m_entries.size()));
+        for (const auto& entry : m_entries)
+        {
+            WriteBytes(buffer, entry.first);
+            WriteNumber<std::uint8_t>(buffer, entry.second.tracked ? 1 : 0);
+            WriteNumber(buffer, entry.second.size);
+            WriteBytes(buffer, entry.second.hashes.data(), entry.second.hashes.size());
+        }
+        ReplaceFile(directory, stateFile, UNPACK_TEMP_SUFFIX, buffer);
+    }
+
+    void UnpackState::Invalidate(const ComPtr<IDirectoryObject>& directory, const std::string& stateFile)
+    {
+        ThrowErrorIfNot(Error::FileWrite, directory->RemoveFile(stateFile), std::string("Failed to delete unpack state: " + stateFile).c_str());
+    }
+
+    const UnpackStateEntry* UnpackState::Find(const std::string& fileName) const
+    {
+        auto entry = m_entries.find(fileName);
+        return (entry == m_entries.end()) ? nullptr : &entry->second;
+    }
+
+    UnpackStateEntry UnpackState::CreateEntry(std::uint64_t size, const std::vector<Block>& blocks)
+    {
+        UnpackStateEntry entry;
+        entry.tracked = true;
+        entry.size = size;
+        for (const auto& block : blocks)
+        {
+            entry.hashes.insert(entry.hashes.end(), block.hash.begin(), block.hash.end());
+        }
+        return entry;
+    }
+
+    bool UnpackState::StreamMatchesBlocks(const ComPtr<IStream>& stream, std::uint64_t size, const std::vector<Block>& blocks)
+    {
+        LARGE_INTEGER start = { 0 };
+        ULARGE_INTEGER end = { 0 };
+        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::END, &end));
+        ThrowHrIfFailed(stream->Seek(start, StreamBase::Reference::START, nullptr));
+        if (end.QuadPart != size)
+        {
+            return false;
+        }
+
+        std::vector<std::uint8_t> buffer(static_cast<std::size_t>(BLOCKMAP_BLOCK_SIZE));
+        std::vector<std::uint8_t> hash;
+        std::uint64_t remaining = size;
+        for (const auto& block : blocks)
+        {
+            ULONG toRead = static_cast<ULONG>(std::min(remaining, BLOCKMAP_BLOCK_SIZE));
+            ULONG bytesRead = 0;
+            ThrowHrIfFailed(stream->Read(buffer.data(), toRead, &bytesRead));
+            if (bytesRead != toRead)
+            {
+                return false;
+            }
+            ThrowErrorIfNot(Error::Unexpected, SHA256::ComputeHash(buffer.data(), bytesRead, hash), "Failed computing hash");
+            if (hash != block.hash)
+            {
+                return false;
+            }
+            remaining -= bytesRead;
+        }
+        return (remaining == 0);
+    }
+}
@@ -80,36 +80,45 @@ namespace MSIX {
         auto result = m_streams.find(fileName);
         if (result == m_streams.end())
         {
-            auto centralFileHeader = m_centralDirectories.find(fileName);
-            if(centralFileHeader == m_centralDirectories.end())
+            auto fileStream = GetRawFile(fileName);
+            if (!fileStream)
             {
-                return ComPtr<IStream>();
+                return fileStream;
             }
-            LARGE_INTEGER pos = {0};
-            pos.QuadPart = centralFileHeader->second.GetRelativeOffsetOfLocalHeader();
-            ThrowHrIfFailed(m_stream->Seek(pos, MSIX::StreamBase::Reference::START, nullptr));
-            LocalFileHeader lfh = LocalFileHeader();
-            lfh.Read(m_stream.Get(), centralFileHeader->second);
-
-            auto fileStream = ComPtr<IStream>::Make<ZipFileStream>(
-                centralFileHeader->first,
-                centralFileHeader->second.GetCompressionMethod() == CompressionType::Deflate,
-                centralFileHeader->second.GetRelativeOffsetOfLocalHeader() + lfh.Size(),
-                centralFileHeader->second.GetCompressedSize(),
-                m_stream.Get()
-            );
-
-            if (centralFileHeader->second.GetCompressionMethod() == CompressionType::Deflate)
+            const auto& centralFileHeader = m_centralDirectories.find(fileName)->second;
+            if (centralFileHeader.GetCompressionMethod() == CompressionType::Deflate)
             {
-                fileStream = ComPtr<IStream>::Make<InflateStream>(std::move(fileStream), centralFileHeader->second.GetUncompressedSize());
+                fileStream = ComPtr<IStream>::Make<InflateStream>(std::move(fileStream), centralFileHeader.GetUncompressedSize());
             }
             ComPtr<IStream> result(fileStream);
-            m_streams.insert(std::make_pair(centralFileHeader->first, std::move(fileStream)));
+            m_streams.insert(std::make_pair(fileName, std::move(fileStream)));
             return result;
         }
         return result->second;
     }
 
+    ComPtr<IStream> ZipObjectReader::GetRawFile(const std::string& fileName)
+    {
+        auto centralFileHeader = m_centralDirectories.find(fileName);
+        if(centralFileHeader == m_centralDirectories.end())
+        {
+            return ComPtr<IStream>();
+        }
+        LARGE_INTEGER pos = {0};
+        pos.QuadPart = centralFileHeader->second.GetRelativeOffsetOfLocalHeader();
+        ThrowHrIfFailed(m_stream->Seek(pos, MSIX::StreamBase::Reference::START, nullptr));
+        LocalFileHeader lfh = LocalFileHeader();
+        lfh.Read(m_stream.Get(), centralFileHeader->second);
+
+        return ComPtr<IStream>::Make<ZipFileStream>(
+            centralFileHeader->first,
+            centralFileHeader->second.GetCompressionMethod() == CompressionType::Deflate,
+            centralFileHeader->second.GetRelativeOffsetOfLocalHeader() + lfh.Size(),
+            centralFileHeader->second.GetCompressedSize(),
+            m_stream.Get()
+        );
+    }
+
     std::string ZipObjectReader::GetFileName()
     {
         return m_stream.As<IStreamInternal>()->GetName();
@@ -11,6 +11,9 @@
 
 #include <iostream>
 #include <array>
+#include <random>
+#include <string>
+#include <vector>
 
 // Validates IAppxBlockMapReader::GetStream
 TEST_CASE("Api_AppxBlockMapReader_Stream", "[api]")
@@ -127,3 +130,201 @@ TEST_CASE("Api_AppxBlockMapReader_Files", "[api]")
     }
     REQUIRE(expectedBlockMapFiles.size() == numOfBlockMapFiles);
 }
+
+namespace {
+    const std::string base64Alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    std::string EncodeBase64(const std::vector<std::uint8_t>& data)
+    {
+        std::string result;
+        for (size_t i = 0; i < data.size(); i += 3)
+        {
+            std::uint32_t value = data[i] << 16;
+            if (i + 1 < data.size()) { value |= data[i + 1] << 8; }
+            if (i + 2 < data.size()) { value |= data[i + 2]; }
+            result += base64Alphabet[(value >> 18) & 0x3F];
+            result += base64Alphabet[(value >> 12) & 0x3F];
+            result += (i + 1 < data.size()) ? base64Alphabet[(value >> 6) & 0x3F] : '=';
+            result += (i + 2 < data.size()) ? base64Alphabet[value & 0x3F] : '=';
+        }
+        return result;
+    }
+
+    // Decodes groups of four characters. A group may end with padding.
+    bool DecodeBase64(const std::string& value, std::vector<std::uint8_t>& result)
+    {
+        if (value.size() % 4 != 0) { return false; }
+        for (size_t i = 0; i < value.size(); i += 4)
+        {
+            std::uint32_t digits[4];
+            for (size_t j = 0; j < 4; j++)
+            {
+                auto position = base64Alphabet.find(value[i + j]);
+                digits[j] = (value[i + j] == '=') ? 64 : static_cast<std::uint32_t>(position);
+                if (position == std::string::npos && value[i + j] != '=') { return false; }
+            }
+            if (digits[0] == 64 || digits[1] == 64 || (digits[2] == 64 && digits[3] != 64)) { return false; }
+            result.push_back(static_cast<std::uint8_t>((digits[0] << 2) | (digits[1] >> 4)));
+            if (digits[2] != 64) { result.push_back(static_cast<std::uint8_t>((digits[1] << 4) | (digits[2] >> 2))); }
+            if (digits[3] != 64) { result.push_back(static_cast<std::uint8_t>((digits[2] << 6) | digits[3])); }
+        }
+        return true;
+    }
+
+    // Blockmap with a file that has a block for each hash
+    std::string MakeBlockMap(const std::vector<std::string>& hashes)
+    {
+        std::string blockMap = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            "<BlockMap xmlns=\"http://schemas.microsoft.com/appx/2010/blockmap\" HashMethod=\"http://www.w3.org/2001/04/xmlenc#sha256\">"
+            "<File Name=\"file.txt\" Size=\"" + std::to_string(hashes.size() * 65536) + "\" LfhSize=\"38\">";
+        for (const auto& hash : hashes)
+        {
+            blockMap += "<Block Hash=\"" + hash + "\"/>";
+        }
+        blockMap += "</File></BlockMap>";
+        return blockMap;
+    }
+
+    // Reads a blockmap with a file that has a block for each hash and returns the decoded hashes
+    HRESULT GetBlockHashes(const std::vector<std::string>& hashes, MSIX_VALIDATION_OPTION validation,
+        std::vector<std::vector<std::uint8_t>>& result)
+    {
+        auto blockMap = MakeBlockMap(hashes);
+        auto stream = MsixTest::StreamFile("test_blockmap.xml", false, true);
+        ULONG written = 0;
+        REQUIRE_SUCCEEDED(stream->Write(blockMap.data(), static_cast<ULONG>(blockMap.size()), &written));
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_SET, nullptr));
+
+        MsixTest::ComPtr<IAppxFactory> factory;
+        REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+        MsixTest::ComPtr<IAppxBlockMapReader> blockMapReader;
+        HRESULT hr = factory->CreateBlockMapReader(stream.Get(), &blockMapReader);
+        if (FAILED(hr)) { return hr; }
+
+        MsixTest::ComPtr<IAppxBlockMapFile> file;
+        REQUIRE_SUCCEEDED(blockMapReader->GetFile(L"file.txt", &file));
+        MsixTest::ComPtr<IAppxBlockMapBlocksEnumerator> blocks;
+        REQUIRE_SUCCEEDED(file->GetBlocks(&blocks));
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(blocks->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxBlockMapBlock> block;
+            REQUIRE_SUCCEEDED(blocks->GetCurrent(&block));
+            UINT32 size = 0;
+            MsixTest::Wrappers::Buffer<BYTE> hash;
+            REQUIRE_SUCCEEDED(block->GetHash(&size, &hash));
+            result.emplace_back(hash.Get(), hash.Get() + size);
+            REQUIRE_SUCCEEDED(blocks->MoveNext(&hasCurrent));
+        }
+        return S_OK;
+    }
+
+    const MSIX_VALIDATION_OPTION xmlParsers[] = {
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_FULL,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION };
+}
+
+// Validates the Base64 decoding of block hashes with known values, values of every length up to 100 bytes, and
+// values with a character replaced.
+TEST_CASE("Api_AppxBlockMapReader_Base64Hashes", "[api]")
+{
+    std::vector<std::string> knownValues = { "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy",
+        "NQL/PSheCSB3yZzKyZ6nHbsfzJt1EZJxOXLllMVvtEI=" };
+    std::vector<std::string> knownResults = { "f", "fo", "foo", "foob", "fooba", "foobar" };
+
+    std::mt19937 random(42);
+    std::vector<std::vector<std::uint8_t>> values;
+    std::vector<std::string> encoded;
+    for (size_t size = 1; size <= 100; size++)
+    {
+        std::vector<std::uint8_t> value(size);
+        for (auto& byte : value) { byte = static_cast<std::uint8_t>(random()); }
+        encoded.push_back(EncodeBase64(value));
+        values.push_back(std::move(value));
+    }
+
+    for (auto validation : xmlParsers)
+    {
+        std::vector<std::vector<std::uint8_t>> result;
+        REQUIRE_SUCCEEDED(GetBlockHashes(knownValues, validation, result));
+        REQUIRE(result.size() == knownValues.size());
+        for (size_t i = 0; i < knownResults.size(); i++)
+        {
+            REQUIRE(std::string(result[i].begin(), result[i].end()) == knownResults[i]);
+        }
+        REQUIRE(result.back().size() == 32);
+        REQUIRE(EncodeBase64(result.back()) == knownValues.back());
+
+        result.clear();
+        REQUIRE_SUCCEEDED(GetBlockHashes(encoded, validation, result));
+        REQUIRE(result == values);
+
+        // Printable characters that are allowed in an attribute value
+        std::string characters;
+        for (char c = ' '; c < 127; c++)
+        {
+            if (c != '"' && c != '&' && c != '<') { characters += c; }
+        }
+        std::mt19937 mutations(7);
+        for (int i = 0; i < 200; i++)
+        {
+            std::string value = encoded[mutations() % encoded.size()];
+            value[mutations() % value.size()] = characters[mutations() % characters.size()];
+            std::vector<std::uint8_t> expected;
+            bool valid = DecodeBase64(value, expected);
+
+            result.clear();
+            HRESULT hr = GetBlockHashes({ value }, validation, result);
+            if (valid)
+            {
+                REQUIRE_SUCCEEDED(hr);
+                REQUIRE(result.size() == 1);
+                REQUIRE(result[0] == expected);
+            }
+            else
+            {
+                REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter), hr);
+            }
+        }
+
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter), GetBlockHashes({ "Zm9" }, validation, result));
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter), GetBlockHashes({ "Z===" }, validation, result));
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter), GetBlockHashes({ "Zm=v" }, validation, result));
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter), GetBlockHashes({ "\xC3\xA9\xC3\xA9\xC3\xA9\xC3\xA9" }, validation, result));
+    }
+}
+
+// Time to open a blockmap of 125000 blocks, which decodes their SHA256 hashes, with each XML parser
+TEST_CASE("Api_AppxBlockMapReader_Base64Hashes_benchmark", "[api][.benchmark]")
+{
+    std::mt19937 random(42);
+    std::vector<std::string> hashes;
+    for (size_t i = 0; i < 125000; i++)
+    {
+        std::vector<std::uint8_t> value(32);
+        for (auto& byte : value) { byte = static_cast<std::uint8_t>(random()); }
+        hashes.push_back(EncodeBase64(value));
+    }
+    auto blockMap = MakeBlockMap(hashes);
+    auto stream = MsixTest::StreamFile("test_blockmap.xml", false, true);
+    ULONG written = 0;
+    REQUIRE_SUCCEEDED(stream->Write(blockMap.data(), static_cast<ULONG>(blockMap.size()), &written));
+
+    const std::size_t runs = 5;
+    for (auto validation : xmlParsers)
+    {
+        MsixTest::ComPtr<IAppxFactory> factory;
+        REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+        auto elapsed = MsixTest::Benchmark::Measure(runs, [&]()
+        {
+            LARGE_INTEGER zero = { 0 };
+            REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_SET, nullptr));
+            MsixTest::ComPtr<IAppxBlockMapReader> blockMapReader;
+            REQUIRE_SUCCEEDED(factory->CreateBlockMapReader(stream.Get(), &blockMapReader));
+        });
+        std::cout << ((validation & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION) ? "Non-validating" : "Validating")
+            << ": " << blockMap.size() / 1024 << " KB blockmap opened in " << elapsed / 1000 << " ms" << std::endl;
+    }
+}
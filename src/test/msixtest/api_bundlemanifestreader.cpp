@@ -193,3 +193,48 @@ TEST_CASE("Api_AppxBundleManifestReader_PackageInfo", "[api]")
     }
     REQUIRE(expectedPackages.size() == numOfItems);
 }
+
+namespace {
+    HRESULT CreateBundleManifestReader(const std::string& fileName, MSIX_VALIDATION_OPTION validation)
+    {
+        std::string manifest =
+            "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+            "<Bundle xmlns=\"http://schemas.microsoft.com/appx/2013/bundle\" SchemaVersion=\"2.0\">"
+            "<Identity Name=\"Test.Bundle\" Publisher=\"CN=Test\" Version=\"1.0.0.0\"/>"
+            "<Packages>"
+            "<Package Type=\"application\" Version=\"1.0.0.0\" Architecture=\"x64\" FileName=\"" + fileName + "\" Offset=\"0\" Size=\"100\">"
+            "<Resources><Resource Language=\"en-us\"/></Resources>"
+            "</Package>"
+            "</Packages>"
+            "</Bundle>";
+        auto manifestStream = MsixTest::StreamFile("test_bundlemanifest.xml", false, true);
+        ULONG written = 0;
+        REQUIRE_SUCCEEDED(manifestStream->Write(manifest.data(), static_cast<ULONG>(manifest.size()), &written));
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(manifestStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+
+        MsixTest::ComPtr<IAppxBundleFactory> factory;
+        REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+            validation, MSIX_APPLICABILITY_OPTIONS::MSIX_APPLICABILITY_OPTION_FULL, &factory));
+        MsixTest::ComPtr<IAppxBundleManifestReader> bundleManifestReader;
+        return factory->CreateBundleManifestReader(manifestStream.Get(), &bundleManifestReader);
+    }
+}
+
+// Validates the FileName of the packages in the bundle manifest
+TEST_CASE("Api_AppxBundleManifestReader_PackageFileName", "[api]")
+{
+    for (auto validation : { MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        static_cast<MSIX_VALIDATION_OPTION>(MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION) })
+    {
+        for (const auto& fileName : { "a.appx", "a.msix", "Package_x64.appx", "..appx", "a b.msix", "a.msix.appx" })
+        {
+            REQUIRE_SUCCEEDED(CreateBundleManifestReader(fileName, validation));
+        }
+        for (const auto& fileName : { ".appx", ".msix", "a.APPX", "a.msixbundle", "a.appx.zip", "aappx", "a.msi", "a" })
+        {
+            INFO(fileName);
+            REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::AppxManifestSemanticError), CreateBundleManifestReader(fileName, validation));
+        }
+    }
+}
@@ -9,6 +9,9 @@
 #include "UnbundleTestData.hpp"
 #include "macros.hpp"
 
+#include <string>
+#include <vector>
+
 // Validates a footprint files from a bundle
 TEST_CASE("Api_AppxBundleReader_FootprintFiles", "[api]")
 {
@@ -85,3 +88,114 @@ TEST_CASE("Api_AppxBundleReader_PayloadPackages", "[api]")
     }
     REQUIRE(expectedPackages.size() == numOfPackages);
 }
+
+namespace {
+    // Values read from the bundle, its manifest, its blockmap and its payload packages with the validation options,
+    // used to compare the XML parsers
+    std::vector<std::string> GetBundleValues(const std::string& bundle, MSIX_VALIDATION_OPTION validation)
+    {
+        auto bundlePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unbundle) + "/" + bundle;
+        auto inputStream = MsixTest::StreamFile(bundlePath, true);
+        MsixTest::ComPtr<IAppxBundleFactory> bundleFactory;
+        REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation,
+            static_cast<MSIX_APPLICABILITY_OPTIONS>(MSIX_APPLICABILITY_OPTIONS::MSIX_APPLICABILITY_OPTION_SKIPPLATFORM |
+                                                    MSIX_APPLICABILITY_OPTIONS::MSIX_APPLICABILITY_OPTION_SKIPLANGUAGE),
+            &bundleFactory));
+        MsixTest::ComPtr<IAppxBundleReader> bundleReader;
+        REQUIRE_SUCCEEDED(bundleFactory->CreateBundleReader(inputStream.Get(), &bundleReader));
+
+        std::vector<std::string> result;
+        MsixTest::ComPtr<IAppxBundleManifestReader> bundleManifestReader;
+        REQUIRE_SUCCEEDED(bundleReader->GetManifest(&bundleManifestReader));
+        MsixTest::ComPtr<IAppxManifestPackageId> packageId;
+        REQUIRE_SUCCEEDED(bundleManifestReader->GetPackageId(&packageId));
+        MsixTest::Wrappers::Buffer<wchar_t> fullName;
+        REQUIRE_SUCCEEDED(packageId->GetPackageFullName(&fullName));
+        result.push_back(fullName.ToString());
+
+        MsixTest::ComPtr<IAppxBundleManifestPackageInfoEnumerator> packageInfoItems;
+        REQUIRE_SUCCEEDED(bundleManifestReader->GetPackageInfoItems(&packageInfoItems));
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(packageInfoItems->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxBundleManifestPackageInfo> packageInfo;
+            REQUIRE_SUCCEEDED(packageInfoItems->GetCurrent(&packageInfo));
+            APPX_BUNDLE_PAYLOAD_PACKAGE_TYPE type;
+            REQUIRE_SUCCEEDED(packageInfo->GetPackageType(&type));
+            MsixTest::ComPtr<IAppxManifestPackageId> infoPackageId;
+            REQUIRE_SUCCEEDED(packageInfo->GetPackageId(&infoPackageId));
+            MsixTest::Wrappers::Buffer<wchar_t> infoFullName;
+            REQUIRE_SUCCEEDED(infoPackageId->GetPackageFullName(&infoFullName));
+            MsixTest::Wrappers::Buffer<wchar_t> fileName;
+            REQUIRE_SUCCEEDED(packageInfo->GetFileName(&fileName));
+            UINT64 offset = 0;
+            REQUIRE_SUCCEEDED(packageInfo->GetOffset(&offset));
+            UINT64 size = 0;
+            REQUIRE_SUCCEEDED(packageInfo->GetSize(&size));
+            result.push_back(std::to_string(type) + " " + infoFullName.ToString() + " " + fileName.ToString() + " " +
+                std::to_string(offset) + " " + std::to_string(size));
+
+            MsixTest::ComPtr<IAppxManifestQualifiedResourcesEnumerator> resources;
+            REQUIRE_SUCCEEDED(packageInfo->GetResources(&resources));
+            BOOL hasCurrentResource = FALSE;
+            REQUIRE_SUCCEEDED(resources->GetHasCurrent(&hasCurrentResource));
+            while (hasCurrentResource)
+            {
+                MsixTest::ComPtr<IAppxManifestQualifiedResource> resource;
+                REQUIRE_SUCCEEDED(resources->GetCurrent(&resource));
+                MsixTest::Wrappers::Buffer<wchar_t> language;
+                REQUIRE_SUCCEEDED(resource->GetLanguage(&language));
+                UINT32 scale = 0;
+                REQUIRE_SUCCEEDED(resource->GetScale(&scale));
+                result.push_back(((language.Get() == nullptr) ? std::string() : language.ToString()) + " " + std::to_string(scale));
+                REQUIRE_SUCCEEDED(resources->MoveNext(&hasCurrentResource));
+            }
+            REQUIRE_SUCCEEDED(packageInfoItems->MoveNext(&hasCurrent));
+        }
+
+        MsixTest::ComPtr<IAppxBlockMapReader> blockMapReader;
+        REQUIRE_SUCCEEDED(bundleReader->GetBlockMap(&blockMapReader));
+        auto blockMap = MsixTest::GetBlockMapValues(blockMapReader.Get());
+        result.insert(result.end(), blockMap.begin(), blockMap.end());
+
+        MsixTest::ComPtr<IAppxFactory> factory;
+        REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+        MsixTest::ComPtr<IAppxFilesEnumerator> packages;
+        REQUIRE_SUCCEEDED(bundleReader->GetPayloadPackages(&packages));
+        REQUIRE_SUCCEEDED(packages->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxFile> package;
+            REQUIRE_SUCCEEDED(packages->GetCurrent(&package));
+            MsixTest::Wrappers::Buffer<wchar_t> packageName;
+            REQUIRE_SUCCEEDED(package->GetName(&packageName));
+            result.push_back(packageName.ToString());
+            MsixTest::ComPtr<IStream> packageStream;
+            REQUIRE_SUCCEEDED(package->GetStream(&packageStream));
+            MsixTest::ComPtr<IAppxPackageReader> packageReader;
+            REQUIRE_SUCCEEDED(factory->CreatePackageReader(packageStream.Get(), &packageReader));
+            auto packageValues = MsixTest::GetPackageValues(packageReader.Get());
+            result.insert(result.end(), packageValues.begin(), packageValues.end());
+            REQUIRE_SUCCEEDED(packages->MoveNext(&hasCurrent));
+        }
+        return result;
+    }
+}
+
+// Validates the non-validating XML parser reads the same bundle manifest, blockmap and payload packages from
+// every good bundle
+TEST_CASE("Api_AppxBundleReader_SkipXmlSchemaValidation", "[api]")
+{
+    auto validation = static_cast<MSIX_VALIDATION_OPTION>(
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION);
+    // Flat bundles can't be opened from a stream without a stream factory, the packages of the one in the test data
+    // are compared by Api_AppxPackageReader_SkipXmlSchemaValidation
+    for (const auto& bundle : { "BundleWithIntlPackage.appxbundle", "LanguageApplicability.appxbundle" })
+    {
+        INFO(bundle);
+        auto expected = GetBundleValues(bundle, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE);
+        REQUIRE(expected.size() > 1);
+        REQUIRE(expected == GetBundleValues(bundle, validation));
+    }
+}
@@ -9,7 +9,11 @@
 #include "macros.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <array>
+#include <string>
+#include <vector>
 
 // Validates IAppxManifestReader::GetStream
 TEST_CASE("Api_AppxManifestReader_Stream", "[api]")
@@ -674,3 +678,219 @@ TEST_CASE("Api_AppxManifestReader_OptionalPackage", "[api]")
     }
     REQUIRE(2 == numDep);
 }
+
+namespace {
+    // Validates the elements found by the manifest reader are the same the XPath API finds
+    void ValidateQueriesMatchXPath(const std::string& manifest)
+    {
+        MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+        MsixTest::InitializeManifestReader(manifest, &manifestReader);
+
+        std::vector<std::string> applications;
+        MsixTest::ComPtr<IAppxManifestApplicationsEnumerator> applicationsEnum;
+        REQUIRE_SUCCEEDED(manifestReader->GetApplications(&applicationsEnum));
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(applicationsEnum->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxManifestApplication> application;
+            REQUIRE_SUCCEEDED(applicationsEnum->GetCurrent(&application));
+            MsixTest::Wrappers::Buffer<wchar_t> aumid;
+            REQUIRE_SUCCEEDED(application->GetAppUserModelId(&aumid));
+            auto value = aumid.ToString();
+            applications.push_back(value.substr(value.find('!') + 1));
+            REQUIRE_SUCCEEDED(applicationsEnum->MoveNext(&hasCurrent));
+        }
+        REQUIRE(applications == MsixTest::GetAttributeValuesByXPath(manifestReader.Get(), { "Package", "Applications", "Application" }, "Id"));
+
+        std::vector<std::string> resources;
+        MsixTest::ComPtr<IAppxManifestResourcesEnumerator> resourcesEnum;
+        REQUIRE_SUCCEEDED(manifestReader->GetResources(&resourcesEnum));
+        REQUIRE_SUCCEEDED(resourcesEnum->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::Wrappers::Buffer<wchar_t> resource;
+            REQUIRE_SUCCEEDED(resourcesEnum->GetCurrent(&resource));
+            resources.push_back(resource.ToString());
+            REQUIRE_SUCCEEDED(resourcesEnum->MoveNext(&hasCurrent));
+        }
+        REQUIRE(resources == MsixTest::GetAttributeValuesByXPath(manifestReader.Get(), { "Package", "Resources", "Resource" }, "Language"));
+
+        std::vector<std::string> dependencies;
+        MsixTest::ComPtr<IAppxManifestPackageDependenciesEnumerator> dependenciesEnum;
+        REQUIRE_SUCCEEDED(manifestReader->GetPackageDependencies(&dependenciesEnum));
+        REQUIRE_SUCCEEDED(dependenciesEnum->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxManifestPackageDependency> dependency;
+            REQUIRE_SUCCEEDED(dependenciesEnum->GetCurrent(&dependency));
+            MsixTest::Wrappers::Buffer<wchar_t> name;
+            REQUIRE_SUCCEEDED(dependency->GetName(&name));
+            dependencies.push_back(name.ToString());
+            REQUIRE_SUCCEEDED(dependenciesEnum->MoveNext(&hasCurrent));
+        }
+        REQUIRE(dependencies == MsixTest::GetAttributeValuesByXPath(manifestReader.Get(), { "Package", "Dependencies", "PackageDependency" }, "Name"));
+
+        std::vector<std::string> tdfs;
+        MsixTest::ComPtr<IAppxManifestReader3> manifestReader3;
+        REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IAppxManifestReader3>::iid, reinterpret_cast<void**>(&manifestReader3)));
+        MsixTest::ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator> tdfEnum;
+        REQUIRE_SUCCEEDED(manifestReader3->GetTargetDeviceFamilies(&tdfEnum));
+        REQUIRE_SUCCEEDED(tdfEnum->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxManifestTargetDeviceFamily> tdf;
+            REQUIRE_SUCCEEDED(tdfEnum->GetCurrent(&tdf));
+            MsixTest::Wrappers::Buffer<wchar_t> name;
+            REQUIRE_SUCCEEDED(tdf->GetName(&name));
+            tdfs.push_back(name.ToString());
+            REQUIRE_SUCCEEDED(tdfEnum->MoveNext(&hasCurrent));
+        }
+        REQUIRE(tdfs == MsixTest::GetAttributeValuesByXPath(manifestReader.Get(), { "Package", "Dependencies", "TargetDeviceFamily" }, "Name"));
+    }
+}
+
+TEST_CASE("Api_AppxManifestReader_QueriesMatchXPath", "[api]")
+{
+    ValidateQueriesMatchXPath("Sample_AppxManifest.xml");
+    ValidateQueriesMatchXPath("Sample_AppxManifest_WithMainPackageDependencies.xml");
+}
+
+namespace {
+    // Values read from the manifest with the validation options, used to compare the XML parsers
+    std::vector<std::string> GetManifestValues(const std::string& manifest, MSIX_VALIDATION_OPTION validation)
+    {
+        auto manifestPath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Manifest) + "/" + manifest;
+        auto inputStream = MsixTest::StreamFile(manifestPath, true);
+        MsixTest::ComPtr<IAppxFactory> factory;
+        REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+        MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+        REQUIRE_SUCCEEDED(factory->CreateManifestReader(inputStream.Get(), &manifestReader));
+        return MsixTest::GetManifestValues(manifestReader.Get());
+    }
+}
+
+// Validates the non-validating XML parser reads the same values from the manifests
+TEST_CASE("Api_AppxManifestReader_SkipXmlSchemaValidation", "[api]")
+{
+    auto validation = static_cast<MSIX_VALIDATION_OPTION>(
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION);
+    for (const auto& manifest : { "Sample_AppxManifest.xml", "Sample_AppxManifest_WithMainPackageDependencies.xml" })
+    {
+        REQUIRE(GetManifestValues(manifest, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE) ==
+            GetManifestValues(manifest, validation));
+    }
+
+    // The document still has to be well formed
+    auto manifestStream = MsixTest::StreamFile("test_manifest.xml", false, true);
+    std::string manifest = "<?xml version=\"1.0\" encoding=\"utf-8\"?><Package><Identity Name=\"a\"></Package>";
+    ULONG written = 0;
+    REQUIRE_SUCCEEDED(manifestStream->Write(manifest.data(), static_cast<ULONG>(manifest.size()), &written));
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(manifestStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    MsixTest::ComPtr<IAppxFactory> factory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+    MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+    REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::XmlFatal), factory->CreateManifestReader(manifestStream.Get(), &manifestReader));
+}
+
+namespace {
+    // Reads Sample_AppxManifest.xml with the Name of the Identity and the TargetDeviceFamily replaced
+    HRESULT CreateManifestReader(const std::string& name, const std::string& tdf, MSIX_VALIDATION_OPTION validation)
+    {
+        auto manifestPath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Manifest) + "/Sample_AppxManifest.xml";
+        std::ifstream file(manifestPath, std::ios::binary);
+        std::string manifest((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto Replace = [&manifest](const std::string& from, const std::string& to)
+        {
+            auto position = manifest.find(from);
+            REQUIRE(position != std::string::npos);
+            manifest.replace(position, from.size(), to);
+        };
+        Replace("Identity Name=\"SampleAppManifest\"", "Identity Name=\"" + name + "\"");
+        Replace("TargetDeviceFamily Name=\"Windows.Desktop\"", "TargetDeviceFamily Name=\"" + tdf + "\"");
+
+        auto manifestStream = MsixTest::StreamFile("test_manifest.xml", false, true);
+        ULONG written = 0;
+        REQUIRE_SUCCEEDED(manifestStream->Write(manifest.data(), static_cast<ULONG>(manifest.size()), &written));
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(manifestStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+        MsixTest::ComPtr<IAppxFactory> factory;
+        REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+        MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+        return factory->CreateManifestReader(manifestStream.Get(), &manifestReader);
+    }
+}
+
+// Validates the semantic checks of identifiers and target device families
+TEST_CASE("Api_AppxManifestReader_IdentifierValidation", "[api]")
+{
+    auto validation = static_cast<MSIX_VALIDATION_OPTION>(
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION);
+
+    for (const auto& name : { "SampleAppManifest", "com10", "com0.app", "Lpt", "console", "con-app", "a.con", "null.x", "auxiliary", "xn-a", "a.xn--" })
+    {
+        INFO(name);
+        REQUIRE_SUCCEEDED(CreateManifestReader(name, "Windows.Desktop", validation));
+        REQUIRE_SUCCEEDED(CreateManifestReader(name, "Windows.Desktop", MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE));
+    }
+    for (const auto& name : { "con", "CON", "Prn.app", "aux.", "NUL.a.b", "nul.x", "com1", "COM9.x", "lpt5", "LPT1.txt", "xn--app", "XN--app", "app.", "app.." })
+    {
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::AppxManifestSemanticError), CreateManifestReader(name, "Windows.Desktop", validation));
+    }
+
+    for (const auto& tdf : { "Windows.Desktop", "windows.desktop", "WINDOWS.UNIVERSAL", "Platform.All", "Google.Android.Tablet", "web.all" })
+    {
+        REQUIRE_SUCCEEDED(CreateManifestReader("SampleAppManifest", tdf, validation));
+    }
+    for (const auto& tdf : { "Windows", "Windows.Desktop.", "Windows.Desktops", "Windows Desktop", "web.all.all" })
+    {
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::AppxManifestSemanticError), CreateManifestReader("SampleAppManifest", tdf, validation));
+    }
+}
+
+// Validates the sections of the manifest read on demand give the same values every time they are requested
+TEST_CASE("Api_AppxManifestReader_SectionsReadOnDemand", "[api]")
+{
+    for (const auto& manifest : { "Sample_AppxManifest.xml", "Sample_AppxManifest_WithMainPackageDependencies.xml" })
+    {
+        MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+        MsixTest::InitializeManifestReader(manifest, &manifestReader);
+        auto values = MsixTest::GetManifestValues(manifestReader.Get());
+        REQUIRE(values == MsixTest::GetManifestValues(manifestReader.Get()));
+        REQUIRE(values == GetManifestValues(manifest, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE));
+
+        MsixTest::ComPtr<IAppxManifestReader5> manifestReader5;
+        REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IAppxManifestReader5>::iid, reinterpret_cast<void**>(&manifestReader5)));
+        MsixTest::ComPtr<IAppxManifestReader4> manifestReader4;
+        REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IAppxManifestReader4>::iid, reinterpret_cast<void**>(&manifestReader4)));
+        for (int i = 0; i < 2; i++)
+        {
+            MsixTest::ComPtr<IAppxManifestMainPackageDependenciesEnumerator> mainPackageDependencies;
+            REQUIRE_SUCCEEDED(manifestReader5->GetMainPackageDependencies(&mainPackageDependencies));
+            BOOL hasCurrent = FALSE;
+            REQUIRE_SUCCEEDED(mainPackageDependencies->GetHasCurrent(&hasCurrent));
+            std::string firstName;
+            if (hasCurrent)
+            {
+                MsixTest::ComPtr<IAppxManifestMainPackageDependency> mainPackageDependency;
+                REQUIRE_SUCCEEDED(mainPackageDependencies->GetCurrent(&mainPackageDependency));
+                MsixTest::Wrappers::Buffer<wchar_t> name;
+                REQUIRE_SUCCEEDED(mainPackageDependency->GetName(&name));
+                firstName = name.ToString();
+            }
+
+            MsixTest::ComPtr<IAppxManifestOptionalPackageInfo> optionalPackageInfo;
+            REQUIRE_SUCCEEDED(manifestReader4->GetOptionalPackageInfo(&optionalPackageInfo));
+            BOOL isOptional = FALSE;
+            REQUIRE_SUCCEEDED(optionalPackageInfo->GetIsOptionalPackage(&isOptional));
+            REQUIRE(isOptional == hasCurrent);
+            if (isOptional)
+            {
+                MsixTest::Wrappers::Buffer<wchar_t> mainPackageName;
+                REQUIRE_SUCCEEDED(optionalPackageInfo->GetMainPackageName(&mainPackageName));
+                REQUIRE(firstName == mainPackageName.ToString());
+            }
+        }
+    }
+}
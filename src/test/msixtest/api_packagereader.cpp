@@ -12,6 +12,8 @@
 
 #include <iostream>
 #include <array>
+#include <string>
+#include <vector>
 
 // Validates all payload files from the package are correct
 TEST_CASE("Api_AppxPackageReader_PayloadFiles", "[api]")
@@ -141,3 +143,227 @@ TEST_CASE("Api_AppxPackageReader_FootprintFile", "[api]")
     std::replace(codeIntegrityName.begin(), codeIntegrityName.end(), '/', '\\');
     REQUIRE(codeIntegrityName == appxCodeIntegrityName.ToString());
 }
+
+// Opening the same package again takes its footprint files from the factory's document cache
+TEST_CASE("Api_AppxPackageReader_DocumentCache", "[api]")
+{
+    auto packagePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unpack) + "/HelloWorld.appx";
+
+    MsixTest::ComPtr<IAppxFactory> factory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &factory));
+    MsixTest::ComPtr<IMsixDocumentCache> cache;
+    REQUIRE_SUCCEEDED(factory->QueryInterface(UuidOfImpl<IMsixDocumentCache>::iid, reinterpret_cast<void**>(&cache)));
+
+    auto open = [&](IAppxPackageReader** packageReader)
+    {
+        auto stream = MsixTest::StreamFile(packagePath, true);
+        REQUIRE_SUCCEEDED(factory->CreatePackageReader(stream.Get(), packageReader));
+    };
+    auto getFullName = [](IAppxPackageReader* packageReader)
+    {
+        MsixTest::ComPtr<IAppxManifestReader> manifest;
+        REQUIRE_SUCCEEDED(packageReader->GetManifest(&manifest));
+        MsixTest::ComPtr<IAppxManifestPackageId> packageId;
+        REQUIRE_SUCCEEDED(manifest->GetPackageId(&packageId));
+        MsixTest::Wrappers::Buffer<wchar_t> fullName;
+        REQUIRE_SUCCEEDED(packageId->GetPackageFullName(&fullName));
+        return fullName.ToString();
+    };
+    auto getManifestBlocks = [](IAppxPackageReader* packageReader)
+    {
+        MsixTest::ComPtr<IAppxBlockMapReader> blockMap;
+        REQUIRE_SUCCEEDED(packageReader->GetBlockMap(&blockMap));
+        MsixTest::ComPtr<IAppxBlockMapFile> file;
+        REQUIRE_SUCCEEDED(blockMap->GetFile(L"AppxManifest.xml", &file));
+        MsixTest::ComPtr<IAppxBlockMapBlocksEnumerator> blocks;
+        REQUIRE_SUCCEEDED(file->GetBlocks(&blocks));
+        std::vector<std::vector<std::uint8_t>> hashes;
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(blocks->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            MsixTest::ComPtr<IAppxBlockMapBlock> block;
+            REQUIRE_SUCCEEDED(blocks->GetCurrent(&block));
+            UINT32 size = 0;
+            MsixTest::Wrappers::Buffer<BYTE> hash;
+            REQUIRE_SUCCEEDED(block->GetHash(&size, &hash));
+            hashes.emplace_back(hash.Get(), hash.Get() + size);
+            REQUIRE_SUCCEEDED(blocks->MoveNext(&hasCurrent));
+        }
+        return hashes;
+    };
+
+    // Disabled until a size limit is set
+    MsixTest::ComPtr<IAppxPackageReader> uncached;
+    open(&uncached);
+    MSIX_DOCUMENT_CACHE_STATISTICS statistics = {};
+    REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+    REQUIRE(statistics.entries == 0);
+    REQUIRE(statistics.misses == 0);
+    auto stream = MsixTest::StreamFile(packagePath, true);
+    REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidState), cache->Prewarm(stream.Get()));
+
+    // The content types, blockmap and manifest are parsed once
+    REQUIRE_SUCCEEDED(cache->SetSizeLimit(16 * 1024 * 1024));
+    MsixTest::ComPtr<IAppxPackageReader> first;
+    open(&first);
+    REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+    REQUIRE(statistics.misses == 3);
+    REQUIRE(statistics.hits == 0);
+    REQUIRE(statistics.entries == 3);
+    REQUIRE(statistics.size > 0);
+
+    MsixTest::ComPtr<IAppxPackageReader> second;
+    open(&second);
+    REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+    REQUIRE(statistics.misses == 3);
+    REQUIRE(statistics.hits == 3);
+    REQUIRE(statistics.entries == 3);
+
+    REQUIRE(getFullName(first.Get()) == getFullName(uncached.Get()));
+    REQUIRE(getFullName(second.Get()) == getFullName(uncached.Get()));
+    REQUIRE(getManifestBlocks(first.Get()) == getManifestBlocks(uncached.Get()));
+    REQUIRE(getManifestBlocks(second.Get()) == getManifestBlocks(uncached.Get()));
+
+    // The document element is read without the lock of the shared document, the reader parses its own DOM for it
+    {
+        MsixTest::ComPtr<IAppxManifestReader> manifest;
+        REQUIRE_SUCCEEDED(second->GetManifest(&manifest));
+        MsixTest::ComPtr<IMsixDocumentElement> msixDocument;
+        REQUIRE_SUCCEEDED(manifest->QueryInterface(UuidOfImpl<IMsixDocumentElement>::iid, reinterpret_cast<void**>(&msixDocument)));
+        MsixTest::ComPtr<IMsixElement> manifestElement;
+        REQUIRE_SUCCEEDED(msixDocument->GetDocumentElement(&manifestElement));
+        MsixTest::ComPtr<IMsixElementEnumerator> identities;
+        #ifdef MSIX_MSXML6
+        REQUIRE_SUCCEEDED(manifestElement->GetElementsUtf8("/*[local-name()='Package']/*[local-name()='Identity']", &identities));
+        #else
+        REQUIRE_SUCCEEDED(manifestElement->GetElementsUtf8("/Package/Identity", &identities));
+        #endif
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(identities->GetHasCurrent(&hasCurrent));
+        REQUIRE(hasCurrent);
+        MsixTest::ComPtr<IMsixElement> identity;
+        REQUIRE_SUCCEEDED(identities->GetCurrent(&identity));
+        MsixTest::Wrappers::Buffer<char> name;
+        REQUIRE_SUCCEEDED(identity->GetAttributeValueUtf8("Name", &name));
+        REQUIRE(getFullName(uncached.Get()).compare(0, name.ToString().size() + 1, name.ToString() + "_") == 0);
+
+        REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+        REQUIRE(statistics.misses == 3);
+        REQUIRE(statistics.hits == 3);
+    }
+
+    // Readers keep what they share after the cache drops it
+    REQUIRE_SUCCEEDED(cache->Clear());
+    REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+    REQUIRE(statistics.entries == 0);
+    REQUIRE(statistics.size == 0);
+    REQUIRE(getFullName(second.Get()) == getFullName(uncached.Get()));
+
+    stream = MsixTest::StreamFile(packagePath, true);
+    REQUIRE_SUCCEEDED(cache->Prewarm(stream.Get()));
+    MsixTest::ComPtr<IAppxPackageReader> prewarmed;
+    open(&prewarmed);
+    REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+    REQUIRE(statistics.misses == 6);
+    REQUIRE(statistics.hits == 6);
+
+    // Entries over the size limit are evicted, and not added
+    REQUIRE_SUCCEEDED(cache->SetSizeLimit(1));
+    REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+    REQUIRE(statistics.entries == 0);
+    REQUIRE(statistics.evictions == 3);
+    MsixTest::ComPtr<IAppxPackageReader> tooBig;
+    open(&tooBig);
+    REQUIRE_SUCCEEDED(cache->GetStatistics(&statistics));
+    REQUIRE(statistics.entries == 0);
+    REQUIRE(statistics.misses == 9);
+    REQUIRE(getFullName(tooBig.Get()) == getFullName(uncached.Get()));
+
+    REQUIRE_SUCCEEDED(cache->SetSizeLimit(0));
+    REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::InvalidParameter), cache->GetStatistics(nullptr));
+}
+
+namespace {
+    // Packages in the test data that can be opened
+    const std::vector<std::string> goodPackages = {
+        "CentennialCoffee.appx", "HelloWorld.appx", "IntlPackage.appx", "NotepadPlusPlus.appx",
+        "TestAppxPackage_Win32.appx", "TestAppxPackage_x64.appx",
+        "platforms/TestAosp.msix", "platforms/TestAppleIos.msix", "platforms/TestLinux.msix", "platforms/TestMac.msix",
+        "platforms/TestPlatformAll.msix",
+        "flat/language-de.appx", "flat/language-en.appx", "flat/language-es.appx", "flat/language-fr.appx",
+        "flat/language-it.appx", "flat/language-ja.appx", "flat/language-ko.appx", "flat/language-pt.appx",
+        "flat/language-ru.appx", "flat/language-uk.appx", "flat/language-zh-hans.appx", "flat/language-zh-hant.appx",
+        "flat/scale-140.appx", "flat/scale-180.appx", "flat/scale-240.appx" };
+
+    // Opens a package of the test data with the validation options
+    void OpenPackage(const std::string& package, MSIX_VALIDATION_OPTION validation, IAppxPackageReader** packageReader)
+    {
+        auto packagePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unpack) + "/" + package;
+        auto inputStream = MsixTest::StreamFile(packagePath, true);
+        MsixTest::ComPtr<IAppxFactory> factory;
+        REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+        REQUIRE_SUCCEEDED(factory->CreatePackageReader(inputStream.Get(), packageReader));
+    }
+
+    // Values read from the package with the validation options, used to compare the XML parsers
+    std::vector<std::string> GetPackageValues(const std::string& package, MSIX_VALIDATION_OPTION validation)
+    {
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        OpenPackage(package, validation, &packageReader);
+        return MsixTest::GetPackageValues(packageReader.Get());
+    }
+}
+
+// Validates the non-validating XML parser reads the same manifest and blockmap values from every good package.
+// [Content_Types].xml is parsed by both when the package is opened, nothing is read from it; what each accepts is
+// validated by Pack_ContentTypes_SkipXmlSchemaValidation.
+TEST_CASE("Api_AppxPackageReader_SkipXmlSchemaValidation", "[api]")
+{
+    auto validation = static_cast<MSIX_VALIDATION_OPTION>(
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION);
+    for (const auto& package : goodPackages)
+    {
+        INFO(package);
+        auto expected = GetPackageValues(package, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE);
+        REQUIRE(expected.size() > 1);
+        REQUIRE(expected == GetPackageValues(package, validation));
+    }
+}
+
+// Time to open every good package, which parses its [Content_Types].xml, AppxBlockMap.xml and AppxManifest.xml,
+// with the validating and with the non-validating XML parser
+TEST_CASE("Api_AppxPackageReader_SkipXmlSchemaValidation_benchmark", "[api][.benchmark]")
+{
+    UINT64 footprintSize = 0;
+    for (const auto& package : goodPackages)
+    {
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        OpenPackage(package, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &packageReader);
+        for (auto type : { APPX_FOOTPRINT_FILE_TYPE_MANIFEST, APPX_FOOTPRINT_FILE_TYPE_BLOCKMAP })
+        {
+            MsixTest::ComPtr<IAppxFile> file;
+            REQUIRE_SUCCEEDED(packageReader->GetFootprintFile(type, &file));
+            UINT64 size = 0;
+            REQUIRE_SUCCEEDED(file->GetSize(&size));
+            footprintSize += size;
+        }
+    }
+
+    const std::size_t runs = 20;
+    for (auto validation : { MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE, static_cast<MSIX_VALIDATION_OPTION>(
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION) })
+    {
+        auto elapsed = MsixTest::Benchmark::Measure(runs, [&]()
+        {
+            for (const auto& package : goodPackages)
+            {
+                MsixTest::ComPtr<IAppxPackageReader> packageReader;
+                OpenPackage(package, validation, &packageReader);
+            }
+        });
+        std::cout << ((validation & MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION) ? "Non-validating" : "Validating")
+            << ": " << goodPackages.size() << " packages in " << elapsed / 1000 << " ms, "
+            << footprintSize / elapsed << " MB/s of manifests and blockmaps" << std::endl;
+    }
+}
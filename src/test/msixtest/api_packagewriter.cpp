@@ -11,6 +11,13 @@
 #include "StreamBase.hpp"
 
 #include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
 
 using namespace MsixTest::Pack;
 
@@ -196,8 +203,8 @@ TEST_CASE("Api_AppxPackageWriter_payloadfiles", "[api]")
 
     auto packageWriter3 = packageWriter.As<IAppxPackageWriter3>();
 
-    // memoryLimist isn't implemented yet, but set a very small memory limit to force
-    // all the handling loops when we do: 320kb.
+    // Set a very small memory limit to force all the handling loops: 320kb. The files are
+    // compressed in several batches and the biggest ones don't fit in memory at all.
     REQUIRE_SUCCEEDED(packageWriter3->AddPayloadFiles(
         static_cast<UINT32>(TestConstants::GoodFileNames.size()),
         payloadFiles.data(),
@@ -257,8 +264,8 @@ TEST_CASE("Api_AppxPackageWriter_payloadfiles_utf8", "[api]")
 
     auto packageWriter3utf8 = packageWriter.As<IAppxPackageWriter3Utf8>();
 
-    // memoryLimist isn't implemented yet, but set a very small memory limit to force
-    // all the handling loops when we do: 320kb.
+    // Set a very small memory limit to force all the handling loops: 320kb. The files are
+    // compressed in several batches and the biggest ones don't fit in memory at all.
     REQUIRE_SUCCEEDED(packageWriter3utf8->AddPayloadFiles(
         static_cast<UINT32>(TestConstants::GoodFileNames.size()),
         payloadFiles.data(),
@@ -278,6 +285,123 @@ TEST_CASE("Api_AppxPackageWriter_payloadfiles_utf8", "[api]")
     MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
 }
 
+std::vector<std::uint8_t> ReadPackageWriterOutput(IStream* stream)
+{
+    LARGE_INTEGER zero = { 0 };
+    ULARGE_INTEGER size = { 0 };
+    REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_END, &size));
+    REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    std::vector<std::uint8_t> data(static_cast<size_t>(size.QuadPart));
+    ULONG read = 0;
+    REQUIRE_SUCCEEDED(stream->Read(data.data(), static_cast<ULONG>(data.size()), &read));
+    REQUIRE(read == data.size());
+    return data;
+}
+
+// Test that IAppxPackageWriter3 produces the same package as adding the files one by one
+TEST_CASE("Api_AppxPackageWriter_payloadfiles_deterministic", "[api]")
+{
+    std::vector<APPX_PACKAGE_WRITER_PAYLOAD_STREAM> payloadFiles;
+    std::vector<MsixTest::StreamFile> streams;
+    payloadFiles.resize(TestConstants::GoodFileNames.size());
+    streams.resize(TestConstants::GoodFileNames.size());
+
+    const std::uint32_t contentSizeIncrement = DefaultBlockSize * 10 / static_cast<uint32_t>(TestConstants::GoodFileNames.size()) + 1;
+    std::uint32_t contentSize = 10;
+
+    for(size_t i = 0; i < TestConstants::GoodFileNames.size(); i++)
+    {
+        streams[i].Initialize(TestConstants::GoodFileNames[i].first, false, true);
+        WriteContentToStream(contentSize, streams[i].Get());
+
+        payloadFiles[i].fileName = TestConstants::GoodFileNames[i].second.c_str();
+        payloadFiles[i].contentType = TestConstants::ContentType.c_str();
+        // Mix stored and compressed files
+        payloadFiles[i].compressionOption = (i % 3 == 0) ? APPX_COMPRESSION_OPTION_NONE : APPX_COMPRESSION_OPTION_NORMAL;
+        payloadFiles[i].inputStream = streams[i].Get();
+        contentSize += contentSizeIncrement;
+    }
+
+    // One by one
+    auto serialStream = MsixTest::StreamFile("test_package_serial.msix", false, true);
+    {
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(serialStream.Get(), &packageWriter);
+        for (const auto& payloadFile : payloadFiles)
+        {
+            REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(payloadFile.fileName, payloadFile.contentType,
+                payloadFile.compressionOption, payloadFile.inputStream));
+        }
+        MsixTest::ComPtr<IStream> manifestStream;
+        MakeManifestStream(&manifestStream);
+        REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+    }
+    auto expected = ReadPackageWriterOutput(serialStream.Get());
+
+    // All in memory, and with a limit that splits them in batches
+    for (UINT64 memoryLimit : { static_cast<UINT64>(0x10000000), static_cast<UINT64>(327680) })
+    {
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        REQUIRE_SUCCEEDED(packageWriter.As<IAppxPackageWriter3>()->AddPayloadFiles(
+            static_cast<UINT32>(payloadFiles.size()), payloadFiles.data(), memoryLimit));
+        MsixTest::ComPtr<IStream> manifestStream;
+        MakeManifestStream(&manifestStream);
+        REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+        REQUIRE(expected == ReadPackageWriterOutput(outputStream.Get()));
+    }
+}
+
+// Test that the block buffers are allocated once and reused for every file, and that
+// the zip records are written with one write per file plus one for the central directory
+TEST_CASE("Api_AppxPackageWriter_statistics", "[api]")
+{
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+
+    MSIX_PACK_STATISTICS statistics = {};
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+
+    const std::uint32_t contentSize = DefaultBlockSize * 3 + 10;
+    std::uint64_t expectedBlocks = 0;
+    for(const auto& fileName : TestConstants::GoodFileNames)
+    {
+        auto fileStream = MsixTest::StreamFile(fileName.first, false, true);
+        WriteContentToStream(contentSize, fileStream.Get());
+        REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(
+            fileName.second.c_str(),
+            TestConstants::ContentType.c_str(),
+            APPX_COMPRESSION_OPTION_NORMAL,
+            fileStream.Get()));
+        expectedBlocks += 4;
+    }
+
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, false));
+    REQUIRE(statistics.blocks == expectedBlocks);
+    REQUIRE(statistics.bufferAllocations == 2);
+    REQUIRE(statistics.bufferReuses == TestConstants::GoodFileNames.size() - 1);
+
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    REQUIRE(statistics.bufferAllocations == 2);
+
+    // Payload files, AppxManifest.xml, AppxBlockMap.xml and [Content_Types].xml
+    auto files = TestConstants::GoodFileNames.size() + 3;
+    REQUIRE(statistics.zipRecordWrites == files + 1);
+
+    ULARGE_INTEGER packageSize = { 0 };
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_END, &packageSize));
+    REQUIRE(statistics.zipRecordBytes < packageSize.QuadPart);
+}
+
 // Tests failure cases for IAppxPackageWriter
 TEST_CASE("Api_AppxPackageWriter_state_errors", "[api]")
 {
@@ -329,6 +453,490 @@ TEST_CASE("Api_AppxPackageWriter_invalid_names", "[api]")
     }
 }
 
+// Names must round trip through the UTF-8 and the wide APIs unchanged
+TEST_CASE("Api_AppxPackageWriter_unicode_names", "[api]")
+{
+    std::vector<std::pair<std::wstring, std::string>> names = {
+        { L"caf\u00e9.txt", "caf\xC3\xA9.txt" },
+        { L"\u65e5\u672c\u8a9e.txt", "\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E.txt" },
+        { L"\ue000.txt", "\xEE\x80\x80.txt" },
+        { L"a\ufeffb.txt", "a\xEF\xBB\xBF" "b.txt" },
+        { L"\U0001F600.txt", "\xF0\x9F\x98\x80.txt" },
+        { L"\U0010FFFD.txt", "\xF4\x8F\xBF\xBD.txt" },
+    };
+    // Non-ASCII characters before, at and after the end of a vector of ASCII
+    for (std::size_t count : { 7, 8, 9, 15, 16, 17, 31, 32, 33 })
+    {
+        names.push_back({ std::wstring(count, L'a') + L"\u00e9\u20ac" + std::wstring(count, L'b'),
+            std::string(count, 'a') + "\xC3\xA9\xE2\x82\xAC" + std::string(count, 'b') });
+    }
+    // Names of exactly one and two vectors of UTF-16 units, all ASCII or with a non-ASCII last unit
+    for (std::size_t count : { 8, 16 })
+    {
+        names.push_back({ std::wstring(count - 4, L'a') + L".txt", std::string(count - 4, 'a') + ".txt" });
+        names.push_back({ std::wstring(count - 1, L'a') + L"\u00e9", std::string(count - 1, 'a') + "\xC3\xA9" });
+    }
+
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+    for (bool useUtf8 : { false, true })
+    {
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+        auto fileStream = MsixTest::StreamFile("test_file.txt", false, true);
+        WriteContentToStream(200, fileStream.Get());
+        for (const auto& name : names)
+        {
+            if (useUtf8)
+            {
+                REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(name.second.c_str(), contentType.c_str(),
+                    APPX_COMPRESSION_OPTION_NORMAL, fileStream.Get()));
+            }
+            else
+            {
+                REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(name.first.c_str(), TestConstants::ContentType.c_str(),
+                    APPX_COMPRESSION_OPTION_NORMAL, fileStream.Get()));
+            }
+        }
+
+        MsixTest::ComPtr<IStream> manifestStream;
+        MakeManifestStream(&manifestStream);
+        REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+        for (const auto& name : names)
+        {
+            MsixTest::ComPtr<IAppxFile> appxFile;
+            REQUIRE_SUCCEEDED(packageReader->GetPayloadFile(name.first.c_str(), &appxFile));
+
+            MsixTest::Wrappers::Buffer<wchar_t> nameW;
+            REQUIRE_SUCCEEDED(appxFile->GetName(&nameW));
+            REQUIRE(name.first == nameW.Get());
+
+            MsixTest::Wrappers::Buffer<char> nameUtf8;
+            REQUIRE_SUCCEEDED(appxFile.As<IAppxFileUtf8>()->GetName(&nameUtf8));
+            REQUIRE(name.second == nameUtf8.Get());
+        }
+    }
+}
+
+struct ZipEntry
+{
+    std::string name;
+    std::uint64_t lfhOffset;
+};
+
+// Returns the entries in the central directory of a zip64 package, in the order they are in it. Checks that the
+// local file header of every entry is at its offset and has its name.
+std::vector<ZipEntry> GetZipEntries(IStream* stream)
+{
+    LARGE_INTEGER zero = { 0 };
+    ULARGE_INTEGER size = { 0 };
+    REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_END, &size));
+    REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    std::vector<std::uint8_t> data(static_cast<std::size_t>(size.QuadPart));
+    ULONG read = 0;
+    REQUIRE_SUCCEEDED(stream->Read(data.data(), static_cast<ULONG>(data.size()), &read));
+    REQUIRE(read == data.size());
+
+    auto readNumber = [&data](std::size_t offset, std::size_t bytes)
+    {
+        REQUIRE(offset + bytes <= data.size());
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < bytes; i++) { value |= static_cast<std::uint64_t>(data[offset + i]) << (8 * i); }
+        return value;
+    };
+
+    // End of central directory record (no comment), preceded by the zip64 locator
+    REQUIRE(data.size() >= 22 + 20);
+    std::size_t endOfCentralDirectory = data.size() - 22;
+    REQUIRE(readNumber(endOfCentralDirectory, 4) == 0x06054b50);
+    REQUIRE(readNumber(endOfCentralDirectory - 20, 4) == 0x07064b50);
+    auto zip64EndOfCentralDirectory = static_cast<std::size_t>(readNumber(endOfCentralDirectory - 20 + 8, 8));
+    REQUIRE(readNumber(zip64EndOfCentralDirectory, 4) == 0x06064b50);
+    auto entries = readNumber(zip64EndOfCentralDirectory + 32, 8);
+    auto offset = static_cast<std::size_t>(readNumber(zip64EndOfCentralDirectory + 48, 8));
+
+    std::vector<ZipEntry> result;
+    for (std::uint64_t entry = 0; entry < entries; entry++)
+    {
+        REQUIRE(readNumber(offset, 4) == 0x02014b50);
+        auto nameSize = static_cast<std::size_t>(readNumber(offset + 28, 2));
+        auto extraSize = static_cast<std::size_t>(readNumber(offset + 30, 2));
+        auto commentSize = static_cast<std::size_t>(readNumber(offset + 32, 2));
+        REQUIRE(offset + 46 + nameSize <= data.size());
+        ZipEntry zipEntry = { std::string(reinterpret_cast<const char*>(data.data() + offset + 46), nameSize),
+            readNumber(offset + 42, 4) };
+        if (zipEntry.lfhOffset == 0xFFFFFFFF)
+        {   // In the zip64 extra field, after the sizes that don't fit in the header
+            auto extra = offset + 46 + nameSize;
+            REQUIRE(readNumber(extra, 2) == 0x0001);
+            auto field = extra + 4;
+            if (readNumber(offset + 24, 4) == 0xFFFFFFFF) { field += 8; }
+            if (readNumber(offset + 20, 4) == 0xFFFFFFFF) { field += 8; }
+            zipEntry.lfhOffset = readNumber(field, 8);
+        }
+        auto lfh = static_cast<std::size_t>(zipEntry.lfhOffset);
+        REQUIRE(readNumber(lfh, 4) == 0x04034b50);
+        REQUIRE(readNumber(lfh + 26, 2) == nameSize);
+        REQUIRE(zipEntry.name == std::string(reinterpret_cast<const char*>(data.data() + lfh + 30), nameSize));
+        result.push_back(std::move(zipEntry));
+        offset += 46 + nameSize + extraSize + commentSize;
+    }
+    return result;
+}
+
+// Returns the names of the entries in the central directory of a zip64 package
+std::vector<std::string> GetZipEntryNames(IStream* stream)
+{
+    std::vector<std::string> names;
+    for (const auto& entry : GetZipEntries(stream))
+    {
+        names.push_back(entry.name);
+    }
+    return names;
+}
+
+// Names are percentage encoded in the package and must come back unchanged when unpacked. The encoded names were
+// produced by the previous, UTF-16 based, implementation.
+TEST_CASE("Api_AppxPackageWriter_escaped_names_unpack", "[api]")
+{
+    struct EscapedName
+    {
+        std::string name;
+        std::string encoded;
+        std::string unpacked;
+    };
+    const std::vector<EscapedName> names = {
+        { "plain_name-1.0.txt", "plain_name-1.0.txt", "plain_name-1.0.txt" },
+        { " !#$%&'()+,;=@[]^`{}~.txt", "%20%21%23%24%25%26%27%28%29%2B%2C%3B%3D%40%5B%5D%5E%60%7B%7D~.txt", " !#$%&'()+,;=@[]^`{}~.txt" },
+        { "%%41%20.txt", "%25%2541%2520.txt", "%%41%20.txt" },
+        { "dir with spaces/file\x7F.txt", "dir%20with%20spaces/file\x7F.txt", "dir with spaces/file\x7F.txt" },
+        { "caf\xC3\xA9/\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E.txt", "caf%C3%A9/%E6%97%A5%E6%9C%AC%E8%AA%9E.txt", "caf\xC3\xA9/\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E.txt" },
+        { "\xF0\x9F\x98\x80 and more text after the sequence.txt", "%F0%9F%98%80%20and%20more%20text%20after%20the%20sequence.txt", "\xF0\x9F\x98\x80 and more text after the sequence.txt" },
+        { "\xF0\x9D\xA0\x80.txt", "%F0%9D%A0%80.txt", "\xF0\x9D\xA0\x80.txt" },
+        { "end\xE2\x82\xAC", "end%E2%82%AC", "end\xE2\x82\xAC" },
+        // Text that looks like escapes is escaped again, not decoded
+        { "%00 null.txt", "%2500%20null.txt", "%00 null.txt" },
+        { "%c3%a9 lower.txt", "%25c3%25a9%20lower.txt", "%c3%a9 lower.txt" },
+        { "%G1%1 bad hex.txt", "%25G1%251%20bad%20hex.txt", "%G1%1 bad hex.txt" },
+        { "%E6%97 truncated.txt", "%25E6%2597%20truncated.txt", "%E6%97 truncated.txt" },
+    };
+
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+    auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+    // Every file gets its own content, so a file unpacked under the wrong name is found
+    std::vector<std::string> contents;
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        std::string content;
+        for (int repeat = 0; repeat < 20; repeat++) { content += std::to_string(i) + ": " + names[i].name + "\n"; }
+        contents.push_back(content);
+
+        auto fileStream = MsixTest::StreamFile("test_file_" + std::to_string(i) + ".txt", false, true);
+        REQUIRE_SUCCEEDED(fileStream.Get()->Write(content.data(), static_cast<ULONG>(content.size()), nullptr));
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(fileStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+        REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(names[i].name.c_str(), contentType.c_str(),
+            APPX_COMPRESSION_OPTION_NORMAL, fileStream.Get()));
+    }
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    auto entryNames = GetZipEntryNames(outputStream.Get());
+    for (const auto& name : names)
+    {
+        INFO(name.encoded);
+        REQUIRE(std::find(entryNames.begin(), entryNames.end(), name.encoded) != entryNames.end());
+    }
+
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+    auto outputDir = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Output);
+    REQUIRE_SUCCEEDED(UnpackPackageFromStream(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+        outputStream.Get(),
+        const_cast<char*>(outputDir.c_str())));
+
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        INFO(names[i].unpacked);
+        auto unpacked = MsixTest::StreamFile(outputDir + "/" + names[i].unpacked, true);
+        ULARGE_INTEGER size = { 0 };
+        REQUIRE_SUCCEEDED(unpacked.Get()->Seek(zero, STREAM_SEEK_END, &size));
+        REQUIRE(contents[i].size() == static_cast<std::size_t>(size.QuadPart));
+        REQUIRE_SUCCEEDED(unpacked.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+        std::string content(contents[i].size(), '\0');
+        ULONG read = 0;
+        REQUIRE_SUCCEEDED(unpacked.Get()->Read(&content[0], static_cast<ULONG>(content.size()), &read));
+        REQUIRE(read == content.size());
+        REQUIRE(contents[i] == content);
+    }
+    CHECK(MsixTest::Directory::CleanDirectory(outputDir));
+}
+
+// Reads a footprint file of a package written by a package writer
+std::string ReadFootprintFile(IStream* packageStream, APPX_FOOTPRINT_FILE_TYPE type)
+{
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(packageStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    MsixTest::InitializePackageReader(packageStream, &packageReader);
+    MsixTest::ComPtr<IAppxFile> file;
+    REQUIRE_SUCCEEDED(packageReader->GetFootprintFile(type, &file));
+    MsixTest::ComPtr<IStream> stream;
+    REQUIRE_SUCCEEDED(file->GetStream(&stream));
+
+    std::string content;
+    std::vector<char> buffer(DefaultBlockSize);
+    ULONG read = 0;
+    do
+    {
+        REQUIRE_SUCCEEDED(stream->Read(buffer.data(), static_cast<ULONG>(buffer.size()), &read));
+        content.append(buffer.data(), read);
+    } while (read != 0);
+    return content;
+}
+
+// Test that attribute values are escaped. AppxBlockMap.xml must match the document written by the
+// previous XmlWriter, which escaped & < > and #xD the same way.
+TEST_CASE("Api_AppxPackageWriter_escaped_attributes", "[api]")
+{
+    // The schema of [Content_Types].xml allows & and ' in content types, but not < > or quotes
+    const std::vector<std::pair<std::string, std::string>> files = {
+        { "a&b's.txt", "text/x-a&b's" },
+        { "dir&co/it's.a&b", "application/x-'a'&(b)" },
+        { "noext&", "application/x-it's&more" },
+        { "media/it's.png", "image/png" },
+    };
+
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+    auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+    const std::string content = "some content\n";
+    for (const auto& file : files)
+    {
+        auto fileStream = MsixTest::StreamFile("test_file.txt", false, true);
+        REQUIRE_SUCCEEDED(fileStream.Get()->Write(content.data(), static_cast<ULONG>(content.size()), nullptr));
+        REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(file.first.c_str(), file.second.c_str(),
+            APPX_COMPRESSION_OPTION_NORMAL, fileStream.Get()));
+    }
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    auto expectedPath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/EscapedAttributes_AppxBlockMap.xml";
+    auto expected = ReadPackageWriterOutput(MsixTest::StreamFile(expectedPath, true).Get());
+    // Opening the package also parses [Content_Types].xml, and validates it against its schema where the parser does
+    auto blockMap = ReadFootprintFile(outputStream.Get(), APPX_FOOTPRINT_FILE_TYPE_BLOCKMAP);
+    REQUIRE(std::string(expected.begin(), expected.end()) == blockMap);
+}
+
+// Test that content types the schema rejects still make a well formed [Content_Types].xml. The previous
+// XmlWriter wrote quotes as they are, which ended the ContentType attribute and failed with XmlFatal.
+TEST_CASE("Api_AppxPackageWriter_escaped_attributes_schema", "[api]")
+{
+    const std::vector<std::string> contentTypes = {
+        "text/x-<less>&<greater>",
+        "text/plain;name=\"it's\"",
+        "text/plain;a=b\rc",
+    };
+
+    for (const auto& contentType : contentTypes)
+    {
+        INFO(contentType);
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        auto fileStream = MsixTest::StreamFile("test_file.txt", false, true);
+        WriteContentToStream(100, fileStream.Get());
+        REQUIRE_SUCCEEDED(packageWriter.As<IAppxPackageWriterUtf8>()->AddPayloadFile("file.txt", contentType.c_str(),
+            APPX_COMPRESSION_OPTION_NORMAL, fileStream.Get()));
+        MsixTest::ComPtr<IStream> manifestStream;
+        MakeManifestStream(&manifestStream);
+        REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+        // A validating parser rejects the value with the schema, any other opens the package
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+        MsixTest::ComPtr<IAppxFactory> appxFactory;
+        REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+            MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &appxFactory));
+        MsixTest::ComPtr<IAppxPackageReader> packageReader;
+        auto hr = appxFactory->CreatePackageReader(outputStream.Get(), &packageReader);
+        if (hr != S_OK)
+        {
+            REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::XmlError), hr);
+        }
+    }
+}
+
+// Name of a file of the spill tests, size characters long
+std::string GetSpillFileName(std::size_t index, std::size_t size)
+{
+    auto number = std::to_string(index);
+    auto name = "spill/" + std::string(6 - number.size(), '0') + number;
+    name.append(size - name.size() - 4, 'x');
+    return name + ".txt";
+}
+
+// Packs one byte, stored, files and returns the AppxBlockMap.xml of the package
+std::string PackBlockMap(const std::vector<std::string>& names)
+{
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+    auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+    // Every package gets the same content, unlike with WriteContentToStream
+    auto contentStream = MsixTest::StreamFile("test_file.txt", false, true);
+    REQUIRE_SUCCEEDED(contentStream.Get()->Write("x", 1, nullptr));
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+    for (const auto& name : names)
+    {
+        REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(name.c_str(), contentType.c_str(),
+            APPX_COMPRESSION_OPTION_NONE, contentStream.Get()));
+    }
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+    return ReadFootprintFile(outputStream.Get(), APPX_FOOTPRINT_FILE_TYPE_BLOCKMAP);
+}
+
+// Test AppxBlockMap.xml documents around the 4MB the package writer keeps in memory before it moves
+// them to a temporary file. Every File element is the same but for the name, so the expected document
+// is built from the one of a single file package.
+TEST_CASE("Api_AppxPackageWriter_blockmap_spill", "[api]")
+{
+    const std::size_t memoryLimit = 4 * 1024 * 1024;
+    const std::size_t nameSize = 100;
+
+    auto probeName = GetSpillFileName(0, nameSize);
+    auto probe = PackBlockMap({ probeName });
+    auto fileStart = probe.find("<File ");
+    auto manifestStart = probe.find("<File Name=\"AppxManifest.xml\"");
+    REQUIRE(fileStart < manifestStart);
+    auto prefix = probe.substr(0, fileStart);
+    auto suffix = probe.substr(manifestStart);
+
+    // <File Name="spill\000000xx...x.txt" Size="1" LfhSize="130">...</File>
+    auto element = probe.substr(fileStart, manifestStart - fileStart);
+    std::replace(probeName.begin(), probeName.end(), '/', '\\');
+    auto namePosition = element.find(probeName);
+    auto lfhPosition = element.find("LfhSize=\"") + 9;
+    auto lfhEnd = element.find('"', lfhPosition);
+    REQUIRE(namePosition != std::string::npos);
+    auto lfhBase = std::stoul(element.substr(lfhPosition, lfhEnd - lfhPosition)) - nameSize;
+    auto elementStart = element.substr(0, namePosition);
+    auto elementMiddle = element.substr(namePosition + nameSize, lfhPosition - namePosition - nameSize);
+    auto elementEnd = element.substr(lfhEnd);
+
+    SECTION("No payload files")
+    {
+        REQUIRE((prefix + suffix) == PackBlockMap({}));
+    }
+
+    // At the limit the document stays in memory, one byte over and more it is written to the temporary file
+    for (std::size_t size : { memoryLimit, memoryLimit + 1, memoryLimit * 2 })
+    {
+        SECTION("Document of " + std::to_string(size) + " bytes")
+        {
+            // Names one character longer take up the remainder
+            auto available = size - prefix.size() - suffix.size();
+            auto count = available / element.size();
+            auto longer = available % element.size();
+            REQUIRE(longer <= count);
+
+            std::vector<std::string> names;
+            std::string expected = prefix;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                auto nameLength = (i < longer) ? nameSize + 1 : nameSize;
+                auto name = GetSpillFileName(i, nameLength);
+                names.push_back(name);
+                std::replace(name.begin(), name.end(), '/', '\\');
+                expected += elementStart + name + elementMiddle + std::to_string(lfhBase + nameLength) + elementEnd;
+            }
+            expected += suffix;
+            REQUIRE(expected.size() == size);
+
+            auto blockMap = PackBlockMap(names);
+            REQUIRE(blockMap.size() == expected.size());
+            REQUIRE((blockMap == expected));
+        }
+    }
+}
+
+// Malformed UTF-8 is rejected, never replaced. The previous implementation failed all of them with Unexpected.
+TEST_CASE("Api_AppxPackageWriter_invalid_names_utf8", "[api]")
+{
+    const std::vector<std::string> names = {
+        "a\x80.txt",                // unexpected continuation byte
+        "a\xC3(.txt",               // missing continuation byte
+        "a\xC3",                    // truncated at the end
+        "a\xE6\x97.txt",            // truncated three byte sequence
+        "a\xC0\xAF.txt",            // overlong '/'
+        "a\xC1\xBF.txt",            // overlong
+        "a\xE0\x80\xAF.txt",        // overlong three byte sequence
+        "a\xF0\x80\x80\xAF.txt",    // overlong four byte sequence
+        "a\xED\xA0\x80.txt",        // high surrogate
+        "a\xED\xBF\xBF.txt",        // low surrogate
+        "a\xF4\x90\x80\x80.txt",    // above U+10FFFF
+        "a\xF5\x80\x80\x80.txt",    // invalid lead byte
+        "a\xFF.txt",                // invalid lead byte
+        "abcdefghijklmnopqrstuvwxyz\xE2\x82.txt",
+    };
+
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    auto fileStream = MsixTest::StreamFile("test_file.txt", false, true);
+    WriteContentToStream(200, fileStream.Get());
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+    for (const auto& name : names)
+    {
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::Unexpected), packageWriter.As<IAppxPackageWriterUtf8>()->AddPayloadFile(
+            name.c_str(), contentType.c_str(), APPX_COMPRESSION_OPTION_NORMAL, fileStream.Get()));
+    }
+}
+
+// Unpaired surrogates and values that aren't characters are rejected, never replaced
+TEST_CASE("Api_AppxPackageWriter_invalid_names_wide", "[api]")
+{
+    std::vector<std::wstring> names = {
+        std::wstring(L"a") + static_cast<wchar_t>(0xD800) + L".txt",    // unpaired high surrogate
+        std::wstring(L"a") + static_cast<wchar_t>(0xDC00) + L".txt",    // lone low surrogate
+        std::wstring(L"a.txt") + static_cast<wchar_t>(0xD800),          // high surrogate at the end
+        std::wstring(L"abcdefghijklmnopqrstuvwxyz") + static_cast<wchar_t>(0xDBFF) + L".txt",
+    };
+    #ifndef WIN32
+    names.push_back(std::wstring(L"a") + static_cast<wchar_t>(0x110000) + L".txt"); // above U+10FFFF
+    #endif
+
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    auto fileStream = MsixTest::StreamFile("test_file.txt", false, true);
+    WriteContentToStream(200, fileStream.Get());
+    for (const auto& name : names)
+    {
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::Unexpected), packageWriter->AddPayloadFile(
+            name.c_str(), TestConstants::ContentType.c_str(), APPX_COMPRESSION_OPTION_NORMAL, fileStream.Get()));
+    }
+}
+
 TEST_CASE("Api_AppxPackageWriter_closed", "[api]")
 {
     auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
@@ -385,6 +993,248 @@ TEST_CASE("Api_AppxPackageWriter_add_same_payload_file")
         contentStream.Get()));
 }
 
+// Duplicated names are found among many files, in batches and against files added before a batch
+TEST_CASE("Api_AppxPackageWriter_duplicate_names", "[api]")
+{
+    auto contentStream = MsixTest::StreamFile("test_file.txt", false, true);
+    WriteContentToStream(100, contentStream.Get());
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+
+    auto addFiles = [&](IAppxPackageWriter* packageWriter, std::size_t count)
+    {
+        auto packageWriterUtf8 = MsixTest::ComPtr<IAppxPackageWriter>(packageWriter).As<IAppxPackageWriterUtf8>();
+        for (std::size_t i = 0; i < count; i++)
+        {
+            auto name = "file" + std::to_string(i) + ".txt";
+            REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(name.c_str(), contentType.c_str(),
+                APPX_COMPRESSION_OPTION_NONE, contentStream.Get()));
+        }
+    };
+
+    SECTION("Among many files")
+    {
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        addFiles(packageWriter.Get(), 1000);
+
+        // Names that only share a prefix with others aren't duplicates
+        for (auto name : { L"file1.txt.bak", L"file1", L"File1.txt" })
+        {
+            REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(name, TestConstants::ContentType.c_str(),
+                APPX_COMPRESSION_OPTION_NONE, contentStream.Get()));
+        }
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::DuplicateFile),
+            packageWriter->AddPayloadFile(L"file0.txt", TestConstants::ContentType.c_str(),
+                APPX_COMPRESSION_OPTION_NONE, contentStream.Get()));
+    }
+
+    SECTION("In a batch")
+    {
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        addFiles(packageWriter.Get(), 10);
+
+        // The files of a batch are read concurrently, each needs its own stream
+        auto contentStream2 = MsixTest::StreamFile("test_file_2.txt", false, true);
+        WriteContentToStream(100, contentStream2.Get());
+        std::vector<APPX_PACKAGE_WRITER_PAYLOAD_STREAM> payloadFiles(2);
+        payloadFiles[0] = { contentStream.Get(), L"batch.txt", TestConstants::ContentType.c_str(), APPX_COMPRESSION_OPTION_NORMAL };
+        payloadFiles[1] = { contentStream2.Get(), L"batch.txt", TestConstants::ContentType.c_str(), APPX_COMPRESSION_OPTION_NORMAL };
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::DuplicateFile),
+            packageWriter.As<IAppxPackageWriter3>()->AddPayloadFiles(static_cast<UINT32>(payloadFiles.size()), payloadFiles.data(), 0x10000000));
+    }
+
+    SECTION("Of a file added before a batch")
+    {
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        addFiles(packageWriter.Get(), 10);
+
+        auto contentStream2 = MsixTest::StreamFile("test_file_2.txt", false, true);
+        WriteContentToStream(100, contentStream2.Get());
+        std::vector<APPX_PACKAGE_WRITER_PAYLOAD_STREAM> payloadFiles(2);
+        payloadFiles[0] = { contentStream.Get(), L"batch.txt", TestConstants::ContentType.c_str(), APPX_COMPRESSION_OPTION_NORMAL };
+        payloadFiles[1] = { contentStream2.Get(), L"file5.txt", TestConstants::ContentType.c_str(), APPX_COMPRESSION_OPTION_NORMAL };
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::DuplicateFile),
+            packageWriter.As<IAppxPackageWriter3>()->AddPayloadFiles(static_cast<UINT32>(payloadFiles.size()), payloadFiles.data(), 0x10000000));
+    }
+}
+
+// The central directory is written in the order the files were added, not sorted by name. The package must read
+// back with the right names and contents.
+TEST_CASE("Api_AppxPackageWriter_central_directory_order", "[api]")
+{
+    const std::vector<std::string> names = { "z.txt", "b/y.txt", "a.txt", "m/n/o.txt", "B.txt" };
+
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+    auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+    std::vector<std::string> contents;
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        // Different sizes, so a file read at another file's offset is found
+        std::string content(100 * (i + 1), static_cast<char>('a' + i));
+        contents.push_back(content);
+        auto fileStream = MsixTest::StreamFile("test_file_" + std::to_string(i) + ".txt", false, true);
+        REQUIRE_SUCCEEDED(fileStream.Get()->Write(content.data(), static_cast<ULONG>(content.size()), nullptr));
+        REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(names[i].c_str(), contentType.c_str(),
+            (i % 2 == 0) ? APPX_COMPRESSION_OPTION_NORMAL : APPX_COMPRESSION_OPTION_NONE, fileStream.Get()));
+    }
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    // The payload files come first, in the order they were added, and each one is at its offset
+    auto entries = GetZipEntries(outputStream.Get());
+    REQUIRE(entries.size() == names.size() + 3);
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        REQUIRE(entries[i].name == names[i]);
+        if (i > 0) { REQUIRE(entries[i].lfhOffset > entries[i - 1].lfhOffset); }
+    }
+
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+    for (std::size_t i = 0; i < names.size(); i++)
+    {
+        INFO(names[i]);
+        MsixTest::ComPtr<IAppxFile> appxFile;
+        REQUIRE_SUCCEEDED(packageReader.As<IAppxPackageReaderUtf8>()->GetPayloadFile(names[i].c_str(), &appxFile));
+        // Names come back with the separator of the blockmap
+        auto expectedName = names[i];
+        std::replace(expectedName.begin(), expectedName.end(), '/', '\\');
+        MsixTest::Wrappers::Buffer<char> name;
+        REQUIRE_SUCCEEDED(appxFile.As<IAppxFileUtf8>()->GetName(&name));
+        REQUIRE(expectedName == name.ToString());
+
+        MsixTest::ComPtr<IStream> stream;
+        REQUIRE_SUCCEEDED(appxFile->GetStream(&stream));
+        ULARGE_INTEGER size = { 0 };
+        REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_END, &size));
+        REQUIRE(contents[i].size() == static_cast<std::size_t>(size.QuadPart));
+        REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_SET, nullptr));
+        std::string content(contents[i].size(), '\0');
+        ULONG read = 0;
+        REQUIRE_SUCCEEDED(stream->Read(&content[0], static_cast<ULONG>(content.size()), &read));
+        REQUIRE(contents[i] == content);
+    }
+}
+
+// The central directory is written in chunks of up to 1MB. With long names this one needs two.
+TEST_CASE("Api_AppxPackageWriter_central_directory_chunks", "[api]")
+{
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+    auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+    auto contentStream = MsixTest::StreamFile("test_file.txt", false, true);
+    WriteContentToStream(10, contentStream.Get());
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+
+    MSIX_PACK_STATISTICS statistics = {};
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+
+    // About 250 bytes of central directory each, 1.5MB in total
+    const std::size_t files = 6000;
+    std::vector<std::string> names;
+    for (std::size_t i = 0; i < files; i++)
+    {
+        names.push_back("folder/" + std::string(190, 'n') + std::to_string(i) + ".txt");
+        REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(names.back().c_str(), contentType.c_str(),
+            APPX_COMPRESSION_OPTION_NONE, contentStream.Get()));
+    }
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    // One write for each file and the footprint files, and two for the central directory and end records
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    REQUIRE(statistics.zipRecordWrites == files + 3 + 2);
+
+    auto entries = GetZipEntries(outputStream.Get());
+    REQUIRE(entries.size() == files + 3);
+    for (std::size_t i = 0; i < files; i++)
+    {
+        REQUIRE(entries[i].name == names[i]);
+    }
+
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+    MsixTest::ComPtr<IAppxFile> appxFile;
+    REQUIRE_SUCCEEDED(packageReader.As<IAppxPackageReaderUtf8>()->GetPayloadFile(names.back().c_str(), &appxFile));
+}
+
+// Write only stream that can't seek, like a pipe. The data goes to another stream to read it back.
+class ForwardOnlyStream final : public MSIX::StreamBase
+{
+public:
+    ForwardOnlyStream(IStream* stream) : m_stream(stream) {}
+
+    HRESULT STDMETHODCALLTYPE Write(const void* buffer, ULONG countBytes, ULONG* bytesWritten) noexcept override
+    {
+        return m_stream->Write(buffer, countBytes, bytesWritten);
+    }
+
+protected:
+    IStream* m_stream;
+};
+
+// Test creating a package in a stream that can't seek
+TEST_CASE("Api_AppxPackageWriter_not_seekable_output", "[api]")
+{
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    auto pipeStream = MsixTest::ComPtr<IStream>::Make<ForwardOnlyStream>(outputStream.Get());
+
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(pipeStream.Get(), &packageWriter);
+
+    std::uint32_t contentSize = 10;
+    for(const auto& fileName : TestConstants::GoodFileNames)
+    {
+        auto fileStream = MsixTest::StreamFile(fileName.first, false, true);
+        WriteContentToStream(contentSize, fileStream.Get());
+        REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(
+            fileName.second.c_str(),
+            TestConstants::ContentType.c_str(),
+            APPX_COMPRESSION_OPTION_NORMAL,
+            fileStream.Get()));
+        contentSize += DefaultBlockSize / 2;
+    }
+
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    // Read the package back from what went through the stream
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+
+    MsixTest::ComPtr<IAppxFilesEnumerator> files;
+    REQUIRE_SUCCEEDED(packageReader->GetPayloadFiles(&files));
+    std::size_t count = 0;
+    BOOL hasCurrent = FALSE;
+    REQUIRE_SUCCEEDED(files->GetHasCurrent(&hasCurrent));
+    while (hasCurrent)
+    {
+        count++;
+        REQUIRE_SUCCEEDED(files->MoveNext(&hasCurrent));
+    }
+    REQUIRE(count == TestConstants::GoodFileNames.size());
+}
+
 class GeneratedEasilyCompressedFileStream final : public MSIX::StreamBase
 {
 public:
@@ -478,3 +1328,147 @@ TEST_CASE("Api_AppxPackageWriter_file_over_4GB", "[api][.slow]")
     MsixTest::ComPtr<IAppxPackageReader> packageReader;
     MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
 }
+
+// Peak resident memory of the process in KB, 0 where it isn't available
+std::uint64_t GetPeakMemory()
+{
+#ifndef WIN32
+    rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        return static_cast<std::uint64_t>(usage.ru_maxrss);
+    }
+#endif
+    return 0;
+}
+
+// Memory of the central directory while 1,000,000 one byte files are added, and the time Close takes to write it
+TEST_CASE("Api_AppxPackageWriter_million_files_benchmark", "[api][.benchmark]")
+{
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+    auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+    auto contentStream = MsixTest::StreamFile("test_file.txt", false, true);
+    WriteContentToStream(1, contentStream.Get());
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+
+    const std::size_t files = 1000000;
+    auto add = MsixTest::Benchmark::Measure(1, [&]()
+    {
+        for (std::size_t i = 0; i < files; i++)
+        {
+            auto name = "folder" + std::to_string(i % 100) + "/file" + std::to_string(i) + ".txt";
+            REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(name.c_str(), contentType.c_str(),
+                APPX_COMPRESSION_OPTION_NONE, contentStream.Get()));
+        }
+    });
+    auto peakBeforeClose = GetPeakMemory();
+
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    auto close = MsixTest::Benchmark::Measure(1, [&]() { REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get())); });
+
+    std::cout << "Add " << files << " files: " << add / 1000 << " ms" << std::endl;
+    std::cout << "Close: " << close / 1000 << " ms" << std::endl;
+    std::cout << "Peak memory before Close: " << peakBeforeClose / 1024 << " MB, after: " << GetPeakMemory() / 1024 << " MB" << std::endl;
+}
+
+// Time Close takes to write AppxBlockMap.xml and [Content_Types].xml of packages with 100 character names, below
+// the 4MB the writer keeps in memory and above it, where the documents are copied back from a temporary file
+TEST_CASE("Api_AppxPackageWriter_blockmap_spill_benchmark", "[api][.benchmark]")
+{
+    std::string contentType = MsixTest::String::utf16_to_utf8(TestConstants::ContentType);
+    for (std::size_t files : { 10000, 100000 })
+    {
+        auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+        MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+        InitializePackageWriter(outputStream.Get(), &packageWriter);
+        auto packageWriterUtf8 = packageWriter.As<IAppxPackageWriterUtf8>();
+
+        auto contentStream = MsixTest::StreamFile("test_file.txt", false, true);
+        WriteContentToStream(1, contentStream.Get());
+        auto add = MsixTest::Benchmark::Measure(1, [&]()
+        {
+            for (std::size_t i = 0; i < files; i++)
+            {
+                REQUIRE_SUCCEEDED(packageWriterUtf8->AddPayloadFile(GetSpillFileName(i, 100).c_str(), contentType.c_str(),
+                    APPX_COMPRESSION_OPTION_NONE, contentStream.Get()));
+            }
+        });
+
+        MsixTest::ComPtr<IStream> manifestStream;
+        MakeManifestStream(&manifestStream);
+        auto close = MsixTest::Benchmark::Measure(1, [&]() { REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get())); });
+
+        std::cout << "Add " << files << " files: " << add / 1000 << " ms, Close: " << close / 1000 << " ms" << std::endl;
+    }
+}
+
+// Time the wide APIs take to convert names of payload files, through GetName, which converts the UTF-8 name, and
+// GetPayloadFile, which converts the name looked up. The UTF-8 APIs, which don't convert, are the baseline.
+TEST_CASE("Api_AppxPackageWriter_name_conversion_benchmark", "[api][.benchmark]")
+{
+    std::string japanese;
+    for (std::size_t i = 0; i < 100; i++) { japanese += "\xE6\x97\xA5"; }
+    // Names of a single segment, which is at most 255 characters
+    const std::vector<std::pair<std::wstring, std::string>> names = {
+        { std::wstring(32, L'a') + L".txt", std::string(32, 'a') + ".txt" },
+        { std::wstring(250, L'a') + L".txt", std::string(250, 'a') + ".txt" },
+        { std::wstring(100, L'\u65e5') + L".txt", japanese + ".txt" },
+    };
+
+    auto outputStream = MsixTest::StreamFile("test_package.msix", false, true);
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    InitializePackageWriter(outputStream.Get(), &packageWriter);
+    auto fileStream = MsixTest::StreamFile("test_file.txt", false, true);
+    WriteContentToStream(1, fileStream.Get());
+    for (const auto& name : names)
+    {
+        REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(name.first.c_str(), TestConstants::ContentType.c_str(),
+            APPX_COMPRESSION_OPTION_NONE, fileStream.Get()));
+    }
+    MsixTest::ComPtr<IStream> manifestStream;
+    MakeManifestStream(&manifestStream);
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(outputStream.Get()->Seek(zero, STREAM_SEEK_SET, nullptr));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    MsixTest::InitializePackageReader(outputStream.Get(), &packageReader);
+    auto packageReaderUtf8 = packageReader.As<IAppxPackageReaderUtf8>();
+
+    const std::size_t runs = 100000;
+    for (const auto& name : names)
+    {
+        MsixTest::ComPtr<IAppxFile> appxFile;
+        REQUIRE_SUCCEEDED(packageReader->GetPayloadFile(name.first.c_str(), &appxFile));
+        auto appxFileUtf8 = appxFile.As<IAppxFileUtf8>();
+
+        auto getName = MsixTest::Benchmark::Measure(runs, [&]()
+        {
+            MsixTest::Wrappers::Buffer<wchar_t> value;
+            REQUIRE_SUCCEEDED(appxFile->GetName(&value));
+        });
+        auto getNameUtf8 = MsixTest::Benchmark::Measure(runs, [&]()
+        {
+            MsixTest::Wrappers::Buffer<char> value;
+            REQUIRE_SUCCEEDED(appxFileUtf8->GetName(&value));
+        });
+        auto getPayloadFile = MsixTest::Benchmark::Measure(runs, [&]()
+        {
+            MsixTest::ComPtr<IAppxFile> file;
+            REQUIRE_SUCCEEDED(packageReader->GetPayloadFile(name.first.c_str(), &file));
+        });
+        auto getPayloadFileUtf8 = MsixTest::Benchmark::Measure(runs, [&]()
+        {
+            MsixTest::ComPtr<IAppxFile> file;
+            REQUIRE_SUCCEEDED(packageReaderUtf8->GetPayloadFile(name.second.c_str(), &file));
+        });
+
+        std::cout << name.second.size() << " byte name, ns per call: GetName " << getName * 1000 << " (UTF-8 "
+            << getNameUtf8 * 1000 << "), GetPayloadFile " << getPayloadFile * 1000 << " (UTF-8 "
+            << getPayloadFileUtf8 * 1000 << ")" << std::endl;
+    }
+}
@@ -11,8 +11,10 @@
 #include "msixtest.hpp"
 #include "macros.hpp"
 
+#include <chrono>
 #include <string>
 #include <map>
+#include <vector>
 
 namespace MsixTest {
 
@@ -111,12 +113,37 @@ namespace MsixTest {
         void PrintMsixLog(HRESULT actual, HRESULT result);
     }
 
+    // Helpers of the [.benchmark] test cases. They aren't run by default, use msixtest "[benchmark]".
+    namespace Benchmark
+    {
+        // Returns the average time of a call to function over the runs, in microseconds.
+        template<typename Function>
+        double Measure(std::size_t runs, Function function)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (std::size_t i = 0; i < runs; i++) { function(); }
+            std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / static_cast<double>(runs);
+        }
+    }
+
     // Initialize helpers
     void InitializePackageReader(const std::string& package, IAppxPackageReader** packageReader);
     void InitializePackageReader(IStream* stream, IAppxPackageReader** packageReader);
     void InitializeBundleReader(const std::string& package, IAppxBundleReader** bundleReader);
     void InitializeManifestReader(const std::string& manifest, IAppxManifestReader** manifestReader);
 
+    // Values of an attribute of the elements found with the XPath API, from the root of the manifest
+    std::vector<std::string> GetAttributeValuesByXPath(IAppxManifestReader* manifestReader,
+        const std::vector<std::string>& path, const std::string& attributeName);
+
+    // Values read through the reader interfaces, used to compare readers created with different options
+    std::vector<std::string> GetManifestValues(IAppxManifestReader* manifestReader);
+    // Files of the blockmap with their sizes and blocks
+    std::vector<std::string> GetBlockMapValues(IAppxBlockMapReader* blockMapReader);
+    // Manifest and blockmap values followed by the payload files and their sizes
+    std::vector<std::string> GetPackageValues(IAppxPackageReader* packageReader);
+
     // Use the product ComPtr; enables sharing without updating every qualified use.
     using MSIX::ComPtr;
 
@@ -179,6 +179,198 @@ namespace MsixTest {
         REQUIRE_NOT_NULL(*manifestReader);
     }
 
+    std::vector<std::string> GetAttributeValuesByXPath(IAppxManifestReader* manifestReader,
+        const std::vector<std::string>& path, const std::string& attributeName)
+    {
+        std::string xpath;
+        for (const auto& step : path)
+        {
+            #ifdef MSIX_MSXML6
+            xpath += "/*[local-name()='" + step + "']";
+            #else
+            xpath += "/" + step;
+            #endif
+        }
+
+        ComPtr<IMsixDocumentElement> msixDocument;
+        REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IMsixDocumentElement>::iid, reinterpret_cast<void**>(&msixDocument)));
+        ComPtr<IMsixElement> manifestElement;
+        REQUIRE_SUCCEEDED(msixDocument->GetDocumentElement(&manifestElement));
+        ComPtr<IMsixElementEnumerator> elementEnum;
+        REQUIRE_SUCCEEDED(manifestElement->GetElementsUtf8(xpath.c_str(), &elementEnum));
+
+        std::vector<std::string> result;
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(elementEnum->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            ComPtr<IMsixElement> element;
+            REQUIRE_SUCCEEDED(elementEnum->GetCurrent(&element));
+            Wrappers::Buffer<char> value;
+            REQUIRE_SUCCEEDED(element->GetAttributeValueUtf8(attributeName.c_str(), &value));
+            result.push_back(value.ToString());
+            REQUIRE_SUCCEEDED(elementEnum->MoveNext(&hasCurrent));
+        }
+        return result;
+    }
+
+    std::vector<std::string> GetManifestValues(IAppxManifestReader* manifestReader)
+    {
+        std::vector<std::string> result;
+        ComPtr<IAppxManifestPackageId> packageId;
+        REQUIRE_SUCCEEDED(manifestReader->GetPackageId(&packageId));
+        Wrappers::Buffer<wchar_t> fullName;
+        REQUIRE_SUCCEEDED(packageId->GetPackageFullName(&fullName));
+        result.push_back(fullName.ToString());
+
+        ComPtr<IAppxManifestProperties> properties;
+        REQUIRE_SUCCEEDED(manifestReader->GetProperties(&properties));
+        for (const auto& name : { L"DisplayName", L"PublisherDisplayName", L"Description", L"Logo" })
+        {
+            Wrappers::Buffer<wchar_t> value;
+            REQUIRE_SUCCEEDED(properties->GetStringValue(name, &value));
+            // Description is optional
+            result.push_back((value.Get() == nullptr) ? std::string() : value.ToString());
+        }
+
+        APPX_CAPABILITIES capabilities;
+        REQUIRE_SUCCEEDED(manifestReader->GetCapabilities(&capabilities));
+        result.push_back(std::to_string(capabilities));
+
+        ComPtr<IAppxManifestApplicationsEnumerator> applications;
+        REQUIRE_SUCCEEDED(manifestReader->GetApplications(&applications));
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(applications->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            ComPtr<IAppxManifestApplication> application;
+            REQUIRE_SUCCEEDED(applications->GetCurrent(&application));
+            Wrappers::Buffer<wchar_t> aumid;
+            REQUIRE_SUCCEEDED(application->GetAppUserModelId(&aumid));
+            result.push_back(aumid.ToString());
+            REQUIRE_SUCCEEDED(applications->MoveNext(&hasCurrent));
+        }
+
+        ComPtr<IAppxManifestResourcesEnumerator> resources;
+        REQUIRE_SUCCEEDED(manifestReader->GetResources(&resources));
+        REQUIRE_SUCCEEDED(resources->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            Wrappers::Buffer<wchar_t> resource;
+            REQUIRE_SUCCEEDED(resources->GetCurrent(&resource));
+            // Resources with only a scale have no language
+            result.push_back((resource.Get() == nullptr) ? std::string() : resource.ToString());
+            REQUIRE_SUCCEEDED(resources->MoveNext(&hasCurrent));
+        }
+
+        ComPtr<IAppxManifestPackageDependenciesEnumerator> dependencies;
+        REQUIRE_SUCCEEDED(manifestReader->GetPackageDependencies(&dependencies));
+        REQUIRE_SUCCEEDED(dependencies->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            ComPtr<IAppxManifestPackageDependency> dependency;
+            REQUIRE_SUCCEEDED(dependencies->GetCurrent(&dependency));
+            Wrappers::Buffer<wchar_t> name;
+            REQUIRE_SUCCEEDED(dependency->GetName(&name));
+            UINT64 minVersion = 0;
+            REQUIRE_SUCCEEDED(dependency->GetMinVersion(&minVersion));
+            result.push_back(name.ToString() + " " + std::to_string(minVersion));
+            REQUIRE_SUCCEEDED(dependencies->MoveNext(&hasCurrent));
+        }
+
+        ComPtr<IAppxManifestReader3> manifestReader3;
+        REQUIRE_SUCCEEDED(manifestReader->QueryInterface(UuidOfImpl<IAppxManifestReader3>::iid, reinterpret_cast<void**>(&manifestReader3)));
+        ComPtr<IAppxManifestTargetDeviceFamiliesEnumerator> tdfs;
+        REQUIRE_SUCCEEDED(manifestReader3->GetTargetDeviceFamilies(&tdfs));
+        REQUIRE_SUCCEEDED(tdfs->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            ComPtr<IAppxManifestTargetDeviceFamily> tdf;
+            REQUIRE_SUCCEEDED(tdfs->GetCurrent(&tdf));
+            Wrappers::Buffer<wchar_t> name;
+            REQUIRE_SUCCEEDED(tdf->GetName(&name));
+            UINT64 maxVersionTested = 0;
+            REQUIRE_SUCCEEDED(tdf->GetMaxVersionTested(&maxVersionTested));
+            result.push_back(name.ToString() + " " + std::to_string(maxVersionTested));
+            REQUIRE_SUCCEEDED(tdfs->MoveNext(&hasCurrent));
+        }
+
+        // Unprefixed steps select by local name with MSXML, but only in the default namespace with Xerces, so only
+        // elements that can't come from other namespaces are selected
+        auto applicationIds = GetAttributeValuesByXPath(manifestReader, { "Package", "Applications", "Application" }, "Id");
+        result.insert(result.end(), applicationIds.begin(), applicationIds.end());
+        return result;
+    }
+
+    std::vector<std::string> GetBlockMapValues(IAppxBlockMapReader* blockMapReader)
+    {
+        std::vector<std::string> result;
+        ComPtr<IAppxBlockMapFilesEnumerator> files;
+        REQUIRE_SUCCEEDED(blockMapReader->GetFiles(&files));
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(files->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            ComPtr<IAppxBlockMapFile> file;
+            REQUIRE_SUCCEEDED(files->GetCurrent(&file));
+            Wrappers::Buffer<wchar_t> name;
+            REQUIRE_SUCCEEDED(file->GetName(&name));
+            UINT64 size = 0;
+            REQUIRE_SUCCEEDED(file->GetUncompressedSize(&size));
+            UINT32 lfh = 0;
+            REQUIRE_SUCCEEDED(file->GetLocalFileHeaderSize(&lfh));
+            result.push_back(name.ToString() + " " + std::to_string(size) + " " + std::to_string(lfh));
+
+            ComPtr<IAppxBlockMapBlocksEnumerator> blocks;
+            REQUIRE_SUCCEEDED(file->GetBlocks(&blocks));
+            BOOL hasCurrentBlock = FALSE;
+            REQUIRE_SUCCEEDED(blocks->GetHasCurrent(&hasCurrentBlock));
+            while (hasCurrentBlock)
+            {
+                ComPtr<IAppxBlockMapBlock> block;
+                REQUIRE_SUCCEEDED(blocks->GetCurrent(&block));
+                UINT32 hashSize = 0;
+                Wrappers::Buffer<BYTE> hash;
+                REQUIRE_SUCCEEDED(block->GetHash(&hashSize, &hash));
+                UINT32 compressedSize = 0;
+                REQUIRE_SUCCEEDED(block->GetCompressedSize(&compressedSize));
+                result.push_back(std::string(reinterpret_cast<char*>(hash.Get()), hashSize) + " " + std::to_string(compressedSize));
+                REQUIRE_SUCCEEDED(blocks->MoveNext(&hasCurrentBlock));
+            }
+            REQUIRE_SUCCEEDED(files->MoveNext(&hasCurrent));
+        }
+        return result;
+    }
+
+    std::vector<std::string> GetPackageValues(IAppxPackageReader* packageReader)
+    {
+        ComPtr<IAppxManifestReader> manifestReader;
+        REQUIRE_SUCCEEDED(packageReader->GetManifest(&manifestReader));
+        auto result = GetManifestValues(manifestReader.Get());
+
+        ComPtr<IAppxBlockMapReader> blockMapReader;
+        REQUIRE_SUCCEEDED(packageReader->GetBlockMap(&blockMapReader));
+        auto blockMap = GetBlockMapValues(blockMapReader.Get());
+        result.insert(result.end(), blockMap.begin(), blockMap.end());
+
+        ComPtr<IAppxFilesEnumerator> files;
+        REQUIRE_SUCCEEDED(packageReader->GetPayloadFiles(&files));
+        BOOL hasCurrent = FALSE;
+        REQUIRE_SUCCEEDED(files->GetHasCurrent(&hasCurrent));
+        while (hasCurrent)
+        {
+            ComPtr<IAppxFile> file;
+            REQUIRE_SUCCEEDED(files->GetCurrent(&file));
+            Wrappers::Buffer<wchar_t> name;
+            REQUIRE_SUCCEEDED(file->GetName(&name));
+            UINT64 size = 0;
+            REQUIRE_SUCCEEDED(file->GetSize(&size));
+            result.push_back(name.ToString() + " " + std::to_string(size));
+            REQUIRE_SUCCEEDED(files->MoveNext(&hasCurrent));
+        }
+        return result;
+    }
+
     StreamFile::StreamFile(std::string fileName, bool toRead, bool toDelete): m_toDelete(toDelete)
     {
         InitializeStream(fileName, toRead);
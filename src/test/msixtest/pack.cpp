@@ -10,7 +10,19 @@
 #include "PackTestData.hpp"
 #include "PackValidation.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 static std::string outputPackage = "package.msix";
 
@@ -117,3 +129,750 @@ TEST_CASE("Pack_InvalidParameters", "[pack]")
                     const_cast<char*>(outputPackage.c_str()),
                     nullptr));
 }
+
+std::vector<std::uint8_t> ReadPackFile(const std::string& fileName)
+{
+    MsixTest::ComPtr<IStream> stream;
+    REQUIRE_SUCCEEDED(CreateStreamOnFile(const_cast<char*>(fileName.c_str()), true, &stream));
+    LARGE_INTEGER zero = { 0 };
+    ULARGE_INTEGER size = { 0 };
+    REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_END, &size));
+    REQUIRE_SUCCEEDED(stream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    std::vector<std::uint8_t> data(static_cast<size_t>(size.QuadPart));
+    ULONG read = 0;
+    REQUIRE_SUCCEEDED(stream->Read(data.data(), static_cast<ULONG>(data.size()), &read));
+    REQUIRE(read == data.size());
+    return data;
+}
+
+// Validates a package packed with blocks of a previous version of it is the same as packing it from scratch
+TEST_CASE("Pack_BlockCache_Seed", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+    auto expected = ReadPackFile(outputPackage);
+
+    auto directoryPath = MsixTest::Directory::PathAsCurrentPlatform(
+        MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input");
+    std::string seededPackage = "package_seeded.msix";
+
+    MSIX_PACK_STATISTICS statistics = {};
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    REQUIRE_SUCCEEDED(PackPackageWithBlockCache(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                                MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                                const_cast<char*>(directoryPath.c_str()),
+                                                const_cast<char*>(seededPackage.c_str()),
+                                                nullptr,
+                                                const_cast<char*>(outputPackage.c_str()),
+                                                0));
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    // AppxBlockMap.xml and [Content_Types].xml are not in the blockmap of the seed
+    CHECK(statistics.cacheHits > 0);
+    CHECK(statistics.cacheMisses == 2);
+
+    REQUIRE(expected == ReadPackFile(seededPackage));
+}
+
+// Validates blocks kept in a cache directory are reused by the next pack, which outputs the same package
+TEST_CASE("Pack_BlockCache_Directory", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+    auto expected = ReadPackFile(outputPackage);
+
+    auto directoryPath = MsixTest::Directory::PathAsCurrentPlatform(
+        MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input");
+    std::string cacheDirectory = "blockcache";
+    // Left behind by a previous run
+    MsixTest::Directory::CleanDirectory(cacheDirectory);
+
+    MSIX_PACK_STATISTICS statistics = {};
+    for (int i = 0; i < 2; i++)
+    {
+        REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+        REQUIRE_SUCCEEDED(PackPackageWithBlockCache(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                                    MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                                    const_cast<char*>(directoryPath.c_str()),
+                                                    const_cast<char*>(outputPackage.c_str()),
+                                                    const_cast<char*>(cacheDirectory.c_str()),
+                                                    nullptr,
+                                                    0));
+        REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+        if (i == 0)
+        {
+            CHECK(statistics.cacheHits == 0);
+            CHECK(statistics.cacheMisses > 0);
+        }
+        else
+        {
+            CHECK(statistics.cacheHits > 0);
+            CHECK(statistics.cacheMisses == 0);
+        }
+        REQUIRE(expected == ReadPackFile(outputPackage));
+    }
+
+    REQUIRE(MsixTest::Directory::CleanDirectory(cacheDirectory));
+}
+
+// Validates corrupted blocks of a seed package or a cache file are not reused
+TEST_CASE("Pack_BlockCache_Corrupted", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+    auto expected = ReadPackFile(outputPackage);
+
+    auto directoryPath = MsixTest::Directory::PathAsCurrentPlatform(
+        MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input");
+    std::string seedPackage = "package_seed.msix";
+    std::string seededPackage = "package_seeded.msix";
+    std::string cacheDirectory = "blockcache";
+    std::string cacheFile = cacheDirectory + "/.msixblockcache";
+    // Left behind by a previous run
+    MsixTest::Directory::CleanDirectory(cacheDirectory);
+
+    auto writeFile = [](const std::string& fileName, const std::vector<std::uint8_t>& data)
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+    };
+    auto pack = [&](const char* seed, const char* cache, MSIX_PACK_STATISTICS& statistics)
+    {
+        REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+        REQUIRE_SUCCEEDED(PackPackageWithBlockCache(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                                    MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                                    const_cast<char*>(directoryPath.c_str()),
+                                                    const_cast<char*>(seededPackage.c_str()),
+                                                    const_cast<char*>(cache),
+                                                    const_cast<char*>(seed),
+                                                    0));
+        REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    };
+
+    // Change a byte in the middle of the data of TestAppxPackage.exe in the seed
+    auto seed = expected;
+    std::string exeName = "TestAppxPackage.exe";
+    auto localHeader = std::search(seed.begin(), seed.end(), exeName.begin(), exeName.end()) - seed.begin() - 30;
+    REQUIRE(localHeader >= 0);
+    std::size_t exeData = localHeader + 30 + exeName.size() + (seed[localHeader + 28] | (seed[localHeader + 29] << 8));
+    seed[exeData + 40000] ^= 0x55;
+    writeFile(seedPackage, seed);
+
+    MSIX_PACK_STATISTICS statistics = {};
+    pack(seedPackage.c_str(), nullptr, statistics);
+    CHECK(statistics.cacheHits > 0);
+    CHECK(statistics.cacheMisses > 2);
+    REQUIRE(expected == ReadPackFile(seededPackage));
+
+    // Change a byte of the last block of the cache file
+    pack(nullptr, cacheDirectory.c_str(), statistics);
+    auto cache = ReadPackFile(cacheFile);
+    REQUIRE(cache.size() > 20);
+    cache[cache.size() - 20] ^= 0x55;
+    writeFile(cacheFile, cache);
+
+    pack(nullptr, cacheDirectory.c_str(), statistics);
+    CHECK(statistics.cacheHits > 0);
+    CHECK(statistics.cacheMisses == 1);
+    REQUIRE(expected == ReadPackFile(seededPackage));
+
+    remove(seedPackage.c_str());
+    remove(seededPackage.c_str());
+    REQUIRE(MsixTest::Directory::CleanDirectory(cacheDirectory));
+}
+
+// Validates the files found in the input directory are reported
+TEST_CASE("Pack_ScanStatistics", "[pack]")
+{
+    MSIX_PACK_STATISTICS statistics = {};
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+
+    RunPackTest(S_OK, "input");
+
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    // AppxManifest.xml, TestAppxPackage.exe, TestAppxPackage.winmd, resources.pri and 7 files in Assets
+    CHECK(statistics.scannedFiles == 11);
+#ifndef WIN32
+    CHECK(statistics.scannedDirectories == 2);
+#endif
+}
+
+// Validates a package packed from a tar stream has the same files as the directory the tar was made from
+TEST_CASE("Pack_FromTar", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+
+    std::string tarFile = "package.tar";
+    std::string tarPackage = "package_tar.msix";
+    REQUIRE_SUCCEEDED(UnpackPackageToTar(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                         MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                         const_cast<char*>(outputPackage.c_str()),
+                                         const_cast<char*>(tarFile.c_str())));
+    REQUIRE_SUCCEEDED(PackPackageFromTar(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                         MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                         const_cast<char*>(tarFile.c_str()),
+                                         const_cast<char*>(tarPackage.c_str())));
+    remove(tarFile.c_str());
+
+    // Verify output package
+    MsixTest::Pack::ValidatePackageStream(tarPackage);
+}
+
+// Package full name and the files and blocks of the blockmap, as read with the validation options
+std::vector<std::string> GetPackageValues(const std::string& package, MSIX_VALIDATION_OPTION validation)
+{
+    auto inputStream = MsixTest::StreamFile(package, true);
+    MsixTest::ComPtr<IAppxFactory> factory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    REQUIRE_SUCCEEDED(factory->CreatePackageReader(inputStream.Get(), &packageReader));
+
+    std::vector<std::string> result;
+    MsixTest::ComPtr<IAppxManifestReader> manifestReader;
+    REQUIRE_SUCCEEDED(packageReader->GetManifest(&manifestReader));
+    MsixTest::ComPtr<IAppxManifestPackageId> packageId;
+    REQUIRE_SUCCEEDED(manifestReader->GetPackageId(&packageId));
+    MsixTest::Wrappers::Buffer<wchar_t> fullName;
+    REQUIRE_SUCCEEDED(packageId->GetPackageFullName(&fullName));
+    result.push_back(fullName.ToString());
+
+    MsixTest::ComPtr<IAppxBlockMapReader> blockMapReader;
+    REQUIRE_SUCCEEDED(packageReader->GetBlockMap(&blockMapReader));
+    auto blockMap = MsixTest::GetBlockMapValues(blockMapReader.Get());
+    result.insert(result.end(), blockMap.begin(), blockMap.end());
+    return result;
+}
+
+// Validates a package read with the non-validating XML parser has the same identity and blockmap
+TEST_CASE("Pack_Good_SkipXmlSchemaValidation", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+
+    auto expected = GetPackageValues(outputPackage, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE);
+    auto actual = GetPackageValues(outputPackage, static_cast<MSIX_VALIDATION_OPTION>(
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION));
+    REQUIRE(expected.size() > 1);
+    REQUIRE(expected == actual);
+}
+
+// Returns a copy of a package written by the packer with the data of a file replaced by contents, stored
+// uncompressed. The packer writes no extra fields in the central directory, so only offsets have to be moved.
+std::vector<std::uint8_t> ReplaceFile(const std::vector<std::uint8_t>& package, const std::string& name, const std::string& contents)
+{
+    auto readNumber = [&package](std::size_t offset, std::size_t bytes)
+    {
+        REQUIRE(offset + bytes <= package.size());
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < bytes; i++) { value |= static_cast<std::uint64_t>(package[offset + i]) << (8 * i); }
+        return value;
+    };
+    auto writeNumber = [](std::vector<std::uint8_t>& data, std::size_t offset, std::uint64_t value, std::size_t bytes)
+    {
+        for (std::size_t i = 0; i < bytes; i++) { data[offset + i] = static_cast<std::uint8_t>(value >> (8 * i)); }
+    };
+
+    // End of central directory record, zip64 locator and zip64 end of central directory record
+    REQUIRE(package.size() >= 22 + 20);
+    std::size_t endOfCentralDirectory = package.size() - 22;
+    std::size_t locator = endOfCentralDirectory - 20;
+    REQUIRE(readNumber(endOfCentralDirectory, 4) == 0x06054b50);
+    REQUIRE(readNumber(locator, 4) == 0x07064b50);
+    auto zip64EndOfCentralDirectory = static_cast<std::size_t>(readNumber(locator + 8, 8));
+    REQUIRE(readNumber(zip64EndOfCentralDirectory, 4) == 0x06064b50);
+    auto entries = readNumber(zip64EndOfCentralDirectory + 32, 8);
+    auto centralDirectory = static_cast<std::size_t>(readNumber(zip64EndOfCentralDirectory + 48, 8));
+
+    std::vector<std::size_t> centralDirectoryEntries;
+    std::size_t fileEntry = 0;
+    std::size_t offset = centralDirectory;
+    for (std::uint64_t entry = 0; entry < entries; entry++)
+    {
+        REQUIRE(readNumber(offset, 4) == 0x02014b50);
+        REQUIRE(readNumber(offset + 30, 2) == 0);
+        auto nameSize = static_cast<std::size_t>(readNumber(offset + 28, 2));
+        if (std::string(reinterpret_cast<const char*>(package.data() + offset + 46), nameSize) == name)
+        {
+            fileEntry = offset;
+        }
+        centralDirectoryEntries.push_back(offset);
+        offset += 46 + nameSize + static_cast<std::size_t>(readNumber(offset + 32, 2));
+    }
+    REQUIRE(fileEntry != 0);
+    REQUIRE(offset == zip64EndOfCentralDirectory);
+
+    // The file ends, with its data descriptor, where the next one starts
+    auto lfh = static_cast<std::size_t>(readNumber(fileEntry + 42, 4));
+    auto fileEnd = centralDirectory;
+    for (auto entry : centralDirectoryEntries)
+    {
+        auto entryLfh = static_cast<std::size_t>(readNumber(entry + 42, 4));
+        if (entryLfh > lfh) { fileEnd = std::min(fileEnd, entryLfh); }
+    }
+
+    // Files before it, its local file header without data descriptor, its new data and the files after it
+    auto nameSize = static_cast<std::size_t>(readNumber(lfh + 26, 2));
+    std::vector<std::uint8_t> result(package.begin(), package.begin() + lfh + 30 + nameSize);
+    writeNumber(result, lfh + 6, 0, 2);                  // general purpose flags
+    writeNumber(result, lfh + 8, 0, 2);                  // stored
+    writeNumber(result, lfh + 14, 0, 4);                 // crc
+    writeNumber(result, lfh + 18, contents.size(), 4);   // compressed size
+    writeNumber(result, lfh + 22, contents.size(), 4);   // uncompressed size
+    writeNumber(result, lfh + 28, 0, 2);                 // extra field
+    result.insert(result.end(), contents.begin(), contents.end());
+    auto moved = static_cast<std::int64_t>(result.size()) - static_cast<std::int64_t>(fileEnd);
+    result.insert(result.end(), package.begin() + fileEnd, package.begin() + centralDirectory);
+
+    // Central directory with the new values for it and the moved offsets of the files after it
+    auto newCentralDirectory = result.size();
+    result.insert(result.end(), package.begin() + centralDirectory, package.begin() + zip64EndOfCentralDirectory);
+    for (auto entry : centralDirectoryEntries)
+    {
+        auto newEntry = newCentralDirectory + (entry - centralDirectory);
+        auto entryLfh = readNumber(entry + 42, 4);
+        if (entryLfh > lfh) { writeNumber(result, newEntry + 42, static_cast<std::uint64_t>(entryLfh + moved), 4); }
+    }
+    auto newEntry = newCentralDirectory + (fileEntry - centralDirectory);
+    writeNumber(result, newEntry + 8, 0, 2);
+    writeNumber(result, newEntry + 10, 0, 2);
+    writeNumber(result, newEntry + 16, 0, 4);
+    writeNumber(result, newEntry + 20, contents.size(), 4);
+    writeNumber(result, newEntry + 24, contents.size(), 4);
+
+    // End records pointing at it
+    auto newZip64EndOfCentralDirectory = result.size();
+    result.insert(result.end(), package.begin() + zip64EndOfCentralDirectory, package.end());
+    writeNumber(result, newZip64EndOfCentralDirectory + 48, newCentralDirectory, 8);
+    writeNumber(result, newZip64EndOfCentralDirectory + (locator - zip64EndOfCentralDirectory) + 8, newZip64EndOfCentralDirectory, 8);
+    return result;
+}
+
+// Opens a package in memory with the validation options, returns the values read from it if it succeeded
+HRESULT ReadPackageValues(const std::vector<std::uint8_t>& package, MSIX_VALIDATION_OPTION validation, std::vector<std::string>& values)
+{
+    const std::string fileName = "contenttypes.msix";
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(package.data()), static_cast<std::streamsize>(package.size()));
+        REQUIRE(file.good());
+    }
+    auto inputStream = MsixTest::StreamFile(fileName, true, true);
+    MsixTest::ComPtr<IAppxFactory> factory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free, validation, &factory));
+    MsixTest::ComPtr<IAppxPackageReader> packageReader;
+    auto hr = factory->CreatePackageReader(inputStream.Get(), &packageReader);
+    if (SUCCEEDED(hr))
+    {
+        values = MsixTest::GetPackageValues(packageReader.Get());
+    }
+    return hr;
+}
+
+// Validates [Content_Types].xml is accepted and rejected by the non-validating XML parser like by Xerces, except
+// for what only the schema catches
+TEST_CASE("Pack_ContentTypes_SkipXmlSchemaValidation", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+    auto package = ReadPackFile(outputPackage);
+
+    auto validation = MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE;
+    auto skipSchema = static_cast<MSIX_VALIDATION_OPTION>(
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPXMLSCHEMAVALIDATION);
+
+    const std::string declaration = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>";
+    const std::string types = "<Types xmlns=\"http://schemas.openxmlformats.org/package/2006/content-types\">";
+    const std::string defaults = "<Default Extension=\"xml\" ContentType=\"application/vnd.ms-appx.manifest+xml\"/>";
+
+    std::vector<std::string> valid = {
+        declaration + types + defaults + "</Types>",
+        declaration + "\r\n<!-- comment -->\r\n" + types + "\r\n  " + defaults +
+            "\r\n  <Default Extension=\"t&#x78;t\" ContentType=\"application/x-a&amp;b\"/>\r\n</Types>\r\n",
+        declaration + "<ct:Types xmlns:ct=\"http://schemas.openxmlformats.org/package/2006/content-types\">"
+            "<ct:Default Extension=\"xml\" ContentType=\"application/vnd.ms-appx.manifest+xml\"/></ct:Types>",
+    };
+    for (const auto& contentTypes : valid)
+    {
+        INFO(contentTypes);
+        auto replaced = ReplaceFile(package, "[Content_Types].xml", contentTypes);
+        std::vector<std::string> expected;
+        std::vector<std::string> actual;
+        REQUIRE_SUCCEEDED(ReadPackageValues(replaced, validation, expected));
+        REQUIRE_SUCCEEDED(ReadPackageValues(replaced, skipSchema, actual));
+        REQUIRE(expected.size() > 1);
+        REQUIRE(expected == actual);
+    }
+
+    std::vector<std::string> malformed = {
+        declaration + types + defaults,
+        declaration + types + "<Default Extension=\"&unknown;\" ContentType=\"text/plain\"/></Types>",
+        declaration + types + "<Default Extension=\"<\" ContentType=\"text/plain\"/></Types>",
+        declaration + types + "<Default Extension=\"xml\" ContentType=\"text/plain\"></Override></Types>",
+    };
+    for (const auto& contentTypes : malformed)
+    {
+        INFO(contentTypes);
+        auto replaced = ReplaceFile(package, "[Content_Types].xml", contentTypes);
+        std::vector<std::string> values;
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::XmlFatal), ReadPackageValues(replaced, validation, values));
+        REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::XmlFatal), ReadPackageValues(replaced, skipSchema, values));
+    }
+
+    // Only the schema rejects unknown elements
+    auto unknown = ReplaceFile(package, "[Content_Types].xml", declaration + types + defaults + "<Unknown/></Types>");
+    std::vector<std::string> values;
+    REQUIRE_HR(static_cast<HRESULT>(MSIX::Error::XmlError), ReadPackageValues(unknown, validation, values));
+    REQUIRE_SUCCEEDED(ReadPackageValues(unknown, skipSchema, values));
+}
+
+// Writes tar entries the way the different tar formats store names and sizes
+class TarBuilder
+{
+public:
+    enum class SizeFormat { Octal, Base256, Zero };
+
+    // Adds an entry. The name goes in the name field, unless a prefix is given for the ustar prefix field.
+    void Add(const std::string& name, const std::vector<std::uint8_t>& data, char type = '0',
+        SizeFormat sizeFormat = SizeFormat::Octal, const std::string& prefix = "")
+    {
+        std::vector<std::uint8_t> header(512, 0);
+        std::copy(name.begin(), name.begin() + std::min<std::size_t>(name.size(), 100), header.begin());
+        SetOctal(header, 100, 8, 0644);
+        SetOctal(header, 108, 8, 0);
+        SetOctal(header, 116, 8, 0);
+        if (sizeFormat == SizeFormat::Base256)
+        {
+            header[124] = 0x80;
+            for (std::size_t i = 0; i < 8; i++)
+            {
+                header[135 - i] = static_cast<std::uint8_t>(data.size() >> (8 * i));
+            }
+        }
+        else
+        {
+            SetOctal(header, 124, 12, (sizeFormat == SizeFormat::Zero) ? 0 : data.size());
+        }
+        SetOctal(header, 136, 12, 0);
+        header[156] = static_cast<std::uint8_t>(type);
+        std::memcpy(&header[257], "ustar\0" "00", 8);
+        std::copy(prefix.begin(), prefix.end(), header.begin() + 345);
+
+        std::fill(header.begin() + 148, header.begin() + 156, ' ');
+        std::uint32_t checksum = 0;
+        for (auto byte : header) { checksum += byte; }
+        SetOctal(header, 148, 7, checksum);
+
+        m_data.insert(m_data.end(), header.begin(), header.end());
+        m_data.insert(m_data.end(), data.begin(), data.end());
+        m_data.resize(m_data.size() + (512 - data.size() % 512) % 512, 0);
+    }
+
+    // Adds a pax extended header with the given records, which apply to the next entry
+    void AddPax(const std::vector<std::pair<std::string, std::string>>& records)
+    {
+        std::string data;
+        for (const auto& record : records)
+        {
+            // The length includes itself
+            std::string content = " " + record.first + "=" + record.second + "\n";
+            std::size_t length = content.size() + 1;
+            while (std::to_string(length).size() + content.size() != length) { length++; }
+            data += std::to_string(length) + content;
+        }
+        Add("PaxHeader", std::vector<std::uint8_t>(data.begin(), data.end()), 'x');
+    }
+
+    // Adds a GNU long name entry for the next entry
+    void AddLongName(const std::string& name)
+    {
+        std::vector<std::uint8_t> data(name.begin(), name.end());
+        data.push_back(0);
+        Add("././@LongLink", data, 'L');
+    }
+
+    // Changes a byte of the header of the last entry without updating its checksum
+    void CorruptLastHeader(std::size_t dataSize)
+    {
+        std::size_t header = m_data.size() - ((dataSize + 511) / 512) * 512 - 512;
+        m_data[header] ^= 0x01;
+    }
+
+    void Save(const std::string& fileName)
+    {
+        m_data.resize(m_data.size() + 1024, 0);
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(m_data.data()), m_data.size());
+    }
+
+private:
+    // Octal number padded with zeros and terminated by a null
+    static void SetOctal(std::vector<std::uint8_t>& header, std::size_t offset, std::size_t length, std::uint64_t value)
+    {
+        for (std::size_t i = length - 1; i-- > 0;)
+        {
+            header[offset + i] = static_cast<std::uint8_t>('0' + (value & 7));
+            value >>= 3;
+        }
+        header[offset + length - 1] = 0;
+    }
+
+    std::vector<std::uint8_t> m_data;
+};
+
+// Validates names and sizes stored by pax, GNU and ustar tar headers are read as the same files of the input directory
+TEST_CASE("Pack_FromTar_Formats", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+    auto expected = GetPackageValues(outputPackage, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE);
+    std::sort(expected.begin() + 1, expected.end());
+
+    auto inputPath = MsixTest::Directory::PathAsCurrentPlatform(
+        MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input/");
+    auto readInput = [&inputPath](const std::string& name) { return ReadPackFile(inputPath + name); };
+
+    TarBuilder tar;
+    tar.Add("Assets/", {}, '5');
+    tar.Add("AppxManifest.xml", readInput("AppxManifest.xml"));
+    // pax path and size replace the ones in the header
+    tar.AddPax({ { "mtime", "1500000000.5" }, { "path", "TestAppxPackage.exe" }, { "size", "186368" } });
+    tar.Add("PaxHeaderName", readInput("TestAppxPackage.exe"), '0', TarBuilder::SizeFormat::Zero);
+    // GNU long name, the name field has the truncated name
+    tar.AddLongName("Assets/Square44x44Logo.targetsize-24_altform-unplated.png");
+    tar.Add("Assets/Square44x44Logo.targetsize-24_altfor", readInput("Assets/Square44x44Logo.targetsize-24_altform-unplated.png"));
+    // GNU base-256 size
+    tar.Add("TestAppxPackage.winmd", readInput("TestAppxPackage.winmd"), '0', TarBuilder::SizeFormat::Base256);
+    // ustar prefix
+    tar.Add("Square150x150Logo.scale-200.png", readInput("Assets/Square150x150Logo.scale-200.png"), '0',
+        TarBuilder::SizeFormat::Octal, "Assets");
+    tar.Add("./resources.pri", readInput("resources.pri"));
+    for (const auto& asset : { "LockScreenLogo.scale-200.png", "SplashScreen.scale-200.png", "Square44x44Logo.scale-200.png",
+        "StoreLogo.png", "Wide310x150Logo.scale-200.png" })
+    {
+        tar.Add(std::string("Assets/") + asset, readInput(std::string("Assets/") + asset), '7');
+    }
+
+    std::string tarFile = "package_formats.tar";
+    std::string tarPackage = "package_tar.msix";
+    tar.Save(tarFile);
+    REQUIRE_SUCCEEDED(PackPackageFromTar(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                         MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                         const_cast<char*>(tarFile.c_str()),
+                                         const_cast<char*>(tarPackage.c_str())));
+    remove(tarFile.c_str());
+
+    auto actual = GetPackageValues(tarPackage, MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE);
+    std::sort(actual.begin() + 1, actual.end());
+    REQUIRE(expected.size() > 1);
+    REQUIRE(expected == actual);
+    remove(tarPackage.c_str());
+}
+
+// Fails if a tar header is invalid
+TEST_CASE("Pack_FromTar_InvalidHeaders", "[pack]")
+{
+    auto manifestPath = MsixTest::Directory::PathAsCurrentPlatform(
+        MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input/AppxManifest.xml");
+    auto manifest = ReadPackFile(manifestPath);
+    std::string tarFile = "package_invalid.tar";
+    std::string tarPackage = "package_tar.msix";
+    auto packTar = [&](TarBuilder& tar)
+    {
+        tar.Save(tarFile);
+        auto result = PackPackageFromTar(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                         MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                         const_cast<char*>(tarFile.c_str()),
+                                         const_cast<char*>(tarPackage.c_str()));
+        remove(tarFile.c_str());
+        return result;
+    };
+
+    {
+        TarBuilder tar;
+        tar.Add("AppxManifest.xml", manifest);
+        tar.CorruptLastHeader(manifest.size());
+        CHECK(static_cast<HRESULT>(MSIX::Error::FileRead) == packTar(tar));
+    }
+    {
+        TarBuilder tar;
+        tar.AddPax({ { "size", "18446744073709551616" } });
+        tar.Add("AppxManifest.xml", manifest);
+        CHECK(static_cast<HRESULT>(MSIX::Error::FileRead) == packTar(tar));
+    }
+    {
+        TarBuilder tar;
+        tar.AddPax({ { "size", "12a" } });
+        tar.Add("AppxManifest.xml", manifest);
+        CHECK(static_cast<HRESULT>(MSIX::Error::FileRead) == packTar(tar));
+    }
+}
+
+// Validates a package added with AddPayloadPackage is stored as is in the bundle, at the offset in the bundle manifest
+TEST_CASE("Pack_Bundle_PayloadPackage", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+    auto package = ReadPackFile(outputPackage);
+
+    std::string bundleName = "bundle.msixbundle";
+    {
+        MsixTest::ComPtr<IAppxBundleFactory> bundleFactory;
+        REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+            MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE, static_cast<MSIX_APPLICABILITY_OPTIONS>(MSIX_APPLICABILITY_NONE), &bundleFactory));
+
+        MsixTest::ComPtr<IStream> bundleStream;
+        REQUIRE_SUCCEEDED(CreateStreamOnFile(const_cast<char*>(bundleName.c_str()), false, &bundleStream));
+        MsixTest::ComPtr<IAppxBundleWriter> bundleWriter;
+        REQUIRE_SUCCEEDED(bundleFactory->CreateBundleWriter(bundleStream.Get(), 0x0001000000000000, &bundleWriter));
+
+        MsixTest::ComPtr<IStream> packageStream;
+        REQUIRE_SUCCEEDED(CreateStreamOnFile(const_cast<char*>(outputPackage.c_str()), true, &packageStream));
+        REQUIRE_SUCCEEDED(bundleWriter->AddPayloadPackage(L"package.msix", packageStream.Get()));
+        REQUIRE_SUCCEEDED(bundleWriter->Close());
+    }
+    auto bundle = ReadPackFile(bundleName);
+
+    MsixTest::ComPtr<IAppxBundleFactory> bundleFactory;
+    REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+        MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE, static_cast<MSIX_APPLICABILITY_OPTIONS>(MSIX_APPLICABILITY_NONE), &bundleFactory));
+    MsixTest::ComPtr<IStream> bundleStream;
+    REQUIRE_SUCCEEDED(CreateStreamOnFile(const_cast<char*>(bundleName.c_str()), true, &bundleStream));
+    MsixTest::ComPtr<IAppxBundleReader> bundleReader;
+    REQUIRE_SUCCEEDED(bundleFactory->CreateBundleReader(bundleStream.Get(), &bundleReader));
+
+    MsixTest::ComPtr<IAppxBundleManifestReader> manifestReader;
+    REQUIRE_SUCCEEDED(bundleReader->GetManifest(&manifestReader));
+    MsixTest::ComPtr<IAppxBundleManifestPackageInfoEnumerator> packages;
+    REQUIRE_SUCCEEDED(manifestReader->GetPackageInfoItems(&packages));
+    BOOL hasCurrent = FALSE;
+    REQUIRE_SUCCEEDED(packages->GetHasCurrent(&hasCurrent));
+    REQUIRE(hasCurrent);
+    MsixTest::ComPtr<IAppxBundleManifestPackageInfo> packageInfo;
+    REQUIRE_SUCCEEDED(packages->GetCurrent(&packageInfo));
+
+    UINT64 offset = 0;
+    UINT64 size = 0;
+    REQUIRE_SUCCEEDED(packageInfo->GetOffset(&offset));
+    REQUIRE_SUCCEEDED(packageInfo->GetSize(&size));
+    REQUIRE(size == package.size());
+    REQUIRE(offset + size <= bundle.size());
+    REQUIRE(std::equal(package.begin(), package.end(), bundle.begin() + static_cast<std::ptrdiff_t>(offset)));
+
+    bundleReader = nullptr;
+    bundleStream = nullptr;
+    remove(bundleName.c_str());
+}
+
+// Validates packages of a flat bundle are fully validated unless package validation is skipped, in which
+// case only their manifest is read and checked against their blockmap. Packages are referenced from a mapping file
+// or from a directory.
+TEST_CASE("Pack_FlatBundle_PackageValidation", "[pack]")
+{
+    RunPackTest(S_OK, "input");
+    auto package = ReadPackFile(outputPackage);
+
+    // Corrupt [Content_Types].xml, which is not needed to read the manifest
+    auto corrupt = package;
+    std::string contentTypes = "[Content_Types].xml";
+    auto header = std::search(corrupt.begin(), corrupt.end(), contentTypes.begin(), contentTypes.end()) - corrupt.begin() - 30;
+    REQUIRE(header > 0);
+    auto nameSize = corrupt[header + 26] | (corrupt[header + 27] << 8);
+    auto extraSize = corrupt[header + 28] | (corrupt[header + 29] << 8);
+    auto data = header + 30 + nameSize + extraSize;
+    std::fill(corrupt.begin() + data, corrupt.begin() + data + 4, static_cast<std::uint8_t>(0xFF));
+    std::string corruptPackage = "corrupt.msix";
+    std::ofstream(corruptPackage, std::ios::binary).write(reinterpret_cast<const char*>(corrupt.data()), corrupt.size());
+
+    // Store the manifest uncompressed, as it is and with a letter changed. The changed one still parses, but no
+    // longer matches its hash in the blockmap.
+    auto manifestPath = MsixTest::Directory::PathAsCurrentPlatform(
+        MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input/AppxManifest.xml");
+    auto manifestData = ReadPackFile(manifestPath);
+    std::string manifest(manifestData.begin(), manifestData.end());
+    auto stored = ReplaceFile(package, "AppxManifest.xml", manifest);
+    std::string storedPackage = "stored.msix";
+    std::ofstream(storedPackage, std::ios::binary).write(reinterpret_cast<const char*>(stored.data()), stored.size());
+    auto displayName = manifest.find("<DisplayName>m");
+    REQUIRE(displayName != std::string::npos);
+    manifest[displayName + 13] = 'M';
+    auto tampered = ReplaceFile(package, "AppxManifest.xml", manifest);
+    std::string tamperedPackage = "tampered.msix";
+    std::ofstream(tamperedPackage, std::ios::binary).write(reinterpret_cast<const char*>(tampered.data()), tampered.size());
+
+    std::string mappingFile = "bundle.map";
+    std::string bundleName = "bundle.msixbundle";
+    auto options = static_cast<MSIX_BUNDLE_OPTIONS>(MSIX_BUNDLE_OPTIONS::MSIX_OPTION_OVERWRITE | MSIX_BUNDLE_OPTIONS::MSIX_BUNDLE_OPTION_FLATBUNDLE);
+    auto skipValidation = static_cast<MSIX_BUNDLE_OPTIONS>(options | MSIX_BUNDLE_OPTIONS::MSIX_BUNDLE_OPTION_SKIPPACKAGEVALIDATION);
+    auto packMapped = [&](const std::string& input, MSIX_BUNDLE_OPTIONS bundleOptions)
+    {
+        std::ofstream(mappingFile) << "[Files]\n\"" << input << "\" \"package.msix\"\n";
+        return PackBundle(bundleOptions, nullptr, const_cast<char*>(bundleName.c_str()), const_cast<char*>(mappingFile.c_str()), nullptr);
+    };
+
+    REQUIRE_SUCCEEDED(packMapped(outputPackage, options));
+    REQUIRE_SUCCEEDED(packMapped(outputPackage, skipValidation));
+    REQUIRE_FALSE(SUCCEEDED(packMapped(corruptPackage, options)));
+    REQUIRE_SUCCEEDED(packMapped(corruptPackage, skipValidation));
+    REQUIRE_SUCCEEDED(packMapped(storedPackage, options));
+    REQUIRE_SUCCEEDED(packMapped(storedPackage, skipValidation));
+    REQUIRE_FALSE(SUCCEEDED(packMapped(tamperedPackage, options)));
+    REQUIRE_FALSE(SUCCEEDED(packMapped(tamperedPackage, skipValidation)));
+
+    // The same packages as the only file of a directory
+    std::string directory = "flat_bundle_input";
+    // Left behind by a previous run
+    MsixTest::Directory::CleanDirectory(directory);
+    #ifdef WIN32
+    REQUIRE(_mkdir(directory.c_str()) == 0);
+    #else
+    REQUIRE(mkdir(directory.c_str(), S_IRWXU) == 0);
+    #endif
+    auto packDirectory = [&](const std::vector<std::uint8_t>& input, MSIX_BUNDLE_OPTIONS bundleOptions)
+    {
+        std::ofstream(directory + "/package.msix", std::ios::binary | std::ios::trunc).write(
+            reinterpret_cast<const char*>(input.data()), input.size());
+        return PackBundle(bundleOptions, const_cast<char*>(directory.c_str()), const_cast<char*>(bundleName.c_str()), nullptr, nullptr);
+    };
+
+    REQUIRE_SUCCEEDED(packDirectory(package, options));
+    REQUIRE_SUCCEEDED(packDirectory(package, skipValidation));
+    REQUIRE_FALSE(SUCCEEDED(packDirectory(corrupt, options)));
+    REQUIRE_SUCCEEDED(packDirectory(corrupt, skipValidation));
+    REQUIRE_SUCCEEDED(packDirectory(stored, skipValidation));
+    REQUIRE_FALSE(SUCCEEDED(packDirectory(tampered, skipValidation)));
+
+    MsixTest::Directory::CleanDirectory(directory);
+    remove(bundleName.c_str());
+    remove(mappingFile.c_str());
+    remove(corruptPackage.c_str());
+    remove(storedPackage.c_str());
+    remove(tamperedPackage.c_str());
+}
+
+#ifndef WIN32
+// Validates a link to a directory above it doesn't make pack loop
+TEST_CASE("Pack_DirectoryLoop", "[pack]")
+{
+    auto inputPath = MsixTest::Directory::PathAsAbsolute(
+        MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input");
+    std::string directory = "input_loop";
+    // Left behind by a previous run
+    MsixTest::Directory::CleanDirectory(directory);
+    REQUIRE(mkdir(directory.c_str(), S_IRWXU) == 0);
+    REQUIRE(symlink((inputPath + "/AppxManifest.xml").c_str(), (directory + "/AppxManifest.xml").c_str()) == 0);
+    REQUIRE(symlink((inputPath + "/Assets").c_str(), (directory + "/Assets").c_str()) == 0);
+    REQUIRE(symlink(".", (directory + "/again").c_str()) == 0);
+    REQUIRE(mkdir((directory + "/self").c_str(), S_IRWXU) == 0);
+    REQUIRE(symlink("..", (directory + "/self/loop").c_str()) == 0);
+
+    MSIX_PACK_STATISTICS statistics = {};
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    REQUIRE_SUCCEEDED(PackPackage(MSIX_PACKUNPACK_OPTION::MSIX_PACKUNPACK_OPTION_NONE,
+                                  MSIX_VALIDATION_OPTION::MSIX_VALIDATION_OPTION_SKIPSIGNATURE,
+                                  const_cast<char*>(directory.c_str()),
+                                  const_cast<char*>(outputPackage.c_str())));
+    REQUIRE_SUCCEEDED(MsixGetPackStatistics(&statistics, true));
+    // AppxManifest.xml and the 7 files in Assets
+    CHECK(statistics.scannedFiles == 8);
+    CHECK(statistics.scannedDirectories == 3);
+
+    unlink((directory + "/self/loop").c_str());
+    rmdir((directory + "/self").c_str());
+    unlink((directory + "/again").c_str());
+    unlink((directory + "/Assets").c_str());
+    unlink((directory + "/AppxManifest.xml").c_str());
+    rmdir(directory.c_str());
+}
+#endif
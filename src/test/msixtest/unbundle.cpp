@@ -6,8 +6,12 @@
 #include "msixtest_int.hpp"
 #include "UnbundleTestData.hpp"
 #include "FileHelpers.hpp"
+#include "macros.hpp"
 
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <vector>
 
 void RunUnbundleTest(HRESULT expected, const std::string& bundle, MSIX_VALIDATION_OPTION validation,
     MSIX_PACKUNPACK_OPTION packUnpack, MSIX_APPLICABILITY_OPTIONS applicability,
@@ -388,6 +392,308 @@ TEST_CASE("Unbundle_BundleWithIntlPackage", "[unbundle]")
     RunUnbundleTest(expected, bundle, validation, packUnpack, applicability);
 }
 
+// Languages used for applicability instead of the ones of the system
+class TestLanguagesEnumerator final : public IMsixApplicabilityLanguagesEnumerator
+{
+public:
+    TestLanguagesEnumerator(std::vector<std::string> languages) : m_languages(std::move(languages)) {}
+
+    HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) noexcept override
+    {
+        if (ppvObject == nullptr) { return E_INVALIDARG; }
+        *ppvObject = nullptr;
+        if ((riid == UuidOfImpl<IUnknown>::iid) || (riid == UuidOfImpl<IMsixApplicabilityLanguagesEnumerator>::iid))
+        {
+            *ppvObject = static_cast<IMsixApplicabilityLanguagesEnumerator*>(this);
+            AddRef();
+            return S_OK;
+        }
+        return E_NOINTERFACE;
+    }
+
+    ULONG STDMETHODCALLTYPE AddRef() noexcept override { return ++m_ref; }
+
+    ULONG STDMETHODCALLTYPE Release() noexcept override
+    {
+        auto ref = --m_ref;
+        if (ref == 0) { delete this; }
+        return ref;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetCurrent(LPCSTR* bcp47Language) noexcept override
+    {
+        if (m_current >= m_languages.size()) { return E_BOUNDS; }
+        *bcp47Language = m_languages[m_current].c_str();
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetHasCurrent(BOOL* hasCurrent) noexcept override
+    {
+        *hasCurrent = (m_current < m_languages.size()) ? TRUE : FALSE;
+        return S_OK;
+    }
+
+    HRESULT STDMETHODCALLTYPE MoveNext(BOOL* hasNext) noexcept override
+    {
+        m_current++;
+        return GetHasCurrent(hasNext);
+    }
+
+private:
+    std::vector<std::string> m_languages;
+    std::size_t m_current = 0;
+    ULONG m_ref = 1;
+};
+
+// The French resource package of the bundle is corrupted. It keeps the size in the bundle manifest, so only
+// validating the package finds it.
+TEST_CASE("Unbundle_ResourcePackageIsCorrupted_ValidateApplicableOnly", "[unbundle]")
+{
+    std::string bundle = "ResourcePackageIsCorrupted.appxbundle";
+    std::string applicablePackage = "AppPackage_Neutral.appx";
+    std::string corruptedPackage = "ResourcePackage_French.appx";
+
+    auto openBundle = [&bundle](MSIX_VALIDATION_OPTION validation, IAppxBundleReader** bundleReader)
+    {
+        auto bundlePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unbundle) + "/" + bundle;
+        auto inputStream = MsixTest::StreamFile(bundlePath, true);
+
+        MsixTest::ComPtr<IAppxBundleFactory> bundleFactory;
+        REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+            validation, MSIX_APPLICABILITY_OPTION_FULL, &bundleFactory));
+
+        // English only, so the French package is never applicable
+        MsixTest::ComPtr<IMsixFactoryOverrides> factoryOverrides;
+        REQUIRE_SUCCEEDED(bundleFactory->QueryInterface(UuidOfImpl<IMsixFactoryOverrides>::iid, reinterpret_cast<void**>(&factoryOverrides)));
+        auto languages = MsixTest::ComPtr<IMsixApplicabilityLanguagesEnumerator>::Make<TestLanguagesEnumerator>(
+            std::vector<std::string>{ "en-US" });
+        REQUIRE_SUCCEEDED(factoryOverrides->SpecifyExtension(MSIX_FACTORY_EXTENSION_APPLICABILITY_LANGUAGES, languages.Get()));
+
+        return bundleFactory->CreateBundleReader(inputStream.Get(), bundleReader);
+    };
+
+    // Validating every package finds it when the bundle is opened
+    MsixTest::ComPtr<IAppxBundleReader> fullReader;
+    REQUIRE_FAILED(openBundle(MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &fullReader));
+
+    MsixTest::ComPtr<IAppxBundleReader> bundleReader;
+    REQUIRE_SUCCEEDED(openBundle(static_cast<MSIX_VALIDATION_OPTION>(MSIX_VALIDATION_OPTION_SKIPSIGNATURE |
+        MSIX_VALIDATION_OPTION_VALIDATEAPPLICABLEONLY), &bundleReader));
+
+    MsixTest::ComPtr<IAppxBundleReaderUtf8> bundleReaderUtf8;
+    REQUIRE_SUCCEEDED(bundleReader->QueryInterface(UuidOfImpl<IAppxBundleReaderUtf8>::iid, reinterpret_cast<void**>(&bundleReaderUtf8)));
+
+    MsixTest::ComPtr<IAppxFile> package;
+    REQUIRE_SUCCEEDED(bundleReaderUtf8->GetPayloadPackage(applicablePackage.c_str(), &package));
+    MsixTest::ComPtr<IStream> stream;
+    REQUIRE_SUCCEEDED(package->GetStream(&stream));
+
+    // Getting the package requests its stream, which validates it
+    MsixTest::ComPtr<IAppxFile> corrupted;
+    HRESULT hr = bundleReaderUtf8->GetPayloadPackage(corruptedPackage.c_str(), &corrupted);
+    REQUIRE_FAILED(hr);
+    // The failure is kept for later requests
+    MsixTest::ComPtr<IAppxFile> corrupted2;
+    REQUIRE_HR(hr, bundleReaderUtf8->GetPayloadPackage(corruptedPackage.c_str(), &corrupted2));
+}
+
+// Returns the sorted names of the packages of LanguageApplicability.appxbundle that are applicable for the
+// languages. Its application packages are x86 and x64 with en-us, and its resource packages have en-US, en-GB,
+// en, fr-CA, zh-Hans and scale 200.
+std::vector<std::string> GetApplicablePackages(const std::vector<std::string>& languages, MSIX_APPLICABILITY_OPTIONS applicability)
+{
+    auto bundlePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unbundle) + "/LanguageApplicability.appxbundle";
+    auto inputStream = MsixTest::StreamFile(bundlePath, true);
+
+    MsixTest::ComPtr<IAppxBundleFactory> bundleFactory;
+    REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+        MSIX_VALIDATION_OPTION_SKIPSIGNATURE, applicability, &bundleFactory));
+
+    MsixTest::ComPtr<IMsixFactoryOverrides> factoryOverrides;
+    REQUIRE_SUCCEEDED(bundleFactory->QueryInterface(UuidOfImpl<IMsixFactoryOverrides>::iid, reinterpret_cast<void**>(&factoryOverrides)));
+    auto languagesEnumerator = MsixTest::ComPtr<IMsixApplicabilityLanguagesEnumerator>::Make<TestLanguagesEnumerator>(languages);
+    REQUIRE_SUCCEEDED(factoryOverrides->SpecifyExtension(MSIX_FACTORY_EXTENSION_APPLICABILITY_LANGUAGES, languagesEnumerator.Get()));
+
+    MsixTest::ComPtr<IAppxBundleReader> bundleReader;
+    REQUIRE_SUCCEEDED(bundleFactory->CreateBundleReader(inputStream.Get(), &bundleReader));
+
+    MsixTest::ComPtr<IAppxFilesEnumerator> packages;
+    REQUIRE_SUCCEEDED(bundleReader->GetPayloadPackages(&packages));
+
+    std::vector<std::string> names;
+    BOOL hasCurrent = FALSE;
+    REQUIRE_SUCCEEDED(packages->GetHasCurrent(&hasCurrent));
+    while (hasCurrent)
+    {
+        MsixTest::ComPtr<IAppxFile> package;
+        REQUIRE_SUCCEEDED(packages->GetCurrent(&package));
+        MsixTest::ComPtr<IAppxFileUtf8> packageUtf8;
+        REQUIRE_SUCCEEDED(package->QueryInterface(UuidOfImpl<IAppxFileUtf8>::iid, reinterpret_cast<void**>(&packageUtf8)));
+        MsixTest::Wrappers::Buffer<char> name;
+        REQUIRE_SUCCEEDED(packageUtf8->GetName(&name));
+        names.push_back(name.ToString());
+        REQUIRE_SUCCEEDED(packages->MoveNext(&hasCurrent));
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+TEST_CASE("Unbundle_LanguageApplicability", "[unbundle]")
+{
+    // The platform check is disabled, so the application packages of both architectures are always applicable
+    // when their language is.
+    SECTION("Exact and parent matches")
+    {
+        std::vector<std::string> expected = { "AppPackage_x64.appx", "AppPackage_x86.appx",
+            "ResourcePackage_en-US.appx", "ResourcePackage_en.appx" };
+        REQUIRE(expected == GetApplicablePackages({ "en-US" }, MSIX_APPLICABILITY_OPTION_FULL));
+        // Tags are compared ignoring case
+        REQUIRE(expected == GetApplicablePackages({ "EN-us" }, MSIX_APPLICABILITY_OPTION_FULL));
+        // User languages that don't match any package don't change the result
+        REQUIRE(expected == GetApplicablePackages({ "de-DE", "en-US" }, MSIX_APPLICABILITY_OPTION_FULL));
+    }
+
+    SECTION("Region fallback")
+    {
+        // No exact match, so the packages of other regions are used. No application package matches, so all are.
+        std::vector<std::string> expected = { "AppPackage_x64.appx", "AppPackage_x86.appx", "ResourcePackage_fr-CA.appx" };
+        REQUIRE(expected == GetApplicablePackages({ "fr-FR" }, MSIX_APPLICABILITY_OPTION_FULL));
+        // An exact match of another user language drops them
+        expected = { "AppPackage_x64.appx", "AppPackage_x86.appx", "ResourcePackage_en-US.appx", "ResourcePackage_en.appx" };
+        REQUIRE(expected == GetApplicablePackages({ "fr-FR", "en-US" }, MSIX_APPLICABILITY_OPTION_FULL));
+    }
+
+    SECTION("Script only match")
+    {
+        // zh-CN is read as zh-Hans-CN
+        std::vector<std::string> expected = { "AppPackage_x64.appx", "AppPackage_x86.appx", "ResourcePackage_zh-Hans.appx" };
+        REQUIRE(expected == GetApplicablePackages({ "zh-CN" }, MSIX_APPLICABILITY_OPTION_FULL));
+        REQUIRE(expected == GetApplicablePackages({ "zh-hans" }, MSIX_APPLICABILITY_OPTION_FULL));
+        // Another script doesn't match
+        expected = { "AppPackage_x64.appx", "AppPackage_x86.appx" };
+        REQUIRE(expected == GetApplicablePackages({ "zh-Hant-TW" }, MSIX_APPLICABILITY_OPTION_FULL));
+    }
+
+    SECTION("Scale")
+    {
+        // Resource packages with a scale and no language are only applicable when applicability is off
+        std::vector<std::string> expected = { "AppPackage_x64.appx", "AppPackage_x86.appx", "ResourcePackage_en-GB.appx",
+            "ResourcePackage_en-US.appx", "ResourcePackage_en.appx", "ResourcePackage_fr-CA.appx", "ResourcePackage_zh-Hans.appx" };
+        REQUIRE(expected == GetApplicablePackages({ "en-US" }, MSIX_APPLICABILITY_OPTION_SKIPLANGUAGE));
+        expected.insert(expected.end() - 1, "ResourcePackage_scale-200.appx");
+        REQUIRE(expected == GetApplicablePackages({ "en-US" }, static_cast<MSIX_APPLICABILITY_OPTIONS>(MSIX_APPLICABILITY_NONE)));
+    }
+}
+
+#ifdef MSIX_PACK
+// Writes a package with the manifest to stream, and adds it to the bundle
+void AddApplicabilityPackage(IAppxBundleWriter* bundleWriter, const std::string& fileName, const std::string& resources,
+    const std::string& resourceId)
+{
+    std::string manifestName = "AppxManifest.benchmark.xml";
+    std::ofstream(manifestName) <<
+        "<?xml version=\"1.0\" encoding=\"utf-8\"?>"
+        "<Package xmlns=\"http://schemas.microsoft.com/appx/manifest/foundation/windows10\" xmlns:uap=\"http://schemas.microsoft.com/appx/manifest/uap/windows10\">"
+        "<Identity Name=\"Test\" Publisher=\"CN=TestPublisher\" Version=\"1.0.0.0\" " <<
+        (resourceId.empty() ? std::string("ProcessorArchitecture=\"neutral\"") : "ResourceId=\"" + resourceId + "\"") << " />"
+        "<Properties><DisplayName>Test</DisplayName><PublisherDisplayName>Test</PublisherDisplayName><Logo>StoreLogo.png</Logo>" <<
+        (resourceId.empty() ? "" : "<ResourcePackage>true</ResourcePackage>") << "</Properties>"
+        "<Dependencies><TargetDeviceFamily Name=\"Windows.Universal\" MinVersion=\"10.0.10586.0\" MaxVersionTested=\"10.0.16172.0\" /></Dependencies>"
+        "<Resources>" << resources << "</Resources>" <<
+        (resourceId.empty() ? "<Applications><Application Id=\"App\" Executable=\"Test.exe\" EntryPoint=\"Test.App\">"
+            "<uap:VisualElements DisplayName=\"Test\" Square150x150Logo=\"StoreLogo.png\" Square44x44Logo=\"StoreLogo.png\" "
+            "Description=\"Test\" BackgroundColor=\"transparent\" /></Application></Applications>" : "") <<
+        "</Package>";
+    auto manifestStream = MsixTest::StreamFile(manifestName, true, true);
+    auto logoPath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Pack) + "/input/Assets/StoreLogo.png";
+    auto logoStream = MsixTest::StreamFile(logoPath, true);
+
+    auto packageStream = MsixTest::StreamFile(fileName, false, true);
+    MsixTest::ComPtr<IAppxFactory> appxFactory;
+    REQUIRE_SUCCEEDED(CoCreateAppxFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+        MSIX_VALIDATION_OPTION_SKIPSIGNATURE, &appxFactory));
+    MsixTest::ComPtr<IAppxPackageWriter> packageWriter;
+    REQUIRE_SUCCEEDED(appxFactory->CreatePackageWriter(packageStream.Get(), nullptr, &packageWriter));
+    REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(L"StoreLogo.png", L"image/png", APPX_COMPRESSION_OPTION_NONE, logoStream.Get()));
+    if (resourceId.empty())
+    {   // The logo is as good as an executable here
+        LARGE_INTEGER zero = { 0 };
+        REQUIRE_SUCCEEDED(logoStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+        REQUIRE_SUCCEEDED(packageWriter->AddPayloadFile(L"Test.exe", L"application/x-msdownload", APPX_COMPRESSION_OPTION_NONE, logoStream.Get()));
+    }
+    REQUIRE_SUCCEEDED(packageWriter->Close(manifestStream.Get()));
+
+    LARGE_INTEGER zero = { 0 };
+    REQUIRE_SUCCEEDED(packageStream->Seek(zero, STREAM_SEEK_SET, nullptr));
+    REQUIRE_SUCCEEDED(bundleWriter->AddPayloadPackage(MsixTest::String::utf8_to_utf16(fileName).c_str(), packageStream.Get()));
+}
+
+// Time to open a bundle of 300 resource packages with 1 to 3 languages each, with 1 and with 50 user languages.
+// Only the last user language, en-US, matches any package, which is the worst case for comparing every user
+// language with every package language. Only applicable packages are validated, so the time isn't spent reading
+// packages.
+TEST_CASE("Unbundle_LanguageApplicability_Benchmark", "[unbundle][.benchmark]")
+{
+    const std::vector<std::string> packageLanguages = { "fr", "de", "es", "it", "pt", "nl", "sv", "da", "fi", "nb",
+        "pl", "cs", "sk", "hu", "ro", "bg", "el", "tr", "ru", "uk", "he", "ar", "hi", "th", "ja", "ko", "vi", "id",
+        "ms", "ca" };
+    const std::vector<std::string> regions = { "FR", "DE", "ES", "IT", "BR", "NL", "SE", "CA", "MX", "CH" };
+    std::vector<std::string> userLanguages = { "et-EE", "lv-LV", "lt-LT", "sl-SI", "hr-HR", "sr-Latn-RS", "bs-BA",
+        "mk-MK", "sq-AL", "hy-AM", "ka-GE", "az-Latn-AZ", "kk-KZ", "uz-Latn-UZ", "fa-IR", "ur-PK", "bn-IN", "ta-IN",
+        "te-IN", "kn-IN", "ml-IN", "mr-IN", "gu-IN", "pa-IN", "si-LK", "ne-NP", "km-KH", "lo-LA", "my-MM", "am-ET",
+        "sw-KE", "zu-ZA", "xh-ZA", "af-ZA", "is-IS", "ga-IE", "cy-GB", "eu-ES", "gl-ES", "mt-MT", "lb-LU", "fo-FO",
+        "mn-MN", "ps-AF", "ky-KG", "tg-TJ", "tk-TM", "yo-NG", "ig-NG", "en-US" };
+    REQUIRE(userLanguages.size() == 50);
+
+    std::string bundleName = "applicability.appxbundle";
+    {
+        MsixTest::ComPtr<IAppxBundleFactory> bundleFactory;
+        REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+            MSIX_VALIDATION_OPTION_SKIPSIGNATURE, static_cast<MSIX_APPLICABILITY_OPTIONS>(MSIX_APPLICABILITY_NONE), &bundleFactory));
+        auto bundleStream = MsixTest::StreamFile(bundleName, false);
+        MsixTest::ComPtr<IAppxBundleWriter> bundleWriter;
+        REQUIRE_SUCCEEDED(bundleFactory->CreateBundleWriter(bundleStream.Get(), 0x0001000000000000, &bundleWriter));
+
+        AddApplicabilityPackage(bundleWriter.Get(), "app.appx", "<Resource Language=\"en-US\" />", "");
+        for (std::size_t i = 0; i < 300; i++)
+        {
+            std::string resources;
+            for (std::size_t j = 0; j <= i % 3; j++)
+            {
+                resources += "<Resource Language=\"" + packageLanguages[(i + j * 11) % packageLanguages.size()] + "-" +
+                    regions[(i / packageLanguages.size() + j) % regions.size()] + "\" />";
+            }
+            auto id = std::to_string(i);
+            AddApplicabilityPackage(bundleWriter.Get(), "resources" + id + ".appx", resources, "split.resources" + id);
+        }
+        REQUIRE_SUCCEEDED(bundleWriter->Close());
+    }
+
+    auto openBundle = [&bundleName](const std::vector<std::string>& languages)
+    {
+        auto inputStream = MsixTest::StreamFile(bundleName, true);
+        MsixTest::ComPtr<IAppxBundleFactory> bundleFactory;
+        REQUIRE_SUCCEEDED(CoCreateAppxBundleFactoryWithHeap(MsixTest::Allocators::Allocate, MsixTest::Allocators::Free,
+            static_cast<MSIX_VALIDATION_OPTION>(MSIX_VALIDATION_OPTION_SKIPSIGNATURE | MSIX_VALIDATION_OPTION_VALIDATEAPPLICABLEONLY),
+            MSIX_APPLICABILITY_OPTION_FULL, &bundleFactory));
+        MsixTest::ComPtr<IMsixFactoryOverrides> factoryOverrides;
+        REQUIRE_SUCCEEDED(bundleFactory->QueryInterface(UuidOfImpl<IMsixFactoryOverrides>::iid, reinterpret_cast<void**>(&factoryOverrides)));
+        auto languagesEnumerator = MsixTest::ComPtr<IMsixApplicabilityLanguagesEnumerator>::Make<TestLanguagesEnumerator>(languages);
+        REQUIRE_SUCCEEDED(factoryOverrides->SpecifyExtension(MSIX_FACTORY_EXTENSION_APPLICABILITY_LANGUAGES, languagesEnumerator.Get()));
+        MsixTest::ComPtr<IAppxBundleReader> bundleReader;
+        REQUIRE_SUCCEEDED(bundleFactory->CreateBundleReader(inputStream.Get(), &bundleReader));
+    };
+
+    const std::size_t runs = 20;
+    auto one = MsixTest::Benchmark::Measure(runs, [&]() { openBundle({ "en-US" }); });
+    auto fifty = MsixTest::Benchmark::Measure(runs, [&]() { openBundle(userLanguages); });
+    std::cout << "Open with 1 user language:   " << one << " us" << std::endl;
+    std::cout << "Open with 50 user languages: " << fifty << " us" << std::endl;
+
+    remove(bundleName.c_str());
+}
+#endif
+
 TEST_CASE("Unbundle_FlatBundleWithAsset", "[unbundle][flat]")
 {
     HRESULT expected                         = S_OK;
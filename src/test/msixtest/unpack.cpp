@@ -8,6 +8,15 @@
 #include "FileHelpers.hpp"
 
 #include <iostream>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstring>
+
+#ifndef WIN32
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 void RunUnpackTest(HRESULT expected, const std::string& package, MSIX_VALIDATION_OPTION validation,
     MSIX_PACKUNPACK_OPTION packUnpack, bool clean = true, bool absolutePaths = false)
@@ -356,6 +365,165 @@ TEST_CASE("Unpack_IntlCharsInPath", "[unpack]")
     RunUnpackTest(expected, package, validation, packUnpack);
 }
 
+TEST_CASE("Unpack_Incremental", "[unpack]")
+{
+    HRESULT expected                  = S_OK;
+    std::string package               = "TestAppxPackage_Win32.appx";
+    MSIX_VALIDATION_OPTION validation = MSIX_VALIDATION_OPTION_SKIPSIGNATURE;
+
+    auto outputDir = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Output);
+    std::string executable = outputDir + "/TestAppxPackage.exe";
+    auto GetFileSize = [](const std::string& file) -> std::int64_t
+    {
+        std::ifstream stream(file, std::ios::binary | std::ios::ate);
+        return stream.good() ? static_cast<std::int64_t>(stream.tellg()) : -1;
+    };
+
+    // Files from a previous unpack that are not in the new package are deleted
+    RunUnpackTest(expected, "HelloWorld.appx", validation, MSIX_PACKUNPACK_OPTION_INCREMENTAL, false);
+    CHECK(GetFileSize(outputDir + "/.msixunpackstate") > 0);
+    CHECK(GetFileSize(outputDir + "/bubbles.txt") == 28470);
+    RunUnpackTest(expected, package, validation, MSIX_PACKUNPACK_OPTION_DELETEREMOVEDFILES, false);
+    CHECK(GetFileSize(outputDir + "/bubbles.txt") == -1);
+    CHECK(GetFileSize(outputDir + "/Assets/StoreLogo.png") == 1451);
+    CHECK(GetFileSize(executable) == 186368);
+    CHECK(GetFileSize(executable + ".msixtmp") == -1);
+
+    // Unchanged files tracked by the unpack state are trusted unless verify existing is specified
+    {
+        std::ofstream tampered(executable, std::ios::binary | std::ios::trunc);
+        tampered << "tampered";
+    }
+    RunUnpackTest(expected, package, validation, MSIX_PACKUNPACK_OPTION_INCREMENTAL, false);
+    CHECK(GetFileSize(executable) == 8);
+    RunUnpackTest(expected, package, validation, MSIX_PACKUNPACK_OPTION_VERIFYEXISTINGFILES, false);
+    CHECK(GetFileSize(executable) == 186368);
+
+    // Missing files are extracted again
+    CHECK(std::remove(executable.c_str()) == 0);
+    RunUnpackTest(expected, package, validation, MSIX_PACKUNPACK_OPTION_INCREMENTAL);
+}
+
+#ifndef WIN32
+// Validates an incremental unpack that fails after replacing files doesn't leave a stale state behind
+TEST_CASE("Unpack_Incremental_Failure", "[unpack]")
+{
+    std::string package               = "TestAppxPackage_Win32.appx";
+    MSIX_VALIDATION_OPTION validation = MSIX_VALIDATION_OPTION_SKIPSIGNATURE;
+
+    auto outputDir = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Output);
+    std::string logo = outputDir + "/Assets/LockScreenLogo.scale-200.png";
+    std::string winmd = outputDir + "/TestAppxPackage.winmd";
+    auto FileExists = [](const std::string& file) { return std::ifstream(file).good(); };
+
+    RunUnpackTest(S_OK, package, validation, MSIX_PACKUNPACK_OPTION_INCREMENTAL, false);
+    REQUIRE(FileExists(outputDir + "/.msixunpackstate"));
+
+    // The logo is extracted first, then the winmd can't be written because its temporary file is a directory
+    CHECK(std::remove(logo.c_str()) == 0);
+    CHECK(std::remove(winmd.c_str()) == 0);
+    REQUIRE(mkdir((winmd + ".msixtmp").c_str(), S_IRWXU) == 0);
+    RunUnpackTest(static_cast<HRESULT>(MSIX::Error::FileOpen), package, validation, MSIX_PACKUNPACK_OPTION_INCREMENTAL, false);
+    rmdir((winmd + ".msixtmp").c_str());
+    CHECK(FileExists(logo));
+    CHECK_FALSE(FileExists(outputDir + "/.msixunpackstate"));
+
+    RunUnpackTest(S_OK, package, validation, MSIX_PACKUNPACK_OPTION_INCREMENTAL);
+}
+#endif
+
+// Reads the entries of a tar file. Returns false if the end of archive marker is missing or a header is invalid.
+bool ReadTarEntries(const std::string& tarFile, std::map<std::string, std::uint64_t>& entries, std::string& content)
+{
+    std::ifstream stream(tarFile, std::ios::binary);
+    content.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    std::size_t offset = 0;
+    while (offset + 512 <= content.size())
+    {
+        const char* header = content.data() + offset;
+        if (std::all_of(header, header + 512, [](char c) { return c == '\0'; }))
+        {
+            return (offset + 1024 == content.size());
+        }
+        if (std::string(header + 257, 5) != "ustar")
+        {
+            return false;
+        }
+        std::string name(header, strnlen(header, 100));
+        std::uint64_t size = std::stoull(std::string(header + 124, 11), nullptr, 8);
+        if (header[156] == '0')
+        {
+            entries[name] = size;
+        }
+        offset += 512 + ((size + 511) / 512) * 512;
+    }
+    return false;
+}
+
+TEST_CASE("Unpack_To_Tar", "[unpack]")
+{
+    HRESULT expected                  = S_OK;
+    std::string package               = "TestAppxPackage_Win32.appx";
+    MSIX_VALIDATION_OPTION validation = MSIX_VALIDATION_OPTION_SKIPSIGNATURE;
+    MSIX_PACKUNPACK_OPTION packUnpack = MSIX_PACKUNPACK_OPTION_NONE;
+
+    auto packagePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unpack) + "/" + package;
+    packagePath = MsixTest::Directory::PathAsCurrentPlatform(packagePath);
+    std::string tarFile = "Unpack_To_Tar.tar";
+
+    HRESULT actual = UnpackPackageToTar(packUnpack, validation,
+        const_cast<char*>(packagePath.c_str()), const_cast<char*>(tarFile.c_str()));
+    CHECK(expected == actual);
+    MsixTest::Log::PrintMsixLog(expected, actual);
+
+    std::map<std::string, std::uint64_t> entries;
+    std::string content;
+    CHECK(ReadTarEntries(tarFile, entries, content));
+    CHECK(entries.size() == 14);
+    CHECK(entries["TestAppxPackage.exe"] == 186368);
+    CHECK(entries["Assets/StoreLogo.png"] == 1451);
+    CHECK(entries["AppxMetadata/CodeIntegrity.cat"] == 2528);
+    CHECK(std::remove(tarFile.c_str()) == 0);
+}
+
+TEST_CASE("Unpack_To_Tar_Corrupted_Block", "[unpack]")
+{
+    HRESULT expected                  = static_cast<HRESULT>(MSIX::Error::SignatureInvalid);
+    std::string package               = "TestAppxPackage_Win32.appx";
+    MSIX_VALIDATION_OPTION validation = MSIX_VALIDATION_OPTION_SKIPSIGNATURE;
+    MSIX_PACKUNPACK_OPTION packUnpack = MSIX_PACKUNPACK_OPTION_NONE;
+
+    auto packagePath = MsixTest::TestPath::GetInstance()->GetPath(MsixTest::TestPath::Directory::Unpack) + "/" + package;
+    packagePath = MsixTest::Directory::PathAsCurrentPlatform(packagePath);
+    std::string corruptedPackage = "Unpack_To_Tar_Corrupted.appx";
+    std::string tarFile = "Unpack_To_Tar_Corrupted.tar";
+
+    // Flip a byte in the middle of Assets/SplashScreen.scale-200.png, which is stored uncompressed
+    {
+        std::ifstream source(packagePath, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+        REQUIRE(bytes.size() > 4000);
+        bytes[4000] = ~bytes[4000];
+        std::ofstream target(corruptedPackage, std::ios::binary | std::ios::trunc);
+        target.write(bytes.data(), bytes.size());
+    }
+
+    HRESULT actual = UnpackPackageToTar(packUnpack, validation,
+        const_cast<char*>(corruptedPackage.c_str()), const_cast<char*>(tarFile.c_str()));
+    CHECK(expected == actual);
+    MsixTest::Log::PrintMsixLog(expected, actual);
+
+    // The stream ends with the error trailer instead of the end of archive marker
+    std::map<std::string, std::uint64_t> entries;
+    std::string content;
+    CHECK_FALSE(ReadTarEntries(tarFile, entries, content));
+    CHECK(content.find("MSIX.error=") != std::string::npos);
+    CHECK(entries.find("TestAppxPackage.exe") == entries.end());
+
+    CHECK(std::remove(tarFile.c_str()) == 0);
+    CHECK(std::remove(corruptedPackage.c_str()) == 0);
+}
+
 TEST_CASE("Unpack_To_Absolute_Path", "[unpack]")
 {
     HRESULT expected                  = S_OK;